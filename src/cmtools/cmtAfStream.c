@@ -0,0 +1,493 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmAudioFile.h"
+
+#include "cmtAfStream.h"
+#include "cmtTrace.h"
+
+#include <pthread.h>
+#include <time.h>
+
+cmtAfRdH_t cmtAfRdNullHandle = cmSTATIC_NULL_HANDLE;
+cmtAfWrH_t cmtAfWrNullHandle = cmSTATIC_NULL_HANDLE;
+
+// Block ring shared by the reader and the writer.
+// Blocks [ri, ri+fullCnt) hold data which the consumer has not released.
+typedef struct
+{
+  cmErr_t         err;
+  cmAudioFileH_t  afH;
+  cmChar_t*       fn;
+  unsigned        chIdx;
+  unsigned        blkSmpCnt;
+  unsigned        blkCnt;
+  cmSample_t*     bufV;       // bufV[blkCnt*blkSmpCnt]
+  unsigned*       cntV;       // cntV[blkCnt] count of samples in each block
+  unsigned        ri;         // index of the next block to consume
+  unsigned        wi;         // index of the next block to fill
+  unsigned        fullCnt;    // count of filled blocks
+  bool            doneFl;     // reader: the thread will not fill any more blocks
+  bool            stopFl;     // the stream is being destroyed
+  cmtAfsRC_t      ioRC;       // first I/O error
+  unsigned        remSmpCnt;  // reader: samples remaining to read or cmInvalidCnt for no limit
+  bool            heldFl;     // reader: the caller holds block 'ri'
+  unsigned        fillCnt;    // writer: count of samples in block 'wi'
+  bool            threadFl;
+  pthread_t       thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  cmtAfsStats_t   stats;
+} cmtAfs_t;
+
+double _cmtAfsSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+cmtAfs_t* _cmtAfsHandleToPtr( void* h )
+{
+  cmtAfs_t* p = (cmtAfs_t*)h;
+  assert( p != NULL );
+  return p;
+}
+
+// Wait on the condition while recording the caller stall time.
+void _cmtAfsStall( cmtAfs_t* p )
+{
+  double t0 = _cmtAfsSecs();
+  pthread_cond_wait(&p->cond,&p->mutex);
+  p->stats.stallSecs += _cmtAfsSecs() - t0;
+}
+
+void _cmtAfsFree( cmtAfs_t* p )
+{
+  if( p->threadFl )
+  {
+    pthread_mutex_lock(&p->mutex);
+    p->stopFl = true;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    pthread_join(p->thread,NULL);
+  }
+
+  pthread_cond_destroy(&p->cond);
+  pthread_mutex_destroy(&p->mutex);
+  cmMemFree(p->fn);
+  cmMemFree(p->bufV);
+  cmMemFree(p->cntV);
+  cmMemFree(p);
+}
+
+cmtAfsRC_t _cmtAfsCreate( cmCtx_t* ctx, cmtAfs_t** pp, const cmChar_t* label, cmAudioFileH_t afH, const cmChar_t* fn, unsigned chIdx, unsigned blkSmpCnt, unsigned blkCnt, unsigned maxSmpCnt, void* (*threadFunc)(void*) )
+{
+  cmtAfsRC_t rc = kOkAfsRC;
+  cmtAfs_t*  p  = cmMemAllocZ(cmtAfs_t,1);
+
+  cmErrSetup(&p->err,&ctx->rpt,label);
+
+  p->afH       = afH;
+  p->fn        = cmMemAllocStr(fn==NULL ? "" : fn);
+  p->chIdx     = chIdx;
+  p->blkSmpCnt = blkSmpCnt;
+  p->blkCnt    = blkCnt;
+  p->bufV      = cmMemAllocZ(cmSample_t,blkCnt*blkSmpCnt);
+  p->cntV      = cmMemAllocZ(unsigned,blkCnt);
+  p->remSmpCnt = maxSmpCnt == 0 ? cmInvalidCnt : maxSmpCnt;
+
+  pthread_mutex_init(&p->mutex,NULL);
+  pthread_cond_init(&p->cond,NULL);
+
+  if( blkSmpCnt == 0 || blkCnt < 2 || cmAudioFileIsValid(afH)==false )
+  {
+    rc = cmErrMsg(&p->err,kInvalidArgAfsRC,"The audio file stream for '%s' requires a valid audio file, a non-zero block size and at least two blocks.",p->fn);
+    goto errLabel;
+  }
+
+  if( pthread_create(&p->thread,NULL,threadFunc,p) != 0 )
+  {
+    rc = cmErrMsg(&p->err,kThreadFailAfsRC,"The audio file stream thread for '%s' could not be created.",p->fn);
+    goto errLabel;
+  }
+
+  p->threadFl = true;
+
+ errLabel:
+  if( rc != kOkAfsRC )
+    _cmtAfsFree(p);
+  else
+    *pp = p;
+
+  return rc;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Reader
+//----------------------------------------------------------------------------------------------------
+
+void* _cmtAfRdThreadFunc( void* arg )
+{
+  cmtAfs_t*   p        = (cmtAfs_t*)arg;
+  unsigned    opCnt    = 0;
+  double      busySecs = 0;
+  cmtTrSpan_t sp;
+
+  // one trace span covers all of the reads of the stream
+  cmtTrBegin(&sp,kIoTrCat,"read",p->fn);
+
+  while(1)
+  {
+    pthread_mutex_lock(&p->mutex);
+
+    // wait for an empty block
+    while( p->fullCnt == p->blkCnt && p->stopFl == false )
+      pthread_cond_wait(&p->cond,&p->mutex);
+
+    bool     stopFl = p->stopFl;
+    unsigned wi     = p->wi;
+
+    pthread_mutex_unlock(&p->mutex);
+
+    if( stopFl )
+      break;
+
+    // read the next block outside of the lock
+    cmSample_t* bp        = p->bufV + wi * p->blkSmpCnt;
+    unsigned    smpCnt    = cmMin(p->blkSmpCnt,p->remSmpCnt);
+    unsigned    actFrmCnt = 0;
+    cmtAfsRC_t  rc        = kOkAfsRC;
+    double      t0        = _cmtAfsSecs();
+
+    if( smpCnt > 0 && cmAudioFileReadSample(p->afH, smpCnt, p->chIdx, 1, &bp, &actFrmCnt ) != kOkAfRC )
+      rc = kAudioFileFailAfsRC;
+
+    double dt = _cmtAfsSecs() - t0;
+
+    busySecs += dt;
+    opCnt    += 1;
+
+    if( p->remSmpCnt != cmInvalidCnt )
+      p->remSmpCnt -= actFrmCnt;
+
+    pthread_mutex_lock(&p->mutex);
+
+    p->cntV[wi] = actFrmCnt;
+    p->wi       = (p->wi + 1) % p->blkCnt;
+    p->fullCnt += 1;
+    p->stats.blkCnt += 1;
+    p->stats.ioSecs += dt;
+
+    if( rc != kOkAfsRC )
+      p->ioRC = rc;
+
+    // a short block marks the end of the stream
+    p->doneFl = actFrmCnt < p->blkSmpCnt || rc != kOkAfsRC;
+
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    if( p->doneFl )
+      break;
+  }
+
+  cmtTrEndAgg(&sp,opCnt,busySecs);
+
+  return NULL;
+}
+
+cmtAfsRC_t cmtAfRdCreate( cmCtx_t* ctx, cmtAfRdH_t* hp, cmAudioFileH_t afH, const cmChar_t* fn, unsigned chIdx, unsigned blkSmpCnt, unsigned blkCnt, unsigned maxSmpCnt )
+{
+  cmtAfsRC_t rc;
+  cmtAfs_t*  p = NULL;
+
+  if((rc = cmtAfRdDestroy(hp)) != kOkAfsRC )
+    return rc;
+
+  if((rc = _cmtAfsCreate(ctx,&p,"AF Reader",afH,fn,chIdx,blkSmpCnt,blkCnt,maxSmpCnt,_cmtAfRdThreadFunc)) != kOkAfsRC )
+    return rc;
+
+  hp->h = p;
+  return rc;
+}
+
+cmtAfsRC_t cmtAfRdDestroy( cmtAfRdH_t* hp )
+{
+  if( hp == NULL || cmtAfRdIsValid(*hp) == false )
+    return kOkAfsRC;
+
+  _cmtAfsFree(_cmtAfsHandleToPtr(hp->h));
+  hp->h = NULL;
+  return kOkAfsRC;
+}
+
+bool cmtAfRdIsValid( cmtAfRdH_t h )
+{ return h.h != NULL; }
+
+cmtAfsRC_t cmtAfRdGet( cmtAfRdH_t h, const cmSample_t** bufRef, unsigned* smpCntRef )
+{
+  cmtAfs_t*  p  = _cmtAfsHandleToPtr(h.h);
+  cmtAfsRC_t rc = kOkAfsRC;
+
+  *bufRef    = NULL;
+  *smpCntRef = 0;
+
+  pthread_mutex_lock(&p->mutex);
+
+  // release the block returned by the previous call
+  if( p->heldFl )
+  {
+    p->ri       = (p->ri + 1) % p->blkCnt;
+    p->fullCnt -= 1;
+    p->heldFl   = false;
+    pthread_cond_broadcast(&p->cond);
+  }
+
+  while( p->fullCnt == 0 && p->doneFl == false )
+    _cmtAfsStall(p);
+
+  if( p->fullCnt > 0 )
+  {
+    *bufRef    = p->bufV + p->ri * p->blkSmpCnt;
+    *smpCntRef = p->cntV[p->ri];
+    p->heldFl  = true;
+  }
+  else
+    if( p->ioRC != kOkAfsRC )
+      rc = cmErrMsg(&p->err,p->ioRC,"Audio file read failed on '%s'.",p->fn);
+
+  pthread_mutex_unlock(&p->mutex);
+
+  return rc;
+}
+
+// Copy the stats under the lock - the I/O thread updates them while it runs.
+cmtAfsStats_t _cmtAfsStats( cmtAfs_t* p )
+{
+  cmtAfsStats_t s;
+
+  pthread_mutex_lock(&p->mutex);
+  s = p->stats;
+  pthread_mutex_unlock(&p->mutex);
+
+  return s;
+}
+
+cmtAfsStats_t cmtAfRdStats( cmtAfRdH_t h )
+{ return _cmtAfsStats(_cmtAfsHandleToPtr(h.h)); }
+
+//----------------------------------------------------------------------------------------------------
+// Writer
+//----------------------------------------------------------------------------------------------------
+
+void* _cmtAfWrThreadFunc( void* arg )
+{
+  cmtAfs_t*   p        = (cmtAfs_t*)arg;
+  unsigned    opCnt    = 0;
+  double      busySecs = 0;
+  cmtTrSpan_t sp;
+
+  // one trace span covers all of the writes of the stream
+  cmtTrBegin(&sp,kIoTrCat,"write",p->fn);
+
+  while(1)
+  {
+    pthread_mutex_lock(&p->mutex);
+
+    // wait for a full block
+    while( p->fullCnt == 0 && p->stopFl == false )
+      pthread_cond_wait(&p->cond,&p->mutex);
+
+    // the writer is only stopped after it has been flushed
+    bool     exitFl = p->fullCnt == 0;
+    unsigned ri     = p->ri;
+    unsigned n      = p->cntV[ri];
+
+    pthread_mutex_unlock(&p->mutex);
+
+    if( exitFl )
+      break;
+
+    // write the block outside of the lock - after a failure the blocks are discarded
+    cmSample_t* bp = p->bufV + ri * p->blkSmpCnt;
+    double      t0 = _cmtAfsSecs();
+    cmtAfsRC_t  rc = kOkAfsRC;
+
+    if( p->ioRC == kOkAfsRC && cmAudioFileWriteSample(p->afH, n, 1, &bp ) != kOkAfRC )
+      rc = kAudioFileFailAfsRC;
+
+    double dt = _cmtAfsSecs() - t0;
+
+    busySecs += dt;
+    opCnt    += 1;
+
+    pthread_mutex_lock(&p->mutex);
+
+    p->ri       = (p->ri + 1) % p->blkCnt;
+    p->fullCnt -= 1;
+    p->stats.blkCnt += 1;
+    p->stats.ioSecs += dt;
+
+    if( rc != kOkAfsRC )
+      p->ioRC = rc;
+
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+  }
+
+  cmtTrEndAgg(&sp,opCnt,busySecs);
+
+  return NULL;
+}
+
+// Queue the partially filled block 'wi'. Call with the mutex locked.
+void _cmtAfWrQueue( cmtAfs_t* p )
+{
+  p->cntV[p->wi] = p->fillCnt;
+  p->wi          = (p->wi + 1) % p->blkCnt;
+  p->fullCnt    += 1;
+  p->fillCnt     = 0;
+  pthread_cond_broadcast(&p->cond);
+}
+
+cmtAfsRC_t _cmtAfWrError( cmtAfs_t* p )
+{
+  cmtAfsRC_t rc = p->ioRC;
+
+  if( rc != kOkAfsRC )
+    rc = cmErrMsg(&p->err,rc,"Audio file write failed on '%s'.",p->fn);
+
+  return rc;
+}
+
+cmtAfsRC_t cmtAfWrCreate( cmCtx_t* ctx, cmtAfWrH_t* hp, cmAudioFileH_t afH, const cmChar_t* fn, unsigned blkSmpCnt, unsigned blkCnt )
+{
+  cmtAfsRC_t rc;
+  cmtAfs_t*  p = NULL;
+
+  if((rc = cmtAfWrDestroy(hp)) != kOkAfsRC )
+    return rc;
+
+  if((rc = _cmtAfsCreate(ctx,&p,"AF Writer",afH,fn,0,blkSmpCnt,blkCnt,0,_cmtAfWrThreadFunc)) != kOkAfsRC )
+    return rc;
+
+  hp->h = p;
+  return rc;
+}
+
+cmtAfsRC_t cmtAfWrDestroy( cmtAfWrH_t* hp )
+{
+  cmtAfsRC_t rc = kOkAfsRC;
+
+  if( hp == NULL || cmtAfWrIsValid(*hp) == false )
+    return rc;
+
+  cmtAfs_t* p = _cmtAfsHandleToPtr(hp->h);
+
+  rc = cmtAfWrFlush(*hp);
+
+  _cmtAfsFree(p);
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtAfWrIsValid( cmtAfWrH_t h )
+{ return h.h != NULL; }
+
+cmtAfsRC_t cmtAfWrWrite( cmtAfWrH_t h, const cmSample_t* v, unsigned smpCnt )
+{
+  cmtAfs_t*  p  = _cmtAfsHandleToPtr(h.h);
+  cmtAfsRC_t rc = kOkAfsRC;
+
+  while( smpCnt > 0 )
+  {
+    // wait for block 'wi' to be written before filling it
+    if( p->fillCnt == 0 )
+    {
+      pthread_mutex_lock(&p->mutex);
+
+      while( p->fullCnt == p->blkCnt )
+        _cmtAfsStall(p);
+
+      rc = p->ioRC;
+
+      pthread_mutex_unlock(&p->mutex);
+
+      if( rc != kOkAfsRC )
+        return _cmtAfWrError(p);
+    }
+
+    // block 'wi' is owned by the caller until it is queued
+    unsigned n = cmMin(smpCnt, p->blkSmpCnt - p->fillCnt);
+
+    memcpy(p->bufV + p->wi*p->blkSmpCnt + p->fillCnt, v, n*sizeof(cmSample_t));
+
+    p->fillCnt += n;
+    v          += n;
+    smpCnt     -= n;
+
+    if( p->fillCnt == p->blkSmpCnt )
+    {
+      pthread_mutex_lock(&p->mutex);
+      _cmtAfWrQueue(p);
+      pthread_mutex_unlock(&p->mutex);
+    }
+  }
+
+  return rc;
+}
+
+cmtAfsRC_t cmtAfWrFlush( cmtAfWrH_t h )
+{
+  cmtAfs_t* p = _cmtAfsHandleToPtr(h.h);
+
+  pthread_mutex_lock(&p->mutex);
+
+  if( p->fillCnt > 0 )
+  {
+    while( p->fullCnt == p->blkCnt )
+      _cmtAfsStall(p);
+
+    _cmtAfWrQueue(p);
+  }
+
+  while( p->fullCnt > 0 )
+    _cmtAfsStall(p);
+
+  pthread_mutex_unlock(&p->mutex);
+
+  return _cmtAfWrError(p);
+}
+
+cmtAfsStats_t cmtAfWrStats( cmtAfWrH_t h )
+{ return _cmtAfsStats(_cmtAfsHandleToPtr(h.h)); }
+
+//----------------------------------------------------------------------------------------------------
+
+void cmtAfsReport( cmRpt_t* rpt, const cmChar_t* label, cmtAfRdH_t rdH, cmtAfWrH_t wrH )
+{
+  cmRptPrintf(rpt,"%s",label==NULL ? "" : label);
+
+  if( cmtAfRdIsValid(rdH) )
+  {
+    cmtAfsStats_t s = cmtAfRdStats(rdH);
+    cmRptPrintf(rpt," read blocks:%i io:%f stall:%f",s.blkCnt,s.ioSecs,s.stallSecs);
+  }
+
+  if( cmtAfWrIsValid(wrH) )
+  {
+    cmtAfsStats_t s = cmtAfWrStats(wrH);
+    cmRptPrintf(rpt," write blocks:%i io:%f stall:%f",s.blkCnt,s.ioSecs,s.stallSecs);
+  }
+
+  cmRptPrint(rpt," secs\n");
+}
@@ -0,0 +1,83 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtAfStream_h
+#define cmtAfStream_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Asynchronous audio file block reader and writer.
+  //
+  // Each stream owns a ring of 'blkCnt' blocks of 'blkSmpCnt' samples and
+  // a thread which performs the audio file reads (or writes).  The reader
+  // fills the ring ahead of the caller and the writer empties it behind the
+  // caller so that the computation overlaps the file I/O.
+  //
+  // The audio file handle is used only by the stream thread while the stream
+  // exists. The caller must not access it until the stream is destroyed.
+  //
+  // The time the caller spent waiting on the I/O thread is recorded as
+  // the stream 'stall' time.
+
+  enum
+  {
+    kOkAfsRC = cmOkRC,
+    kThreadFailAfsRC,
+    kAudioFileFailAfsRC,
+    kInvalidArgAfsRC
+  };
+
+  typedef cmRC_t cmtAfsRC_t;
+
+  typedef struct { void* h; } cmtAfRdH_t;
+  typedef struct { void* h; } cmtAfWrH_t;
+
+  extern cmtAfRdH_t cmtAfRdNullHandle;
+  extern cmtAfWrH_t cmtAfWrNullHandle;
+
+  typedef struct
+  {
+    unsigned blkCnt;     // count of blocks read or written
+    double   ioSecs;     // time spent by the I/O thread reading or writing
+    double   stallSecs;  // time spent by the caller waiting on the I/O thread
+  } cmtAfsStats_t;
+
+  // Read channel 'chIdx' of 'afH' from the current file position.  Reading stops at
+  // the end of the file or after 'maxSmpCnt' samples (set maxSmpCnt to 0 to read to the end).
+  cmtAfsRC_t cmtAfRdCreate(  cmCtx_t* ctx, cmtAfRdH_t* hp, cmAudioFileH_t afH, const cmChar_t* fn, unsigned chIdx, unsigned blkSmpCnt, unsigned blkCnt, unsigned maxSmpCnt );
+  cmtAfsRC_t cmtAfRdDestroy( cmtAfRdH_t* hp );
+  bool       cmtAfRdIsValid( cmtAfRdH_t h );
+
+  // Return the next block. The block remains valid until the next call to cmtAfRdGet().
+  // *smpCntRef is less than blkSmpCnt on the last block and 0 after the last block.
+  cmtAfsRC_t cmtAfRdGet( cmtAfRdH_t h, const cmSample_t** bufRef, unsigned* smpCntRef );
+
+  // Return a copy of the stats.  The reader thread may still be reading ahead
+  // so the copy is a snapshot taken under the stream lock.
+  cmtAfsStats_t cmtAfRdStats( cmtAfRdH_t h );
+
+  // Write single channel samples to 'afH' from the current file position.
+  cmtAfsRC_t cmtAfWrCreate(  cmCtx_t* ctx, cmtAfWrH_t* hp, cmAudioFileH_t afH, const cmChar_t* fn, unsigned blkSmpCnt, unsigned blkCnt );
+
+  // Write the pending blocks and stop the thread. The return value
+  // reports any write failure which occurred after the last cmtAfWrWrite().
+  cmtAfsRC_t cmtAfWrDestroy( cmtAfWrH_t* hp );
+  bool       cmtAfWrIsValid( cmtAfWrH_t h );
+
+  // Copy smpCnt samples into the ring. The call only blocks when the ring is full.
+  cmtAfsRC_t cmtAfWrWrite( cmtAfWrH_t h, const cmSample_t* v, unsigned smpCnt );
+
+  // Wait for the pending blocks to be written.  The stats are final after this call.
+  cmtAfsRC_t cmtAfWrFlush( cmtAfWrH_t h );
+
+  cmtAfsStats_t cmtAfWrStats( cmtAfWrH_t h );
+
+  // Print a snapshot of the stats of the valid streams.
+  void cmtAfsReport( cmRpt_t* rpt, const cmChar_t* label, cmtAfRdH_t rdH, cmtAfWrH_t wrH );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,313 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmSymTbl.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmMidiFile.h"
+#include "cmAudioFile.h"
+#include "cmTimeLine.h"
+#include "cmScore.h"
+
+#include "cmtCache.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+cmtCacheH_t cmtCacheNullHandle = cmSTATIC_NULL_HANDLE;
+
+enum
+{
+  kScoreCacheId,
+  kMidiCacheId,
+  kTimeLineCacheId
+};
+
+typedef struct
+{
+  unsigned        typeId;      // kScoreCacheId ...
+  cmChar_t*       fn;
+  cmChar_t*       prefixPath;  // time line data path prefix or NULL
+  double          srate;       // score sample rate
+  struct timespec mtime;       // modification time of 'fn' when it was loaded
+  off_t           byteCnt;     // size of 'fn' when it was loaded
+  unsigned        useCnt;      // value of cmtCache_t.useCnt when this entry was last used
+  cmScH_t         scH;
+  cmMidiFileH_t   mfH;
+  cmTlH_t         tlH;
+} cmtCacheEntry_t;
+
+typedef struct
+{
+  cmErr_t          err;
+  cmCtx_t*         ctx;
+  cmtCacheEntry_t* entryV;     // entryV[maxEntryN]
+  unsigned         entryN;
+  unsigned         maxEntryN;
+  unsigned         useCnt;     // incremented on each cache access
+  unsigned         hitCnt;
+  unsigned         missCnt;
+} cmtCache_t;
+
+cmtCache_t* _cmtCacheHandleToPtr( cmtCacheH_t h )
+{
+  cmtCache_t* p = (cmtCache_t*)h.h;
+  assert( p != NULL );
+  return p;
+}
+
+void _cmtCacheEntryRelease( cmtCacheEntry_t* e )
+{
+  switch( e->typeId )
+  {
+    case kScoreCacheId:    cmScoreFinalize(&e->scH);    break;
+    case kMidiCacheId:     cmMidiFileClose(&e->mfH);    break;
+    case kTimeLineCacheId: cmTimeLineFinalize(&e->tlH); break;
+  }
+
+  cmMemFree(e->fn);
+  cmMemFree(e->prefixPath);
+  memset(e,0,sizeof(*e));
+}
+
+cmtCacheRC_t _cmtCacheFree( cmtCache_t* p )
+{
+  unsigned i;
+
+  for(i=0; i<p->entryN; ++i)
+    _cmtCacheEntryRelease(p->entryV + i);
+
+  cmMemFree(p->entryV);
+  cmMemFree(p);
+  return kOkCacheRC;
+}
+
+cmtCacheRC_t cmtCacheCreate( cmCtx_t* ctx, cmtCacheH_t* hp, unsigned maxEntryN )
+{
+  cmtCacheRC_t rc;
+
+  if((rc = cmtCacheDestroy(hp)) != kOkCacheRC )
+    return rc;
+
+  cmtCache_t* p = cmMemAllocZ(cmtCache_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"Cache");
+  p->ctx       = ctx;
+  p->maxEntryN = cmMax(maxEntryN,3);
+  p->entryV    = cmMemAllocZ(cmtCacheEntry_t,p->maxEntryN);
+
+  hp->h = p;
+  return rc;
+}
+
+cmtCacheRC_t cmtCacheDestroy( cmtCacheH_t* hp )
+{
+  cmtCacheRC_t rc = kOkCacheRC;
+
+  if( hp == NULL || cmtCacheIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtCacheFree(_cmtCacheHandleToPtr(*hp))) != kOkCacheRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtCacheIsValid( cmtCacheH_t h )
+{ return h.h != NULL; }
+
+bool _cmtCacheStrIsEqual( const cmChar_t* s0, const cmChar_t* s1 )
+{
+  if( s0 == NULL || s1 == NULL )
+    return s0 == s1;
+  return strcmp(s0,s1) == 0;
+}
+
+// Return the current entry for a file or NULL if the file is not cached.
+// A stale entry is released. On return *stRef holds the status of 'fn'.
+cmtCacheEntry_t* _cmtCacheFind( cmtCache_t* p, unsigned typeId, const cmChar_t* fn, const cmChar_t* prefixPath, double srate, struct stat* stRef, cmtCacheRC_t* rcRef )
+{
+  unsigned i;
+
+  *rcRef = kOkCacheRC;
+
+  if( fn == NULL || stat(fn,stRef) != 0 )
+  {
+    *rcRef = cmErrSysMsg(&p->err,kFileFailCacheRC,errno,"The file '%s' could not be read.",cmStringNullGuard(fn));
+    return NULL;
+  }
+
+  ++p->useCnt;
+
+  for(i=0; i<p->entryN; ++i)
+  {
+    cmtCacheEntry_t* e = p->entryV + i;
+
+    if( e->typeId != typeId || strcmp(e->fn,fn) != 0 || !_cmtCacheStrIsEqual(e->prefixPath,prefixPath) || e->srate != srate )
+      continue;
+
+    // the file changed since it was loaded
+    if( e->byteCnt != stRef->st_size || e->mtime.tv_sec != stRef->st_mtim.tv_sec || e->mtime.tv_nsec != stRef->st_mtim.tv_nsec )
+    {
+      _cmtCacheEntryRelease(e);
+      p->entryV[i] = p->entryV[ --p->entryN ];
+      return NULL;
+    }
+
+    e->useCnt = p->useCnt;
+    ++p->hitCnt;
+    return e;
+  }
+
+  return NULL;
+}
+
+// Allocate an entry for a file which is about to be loaded.
+cmtCacheEntry_t* _cmtCacheInsert( cmtCache_t* p, unsigned typeId, const cmChar_t* fn, const cmChar_t* prefixPath, double srate, const struct stat* st )
+{
+  cmtCacheEntry_t* e;
+
+  // release the least recently used entry
+  if( p->entryN == p->maxEntryN )
+  {
+    unsigned i,j = 0;
+
+    for(i=1; i<p->entryN; ++i)
+      if( p->entryV[i].useCnt < p->entryV[j].useCnt )
+        j = i;
+
+    _cmtCacheEntryRelease(p->entryV + j);
+    p->entryV[j] = p->entryV[ --p->entryN ];
+  }
+
+  e = p->entryV + p->entryN++;
+
+  memset(e,0,sizeof(*e));
+  e->typeId     = typeId;
+  e->fn         = cmMemAllocStr(fn);
+  e->prefixPath = prefixPath == NULL ? NULL : cmMemAllocStr(prefixPath);
+  e->srate      = srate;
+  e->mtime      = st->st_mtim;
+  e->byteCnt    = st->st_size;
+  e->useCnt     = p->useCnt;
+  e->scH        = cmScNullHandle;
+  e->mfH        = cmMidiFileNullHandle;
+  e->tlH        = cmTimeLineNullHandle;
+
+  ++p->missCnt;
+  return e;
+}
+
+// Remove the last inserted entry after a load failure.
+void _cmtCacheRemoveLast( cmtCache_t* p )
+{
+  _cmtCacheEntryRelease(p->entryV + p->entryN - 1);
+  --p->entryN;
+}
+
+cmtCacheRC_t cmtCacheScore( cmtCacheH_t h, const cmChar_t* fn, double srate, cmScH_t* scHRef, bool* hitFlRef )
+{
+  cmtCache_t*      p = _cmtCacheHandleToPtr(h);
+  cmtCacheRC_t     rc;
+  struct stat      st;
+  cmtCacheEntry_t* e;
+
+  if((e = _cmtCacheFind(p,kScoreCacheId,fn,NULL,srate,&st,&rc)) == NULL )
+  {
+    if( rc != kOkCacheRC )
+      return rc;
+
+    e = _cmtCacheInsert(p,kScoreCacheId,fn,NULL,srate,&st);
+
+    if( cmScoreInitialize(p->ctx,&e->scH,fn,srate,NULL,0,NULL,NULL,cmSymTblNullHandle) != kOkScRC )
+    {
+      _cmtCacheRemoveLast(p);
+      return cmErrMsg(&p->err,kLoadFailCacheRC,"The score '%s' could not be loaded.",fn);
+    }
+
+    *hitFlRef = false;
+  }
+  else
+    *hitFlRef = true;
+
+  *scHRef = e->scH;
+  return kOkCacheRC;
+}
+
+cmtCacheRC_t cmtCacheMidiFile( cmtCacheH_t h, const cmChar_t* fn, cmMidiFileH_t* mfHRef, bool* hitFlRef )
+{
+  cmtCache_t*      p = _cmtCacheHandleToPtr(h);
+  cmtCacheRC_t     rc;
+  struct stat      st;
+  cmtCacheEntry_t* e;
+
+  if((e = _cmtCacheFind(p,kMidiCacheId,fn,NULL,0,&st,&rc)) == NULL )
+  {
+    if( rc != kOkCacheRC )
+      return rc;
+
+    e = _cmtCacheInsert(p,kMidiCacheId,fn,NULL,0,&st);
+
+    if( cmMidiFileOpen(p->ctx,&e->mfH,fn) != kOkMfRC )
+    {
+      _cmtCacheRemoveLast(p);
+      return cmErrMsg(&p->err,kLoadFailCacheRC,"The MIDI file '%s' could not be loaded.",fn);
+    }
+
+    *hitFlRef = false;
+  }
+  else
+    *hitFlRef = true;
+
+  *mfHRef = e->mfH;
+  return kOkCacheRC;
+}
+
+cmtCacheRC_t cmtCacheTimeLine( cmtCacheH_t h, const cmChar_t* fn, const cmChar_t* prefixPath, cmTlH_t* tlHRef, bool* hitFlRef )
+{
+  cmtCache_t*      p = _cmtCacheHandleToPtr(h);
+  cmtCacheRC_t     rc;
+  struct stat      st;
+  cmtCacheEntry_t* e;
+
+  if((e = _cmtCacheFind(p,kTimeLineCacheId,fn,prefixPath,0,&st,&rc)) == NULL )
+  {
+    if( rc != kOkCacheRC )
+      return rc;
+
+    e = _cmtCacheInsert(p,kTimeLineCacheId,fn,prefixPath,0,&st);
+
+    if( cmTimeLineInitializeFromFile(p->ctx,&e->tlH,NULL,NULL,fn,prefixPath) != kOkTlRC )
+    {
+      _cmtCacheRemoveLast(p);
+      return cmErrMsg(&p->err,kLoadFailCacheRC,"The time line '%s' could not be loaded.",fn);
+    }
+
+    *hitFlRef = false;
+  }
+  else
+    *hitFlRef = true;
+
+  *tlHRef = e->tlH;
+  return kOkCacheRC;
+}
+
+void cmtCacheReport( cmtCacheH_t h, cmRpt_t* rpt )
+{
+  cmtCache_t*     p          = _cmtCacheHandleToPtr(h);
+  const cmChar_t* typeLabelV[] = { "score", "midi", "timeline" };
+  unsigned        i;
+
+  cmRptPrintf(rpt,"cache entries:%i max:%i hits:%i misses:%i\n",p->entryN,p->maxEntryN,p->hitCnt,p->missCnt);
+
+  for(i=0; i<p->entryN; ++i)
+    cmRptPrintf(rpt,"%-8s %s\n",typeLabelV[ p->entryV[i].typeId ],p->entryV[i].fn);
+}
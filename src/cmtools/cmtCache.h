@@ -0,0 +1,55 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtCache_h
+#define cmtCache_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Cache of parsed score, MIDI and time line files for long running processes.
+  //
+  // A cached object is reloaded when the modification time or size of its
+  // file changes.  When more than 'maxEntryN' objects are cached the least
+  // recently used object is released.
+  //
+  // The handles returned by the cmtCacheXXX() functions remain owned by the
+  // cache.  At least three entries are kept so that a handle remains valid
+  // until two other objects have been requested (e.g. the score and MIDI
+  // file used by one score follow request).
+
+  enum
+  {
+    kOkCacheRC = cmOkRC,
+    kFileFailCacheRC,
+    kLoadFailCacheRC
+  };
+
+  typedef cmRC_t cmtCacheRC_t;
+
+  typedef struct { void* h; } cmtCacheH_t;
+
+  extern cmtCacheH_t cmtCacheNullHandle;
+
+  cmtCacheRC_t cmtCacheCreate(  cmCtx_t* ctx, cmtCacheH_t* hp, unsigned maxEntryN );
+  cmtCacheRC_t cmtCacheDestroy( cmtCacheH_t* hp );
+  bool         cmtCacheIsValid( cmtCacheH_t h );
+
+  // Return the score CSV file 'fn' loaded at sample rate 'srate'.
+  // *hitFlRef is set to true if the score was taken from the cache.
+  cmtCacheRC_t cmtCacheScore(    cmtCacheH_t h, const cmChar_t* fn, double srate, cmScH_t* scHRef, bool* hitFlRef );
+
+  // Return the MIDI file 'fn'.
+  cmtCacheRC_t cmtCacheMidiFile( cmtCacheH_t h, const cmChar_t* fn, cmMidiFileH_t* mfHRef, bool* hitFlRef );
+
+  // Return the time line 'fn' loaded with the data path prefix 'prefixPath'.
+  cmtCacheRC_t cmtCacheTimeLine( cmtCacheH_t h, const cmChar_t* fn, const cmChar_t* prefixPath, cmTlH_t* tlHRef, bool* hitFlRef );
+
+  // Print the cached objects and the hit and miss counts.
+  void         cmtCacheReport(   cmtCacheH_t h, cmRpt_t* rpt );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,357 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtF32File.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+cmtF32H_t   cmtF32NullHandle   = cmSTATIC_NULL_HANDLE;
+cmtF32WrH_t cmtF32WrNullHandle = cmSTATIC_NULL_HANDLE;
+
+static const cmChar_t _cmtF32Magic[4] = { 'C','M','F','3' };
+
+enum
+{
+  kF32Version = 1
+};
+
+// header sidecar file record
+typedef struct
+{
+  char               magic[4];
+  unsigned           version;
+  unsigned           smpByteCnt;  // always 4
+  unsigned           chCnt;       // always 1
+  double             srate;
+  unsigned long long frameCnt;
+} cmtF32Hdr_t;
+
+typedef struct
+{
+  cmErr_t      err;
+  int          fd;
+  void*        base;
+  size_t       byteCnt;
+  cmtF32Info_t info;
+} cmtF32_t;
+
+typedef struct
+{
+  cmErr_t            err;
+  FILE*              fp;
+  cmChar_t*          fn;
+  double             srate;
+  unsigned long long frameCnt;
+} cmtF32Wr_t;
+
+// The samples are used in place so they must be 32 bit floats on a little-endian host.
+bool _cmtF32IsHostCompatible()
+{
+  unsigned x = 1;
+  return sizeof(cmSample_t) == 4 && *(const unsigned char*)&x == 1;
+}
+
+cmChar_t* _cmtF32HdrFn( const cmChar_t* fn )
+{
+  cmChar_t* hfn = cmMemAllocZ(cmChar_t,strlen(fn) + 5);
+  strcpy(hfn,fn);
+  strcat(hfn,".hdr");
+  return hfn;
+}
+
+bool cmtF32IsFile( const cmChar_t* fn )
+{
+  size_t n = fn==NULL ? 0 : strlen(fn);
+  return n > 4 && strcmp(fn + n - 4, ".f32") == 0;
+}
+
+cmtF32RC_t _cmtF32ReadHdr( cmErr_t* err, const cmChar_t* fn, cmtF32Info_t* info )
+{
+  cmtF32RC_t  rc  = kOkF32RC;
+  cmChar_t*   hfn = _cmtF32HdrFn(fn);
+  FILE*       fp  = NULL;
+  cmtF32Hdr_t hdr;
+
+  if((fp = fopen(hfn,"rb")) == NULL )
+  {
+    rc = cmErrSysMsg(err,kFileFailF32RC,errno,"The float32 header file '%s' could not be opened.",hfn);
+    goto errLabel;
+  }
+
+  if( fread(&hdr,sizeof(hdr),1,fp) != 1 || memcmp(hdr.magic,_cmtF32Magic,sizeof(_cmtF32Magic)) != 0 )
+  {
+    rc = cmErrMsg(err,kFormatFailF32RC,"The file '%s' is not a float32 header file.",hfn);
+    goto errLabel;
+  }
+
+  // the whole file must be addressable in a single mapping
+  if( hdr.version != kF32Version || hdr.smpByteCnt != 4 || hdr.chCnt != 1 || hdr.frameCnt > SIZE_MAX / sizeof(cmSample_t) )
+  {
+    rc = cmErrMsg(err,kFormatFailF32RC,"The float32 header file '%s' has an incompatible version (%i) or format.",hfn,hdr.version);
+    goto errLabel;
+  }
+
+  info->srate    = hdr.srate;
+  info->frameCnt = hdr.frameCnt;
+
+ errLabel:
+  if( fp != NULL )
+    fclose(fp);
+
+  cmMemFree(hfn);
+  return rc;
+}
+
+cmtF32RC_t cmtF32GetInfo( cmCtx_t* ctx, const cmChar_t* fn, cmtF32Info_t* info )
+{
+  cmErr_t err;
+  cmErrSetup(&err,&ctx->rpt,"F32 File");
+  return _cmtF32ReadHdr(&err,fn,info);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Reader
+//----------------------------------------------------------------------------------------------------
+
+cmtF32_t* _cmtF32HandleToPtr( cmtF32H_t h )
+{
+  cmtF32_t* p = (cmtF32_t*)h.h;
+  assert(p != NULL);
+  return p;
+}
+
+cmtF32RC_t _cmtF32Free( cmtF32_t* p )
+{
+  cmtF32RC_t rc = kOkF32RC;
+
+  if( p->base != NULL && munmap(p->base,p->byteCnt) != 0 )
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file unmap failed.");
+
+  if( p->fd != -1 )
+    close(p->fd);
+
+  cmMemFree(p);
+  return rc;
+}
+
+cmtF32RC_t cmtF32Open( cmCtx_t* ctx, cmtF32H_t* hp, const cmChar_t* fn )
+{
+  cmtF32RC_t  rc;
+  struct stat st;
+
+  if((rc = cmtF32Close(hp)) != kOkF32RC )
+    return rc;
+
+  cmtF32_t* p = cmMemAllocZ(cmtF32_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"F32 File");
+  p->fd = -1;
+
+  if( _cmtF32IsHostCompatible() == false )
+  {
+    rc = cmErrMsg(&p->err,kInvalidArgF32RC,"Float32 files can only be used on little-endian hosts with 32 bit samples.");
+    goto errLabel;
+  }
+
+  if((rc = _cmtF32ReadHdr(&p->err,fn,&p->info)) != kOkF32RC )
+    goto errLabel;
+
+  if((p->fd = open(fn,O_RDONLY)) == -1 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file open failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if( fstat(p->fd,&st) != 0 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file stat failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  p->byteCnt = (size_t)p->info.frameCnt * sizeof(cmSample_t);
+
+  if( (size_t)st.st_size < p->byteCnt )
+  {
+    rc = cmErrMsg(&p->err,kFormatFailF32RC,"The float32 file '%s' is shorter than the sample count given in its header.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if( p->byteCnt > 0 )
+  {
+    if((p->base = mmap(NULL,p->byteCnt,PROT_READ,MAP_SHARED,p->fd,0)) == MAP_FAILED )
+    {
+      p->base = NULL;
+      rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file mmap failed on '%s'.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
+
+    // the samples are generally scanned from front to back
+    madvise(p->base,p->byteCnt,MADV_SEQUENTIAL);
+  }
+
+  hp->h = p;
+
+ errLabel:
+  if( rc != kOkF32RC )
+    _cmtF32Free(p);
+
+  return rc;
+}
+
+cmtF32RC_t cmtF32Close( cmtF32H_t* hp )
+{
+  cmtF32RC_t rc = kOkF32RC;
+
+  if( hp == NULL || cmtF32IsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtF32Free(_cmtF32HandleToPtr(*hp))) != kOkF32RC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtF32IsValid( cmtF32H_t h )
+{ return h.h != NULL; }
+
+const cmtF32Info_t* cmtF32Info( cmtF32H_t h )
+{
+  cmtF32_t* p = _cmtF32HandleToPtr(h);
+  return &p->info;
+}
+
+const cmSample_t* cmtF32Samples( cmtF32H_t h )
+{
+  cmtF32_t* p = _cmtF32HandleToPtr(h);
+  return (const cmSample_t*)p->base;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Writer
+//----------------------------------------------------------------------------------------------------
+
+cmtF32Wr_t* _cmtF32WrHandleToPtr( cmtF32WrH_t h )
+{
+  cmtF32Wr_t* p = (cmtF32Wr_t*)h.h;
+  assert(p != NULL);
+  return p;
+}
+
+cmtF32RC_t _cmtF32WrFree( cmtF32Wr_t* p )
+{
+  cmtF32RC_t rc = kOkF32RC;
+
+  if( p->fp != NULL && fclose(p->fp) != 0 )
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file close failed on '%s'.",p->fn);
+
+  cmMemFree(p->fn);
+  cmMemFree(p);
+  return rc;
+}
+
+cmtF32RC_t cmtF32WrCreate( cmCtx_t* ctx, cmtF32WrH_t* hp, const cmChar_t* fn, double srate )
+{
+  cmtF32RC_t rc;
+
+  if((rc = cmtF32WrDestroy(hp)) != kOkF32RC )
+    return rc;
+
+  cmtF32Wr_t* p = cmMemAllocZ(cmtF32Wr_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"F32 File");
+  p->fn    = cmMemAllocStr(fn==NULL ? "" : fn);
+  p->srate = srate;
+
+  if( _cmtF32IsHostCompatible() == false )
+  {
+    rc = cmErrMsg(&p->err,kInvalidArgF32RC,"Float32 files can only be written on little-endian hosts with 32 bit samples.");
+    goto errLabel;
+  }
+
+  if((p->fp = fopen(p->fn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file create failed on '%s'.",p->fn);
+    goto errLabel;
+  }
+
+  hp->h = p;
+
+ errLabel:
+  if( rc != kOkF32RC )
+    _cmtF32WrFree(p);
+
+  return rc;
+}
+
+cmtF32RC_t cmtF32WrDestroy( cmtF32WrH_t* hp )
+{
+  cmtF32RC_t  rc  = kOkF32RC;
+  FILE*       fp  = NULL;
+  cmChar_t*   hfn = NULL;
+  cmtF32Hdr_t hdr;
+
+  if( hp == NULL || cmtF32WrIsValid(*hp) == false )
+    return rc;
+
+  cmtF32Wr_t* p = _cmtF32WrHandleToPtr(*hp);
+
+  // write the header sidecar
+  memset(&hdr,0,sizeof(hdr));
+  memcpy(hdr.magic,_cmtF32Magic,sizeof(_cmtF32Magic));
+  hdr.version    = kF32Version;
+  hdr.smpByteCnt = sizeof(cmSample_t);
+  hdr.chCnt      = 1;
+  hdr.srate      = p->srate;
+  hdr.frameCnt   = p->frameCnt;
+
+  hfn = _cmtF32HdrFn(p->fn);
+
+  if((fp = fopen(hfn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 header file create failed on '%s'.",hfn);
+    goto errLabel;
+  }
+
+  if( fwrite(&hdr,sizeof(hdr),1,fp) != 1 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 header file write failed on '%s'.",hfn);
+    goto errLabel;
+  }
+
+ errLabel:
+  if( fp != NULL )
+    fclose(fp);
+
+  cmMemFree(hfn);
+
+  cmtF32RC_t rc0 = _cmtF32WrFree(p);
+  hp->h = NULL;
+
+  return rc != kOkF32RC ? rc : rc0;
+}
+
+bool cmtF32WrIsValid( cmtF32WrH_t h )
+{ return h.h != NULL; }
+
+cmtF32RC_t cmtF32WrWrite( cmtF32WrH_t h, const cmSample_t* v, unsigned smpCnt )
+{
+  cmtF32Wr_t* p = _cmtF32WrHandleToPtr(h);
+
+  if( smpCnt > 0 && fwrite(v,sizeof(cmSample_t),smpCnt,p->fp) != smpCnt )
+    return cmErrSysMsg(&p->err,kFileFailF32RC,errno,"Float32 file write failed on '%s'.",p->fn);
+
+  p->frameCnt += smpCnt;
+  return kOkF32RC;
+}
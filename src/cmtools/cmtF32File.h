@@ -0,0 +1,68 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtF32File_h
+#define cmtF32File_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Dense float32 sample files.
+  //
+  // A '.f32' file holds the raw little-endian 32 bit float samples of a single
+  // channel signal.  The sample rate and the sample count are stored in the
+  // header sidecar file '<fn>.hdr'.  The sample file is memory mapped on read
+  // so that the samples can be used in place without conversion or copying.
+  //
+  // These files are intended as intermediate files (e.g. the output of 'mas -c').
+
+  enum
+  {
+    kOkF32RC = cmOkRC,
+    kFileFailF32RC,
+    kFormatFailF32RC,
+    kInvalidArgF32RC
+  };
+
+  typedef cmRC_t cmtF32RC_t;
+
+  typedef struct { void* h; } cmtF32H_t;
+  typedef struct { void* h; } cmtF32WrH_t;
+
+  extern cmtF32H_t   cmtF32NullHandle;
+  extern cmtF32WrH_t cmtF32WrNullHandle;
+
+  typedef struct
+  {
+    double             srate;
+    unsigned long long frameCnt;
+  } cmtF32Info_t;
+
+  // Return true if 'fn' uses the '.f32' file name extension.
+  bool       cmtF32IsFile( const cmChar_t* fn );
+
+  // Read the header sidecar of 'fn'.
+  cmtF32RC_t cmtF32GetInfo( cmCtx_t* ctx, const cmChar_t* fn, cmtF32Info_t* info );
+
+  // Memory map the sample file 'fn'.
+  cmtF32RC_t cmtF32Open(  cmCtx_t* ctx, cmtF32H_t* hp, const cmChar_t* fn );
+  cmtF32RC_t cmtF32Close( cmtF32H_t* hp );
+  bool       cmtF32IsValid( cmtF32H_t h );
+
+  const cmtF32Info_t* cmtF32Info(    cmtF32H_t h );
+
+  // Return the base of the mapped samples (cmtF32Info()->frameCnt samples).
+  const cmSample_t*   cmtF32Samples( cmtF32H_t h );
+
+  // Create the sample file 'fn'. The header sidecar is written by cmtF32WrDestroy().
+  cmtF32RC_t cmtF32WrCreate(  cmCtx_t* ctx, cmtF32WrH_t* hp, const cmChar_t* fn, double srate );
+  cmtF32RC_t cmtF32WrDestroy( cmtF32WrH_t* hp );
+  bool       cmtF32WrIsValid( cmtF32WrH_t h );
+
+  cmtF32RC_t cmtF32WrWrite( cmtF32WrH_t h, const cmSample_t* v, unsigned smpCnt );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
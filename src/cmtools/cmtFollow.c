@@ -0,0 +1,349 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmComplexTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmSymTbl.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmMidiFile.h"
+#include "cmAudioFile.h"
+#include "cmScore.h"
+
+#include "cmProcObj.h"
+#include "cmProc4.h"
+
+#include "cmtFollow.h"
+
+#include <time.h>
+
+cmtFlwH_t cmtFlwNullHandle = cmSTATIC_NULL_HANDLE;
+
+typedef struct
+{
+  cmErr_t         err;
+  cmCtx*          ctxp;       // processor context used by the matcher
+  cmScMatcher*    smp;
+  cmtFlwResult_t* resultV;    // resultV[resultAllocN]
+  unsigned        resultN;
+  unsigned        resultAllocN;
+  unsigned        stepCnt;    // matcher defaults
+  unsigned        maxMissCnt;
+  unsigned        beamN;      // beam limits or 0 to use the matcher defaults
+  unsigned        beamMaxN;
+  unsigned        beamCurN;   // current beam
+  unsigned        missN;      // current count of consecutive misses
+  unsigned        widenN;
+  unsigned long long beamSum; // sum of beamCurN over the followed notes
+  unsigned        scanCnt;    // smp->scanCnt at reset
+  double          secs;
+} cmtFlw_t;
+
+cmtFlw_t* _cmtFlwHandleToPtr( cmtFlwH_t h )
+{
+  cmtFlw_t* p = (cmtFlw_t*)h.h;
+  assert( p != NULL );
+  return p;
+}
+
+double _cmtFlwSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+// Apply the current beam to the matcher.  A miss tolerance one greater than
+// the step count is the matcher's own default relation.
+void _cmtFlwApplyBeam( cmtFlw_t* p )
+{
+  if( p->beamN == 0 )
+  {
+    p->smp->stepCnt    = p->stepCnt;
+    p->smp->maxMissCnt = p->maxMissCnt;
+  }
+  else
+  {
+    p->smp->stepCnt    = p->beamCurN;
+    p->smp->maxMissCnt = p->beamCurN + 1;
+  }
+}
+
+// Matcher callback. A note may be reported more than once as the matcher
+// revises its alignment - the last report is kept.
+void _cmtFlwMatchCb( cmScMatcher* smp, void* arg, cmScMatcherResult_t* rp )
+{
+  cmtFlw_t* p = (cmtFlw_t*)arg;
+  unsigned  i;
+
+  // the reported notes are within the last midiWndN notes so search backwards
+  for(i=p->resultN; i>0; --i)
+    if( p->resultV[i-1].muid == rp->muid )
+    {
+      cmtFlwResult_t* r = p->resultV + i - 1;
+      r->locIdx   = rp->locIdx;
+      r->scEvtIdx = rp->scEvtIdx;
+      r->flags    = rp->flags;
+      break;
+    }
+}
+
+cmtFlwRC_t _cmtFlwFree( cmtFlw_t* p )
+{
+  cmScMatcherFree(&p->smp);
+  cmCtxFree(&p->ctxp);
+  cmMemFree(p->resultV);
+  cmMemFree(p);
+  return kOkFlwRC;
+}
+
+cmtFlwRC_t cmtFlwCreate( cmCtx_t* ctx, cmtFlwH_t* hp, cmScH_t scH, double srate, unsigned scWndN, unsigned midiWndN )
+{
+  cmtFlwRC_t rc;
+
+  if((rc = cmtFlwDestroy(hp)) != kOkFlwRC )
+    return rc;
+
+  cmtFlw_t* p = cmMemAllocZ(cmtFlw_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"Follow");
+
+  p->ctxp = cmCtxAlloc(NULL,&ctx->rpt,cmLHeapNullHandle,cmSymTblNullHandle);
+
+  if((p->smp = cmScMatcherAlloc(p->ctxp,NULL,srate,scH,scWndN,midiWndN,_cmtFlwMatchCb,p)) == NULL )
+  {
+    rc = cmErrMsg(&p->err,kMatcherFailFlwRC,"The score matcher could not be created.");
+    goto errLabel;
+  }
+
+  p->stepCnt    = p->smp->stepCnt;
+  p->maxMissCnt = p->smp->maxMissCnt;
+  p->scanCnt    = p->smp->scanCnt;
+
+  hp->h = p;
+
+ errLabel:
+  if( rc != kOkFlwRC )
+    _cmtFlwFree(p);
+
+  return rc;
+}
+
+cmtFlwRC_t cmtFlwDestroy( cmtFlwH_t* hp )
+{
+  cmtFlwRC_t rc = kOkFlwRC;
+
+  if( hp == NULL || cmtFlwIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtFlwFree(_cmtFlwHandleToPtr(*hp))) != kOkFlwRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtFlwIsValid( cmtFlwH_t h )
+{ return h.h != NULL; }
+
+cmtFlwRC_t cmtFlwSetBeam( cmtFlwH_t h, unsigned beamN, unsigned beamMaxN )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+
+  p->beamN    = beamN;
+  p->beamMaxN = beamN == 0 ? 0 : cmMax(beamN, beamMaxN == 0 ? kFlwBeamWidenN * beamN : beamMaxN);
+  p->beamCurN = p->beamN;
+  p->missN    = 0;
+
+  _cmtFlwApplyBeam(p);
+
+  return kOkFlwRC;
+}
+
+cmtFlwRC_t cmtFlwReset( cmtFlwH_t h )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+
+  p->resultN  = 0;
+  p->beamCurN = p->beamN;
+  p->missN    = 0;
+  p->widenN   = 0;
+  p->beamSum  = 0;
+  p->secs     = 0;
+
+  if( cmScMatcherReset(p->smp,0) != cmOkRC )
+    return cmErrMsg(&p->err,kMatcherFailFlwRC,"The score matcher reset failed.");
+
+  _cmtFlwApplyBeam(p);
+  p->scanCnt = p->smp->scanCnt;
+
+  return kOkFlwRC;
+}
+
+cmtFlwRC_t cmtFlwExec( cmtFlwH_t h, unsigned smpIdx, unsigned muid, unsigned status, cmMidiByte_t d0, cmMidiByte_t d1, unsigned* locIdxRef )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+  unsigned  locIdx;
+  double    t0;
+
+  if( locIdxRef != NULL )
+    *locIdxRef = cmInvalidIdx;
+
+  if( status != kNoteOnMdId || d1 == 0 )
+    return kOkFlwRC;
+
+  if( p->resultN == p->resultAllocN )
+  {
+    p->resultAllocN = p->resultAllocN == 0 ? 1024 : 2*p->resultAllocN;
+    p->resultV      = cmMemResizeP(cmtFlwResult_t,p->resultV,p->resultAllocN);
+  }
+
+  cmtFlwResult_t* r = p->resultV + p->resultN;
+
+  r->mni      = p->resultN;
+  r->muid     = muid;
+  r->smpIdx   = smpIdx;
+  r->pitch    = d0;
+  r->vel      = d1;
+  r->locIdx   = cmInvalidIdx;
+  r->scEvtIdx = cmInvalidIdx;
+  r->flags    = 0;
+
+  ++p->resultN;
+
+  t0 = _cmtFlwSecs();
+
+  if( cmScMatcherExec(p->smp,smpIdx,muid,status,d0,d1,&locIdx) != cmOkRC )
+    return cmErrMsg(&p->err,kMatcherFailFlwRC,"The score matcher failed on MIDI msg uid:%i.",muid);
+
+  p->secs    += _cmtFlwSecs() - t0;
+  p->beamSum += p->beamN == 0 ? p->smp->stepCnt : p->beamCurN;
+
+  // widen the beam while the follower is lost and narrow it again as it recovers
+  if( p->beamN != 0 )
+  {
+    if( locIdx != cmInvalidIdx )
+    {
+      p->missN    = 0;
+      p->beamCurN = cmMax(p->beamN,p->beamCurN/2);
+    }
+    else if( ++p->missN >= kFlwBeamMissN && p->beamCurN < p->beamMaxN )
+    {
+      p->missN    = 0;
+      p->beamCurN = cmMin(p->beamMaxN,2*p->beamCurN);
+      ++p->widenN;
+    }
+
+    _cmtFlwApplyBeam(p);
+  }
+
+  if( locIdxRef != NULL )
+    *locIdxRef = locIdx;
+
+  return kOkFlwRC;
+}
+
+cmtFlwRC_t cmtFlwMidiFile( cmtFlwH_t h, cmMidiFileH_t mfH )
+{
+  cmtFlwRC_t               rc;
+  unsigned                 msgN = cmMidiFileMsgCount(mfH);
+  const cmMidiTrackMsg_t** msgV = cmMidiFileMsgArray(mfH);
+  unsigned                 i;
+
+  if( msgV == NULL )
+    return cmErrMsg(&_cmtFlwHandleToPtr(h)->err,kMidiFileFailFlwRC,"The MIDI file message array is not available.");
+
+  if((rc = cmtFlwReset(h)) != kOkFlwRC )
+    return rc;
+
+  for(i=0; i<msgN; ++i)
+  {
+    const cmMidiTrackMsg_t* m = msgV[i];
+
+    if( m->status == kNoteOnMdId && m->u.chMsgPtr->d1 > 0 )
+    {
+      unsigned smpIdx = (unsigned)(m->amicro * kFlwSrate / 1000000);
+
+      if((rc = cmtFlwExec(h,smpIdx,m->uid,m->status,m->u.chMsgPtr->d0,m->u.chMsgPtr->d1,NULL)) != kOkFlwRC )
+        return rc;
+    }
+  }
+
+  return kOkFlwRC;
+}
+
+const cmtFlwResult_t* cmtFlwResults( cmtFlwH_t h, unsigned* resultNRef )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+  *resultNRef = p->resultN;
+  return p->resultV;
+}
+
+unsigned cmtFlwMatchCount( cmtFlwH_t h )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+  unsigned  n = 0;
+  unsigned  i;
+
+  for(i=0; i<p->resultN; ++i)
+    if( p->resultV[i].scEvtIdx != cmInvalidIdx )
+      ++n;
+
+  return n;
+}
+
+void cmtFlwStats( cmtFlwH_t h, cmtFlwStats_t* s )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+
+  s->noteN    = p->resultN;
+  s->matchN   = cmtFlwMatchCount(h);
+  s->beamN    = p->beamN;
+  s->beamMaxN = p->beamMaxN;
+  s->widenN   = p->widenN;
+  s->scanN    = p->smp->scanCnt - p->scanCnt;
+  s->beamMean = p->resultN == 0 ? 0 : (double)p->beamSum / p->resultN;
+  s->secs     = p->secs;
+}
+
+void cmtFlwReport( cmtFlwH_t h, cmRpt_t* rpt )
+{
+  cmtFlw_t* p = _cmtFlwHandleToPtr(h);
+  unsigned  i;
+
+  cmRptPrintf(rpt,"%6s %6s %10s %5s %3s %6s %6s %5s\n","mni","muid","smpIdx","pitch","vel","loc","evt","flags");
+
+  for(i=0; i<p->resultN; ++i)
+  {
+    const cmtFlwResult_t* r = p->resultV + i;
+
+    cmRptPrintf(rpt,"%6i %6i %10i %5i %3i ",r->mni,r->muid,r->smpIdx,r->pitch,r->vel);
+
+    if( r->scEvtIdx == cmInvalidIdx )
+      cmRptPrintf(rpt,"%6s %6s %5s\n","-","-","-");
+    else
+      cmRptPrintf(rpt,"%6i %6i 0x%03x\n",r->locIdx,r->scEvtIdx,r->flags);
+  }
+
+  cmtFlwReportStats(h,rpt);
+}
+
+void cmtFlwReportStats( cmtFlwH_t h, cmRpt_t* rpt )
+{
+  cmtFlwStats_t s;
+
+  cmtFlwStats(h,&s);
+
+  cmRptPrintf(rpt,"notes:%i matched:%i match%%:%.2f\n",s.noteN,s.matchN,s.noteN==0 ? 0.0 : 100.0*s.matchN/s.noteN);
+
+  if( s.beamN == 0 )
+    cmRptPrintf(rpt,"beam:default mean:%.1f scans:%i secs:%f\n",s.beamMean,s.scanN,s.secs);
+  else
+    cmRptPrintf(rpt,"beam:%i max:%i mean:%.1f widened:%i scans:%i secs:%f\n",s.beamN,s.beamMaxN,s.beamMean,s.widenN,s.scanN,s.secs);
+}
@@ -0,0 +1,108 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtFollow_h
+#define cmtFollow_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // MIDI score follower on an already loaded score.
+  //
+  // This is the matcher which cmMidiScoreFollowMain() runs, without the score
+  // and MIDI file loading and the report, SVG, MIDI and time line outputs,
+  // so that a score can be loaded once and followed many times.  The match
+  // result of each performed note-on is kept and may be updated by the matcher
+  // as later notes arrive.
+  //
+  // The follower may be given a beam: the count of score locations around
+  // the last match which are examined for each note.  After kFlwBeamMissN
+  // consecutive unmatched notes the beam is doubled, up to 'beamMaxN', and
+  // each matched note halves it again, down to 'beamN'.  A narrow beam is
+  // faster on long scores, a wide one recovers sooner from skips and errors.
+
+  enum
+  {
+    kOkFlwRC = cmOkRC,
+    kMatcherFailFlwRC,
+    kMidiFileFailFlwRC
+  };
+
+  typedef cmRC_t cmtFlwRC_t;
+
+  typedef struct { void* h; } cmtFlwH_t;
+
+  extern cmtFlwH_t cmtFlwNullHandle;
+
+  enum
+  {
+    kFlwSrate    = 96000,  // score and performance sample rate
+    kFlwScWndN   = 10,     // count of score locations the matcher compares to each note
+    kFlwMidiWndN = 7,      // count of performed notes the matcher aligns at once
+    kFlwBeamMissN = 2,     // consecutive misses which widen the beam
+    kFlwBeamWidenN = 8     // default beamMaxN is kFlwBeamWidenN * beamN
+  };
+
+  typedef struct
+  {
+    unsigned mni;       // index of the note-on in the performance
+    unsigned muid;      // MIDI msg uid
+    unsigned smpIdx;    // time of the note-on in samples
+    unsigned pitch;
+    unsigned vel;
+    unsigned locIdx;    // matched score location or cmInvalidIdx
+    unsigned scEvtIdx;  // matched score event or cmInvalidIdx
+    unsigned flags;     // cmScMatcherResult_t flags
+  } cmtFlwResult_t;
+
+  typedef struct
+  {
+    unsigned noteN;     // count of followed note-ons
+    unsigned matchN;    // count of note-ons matched to a score event
+    unsigned beamN;     // minimum beam or 0 if the beam is not set
+    unsigned beamMaxN;  // maximum beam
+    unsigned widenN;    // count of times the beam was widened
+    unsigned scanN;     // count of re-sync scans of the score
+    double   beamMean;  // mean beam per note
+    double   secs;      // time spent in the matcher
+  } cmtFlwStats_t;
+
+  // 'scH' must remain valid until the follower is destroyed.
+  cmtFlwRC_t cmtFlwCreate(  cmCtx_t* ctx, cmtFlwH_t* hp, cmScH_t scH, double srate, unsigned scWndN, unsigned midiWndN );
+  cmtFlwRC_t cmtFlwDestroy( cmtFlwH_t* hp );
+  bool       cmtFlwIsValid( cmtFlwH_t h );
+
+  // Set the beam to 'beamN' score locations and its limit to 'beamMaxN' (kFlwBeamWidenN * beamN if 0).
+  // Set 'beamN' to 0 to use the matcher defaults.
+  cmtFlwRC_t cmtFlwSetBeam( cmtFlwH_t h, unsigned beamN, unsigned beamMaxN );
+
+  // Clear the results and restart the follower at the beginning of the score.
+  cmtFlwRC_t cmtFlwReset( cmtFlwH_t h );
+
+  // Follow one MIDI event. Only note-on events with a non-zero velocity are matched.
+  // *locIdxRef is set to the score location of the event or cmInvalidIdx.
+  cmtFlwRC_t cmtFlwExec( cmtFlwH_t h, unsigned smpIdx, unsigned muid, unsigned status, cmMidiByte_t d0, cmMidiByte_t d1, unsigned* locIdxRef );
+
+  // Reset the follower and follow all note-on's of a MIDI file.
+  cmtFlwRC_t cmtFlwMidiFile( cmtFlwH_t h, cmMidiFileH_t mfH );
+
+  // Return the results of the notes followed since the last reset.
+  const cmtFlwResult_t* cmtFlwResults( cmtFlwH_t h, unsigned* resultNRef );
+
+  // Return the count of followed notes which were matched to a score event.
+  unsigned cmtFlwMatchCount( cmtFlwH_t h );
+
+  // Return the match counts, beam and timing of the notes followed since the last reset.
+  void cmtFlwStats( cmtFlwH_t h, cmtFlwStats_t* s );
+
+  // Print the results as a table followed by the statistics.
+  void cmtFlwReport( cmtFlwH_t h, cmRpt_t* rpt );
+
+  // Print only the statistics: the match accuracy and the beam cost lines.
+  void cmtFlwReportStats( cmtFlwH_t h, cmRpt_t* rpt );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,678 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmFileSys.h"
+#include "cmAudioFile.h"
+
+#include "cmtF32File.h"
+#include "cmtFpIndex.h"
+
+#include <errno.h>
+
+cmtFpH_t cmtFpNullHandle = cmSTATIC_NULL_HANDLE;
+
+static const cmChar_t _cmtFpMagic[4] = { 'C','M','F','P' };
+
+enum
+{
+  kFpVersion       = 1,
+  kFpBlockSmpCnt   = 65536,  // audio file read block size used by cmtFpAudioOnsets()
+  kFpMaxIntervalQ  = 0xffff  // max. quantized inter-onset interval
+};
+
+typedef struct
+{
+  unsigned hash;
+  unsigned fileIdx;
+  double   secs;     // time of the first onset of the triplet
+} cmtFpEntry_t;
+
+// file header used by cmtFpWrite() and cmtFpRead()
+typedef struct
+{
+  char       magic[4];
+  unsigned   version;
+  cmtFpCfg_t cfg;
+  unsigned   fileCnt;
+  unsigned   entryCnt;
+  unsigned   strByteCnt;   // count of bytes in the file name string table
+} cmtFpHdr_t;
+
+typedef struct
+{
+  unsigned fileIdx;
+  int      bin;
+  double   offsSecs;
+} cmtFpVote_t;
+
+typedef struct
+{
+  cmErr_t       err;
+  cmCtx_t*      ctx;
+  cmtFpCfg_t    cfg;
+  cmChar_t**    fnV;       // fnV[fnN]
+  unsigned      fnN;
+  unsigned      fnAllocN;
+  cmtFpEntry_t* eV;        // eV[eN]
+  unsigned      eN;
+  unsigned      eAllocN;
+  bool          sortFl;    // true if eV[] is sorted by hash
+} cmtFp_t;
+
+cmtFp_t* _cmtFpHandleToPtr( cmtFpH_t h )
+{
+  cmtFp_t* p = (cmtFp_t*)h.h;
+  assert( p != NULL );
+  return p;
+}
+
+cmtFpRC_t _cmtFpFree( cmtFp_t* p )
+{
+  unsigned i;
+  for(i=0; i<p->fnN; ++i)
+    cmMemFree(p->fnV[i]);
+
+  cmMemFree(p->fnV);
+  cmMemFree(p->eV);
+  cmMemFree(p);
+  return kOkFpRC;
+}
+
+void cmtFpCfgDefault( cmtFpCfg_t* cfg )
+{
+  cfg->threshold = 0.1;
+  cfg->minGapMs  = 30;
+  cfg->quantMs   = 20;
+  cfg->fanOut    = 3;
+  cfg->offsBinMs = 100;
+}
+
+cmtFpRC_t cmtFpCreate( cmCtx_t* ctx, cmtFpH_t* hp, const cmtFpCfg_t* cfg )
+{
+  cmtFpRC_t rc;
+
+  if((rc = cmtFpDestroy(hp)) != kOkFpRC )
+    return rc;
+
+  cmtFp_t* p = cmMemAllocZ(cmtFp_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"Fingerprint Index");
+
+  if( cfg == NULL )
+    cmtFpCfgDefault(&p->cfg);
+  else
+    p->cfg = *cfg;
+
+  if( p->cfg.quantMs <= 0 || p->cfg.offsBinMs <= 0 || p->cfg.fanOut == 0 )
+  {
+    rc = cmErrMsg(&p->err,kInvalidArgFpRC,"The fingerprint quantization, offset bin width and fan out must all be greater than zero.");
+    _cmtFpFree(p);
+    return rc;
+  }
+
+  p->ctx    = ctx;
+  p->sortFl = true;
+  hp->h     = p;
+
+  return rc;
+}
+
+cmtFpRC_t cmtFpDestroy( cmtFpH_t* hp )
+{
+  cmtFpRC_t rc = kOkFpRC;
+
+  if( hp == NULL || cmtFpIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtFpFree(_cmtFpHandleToPtr(*hp))) != kOkFpRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtFpIsValid( cmtFpH_t h )
+{ return h.h != NULL; }
+
+const cmtFpCfg_t* cmtFpCfg( cmtFpH_t h )
+{ return &_cmtFpHandleToPtr(h)->cfg; }
+
+unsigned _cmtFpAppendFn( cmtFp_t* p, const cmChar_t* fn )
+{
+  if( p->fnN == p->fnAllocN )
+  {
+    p->fnAllocN = p->fnAllocN == 0 ? 16 : 2*p->fnAllocN;
+    p->fnV      = cmMemResizeZ(cmChar_t*,p->fnV,p->fnAllocN);
+  }
+
+  p->fnV[ p->fnN ] = cmMemAllocStr(fn);
+
+  return p->fnN++;
+}
+
+void _cmtFpAppendEntry( cmtFp_t* p, unsigned hash, unsigned fileIdx, double secs )
+{
+  if( p->eN == p->eAllocN )
+  {
+    p->eAllocN = p->eAllocN == 0 ? 4096 : 2*p->eAllocN;
+    p->eV      = cmMemResizeZ(cmtFpEntry_t,p->eV,p->eAllocN);
+  }
+
+  p->eV[ p->eN ].hash    = hash;
+  p->eV[ p->eN ].fileIdx = fileIdx;
+  p->eV[ p->eN ].secs    = secs;
+  p->eN  += 1;
+  p->sortFl = false;
+}
+
+// Quantize an inter-onset interval. Returns 0 if the interval cannot be hashed.
+unsigned _cmtFpQuantize( const cmtFpCfg_t* cfg, double dtSecs )
+{
+  double q = round(dtSecs * 1000.0 / cfg->quantMs);
+  return q < 1 || q >= kFpMaxIntervalQ ? 0 : (unsigned)q;
+}
+
+unsigned _cmtFpHash( unsigned dt0q, unsigned dt1q )
+{ return (dt0q << 16) | dt1q; }
+
+cmtFpRC_t cmtFpInsertOnsets( cmtFpH_t h, const cmChar_t* fn, const double* onsetSecsV, unsigned onsetCnt )
+{
+  cmtFp_t* p       = _cmtFpHandleToPtr(h);
+  unsigned fileIdx = _cmtFpAppendFn(p,fn);
+  unsigned i,j,k;
+
+  for(i=0; i<onsetCnt; ++i)
+    for(j=i+1; j<onsetCnt && j<=i+p->cfg.fanOut; ++j)
+    {
+      unsigned dt0q = _cmtFpQuantize(&p->cfg,onsetSecsV[j]-onsetSecsV[i]);
+
+      if( dt0q == 0 )
+        continue;
+
+      for(k=j+1; k<onsetCnt && k<=j+p->cfg.fanOut; ++k)
+      {
+        unsigned dt1q = _cmtFpQuantize(&p->cfg,onsetSecsV[k]-onsetSecsV[j]);
+
+        if( dt1q != 0 )
+          _cmtFpAppendEntry(p,_cmtFpHash(dt0q,dt1q),fileIdx,onsetSecsV[i]);
+      }
+    }
+
+  return kOkFpRC;
+}
+
+cmtFpRC_t cmtFpInsertAudioFile( cmtFpH_t h, const cmChar_t* dir, const cmChar_t* fn )
+{
+  cmtFp_t*        p         = _cmtFpHandleToPtr(h);
+  cmtFpRC_t       rc        = kOkFpRC;
+  const cmChar_t* fullFn    = cmFsMakeFn(dir,fn,NULL,NULL);
+  double*         onsetV    = NULL;
+  unsigned        onsetCnt  = 0;
+
+  if((rc = cmtFpAudioOnsets(p->ctx,fullFn,0,0,p->cfg.threshold,p->cfg.minGapMs,&onsetV,&onsetCnt)) == kOkFpRC )
+    rc = cmtFpInsertOnsets(h,fn,onsetV,onsetCnt);
+
+  cmMemFree(onsetV);
+  cmFsFreeFn(fullFn);
+  return rc;
+}
+
+void _cmtFpNoPrint( void* arg, const char* text )
+{}
+
+// Return true if 'dir/fn' is a float32 file or a file the audio file reader can open.
+bool _cmtFpIsAudioFile( const cmChar_t* dir, const cmChar_t* fn )
+{
+  const cmChar_t*   fullFn = cmFsMakeFn(dir,fn,NULL,NULL);
+  cmAudioFileInfo_t afInfo;
+  cmRpt_t           rpt;
+  bool              fl;
+
+  // the open error of a file which is not an audio file is not printed
+  cmRptSetup(&rpt,_cmtFpNoPrint,_cmtFpNoPrint,NULL);
+
+  fl = cmtF32IsFile(fullFn) || cmAudioFileGetInfo(fullFn,&afInfo,&rpt) == kOkAfRC;
+
+  cmFsFreeFn(fullFn);
+  return fl;
+}
+
+cmtFpRC_t cmtFpInsertDir( cmtFpH_t h, const cmChar_t* dir )
+{
+  cmtFp_t*             p   = _cmtFpHandleToPtr(h);
+  cmtFpRC_t            rc  = kOkFpRC;
+  cmFileSysDirEntry_t* dep = NULL;
+  unsigned             dirEntryCnt = 0;
+  unsigned             i;
+
+  if((dep = cmFsDirEntries( dir, kFileFsFl, &dirEntryCnt )) == NULL )
+    return cmErrMsg(&p->err,kFileFailFpRC,"Unable to iterate the directory '%s'.",cmStringNullGuard(dir));
+
+  for(i=0; i<dirEntryCnt && rc==kOkFpRC; ++i)
+  {
+    size_t n = strlen(dep[i].name);
+
+    // skip float32 header sidecar files
+    if( n > 4 && strcmp(dep[i].name + n - 4, ".hdr") == 0 )
+      continue;
+
+    if( !_cmtFpIsAudioFile(dir,dep[i].name) )
+    {
+      cmErrWarnMsg(&p->err,kAudioFileFailFpRC,"The file '%s' in '%s' is not an audio file and was not indexed.",dep[i].name,dir);
+      continue;
+    }
+
+    cmRptPrintf(&p->ctx->rpt,"Fingerprint:%s\n",dep[i].name);
+    rc = cmtFpInsertAudioFile(h,dir,dep[i].name);
+  }
+
+  cmFsDirFreeEntries(dep);
+  return rc;
+}
+
+unsigned cmtFpFileCount( cmtFpH_t h )
+{ return _cmtFpHandleToPtr(h)->fnN; }
+
+const cmChar_t* cmtFpFileName( cmtFpH_t h, unsigned fileIdx )
+{
+  cmtFp_t* p = _cmtFpHandleToPtr(h);
+  return fileIdx < p->fnN ? p->fnV[fileIdx] : NULL;
+}
+
+int _cmtFpEntryCompare( const void* p0, const void* p1 )
+{
+  const cmtFpEntry_t* e0 = (const cmtFpEntry_t*)p0;
+  const cmtFpEntry_t* e1 = (const cmtFpEntry_t*)p1;
+
+  if( e0->hash != e1->hash )
+    return e0->hash < e1->hash ? -1 : 1;
+
+  if( e0->fileIdx != e1->fileIdx )
+    return e0->fileIdx < e1->fileIdx ? -1 : 1;
+
+  return e0->secs < e1->secs ? -1 : (e0->secs > e1->secs ? 1 : 0);
+}
+
+int _cmtFpVoteCompare( const void* p0, const void* p1 )
+{
+  const cmtFpVote_t* v0 = (const cmtFpVote_t*)p0;
+  const cmtFpVote_t* v1 = (const cmtFpVote_t*)p1;
+
+  if( v0->fileIdx != v1->fileIdx )
+    return v0->fileIdx < v1->fileIdx ? -1 : 1;
+
+  return v0->bin < v1->bin ? -1 : (v0->bin > v1->bin ? 1 : 0);
+}
+
+int _cmtFpCandCompare( const void* p0, const void* p1 )
+{
+  const cmtFpCand_t* c0 = (const cmtFpCand_t*)p0;
+  const cmtFpCand_t* c1 = (const cmtFpCand_t*)p1;
+
+  if( c0->voteCnt != c1->voteCnt )
+    return c0->voteCnt > c1->voteCnt ? -1 : 1;
+
+  if( c0->fileIdx != c1->fileIdx )
+    return c0->fileIdx < c1->fileIdx ? -1 : 1;
+
+  return c0->offsSecs < c1->offsSecs ? -1 : (c0->offsSecs > c1->offsSecs ? 1 : 0);
+}
+
+// Return the index of the first entry in eV[] whose hash is not less than 'hash'.
+unsigned _cmtFpLowerBound( const cmtFp_t* p, unsigned hash )
+{
+  unsigned lo = 0;
+  unsigned hi = p->eN;
+
+  while( lo < hi )
+  {
+    unsigned mid = lo + (hi-lo)/2;
+    if( p->eV[mid].hash < hash )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+unsigned cmtFpQuery( cmtFpH_t h, const double* onsetSecsV, unsigned onsetCnt, cmtFpCand_t* candV, unsigned candN )
+{
+  cmtFp_t*     p      = _cmtFpHandleToPtr(h);
+  cmtFpVote_t* vV     = NULL;
+  unsigned     vN     = 0;
+  unsigned     vAllocN= 0;
+  cmtFpCand_t* cV     = NULL;
+  unsigned     cN     = 0;
+  unsigned     i,j,k,n;
+  int          d0,d1;
+
+  if( p->sortFl == false )
+  {
+    qsort(p->eV,p->eN,sizeof(cmtFpEntry_t),_cmtFpEntryCompare);
+    p->sortFl = true;
+  }
+
+  for(i=0; i<onsetCnt; ++i)
+    for(j=i+1; j<onsetCnt && j<=i+p->cfg.fanOut; ++j)
+    {
+      unsigned dt0q = _cmtFpQuantize(&p->cfg,onsetSecsV[j]-onsetSecsV[i]);
+
+      if( dt0q == 0 )
+        continue;
+
+      for(k=j+1; k<onsetCnt && k<=j+p->cfg.fanOut; ++k)
+      {
+        unsigned dt1q = _cmtFpQuantize(&p->cfg,onsetSecsV[k]-onsetSecsV[j]);
+
+        if( dt1q == 0 )
+          continue;
+
+        // probe the neighboring quantization bins to tolerate onset jitter
+        for(d0=-1; d0<=1; ++d0)
+          for(d1=-1; d1<=1; ++d1)
+          {
+            int q0 = (int)dt0q + d0;
+            int q1 = (int)dt1q + d1;
+
+            if( q0 < 1 || q1 < 1 || q0 >= kFpMaxIntervalQ || q1 >= kFpMaxIntervalQ )
+              continue;
+
+            unsigned hash = _cmtFpHash(q0,q1);
+            unsigned ei;
+
+            for(ei=_cmtFpLowerBound(p,hash); ei<p->eN && p->eV[ei].hash==hash; ++ei)
+            {
+              if( vN == vAllocN )
+              {
+                vAllocN = vAllocN==0 ? 1024 : 2*vAllocN;
+                vV      = cmMemResizeZ(cmtFpVote_t,vV,vAllocN);
+              }
+
+              double offsSecs = p->eV[ei].secs - onsetSecsV[i];
+
+              vV[vN].fileIdx  = p->eV[ei].fileIdx;
+              vV[vN].bin      = (int)floor(offsSecs * 1000.0 / p->cfg.offsBinMs);
+              vV[vN].offsSecs = offsSecs;
+              ++vN;
+            }
+          }
+      }
+    }
+
+  if( vN == 0 )
+    goto errLabel;
+
+  // count the votes for each (file,offset bin)
+  qsort(vV,vN,sizeof(cmtFpVote_t),_cmtFpVoteCompare);
+
+  cV = cmMemAllocZ(cmtFpCand_t,vN);
+
+  for(i=0; i<vN; i=j)
+  {
+    double sum = 0;
+
+    for(j=i; j<vN && vV[j].fileIdx==vV[i].fileIdx && vV[j].bin==vV[i].bin; ++j)
+      sum += vV[j].offsSecs;
+
+    cV[cN].fileIdx  = vV[i].fileIdx;
+    cV[cN].offsSecs = sum / (j-i);
+    cV[cN].voteCnt  = j-i;
+    ++cN;
+  }
+
+  qsort(cV,cN,sizeof(cmtFpCand_t),_cmtFpCandCompare);
+
+ errLabel:
+  n = cmMin(cN,candN);
+
+  if( n > 0 )
+    memcpy(candV,cV,n*sizeof(cmtFpCand_t));
+
+  cmMemFree(cV);
+  cmMemFree(vV);
+  return n;
+}
+
+cmtFpRC_t cmtFpWrite( cmtFpH_t h, const cmChar_t* fn )
+{
+  cmtFp_t*   p  = _cmtFpHandleToPtr(h);
+  cmtFpRC_t  rc = kOkFpRC;
+  FILE*      fp = NULL;
+  cmtFpHdr_t hdr;
+  unsigned   i;
+
+  // write the entries in query order so that the reader does not need to sort them
+  if( p->sortFl == false )
+  {
+    qsort(p->eV,p->eN,sizeof(cmtFpEntry_t),_cmtFpEntryCompare);
+    p->sortFl = true;
+  }
+
+  memset(&hdr,0,sizeof(hdr));
+  memcpy(hdr.magic,_cmtFpMagic,sizeof(hdr.magic));
+  hdr.version  = kFpVersion;
+  hdr.cfg      = p->cfg;
+  hdr.fileCnt  = p->fnN;
+  hdr.entryCnt = p->eN;
+
+  for(i=0; i<p->fnN; ++i)
+    hdr.strByteCnt += strlen(p->fnV[i]) + 1;
+
+  if((fp = fopen(fn,"wb")) == NULL )
+    return cmErrSysMsg(&p->err,kFileFailFpRC,errno,"Fingerprint index file create failed on '%s'.",cmStringNullGuard(fn));
+
+  if( fwrite(&hdr,sizeof(hdr),1,fp) != 1 )
+    goto ioErrLabel;
+
+  for(i=0; i<p->fnN; ++i)
+    if( fwrite(p->fnV[i],strlen(p->fnV[i])+1,1,fp) != 1 )
+      goto ioErrLabel;
+
+  if( p->eN > 0 && fwrite(p->eV,sizeof(cmtFpEntry_t),p->eN,fp) != p->eN )
+    goto ioErrLabel;
+
+  goto errLabel;
+
+ ioErrLabel:
+  rc = cmErrSysMsg(&p->err,kFileFailFpRC,errno,"Fingerprint index file write failed on '%s'.",cmStringNullGuard(fn));
+
+ errLabel:
+  if( fclose(fp) != 0 && rc == kOkFpRC )
+    rc = cmErrSysMsg(&p->err,kFileFailFpRC,errno,"Fingerprint index file close failed on '%s'.",cmStringNullGuard(fn));
+
+  return rc;
+}
+
+cmtFpRC_t cmtFpRead( cmCtx_t* ctx, cmtFpH_t* hp, const cmChar_t* fn )
+{
+  cmtFpRC_t  rc   = kOkFpRC;
+  FILE*      fp   = NULL;
+  cmChar_t*  strV = NULL;
+  cmtFpHdr_t hdr;
+  cmtFp_t*   p;
+  unsigned   i;
+
+  if((fp = fopen(fn,"rb")) == NULL )
+    return cmErrSysMsg(&ctx->err,kFileFailFpRC,errno,"Fingerprint index file open failed on '%s'.",cmStringNullGuard(fn));
+
+  if( fread(&hdr,sizeof(hdr),1,fp) != 1 || memcmp(hdr.magic,_cmtFpMagic,sizeof(hdr.magic)) != 0 || hdr.version != kFpVersion )
+  {
+    rc = cmErrMsg(&ctx->err,kFormatFailFpRC,"'%s' is not a fingerprint index file or was written by a different version.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if((rc = cmtFpCreate(ctx,hp,&hdr.cfg)) != kOkFpRC )
+    goto errLabel;
+
+  p = _cmtFpHandleToPtr(*hp);
+
+  // read the file name string table
+  strV = cmMemAllocZ(cmChar_t,hdr.strByteCnt+1);
+
+  if( hdr.strByteCnt > 0 && fread(strV,hdr.strByteCnt,1,fp) != 1 )
+  {
+    rc = cmErrSysMsg(&ctx->err,kFileFailFpRC,errno,"Fingerprint index file name read failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  const cmChar_t* s = strV;
+  for(i=0; i<hdr.fileCnt; ++i)
+  {
+    if( s >= strV + hdr.strByteCnt )
+    {
+      rc = cmErrMsg(&ctx->err,kFormatFailFpRC,"The fingerprint index file name table is corrupt in '%s'.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
+
+    _cmtFpAppendFn(p,s);
+    s += strlen(s) + 1;
+  }
+
+  // read the entries
+  p->eAllocN = p->eN = hdr.entryCnt;
+  p->eV      = cmMemAllocZ(cmtFpEntry_t,cmMax(1,hdr.entryCnt));
+
+  if( hdr.entryCnt > 0 && fread(p->eV,sizeof(cmtFpEntry_t),hdr.entryCnt,fp) != hdr.entryCnt )
+  {
+    rc = cmErrSysMsg(&ctx->err,kFileFailFpRC,errno,"Fingerprint index entry read failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  p->sortFl = true;
+
+ errLabel:
+  if( rc != kOkFpRC )
+    cmtFpDestroy(hp);
+
+  cmMemFree(strV);
+  fclose(fp);
+  return rc;
+}
+
+cmtFpRC_t cmtFpAudioOnsets( cmCtx_t* ctx, const cmChar_t* fn, long long begSmpIdx, long long smpCnt, double threshold, double minGapMs, double** onsetSecsVRef, unsigned* onsetCntRef )
+{
+  cmtFpRC_t         rc        = kOkFpRC;
+  cmAudioFileH_t    afH       = cmNullAudioFileH;
+  cmtF32H_t         f32H      = cmtF32NullHandle;
+  cmAudioFileInfo_t afInfo;
+  long long         frameCnt  = 0;
+  cmRC_t            afRC;
+  cmSample_t*       buf       = NULL;
+  double*           onsetV    = NULL;
+  unsigned          onsetN    = 0;
+  unsigned          onsetAllocN = 0;
+  unsigned          chIdx     = 0;
+  unsigned          chCnt     = 1;
+  unsigned          actFrmCnt = 0;
+  unsigned          i;
+
+  *onsetSecsVRef = NULL;
+  *onsetCntRef   = 0;
+
+  // float32 files are mapped and scanned in place
+  if( cmtF32IsFile(fn) )
+  {
+    if( cmtF32Open(ctx,&f32H,fn) != kOkF32RC )
+      return cmErrMsg(&ctx->err,kAudioFileFailFpRC,"The float32 file '%s' could not be mapped.",cmStringNullGuard(fn));
+
+    afInfo.srate    = cmtF32Info(f32H)->srate;
+    frameCnt        = cmtF32Info(f32H)->frameCnt;
+  }
+  else
+  {
+    if( cmAudioFileIsValid( afH = cmAudioFileNewOpen(fn,&afInfo,&afRC,&ctx->rpt)) == false )
+      return cmErrMsg(&ctx->err,kAudioFileFailFpRC,"The audio file '%s' could not be opened.",cmStringNullGuard(fn));
+
+    frameCnt = afInfo.frameCnt;
+  }
+
+  if( begSmpIdx < 0 )
+    begSmpIdx = 0;
+
+  if( begSmpIdx > frameCnt )
+    begSmpIdx = frameCnt;
+
+  if( smpCnt <= 0 || begSmpIdx + smpCnt > frameCnt )
+    smpCnt = frameCnt - begSmpIdx;
+
+  // audio file (non-float32) indexes are limited to 32 bits by cmAudioFileSeek()
+  if( cmAudioFileIsValid(afH) && cmAudioFileSeek(afH,(unsigned)begSmpIdx) != kOkAfRC )
+  {
+    rc = cmErrMsg(&ctx->err,kAudioFileFailFpRC,"Seek failed on the audio file '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  buf = cmMemAllocZ(cmSample_t,kFpBlockSmpCnt);
+
+  unsigned  minGapSmpCnt = floor(minGapMs * afInfo.srate / 1000.0);
+  long long lastOnsetIdx = -1;
+  long long smpIdx       = begSmpIdx;    // absolute index of the next sample
+  long long endSmpIdx    = begSmpIdx + smpCnt;
+  double    x0           = 0;            // x[smpIdx-2]
+  double    x1           = 0;            // x[smpIdx-1]
+
+  while( smpIdx < endSmpIdx )
+  {
+    unsigned          n  = (unsigned)cmMin((long long)kFpBlockSmpCnt,endSmpIdx-smpIdx);
+    const cmSample_t* xp = buf;
+
+    if( cmtF32IsValid(f32H) )
+    {
+      xp        = cmtF32Samples(f32H) + smpIdx;
+      actFrmCnt = n;
+    }
+    else
+    {
+      cmSample_t* bp = buf;
+
+      if( cmAudioFileReadSample(afH,n,chIdx,chCnt,&bp,&actFrmCnt) != kOkAfRC || actFrmCnt == 0 )
+        break;
+    }
+
+    for(i=0; i<actFrmCnt; ++i,++smpIdx)
+    {
+      double x2 = xp[i];
+
+      // x1 is an onset if it is a local maximum above the threshold
+      if( smpIdx > begSmpIdx+1 && x1 >= threshold && x1 > x0 && x1 >= x2 )
+      {
+        long long onsetIdx = smpIdx - 1;
+
+        if( lastOnsetIdx == -1 || onsetIdx - lastOnsetIdx >= minGapSmpCnt )
+        {
+          if( onsetN == onsetAllocN )
+          {
+            onsetAllocN = onsetAllocN==0 ? 1024 : 2*onsetAllocN;
+            onsetV      = cmMemResizeZ(double,onsetV,onsetAllocN);
+          }
+
+          onsetV[ onsetN++ ] = onsetIdx / afInfo.srate;
+          lastOnsetIdx       = onsetIdx;
+        }
+      }
+
+      x0 = x1;
+      x1 = x2;
+    }
+  }
+
+  *onsetSecsVRef = onsetV;
+  *onsetCntRef   = onsetN;
+
+ errLabel:
+  cmMemFree(buf);
+  cmtF32Close(&f32H);
+
+  if( cmAudioFileIsValid(afH) )
+    cmAudioFileDelete(&afH);
+
+  return rc;
+}
@@ -0,0 +1,92 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtFpIndex_h
+#define cmtFpIndex_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Onset interval fingerprint index.
+  //
+  // Onsets are peak picked from onset impulse (mas -a) or convolved impulse (mas -c)
+  // audio files.  Each onset is paired with the next 'fanOut' onsets and each of
+  // those with their next 'fanOut' onsets.  The two quantized inter-onset intervals
+  // of each triplet form a hash which is stored with the file and time of the first onset.
+  //
+  // A query window (e.g. a section of a MIDI impulse file) is hashed the same way
+  // and every matching hash votes for a (file, time offset) pair. The pairs with
+  // the most votes are returned as candidate locations of the query in the indexed files.
+
+  enum
+  {
+    kOkFpRC = cmOkRC,
+    kFileFailFpRC,
+    kAudioFileFailFpRC,
+    kFormatFailFpRC,
+    kInvalidArgFpRC
+  };
+
+  typedef cmRC_t cmtFpRC_t;
+
+  typedef struct { void* h; } cmtFpH_t;
+
+  extern cmtFpH_t cmtFpNullHandle;
+
+  typedef struct
+  {
+    double   threshold;  // onset peak picking threshold
+    double   minGapMs;   // minimum time between onsets
+    double   quantMs;    // inter-onset interval quantization
+    unsigned fanOut;     // count of following onsets paired with each onset
+    double   offsBinMs;  // width of the candidate offset histogram bins
+  } cmtFpCfg_t;
+
+  typedef struct
+  {
+    unsigned fileIdx;    // index of the matched file (See cmtFpFileName())
+    double   offsSecs;   // time in the indexed file minus time in the query
+    unsigned voteCnt;    // count of hashes which voted for this candidate
+  } cmtFpCand_t;
+
+  // Fill 'cfg' with the default parameters.
+  void        cmtFpCfgDefault( cmtFpCfg_t* cfg );
+
+  cmtFpRC_t   cmtFpCreate(  cmCtx_t* ctx, cmtFpH_t* hp, const cmtFpCfg_t* cfg );
+  cmtFpRC_t   cmtFpDestroy( cmtFpH_t* hp );
+  bool        cmtFpIsValid( cmtFpH_t h );
+
+  const cmtFpCfg_t* cmtFpCfg( cmtFpH_t h );
+
+  // Index a list of onset times from the file 'fn'. 'fn' is copied.
+  cmtFpRC_t   cmtFpInsertOnsets( cmtFpH_t h, const cmChar_t* fn, const double* onsetSecsV, unsigned onsetCnt );
+
+  // Peak pick and index the onsets in the audio file 'dir/fn'.
+  cmtFpRC_t   cmtFpInsertAudioFile( cmtFpH_t h, const cmChar_t* dir, const cmChar_t* fn );
+
+  // Index every audio file in the directory 'dir'. Other files are skipped with a warning.
+  // File names are stored relative to 'dir'.
+  cmtFpRC_t   cmtFpInsertDir( cmtFpH_t h, const cmChar_t* dir );
+
+  unsigned        cmtFpFileCount( cmtFpH_t h );
+  const cmChar_t* cmtFpFileName(  cmtFpH_t h, unsigned fileIdx );
+
+  // Locate the candidate positions of a set of query onsets.
+  // Up to 'candN' candidates are returned in candV[] in order of decreasing vote count.
+  // Returns the count of candidates returned in candV[].
+  unsigned    cmtFpQuery( cmtFpH_t h, const double* onsetSecsV, unsigned onsetCnt, cmtFpCand_t* candV, unsigned candN );
+
+  // Write the index to a file or create an index from a file written by cmtFpWrite().
+  cmtFpRC_t   cmtFpWrite( cmtFpH_t h, const cmChar_t* fn );
+  cmtFpRC_t   cmtFpRead(  cmCtx_t* ctx, cmtFpH_t* hp, const cmChar_t* fn );
+
+  // Peak pick the onsets in the audio file (or float32 file See cmtF32File.h) 'fn' from begSmpIdx to begSmpIdx+smpCnt
+  // (or the end of the file if smpCnt is 0). The onset times are given in seconds
+  // from the start of the file. Release *onsetSecsVRef with cmMemFree().
+  cmtFpRC_t   cmtFpAudioOnsets( cmCtx_t* ctx, const cmChar_t* fn, long long begSmpIdx, long long smpCnt, double threshold, double minGapMs, double** onsetSecsVRef, unsigned* onsetCntRef );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmFileSys.h"
+
+#include "cmtHash.h"
+#include "cmtGenCache.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+// Increment when the cache layout changes.
+#define cmtGcVersionStr "cmtGenCache 1"
+
+// Copy 'srcFn' to 'dstFn'. If 'tmpFl' is set the copy is written to a temporary
+// file which is renamed to 'dstFn' so that concurrent readers never see a partial file.
+cmtGcRC_t _cmtGcCopy( cmtGc_t* p, const cmChar_t* srcFn, const cmChar_t* dstFn, bool tmpFl )
+{
+  cmtGcRC_t rc     = kOkGcRC;
+  FILE*     ifp    = NULL;
+  FILE*     ofp    = NULL;
+  cmChar_t* tmpFn  = NULL;
+  char      buf[ 64*1024 ];
+  size_t    n;
+
+  if( tmpFl )
+  {
+    unsigned tmpN = strlen(dstFn) + 32;
+    tmpFn = cmMemAllocZ(cmChar_t,tmpN);
+    snprintf(tmpFn,tmpN,"%s.tmp%i",dstFn,(int)getpid());
+  }
+
+  if((ifp = fopen(srcFn,"rb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The file '%s' could not be opened.",srcFn);
+    goto errLabel;
+  }
+
+  if((ofp = fopen(tmpFl ? tmpFn : dstFn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The file '%s' could not be created.",dstFn);
+    goto errLabel;
+  }
+
+  while((n = fread(buf,1,sizeof(buf),ifp)) > 0 )
+    if( fwrite(buf,1,n,ofp) != n )
+    {
+      rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The file '%s' could not be written.",dstFn);
+      goto errLabel;
+    }
+
+ errLabel:
+  if( ifp != NULL )
+    fclose(ifp);
+
+  if( ofp != NULL && fclose(ofp) != 0 && rc == kOkGcRC )
+    rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The file '%s' could not be written.",dstFn);
+
+  if( tmpFl && ofp != NULL )
+  {
+    if( rc == kOkGcRC && rename(tmpFn,dstFn) != 0 )
+      rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The file '%s' could not be renamed to '%s'.",tmpFn,dstFn);
+
+    if( rc != kOkGcRC )
+      remove(tmpFn);
+  }
+
+  cmMemFree(tmpFn);
+  return rc;
+}
+
+// Return the name of the cached file for output 'idx' or the printed text if 'idx' is cmInvalidIdx.
+const cmChar_t* _cmtGcFn( cmtGc_t* p, unsigned idx )
+{
+  cmChar_t label[ 32 ];
+
+  if( idx == cmInvalidIdx )
+    snprintf(label,sizeof(label),"%016llx",p->key);
+  else
+    snprintf(label,sizeof(label),"%016llx_%i",p->key,idx);
+
+  return cmFsMakeFn(p->dir,label,idx==cmInvalidIdx ? "txt" : "out",NULL);
+}
+
+cmtGcRC_t cmtGcOpen( cmCtx_t* ctx, cmtGc_t* p, const cmChar_t* dir, const cmChar_t** inFnV, unsigned inFnN, const cmChar_t* parmStr )
+{
+  unsigned i;
+
+  memset(p,0,sizeof(*p));
+  cmErrSetup(&p->err,&ctx->rpt,"Generate Cache");
+  p->ctx = ctx;
+  p->dir = dir;
+
+  p->key = cmtHashStr(cmtGcVersionStr,kFnvSeedHash);
+  p->key = cmtHashStr(parmStr,p->key);
+
+  for(i=0; i<inFnN; ++i)
+  {
+    unsigned long long h = 0;
+
+    // a missing input is hashed as an empty name
+    if( inFnV[i] != NULL && cmtHashFile(inFnV[i],&h) == false )
+      return cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The input file '%s' could not be read.",inFnV[i]);
+
+    p->key = cmtHashBuf(&h,sizeof(h),p->key);
+  }
+
+  if( !cmFsIsDir(dir) )
+    if( cmFsMkDir(dir) != kOkFsRC )
+      return cmErrMsg(&p->err,kDirFailGcRC,"The cache directory '%s' could not be created.",dir);
+
+  return kOkGcRC;
+}
+
+void cmtGcClose( cmtGc_t* p )
+{
+  if( p->captureFl )
+  {
+    p->ctx->rpt  = p->rpt;
+    p->captureFl = false;
+  }
+
+  cmMemPtrFree(&p->text);
+  p->textN      = 0;
+  p->textAllocN = 0;
+}
+
+bool cmtGcRestore( cmtGc_t* p, const cmChar_t** outFnV, unsigned outFnN )
+{
+  const cmChar_t* txtFn = _cmtGcFn(p,cmInvalidIdx);
+  bool            hitFl = false;
+  FILE*           fp    = NULL;
+  unsigned        i;
+
+  // the text file is stored last and therefore marks a complete entry
+  if( !cmFsIsFile(txtFn) )
+    goto errLabel;
+
+  for(i=0; i<outFnN; ++i)
+    if( outFnV[i] != NULL )
+    {
+      const cmChar_t* fn = _cmtGcFn(p,i);
+      bool            fl = cmFsIsFile(fn) && _cmtGcCopy(p,fn,outFnV[i],false) == kOkGcRC;
+      cmFsFreeFn(fn);
+
+      if( !fl )
+        goto errLabel;
+    }
+
+  if((fp = fopen(txtFn,"rb")) != NULL )
+  {
+    char   buf[ 4096 ];
+    size_t n;
+
+    while((n = fread(buf,1,sizeof(buf)-1,fp)) > 0 )
+    {
+      buf[n] = 0;
+      cmRptPrint(&p->ctx->rpt,buf);
+    }
+
+    fclose(fp);
+  }
+
+  hitFl = true;
+
+ errLabel:
+  cmFsFreeFn(txtFn);
+  return hitFl;
+}
+
+// cmRpt_t print function which records the text and passes it on to the original report object.
+void _cmtGcCapturePrint( void* arg, const char* text )
+{
+  cmtGc_t* p = (cmtGc_t*)arg;
+  unsigned n = strlen(text);
+
+  if( p->textN + n + 1 > p->textAllocN )
+  {
+    p->textAllocN = cmMax(2*p->textAllocN,p->textN + n + 1024);
+    p->text       = cmMemResize(cmChar_t,p->text,p->textAllocN);
+  }
+
+  memcpy(p->text + p->textN,text,n+1);
+  p->textN += n;
+
+  cmRptPrint(&p->rpt,text);
+}
+
+void cmtGcCapture( cmtGc_t* p )
+{
+  if( p->captureFl )
+    return;
+
+  p->rpt       = p->ctx->rpt;
+  p->captureFl = true;
+  cmRptSetup(&p->ctx->rpt,_cmtGcCapturePrint,_cmtGcCapturePrint,p);
+}
+
+cmtGcRC_t cmtGcStore( cmtGc_t* p, const cmChar_t** outFnV, unsigned outFnN, bool okFl )
+{
+  cmtGcRC_t       rc     = kOkGcRC;
+  const cmChar_t* txtFn  = NULL;
+  cmChar_t*       tmpFn  = NULL;
+  FILE*           fp     = NULL;
+  unsigned        i;
+
+  if( p->captureFl )
+  {
+    p->ctx->rpt  = p->rpt;
+    p->captureFl = false;
+  }
+
+  if( !okFl )
+    return rc;
+
+  for(i=0; i<outFnN; ++i)
+    if( outFnV[i] != NULL )
+    {
+      const cmChar_t* fn = _cmtGcFn(p,i);
+      rc = _cmtGcCopy(p,outFnV[i],fn,true);
+      cmFsFreeFn(fn);
+
+      if( rc != kOkGcRC )
+        return rc;
+    }
+
+  // write the text file last - see cmtGcRestore()
+  txtFn = _cmtGcFn(p,cmInvalidIdx);
+  tmpFn = cmMemAllocZ(cmChar_t,strlen(txtFn) + 32);
+  sprintf(tmpFn,"%s.tmp%i",txtFn,(int)getpid());
+
+  if((fp = fopen(tmpFn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The cache file '%s' could not be created.",tmpFn);
+    goto errLabel;
+  }
+
+  if( p->textN > 0 )
+    fwrite(p->text,1,p->textN,fp);
+
+  if( fclose(fp) != 0 || rename(tmpFn,txtFn) != 0 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailGcRC,errno,"The cache file '%s' could not be written.",txtFn);
+    remove(tmpFn);
+  }
+
+ errLabel:
+  cmMemFree(tmpFn);
+  cmFsFreeFn(txtFn);
+  return rc;
+}
@@ -0,0 +1,75 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtGenCache_h
+#define cmtGenCache_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Identical-rerun cache of generated output files.
+  //
+  // The key of a generation step is the hash of the contents of its input
+  // files and a string which describes its parameters.  The output files and
+  // the text printed while they were generated are stored in the cache
+  // directory under the key.  When the same inputs and parameters are seen
+  // again the outputs are copied from the cache and the text is printed
+  // again instead of rerunning the step.
+  //
+  // Only the outputs are cached - no intermediate (e.g. parsed) form of the
+  // inputs is kept.  Any change to an input or a parameter reruns the whole
+  // step, so the cache only saves time when a step is rerun unchanged.
+  //
+  //  cmtGcOpen(ctx,&gc,dir,inFnV,inFnN,parmStr);
+  //  if( !cmtGcRestore(&gc,outFnV,outFnN) )
+  //  {
+  //    cmtGcCapture(&gc);
+  //    rc = generate(...);
+  //    cmtGcStore(&gc,outFnV,outFnN,rc==kOkRC);
+  //  }
+  //  cmtGcClose(&gc);
+
+  enum
+  {
+    kOkGcRC = cmOkRC,
+    kFileFailGcRC,
+    kDirFailGcRC
+  };
+
+  typedef cmRC_t cmtGcRC_t;
+
+  typedef struct
+  {
+    cmCtx_t*           ctx;
+    cmErr_t            err;
+    const cmChar_t*    dir;      // cache directory
+    unsigned long long key;
+    cmRpt_t            rpt;      // ctx->rpt before cmtGcCapture()
+    bool               captureFl;
+    cmChar_t*          text;     // text[textAllocN] output printed since cmtGcCapture()
+    unsigned           textN;
+    unsigned           textAllocN;
+  } cmtGc_t;
+
+  // Calculate the key of the files inFnV[inFnN] and the parameter string 'parmStr'.
+  // The directory 'dir' is created if it does not exist.
+  cmtGcRC_t cmtGcOpen(  cmCtx_t* ctx, cmtGc_t* p, const cmChar_t* dir, const cmChar_t** inFnV, unsigned inFnN, const cmChar_t* parmStr );
+  void      cmtGcClose( cmtGc_t* p );
+
+  // Copy the cached outputs to outFnV[outFnN] and print the cached text.
+  // NULL elements of outFnV[] are skipped - if the set of requested outputs
+  // changes what the step prints it must be described by 'parmStr'.
+  // Returns false if any requested output is not in the cache.
+  bool      cmtGcRestore( cmtGc_t* p, const cmChar_t** outFnV, unsigned outFnN );
+
+  // Start recording the text printed through ctx->rpt.  The text is still printed.
+  void      cmtGcCapture( cmtGc_t* p );
+
+  // Stop recording and, if 'okFl' is true, store the outputs and the recorded text.
+  cmtGcRC_t cmtGcStore( cmtGc_t* p, const cmChar_t** outFnV, unsigned outFnN, bool okFl );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
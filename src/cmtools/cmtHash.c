@@ -0,0 +1,127 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtHash.h"
+
+#define cmtFnvOffsetBasis 0xcbf29ce484222325ULL
+#define cmtFnvPrime       0x100000001b3ULL
+
+unsigned long long cmtHashBuf( const void* buf, unsigned byteCnt, unsigned long long seed )
+{
+  const unsigned char* p  = (const unsigned char*)buf;
+  const unsigned char* ep = p + byteCnt;
+  unsigned long long   h  = seed == kFnvSeedHash ? cmtFnvOffsetBasis : seed;
+
+  for(; p<ep; ++p)
+  {
+    h ^= *p;
+    h *= cmtFnvPrime;
+  }
+
+  return h;
+}
+
+unsigned long long cmtHashStr( const cmChar_t* s, unsigned long long seed )
+{ return s==NULL ? cmtHashBuf("",1,seed) : cmtHashBuf(s,strlen(s)+1,seed); }
+
+bool cmtHashFile( const cmChar_t* fn, unsigned long long* hashRef )
+{
+  FILE*              fp;
+  unsigned long long h = kFnvSeedHash;
+  unsigned           bufByteCnt = 64*1024;
+  char               buf[ bufByteCnt ];
+  size_t             n;
+
+  if( fn == NULL || (fp = fopen(fn,"rb")) == NULL )
+    return false;
+
+  while((n = fread(buf,1,bufByteCnt,fp)) > 0 )
+    h = cmtHashBuf(buf,n,h);
+
+  fclose(fp);
+
+  *hashRef = h;
+  return true;
+}
+
+void cmtStrMapInit( cmtStrMap_t* m, unsigned initCnt )
+{
+  unsigned n = 16;
+
+  // keep the table no more than half full
+  while( n < 2*initCnt )
+    n *= 2;
+
+  m->keyV   = cmMemAllocZ(const cmChar_t*,n);
+  m->valV   = cmMemAllocZ(unsigned,n);
+  m->allocN = n;
+  m->n      = 0;
+}
+
+void cmtStrMapFree( cmtStrMap_t* m )
+{
+  cmMemPtrFree(&m->keyV);
+  cmMemPtrFree(&m->valV);
+  m->allocN = 0;
+  m->n      = 0;
+}
+
+// Return the slot which contains 'key' or the empty slot where it should be inserted.
+unsigned _cmtStrMapSlot( const cmtStrMap_t* m, const cmChar_t* key )
+{
+  unsigned mask = m->allocN - 1;
+  unsigned i    = (unsigned)cmtHashStr(key,kFnvSeedHash) & mask;
+
+  while( m->keyV[i] != NULL && strcmp(m->keyV[i],key) != 0 )
+    i = (i + 1) & mask;
+
+  return i;
+}
+
+void cmtStrMapInsert( cmtStrMap_t* m, const cmChar_t* key, unsigned val )
+{
+  unsigned i;
+
+  // grow the table when it becomes half full
+  if( 2*(m->n+1) > m->allocN )
+  {
+    cmtStrMap_t t;
+    cmtStrMapInit(&t,m->allocN);
+
+    for(i=0; i<m->allocN; ++i)
+      if( m->keyV[i] != NULL )
+        cmtStrMapInsert(&t,m->keyV[i],m->valV[i]);
+
+    cmtStrMapFree(m);
+    *m = t;
+  }
+
+  i = _cmtStrMapSlot(m,key);
+
+  if( m->keyV[i] == NULL )
+  {
+    m->keyV[i] = key;
+    ++m->n;
+  }
+
+  m->valV[i] = val;
+}
+
+unsigned cmtStrMapFind( const cmtStrMap_t* m, const cmChar_t* key )
+{
+  unsigned i;
+
+  if( m->allocN == 0 || key == NULL )
+    return cmInvalidIdx;
+
+  i = _cmtStrMapSlot(m,key);
+
+  return m->keyV[i] == NULL ? cmInvalidIdx : m->valV[i];
+}
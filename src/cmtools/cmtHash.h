@@ -0,0 +1,43 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtHash_h
+#define cmtHash_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // 64 bit FNV-1a hash of a byte buffer. Pass the result of a previous
+  // call as 'seed' to hash discontiguous buffers. Use kFnvSeedHash for the first call.
+  enum { kFnvSeedHash = 0 };
+  unsigned long long cmtHashBuf( const void* buf, unsigned byteCnt, unsigned long long seed );
+  unsigned long long cmtHashStr( const cmChar_t* s, unsigned long long seed );
+
+  // Hash the contents of a file. Returns false if the file could not be read.
+  bool cmtHashFile( const cmChar_t* fn, unsigned long long* hashRef );
+
+  // String keyed hash table which maps a string to an unsigned value.
+  // The table does not copy the key strings - they must remain valid
+  // for the lifetime of the table.
+  typedef struct
+  {
+    const cmChar_t** keyV;  // keyV[allocN]
+    unsigned*        valV;  // valV[allocN]
+    unsigned         allocN; // always a power of 2
+    unsigned         n;      // count of keys in the table
+  } cmtStrMap_t;
+
+  void     cmtStrMapInit(  cmtStrMap_t* m, unsigned initCnt );
+  void     cmtStrMapFree(  cmtStrMap_t* m );
+
+  // Insert 'key'.  If 'key' already exists its value is replaced.
+  void     cmtStrMapInsert( cmtStrMap_t* m, const cmChar_t* key, unsigned val );
+
+  // Return the value assoc'd with 'key' or cmInvalidIdx if 'key' is not in the table.
+  unsigned cmtStrMapFind(   const cmtStrMap_t* m, const cmChar_t* key );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
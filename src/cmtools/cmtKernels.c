@@ -0,0 +1,45 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+
+#include "cmtKernels.h"
+
+double cmtKnDistance( const cmSample_t* b0, const cmSample_t* b1, unsigned n, double maxDist )
+{
+  double            sum = 0;
+  const cmSample_t* ep  = b1 + n;
+
+  while(b1 < ep && sum < maxDist )
+  {
+    sum += ((*b0)-(*b1)) * ((*b0)-(*b1));
+    ++b0;
+    ++b1;
+  }
+  return sum;
+}
+
+double cmtKnDistanceStrided( const cmSample_t* b0, const cmSample_t* b1, unsigned n, unsigned stride, double maxDist )
+{
+  double   sum = 0;
+  unsigned i;
+
+  for(i=0; i<n && sum < maxDist; i+=stride)
+    sum += (b0[i]-b1[i]) * (b0[i]-b1[i]);
+
+  return sum;
+}
+
+unsigned cmtKnImpulseFill( cmSample_t* buf, unsigned bufSmpCnt, long long begSmpIdx, const cmtKnImpulse_t* v, unsigned n, unsigned idx )
+{
+  long long endSmpIdx = begSmpIdx + bufSmpCnt;
+
+  memset(buf,0,bufSmpCnt*sizeof(cmSample_t));
+
+  for(; idx<n && v[idx].smpIdx < endSmpIdx; ++idx)
+    if( v[idx].smpIdx >= begSmpIdx )
+      buf[ v[idx].smpIdx - begSmpIdx ] = v[idx].gain;
+
+  return idx;
+}
@@ -0,0 +1,38 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtKernels_h
+#define cmtKernels_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Inner loops of the mas processing stages.
+  //
+  // These are kept apart from mas.c so that they can be timed in isolation
+  // by the kernel microbenchmark (See kernbench.c).
+
+  // Sum of squared differences between b0[n] and the reference window b1[n].
+  // The sum stops once it reaches maxDist.
+  double cmtKnDistance( const cmSample_t* b0, const cmSample_t* b1, unsigned n, double maxDist );
+
+  // Same as cmtKnDistance() but only compares every 'stride' sample.
+  double cmtKnDistanceStrided( const cmSample_t* b0, const cmSample_t* b1, unsigned n, unsigned stride, double maxDist );
+
+  // An impulse in the MIDI impulse file (See midiToAudio()).
+  typedef struct
+  {
+    long long  smpIdx;  // location of the impulse in the audio file
+    cmSample_t gain;
+  } cmtKnImpulse_t;
+
+  // Zero buf[bufSmpCnt], which begins at sample 'begSmpIdx' of the audio file,
+  // and write the impulses v[idx:n] which fall inside it.  v[] must be sorted by
+  // smpIdx.  Returns the index of the first impulse which follows the buffer.
+  unsigned cmtKnImpulseFill( cmSample_t* buf, unsigned bufSmpCnt, long long begSmpIdx, const cmtKnImpulse_t* v, unsigned n, unsigned idx );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,657 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmFileSys.h"
+#include "cmJson.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmMidiFile.h"
+#include "cmAudioFile.h"
+#include "cmTimeLine.h"
+#include "cmScoreProc.h"
+
+#include "cmtHash.h"
+#include "cmtTlBin.h"
+#include "cmtTlIndex.h"
+#include "cmtTrace.h"
+#include "cmtProcPool.h"
+#include "cmtGenCache.h"
+#include "cmtMeasGen.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+// Increment when the measurement or the cache key changes.
+#define cmtMgVersionStr "cmtMeasGen 1"
+
+typedef struct
+{
+  unsigned           objIdx;    // index of the marker in the time line
+  unsigned           trackId;
+  long long          smpIdx;    // begin of the marker in its sequence
+  unsigned long long key;       // cache key
+  cmChar_t*          fn;        // file holding the rows of the marker or NULL
+  bool               ownFl;     // true if 'fn' is a temporary copy of cached rows
+} cmtMgMarker_t;
+
+typedef struct
+{
+  cmCtx_t*        ctx;
+  cmErr_t         err;
+  cmJsonH_t       jsH;           // program resource file
+  const cmChar_t* tlFn;
+  const cmChar_t* tlPrefixPath;
+  const cmChar_t* scoreFn;
+  unsigned*       dynRefV;       // dynRefV[dynRefN]
+  unsigned        dynRefN;
+  cmtTlbH_t       tlbH;
+  const cmChar_t* cacheDir;      // per marker cache directory or NULL
+  cmtMgMarker_t*  mkV;           // mkV[mkN] markers in time line order
+  unsigned        mkN;
+  unsigned*       tdV;           // tdV[tdN] index into mkV[] of the markers to measure
+  unsigned        tdN;
+  unsigned*       grpV;          // grpV[jobN+1] index into tdV[] of the first marker of each job
+  unsigned        jobN;
+  cmChar_t**      tmpFnV;        // tmpFnV[jobN*kMgTmpFnCnt] temporary files of each job
+} cmtMg_t;
+
+// temporary files of a job
+enum
+{
+  kTlMgTmpFnId,
+  kRsrcMgTmpFnId,
+  kOutMgTmpFnId,
+  kMgTmpFnCnt
+};
+
+cmChar_t* _cmtMgTempFn( cmtMg_t* p, const cmChar_t* label )
+{
+  const cmChar_t* dir = getenv("TMPDIR");
+  unsigned        n   = (dir == NULL ? 4 : strlen(dir)) + strlen(label) + 32;
+  cmChar_t*       fn  = cmMemAllocZ(cmChar_t,n);
+  int             fd;
+
+  snprintf(fn,n,"%s/cmtools_%s_XXXXXX",dir == NULL ? "/tmp" : dir,label);
+
+  if((fd = mkstemp(fn)) == -1 )
+  {
+    cmErrSysMsg(&p->err,kFileFailMgRC,errno,"The temporary file '%s' could not be created.",fn);
+    cmMemFree(fn);
+    return NULL;
+  }
+
+  close(fd);
+  return fn;
+}
+
+cmtMgRC_t _cmtMgLoadRsrc( cmtMg_t* p, const cmChar_t* pgmRsrcFn )
+{
+  const cmChar_t* errLabelPtr = NULL;
+  cmJsonNode_t*   dynNp       = NULL;
+  unsigned        i;
+
+  if( cmJsonInitializeFromFile(&p->jsH,pgmRsrcFn,p->ctx) != kOkJsRC )
+    return cmErrMsg(&p->err,kRsrcFailMgRC,"The program resource file '%s' could not be read.",pgmRsrcFn);
+
+  if( cmJsonMemberValues(cmJsonRoot(p->jsH),&errLabelPtr,
+      "timeLineFn",   kStringTId, &p->tlFn,
+      "tlPrefixPath", kStringTId, &p->tlPrefixPath,
+      "scoreFn",      kStringTId, &p->scoreFn,
+      "dynRef",       kArrayTId,  &dynNp,
+      NULL) != kOkJsRC )
+  {
+    return cmErrMsg(&p->err,kRsrcFailMgRC,"The field '%s' is missing or invalid in '%s'.",cmStringNullGuard(errLabelPtr),pgmRsrcFn);
+  }
+
+  p->dynRefN = cmJsonChildCount(dynNp);
+  p->dynRefV = cmMemAllocZ(unsigned,p->dynRefN);
+
+  for(i=0; i<p->dynRefN; ++i)
+    if( cmJsonUIntValue(cmJsonArrayElementC(dynNp,i),p->dynRefV + i) != kOkJsRC )
+      return cmErrMsg(&p->err,kRsrcFailMgRC,"The 'dynRef' element at index %i is not an integer in '%s'.",i,pgmRsrcFn);
+
+  return kOkMgRC;
+}
+
+int _cmtMgMarkerCompare( const void* p0, const void* p1 )
+{
+  const cmtMgMarker_t* m0 = (const cmtMgMarker_t*)p0;
+  const cmtMgMarker_t* m1 = (const cmtMgMarker_t*)p1;
+
+  if( m0->trackId != m1->trackId )
+    return m0->trackId < m1->trackId ? -1 : 1;
+
+  if( m0->smpIdx != m1->smpIdx )
+    return m0->smpIdx < m1->smpIdx ? -1 : 1;
+
+  return m0->objIdx < m1->objIdx ? -1 : (m0->objIdx > m1->objIdx ? 1 : 0);
+}
+
+// Load the time line and locate the markers in the order in which cmScoreProc() measures them:
+// by sequence and then by time.
+cmtMgRC_t _cmtMgLoadTimeLine( cmtMg_t* p )
+{
+  cmtMgRC_t rc     = kOkMgRC;
+  cmChar_t* binFn  = NULL;
+  unsigned  objN;
+  unsigned  i;
+
+  if( cmtTlbIsBinFn(p->tlFn) )
+  {
+    if( cmtTlbOpen(p->ctx,&p->tlbH,p->tlFn) != kOkTlbRC )
+      return cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line '%s' could not be opened.",p->tlFn);
+  }
+  else
+  {
+    // the mapped binary time line remains valid after its file is removed
+    if((binFn = _cmtMgTempFn(p,"tlb")) == NULL )
+      return kFileFailMgRC;
+
+    if( cmtTlbJsonToBin(p->ctx,p->tlFn,binFn) != kOkTlbRC || cmtTlbOpen(p->ctx,&p->tlbH,binFn) != kOkTlbRC )
+      rc = cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line '%s' could not be read.",p->tlFn);
+
+    remove(binFn);
+    cmMemFree(binFn);
+
+    if( rc != kOkMgRC )
+      return rc;
+  }
+
+  objN   = cmtTlbObjCount(p->tlbH);
+  p->mkV = cmMemAllocZ(cmtMgMarker_t,objN);
+
+  for(i=0; i<objN; ++i)
+  {
+    const cmtTlbObj_t* o = cmtTlbObj(p->tlbH,i);
+
+    if( cmtTlbTypeLabelToId(cmtTlbStr(p->tlbH,o->typeOffs)) == kMarkerTlId )
+    {
+      cmtMgMarker_t* m = p->mkV + p->mkN++;
+      m->objIdx  = i;
+      m->trackId = o->trackId;
+      m->smpIdx  = cmtTlbObjAbsSmpIdx(p->tlbH,i);
+    }
+  }
+
+  qsort(p->mkV,p->mkN,sizeof(p->mkV[0]),_cmtMgMarkerCompare);
+
+  return rc;
+}
+
+// Write the time line of job 'jobIdx': every object which is not a marker and the markers of the job.
+cmtMgRC_t _cmtMgWriteTimeLine( cmtMg_t* p, unsigned jobIdx, const cmChar_t* fn )
+{
+  cmtMgRC_t   rc   = kOkMgRC;
+  cmtTlbWrH_t wrH  = cmtTlbWrNullHandle;
+  unsigned    objN = cmtTlbObjCount(p->tlbH);
+  bool*       inclV = cmMemAllocZ(bool,objN);
+  unsigned    i;
+
+  for(i=0; i<objN; ++i)
+    inclV[i] = cmtTlbTypeLabelToId(cmtTlbStr(p->tlbH,cmtTlbObj(p->tlbH,i)->typeOffs)) != kMarkerTlId;
+
+  for(i=p->grpV[jobIdx]; i<p->grpV[jobIdx+1]; ++i)
+    inclV[ p->mkV[ p->tdV[i] ].objIdx ] = true;
+
+  if( cmtTlbWrCreate(p->ctx,&wrH,cmtTlbSampleRate(p->tlbH)) != kOkTlbRC )
+  {
+    rc = cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line builder could not be created.");
+    goto errLabel;
+  }
+
+  for(i=0; i<objN; ++i)
+    if( inclV[i] )
+    {
+      const cmtTlbObj_t* o = cmtTlbObj(p->tlbH,i);
+
+      if( cmtTlbWrInsert(wrH,cmtTlbStr(p->tlbH,o->labelOffs),cmtTlbStr(p->tlbH,o->typeOffs),cmtTlbStr(p->tlbH,o->refOffs),o->offset,o->smpCnt,o->trackId,cmtTlbStr(p->tlbH,o->textOffs)) != kOkTlbRC )
+      {
+        rc = cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line object at index %i could not be copied.",i);
+        goto errLabel;
+      }
+    }
+
+  // cmScoreProc() reads the time line with cmTimeLineInitializeFromFile() which requires JSON.
+  // The JSON time line holds 32 bit positions - cmtTlbWrWriteJson() fails on a position
+  // which does not fit and the job is not run.
+  if( cmtTlbWrWriteJson(wrH,fn) != kOkTlbRC )
+    rc = cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line '%s' could not be written. A time line position may not fit in 32 bits.",fn);
+
+ errLabel:
+  cmtTlbWrDestroy(&wrH);
+  cmMemFree(inclV);
+  return rc;
+}
+
+// Write a copy of the program resource file which refers to the time line 'tlFn'.
+cmtMgRC_t _cmtMgWriteRsrc( cmtMg_t* p, const cmChar_t* tlFn, const cmChar_t* fn )
+{
+  FILE*    fp;
+  unsigned i;
+
+  if((fp = fopen(fn,"w")) == NULL )
+    return cmErrSysMsg(&p->err,kFileFailMgRC,errno,"The program resource file '%s' could not be created.",fn);
+
+  fprintf(fp,"{\n  timeLineFn:   \"%s\"\n  tlPrefixPath: \"%s\"\n  scoreFn:      \"%s\"\n\n  dynRef: [",tlFn,p->tlPrefixPath,p->scoreFn);
+
+  for(i=0; i<p->dynRefN; ++i)
+    fprintf(fp," %i",p->dynRefV[i]);
+
+  fprintf(fp," ]\n}\n");
+
+  if( fclose(fp) != 0 )
+    return cmErrSysMsg(&p->err,kFileFailMgRC,errno,"The program resource file '%s' could not be written.",fn);
+
+  return kOkMgRC;
+}
+
+// Return the hash of the MIDI file of the time line object 'objIdx'.  The file
+// name is tried as given and then relative to the time line prefix path.  If the file
+// cannot be found the name is hashed and cmScoreProc() will report the error.
+unsigned long long _cmtMgMidiFileHash( cmtMg_t* p, unsigned objIdx )
+{
+  const cmChar_t*    fn = cmtTlbStr(p->tlbH,cmtTlbObj(p->tlbH,objIdx)->textOffs);
+  const cmChar_t*    pfn;
+  unsigned long long h  = 0;
+
+  if( cmFsIsFile(fn) && cmtHashFile(fn,&h) )
+    return h;
+
+  if((pfn = cmFsMakeFn(p->tlPrefixPath,fn,NULL,NULL)) != NULL )
+  {
+    bool fl = cmFsIsFile(pfn) && cmtHashFile(pfn,&h);
+    cmFsFreeFn(pfn);
+
+    if( fl )
+      return h;
+  }
+
+  return cmtHashStr(fn,kFnvSeedHash);
+}
+
+// Calculate the cache key of each marker from its time range, the MIDI files
+// which overlap it, the score file and the 'dynRef' table.
+cmtMgRC_t _cmtMgMarkerKeys( cmtMg_t* p )
+{
+  cmtMgRC_t               rc      = kOkMgRC;
+  unsigned                objN    = cmtTlbObjCount(p->tlbH);
+  unsigned long long*     mfHashV = cmMemAllocZ(unsigned long long,objN);
+  bool*                   mfFlV   = cmMemAllocZ(bool,objN);
+  const cmtTlIdxEntry_t** eV      = cmMemAllocZ(const cmtTlIdxEntry_t*,objN);
+  cmtTlIdxH_t             idxH    = cmtTlIdxNullHandle;
+  double                  srate   = cmtTlbSampleRate(p->tlbH);
+  unsigned long long      scHash  = 0;
+  unsigned long long      seed;
+  unsigned                i,j,n;
+
+  if( !cmtHashFile(p->scoreFn,&scHash) )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailMgRC,errno,"The score file '%s' could not be read.",p->scoreFn);
+    goto errLabel;
+  }
+
+  if( cmtTlIdxFromTlb(p->ctx,&idxH,p->tlbH) != kOkTlIdxRC )
+  {
+    rc = cmErrMsg(&p->err,kTimeLineFailMgRC,"The time line index could not be built.");
+    goto errLabel;
+  }
+
+  seed = cmtHashStr(cmtMgVersionStr,kFnvSeedHash);
+  seed = cmtHashBuf(&scHash,sizeof(scHash),seed);
+  seed = cmtHashBuf(&srate,sizeof(srate),seed);
+  seed = cmtHashBuf(p->dynRefV,p->dynRefN*sizeof(p->dynRefV[0]),seed);
+
+  for(i=0; i<p->mkN; ++i)
+  {
+    cmtMgMarker_t*     m = p->mkV + i;
+    const cmtTlbObj_t* o = cmtTlbObj(p->tlbH,m->objIdx);
+    long long          endSmpIdx = m->smpIdx + cmMax(1,o->smpCnt);
+
+    m->key = cmtHashStr(cmtTlbStr(p->tlbH,o->labelOffs),seed);
+    m->key = cmtHashStr(cmtTlbStr(p->tlbH,o->textOffs),m->key);
+    m->key = cmtHashBuf(&m->trackId,sizeof(m->trackId),m->key);
+    m->key = cmtHashBuf(&m->smpIdx,sizeof(m->smpIdx),m->key);
+    m->key = cmtHashBuf(&endSmpIdx,sizeof(endSmpIdx),m->key);
+
+    n = cmtTlIdxRange(idxH,m->trackId,m->smpIdx,endSmpIdx,kMidiFileTlId,eV,objN);
+
+    for(j=0; j<n; ++j)
+    {
+      unsigned k = eV[j]->objIdx;
+
+      if( !mfFlV[k] )
+      {
+        mfHashV[k] = _cmtMgMidiFileHash(p,k);
+        mfFlV[k]   = true;
+      }
+
+      m->key = cmtHashBuf(mfHashV + k,sizeof(mfHashV[k]),m->key);
+      m->key = cmtHashBuf(&eV[j]->begSmpIdx,sizeof(eV[j]->begSmpIdx),m->key);
+      m->key = cmtHashBuf(&eV[j]->endSmpIdx,sizeof(eV[j]->endSmpIdx),m->key);
+    }
+  }
+
+ errLabel:
+  cmtTlIdxDestroy(&idxH);
+  cmMemFree(eV);
+  cmMemFree(mfFlV);
+  cmMemFree(mfHashV);
+  return rc;
+}
+
+// Open the cache entry of marker 'mkIdx'.
+cmtMgRC_t _cmtMgCacheOpen( cmtMg_t* p, unsigned mkIdx, cmtGc_t* gc )
+{
+  cmChar_t parmStr[ 64 ];
+
+  snprintf(parmStr,sizeof(parmStr),"meas_gen %016llx",p->mkV[mkIdx].key);
+
+  if( cmtGcOpen(p->ctx,gc,p->cacheDir,NULL,0,parmStr) != kOkGcRC )
+    return cmErrMsg(&p->err,kFileFailMgRC,"The measurement cache '%s' could not be opened.",p->cacheDir);
+
+  return kOkMgRC;
+}
+
+// Copy the cached rows of each marker to a temporary file and list the markers
+// which are not in the cache in tdV[].
+cmtMgRC_t _cmtMgCacheRestore( cmtMg_t* p )
+{
+  cmtMgRC_t rc = kOkMgRC;
+  unsigned  i;
+
+  for(i=0; i<p->mkN && rc==kOkMgRC; ++i)
+  {
+    cmtMgMarker_t* m = p->mkV + i;
+    cmtGc_t        gc;
+
+    if((m->fn = _cmtMgTempFn(p,"meas")) == NULL )
+      return kFileFailMgRC;
+
+    m->ownFl = true;
+
+    if((rc = _cmtMgCacheOpen(p,i,&gc)) != kOkMgRC )
+      break;
+
+    if( !cmtGcRestore(&gc,(const cmChar_t**)&m->fn,1) )
+    {
+      remove(m->fn);
+      cmMemPtrFree(&m->fn);
+      m->ownFl = false;
+
+      p->tdV[ p->tdN++ ] = i;
+    }
+
+    cmtGcClose(&gc);
+  }
+
+  return rc;
+}
+
+// Store the rows of the markers measured by the job 'jobIdx'.  Each job holds one marker when the cache is used.
+cmtMgRC_t _cmtMgCacheStore( cmtMg_t* p, unsigned jobIdx )
+{
+  cmtMgRC_t       rc;
+  unsigned        mkIdx = p->tdV[ p->grpV[jobIdx] ];
+  const cmChar_t* fn    = p->tmpFnV[ jobIdx*kMgTmpFnCnt + kOutMgTmpFnId ];
+  cmtGc_t         gc;
+
+  if((rc = _cmtMgCacheOpen(p,mkIdx,&gc)) != kOkMgRC )
+    return rc;
+
+  if( cmtGcStore(&gc,&fn,1,true) != kOkGcRC )
+    rc = cmErrMsg(&p->err,kFileFailMgRC,"The measurements of marker %i could not be cached.",mkIdx);
+
+  cmtGcClose(&gc);
+  return rc;
+}
+
+// Measure the markers of one job. Called in a worker process.
+cmRC_t _cmtMgJob( void* arg, unsigned jobIdx )
+{
+  cmtMg_t*   p      = (cmtMg_t*)arg;
+  cmChar_t** fnV    = p->tmpFnV + jobIdx*kMgTmpFnCnt;
+  cmtMgRC_t  rc;
+
+  if((rc = _cmtMgWriteTimeLine(p,jobIdx,fnV[kTlMgTmpFnId])) != kOkMgRC )
+    return rc;
+
+  if((rc = _cmtMgWriteRsrc(p,fnV[kTlMgTmpFnId],fnV[kRsrcMgTmpFnId])) != kOkMgRC )
+    return rc;
+
+  if( cmScoreProc(p->ctx,"meas",fnV[kRsrcMgTmpFnId],fnV[kOutMgTmpFnId]) != cmOkRC )
+    return cmErrMsg(&p->err,kMeasFailMgRC,"Measurement failed on markers %i to %i.",p->tdV[ p->grpV[jobIdx] ],p->tdV[ p->grpV[jobIdx+1]-1 ]);
+
+  return kOkMgRC;
+}
+
+// Append the measurement rows in 'fn' to the array 'dnp' of 'dstH'.  The
+// column title row is appended only if '*titleFlRef' is false.
+cmtMgRC_t _cmtMgAppendRows( cmtMg_t* p, cmJsonH_t dstH, cmJsonNode_t* dnp, const cmChar_t* fn, bool* titleFlRef )
+{
+  cmtMgRC_t     rc  = kOkMgRC;
+  cmJsonH_t     jsH = cmJsonNullHandle;
+  cmJsonNode_t* anp;
+  unsigned      i,n;
+
+  if( cmJsonInitializeFromFile(&jsH,fn,p->ctx) != kOkJsRC )
+    return cmErrMsg(&p->err,kMeasFailMgRC,"The measurement file '%s' could not be read.",fn);
+
+  if((anp = cmJsonFindValue(jsH,"meas",cmJsonRoot(jsH),kArrayTId)) == NULL )
+  {
+    rc = cmErrMsg(&p->err,kMeasFailMgRC,"The measurement file '%s' does not contain a 'meas' array.",fn);
+    goto errLabel;
+  }
+
+  n = cmJsonChildCount(anp);
+
+  // the first row holds the column titles
+  for(i=*titleFlRef ? 1 : 0; i<n; ++i)
+  {
+    if( cmJsonDuplicateNode(dstH,cmJsonArrayElementC(anp,i),dnp) == NULL )
+    {
+      rc = cmErrMsg(&p->err,kMeasFailMgRC,"The measurement row at index %i in '%s' could not be copied.",i,fn);
+      goto errLabel;
+    }
+
+    *titleFlRef = true;
+  }
+
+ errLabel:
+  cmJsonFinalize(&jsH);
+  return rc;
+}
+
+// Merge the rows of each marker, or when the cache is not used of each job, in
+// marker order.  The rows are copied node for node so that the values are
+// written exactly as cmJson would write the rows of a serial run.
+cmtMgRC_t _cmtMgMerge( cmtMg_t* p, const cmChar_t* outFn )
+{
+  cmtMgRC_t     rc      = kOkMgRC;
+  cmJsonH_t     jsH     = cmJsonNullHandle;
+  cmJsonNode_t* anp     = NULL;
+  bool          titleFl = false;
+  unsigned      i;
+
+  if( cmJsonInitialize(&jsH,p->ctx) != kOkJsRC )
+    return cmErrMsg(&p->err,kMeasFailMgRC,"The measurement JSON object could not be created.");
+
+  if( cmJsonCreateObject(jsH,NULL) == NULL || (anp = cmJsonInsertPairArray(jsH,cmJsonRoot(jsH),"meas")) == NULL )
+  {
+    rc = cmErrMsg(&p->err,kMeasFailMgRC,"The measurement array could not be created.");
+    goto errLabel;
+  }
+
+  if( p->cacheDir != NULL )
+  {
+    for(i=0; i<p->mkN && rc==kOkMgRC; ++i)
+      rc = _cmtMgAppendRows(p,jsH,anp,p->mkV[i].fn,&titleFl);
+  }
+  else
+  {
+    for(i=0; i<p->jobN && rc==kOkMgRC; ++i)
+      rc = _cmtMgAppendRows(p,jsH,anp,p->tmpFnV[i*kMgTmpFnCnt + kOutMgTmpFnId],&titleFl);
+  }
+
+  if( rc == kOkMgRC && cmJsonWrite(jsH,cmJsonRoot(jsH),outFn) != kOkJsRC )
+    rc = cmErrMsg(&p->err,kFileFailMgRC,"The measurement file '%s' could not be written.",outFn);
+
+ errLabel:
+  cmJsonFinalize(&jsH);
+  return rc;
+}
+
+cmtMgRC_t cmtMgMeasGen( cmCtx_t* ctx, const cmChar_t* pgmRsrcFn, const cmChar_t* outFn, unsigned workerN, const cmChar_t* cacheDir )
+{
+  cmtMgRC_t   rc   = kOkMgRC;
+  cmtPpJob_t* jobV = NULL;
+  unsigned    okN  = 0;
+  cmtMg_t     mg;
+  cmtMg_t*    p    = &mg;
+  cmtTrSpan_t sp;
+  unsigned    i;
+
+  memset(p,0,sizeof(*p));
+  cmErrSetup(&p->err,&ctx->rpt,"Meas Gen");
+  p->ctx      = ctx;
+  p->jsH      = cmJsonNullHandle;
+  p->tlbH     = cmtTlbNullHandle;
+  p->cacheDir = cacheDir;
+
+  if( workerN == 0 )
+    workerN = cmtPpCpuCount();
+
+  cmtTrBegin(&sp,kPhaseTrCat,"meas_load",pgmRsrcFn);
+
+  if((rc = _cmtMgLoadRsrc(p,pgmRsrcFn)) == kOkMgRC )
+    rc = _cmtMgLoadTimeLine(p);
+
+  cmtTrEnd(&sp);
+
+  if( rc != kOkMgRC )
+    goto errLabel;
+
+  // without the cache and with fewer than two markers there is nothing to divide
+  if( cacheDir == NULL && (p->mkN < 2 || workerN < 2) )
+  {
+    if( cmScoreProc(ctx,"meas",pgmRsrcFn,outFn) != cmOkRC )
+      rc = cmErrMsg(&p->err,kMeasFailMgRC,"Measurement failed.");
+
+    goto errLabel;
+  }
+
+  p->tdV = cmMemAllocZ(unsigned,p->mkN);
+
+  if( cacheDir == NULL )
+  {
+    for(i=0; i<p->mkN; ++i)
+      p->tdV[ p->tdN++ ] = i;
+
+    // divide the markers into contiguous groups of nearly equal size
+    p->jobN = cmMin(p->mkN,workerN*kMgJobsPerWorker);
+  }
+  else
+  {
+    cmtTrBegin(&sp,kPhaseTrCat,"meas_cache",cacheDir);
+
+    if((rc = _cmtMgMarkerKeys(p)) == kOkMgRC )
+      rc = _cmtMgCacheRestore(p);
+
+    cmtTrEnd(&sp);
+
+    if( rc != kOkMgRC )
+      goto errLabel;
+
+    // the rows of a job are cached as the rows of its marker
+    p->jobN = p->tdN;
+
+    cmRptPrintf(&ctx->rpt,"Meas gen: %i of %i markers cached.\n",p->mkN-p->tdN,p->mkN);
+  }
+
+  // every marker may be in the cache
+  if( p->jobN > 0 )
+  {
+    p->grpV   = cmMemAllocZ(unsigned,p->jobN+1);
+    p->tmpFnV = cmMemAllocZ(cmChar_t*,p->jobN*kMgTmpFnCnt);
+    jobV      = cmMemAllocZ(cmtPpJob_t,p->jobN);
+
+    for(i=0; i<=p->jobN; ++i)
+      p->grpV[i] = (unsigned)((unsigned long long)i * p->tdN / p->jobN);
+
+    for(i=0; i<p->jobN*kMgTmpFnCnt; ++i)
+      if((p->tmpFnV[i] = _cmtMgTempFn(p,"meas")) == NULL )
+      {
+        rc = kFileFailMgRC;
+        goto errLabel;
+      }
+
+    cmRptPrintf(&ctx->rpt,"Meas gen: %i markers in %i groups on %i workers.\n",p->tdN,p->jobN,workerN);
+
+    if( cmtPpRun(ctx,jobV,p->jobN,workerN,_cmtMgJob,NULL,p) != kOkPpRC )
+    {
+      rc = cmErrMsg(&p->err,kMeasFailMgRC,"The measurement worker pool failed.");
+      goto errLabel;
+    }
+  }
+
+  for(i=0; i<p->jobN; ++i)
+    if( jobV[i].stateId != kDonePpId )
+      cmErrMsg(&p->err,kMeasFailMgRC,"The measurement of markers %i to %i failed (%s).",p->tdV[ p->grpV[i] ],p->tdV[ p->grpV[i+1]-1 ],cmtPpStateLabel(jobV[i].stateId));
+    else
+    {
+      ++okN;
+
+      // a marker which was measured is merged from the job output
+      if( cacheDir != NULL )
+      {
+        p->mkV[ p->tdV[ p->grpV[i] ] ].fn = p->tmpFnV[ i*kMgTmpFnCnt + kOutMgTmpFnId ];
+
+        if((rc = _cmtMgCacheStore(p,i)) != kOkMgRC )
+          goto errLabel;
+      }
+    }
+
+  if( okN < p->jobN )
+  {
+    rc = cmErrMsg(&p->err,kMeasFailMgRC,"Measurement failed on %i of %i marker groups.",p->jobN-okN,p->jobN);
+    goto errLabel;
+  }
+
+  cmtTrBegin(&sp,kPhaseTrCat,"meas_merge",outFn);
+  rc = _cmtMgMerge(p,outFn);
+  cmtTrEnd(&sp);
+
+ errLabel:
+  if( p->tmpFnV != NULL )
+    for(i=0; i<p->jobN*kMgTmpFnCnt; ++i)
+      if( p->tmpFnV[i] != NULL )
+      {
+        remove(p->tmpFnV[i]);
+        cmMemFree(p->tmpFnV[i]);
+      }
+
+  if( p->mkV != NULL )
+    for(i=0; i<p->mkN; ++i)
+      if( p->mkV[i].ownFl )
+      {
+        remove(p->mkV[i].fn);
+        cmMemFree(p->mkV[i].fn);
+      }
+
+  cmMemFree(p->tmpFnV);
+  cmMemFree(p->grpV);
+  cmMemFree(p->tdV);
+  cmMemFree(jobV);
+  cmMemFree(p->mkV);
+  cmMemFree(p->dynRefV);
+  cmtTlbClose(&p->tlbH);
+  cmJsonFinalize(&p->jsH);
+  return rc;
+}
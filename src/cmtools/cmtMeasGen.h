@@ -0,0 +1,54 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtMeasGen_h
+#define cmtMeasGen_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Performance measurement generation on a pool of worker processes.
+  //
+  // cmScoreProc("meas") follows the performance and extracts the measurements
+  // one time line marker after another.  The markers are independent so they
+  // are divided into contiguous groups and each group is measured by
+  // cmScoreProc() in its own worker process.  A worker is given a copy of
+  // the program resource file whose time line holds every object of the
+  // original time line but only the markers of its group.  The measurement
+  // rows of the groups are then merged, in marker order, into one output file.
+  //
+  // Only the 'timeLineFn', 'tlPrefixPath', 'scoreFn' and 'dynRef' fields of
+  // the program resource file are passed on to the workers.
+  //
+  // If a cache directory is given the rows of each marker are cached (See
+  // cmtGenCache.h) under a key made from the marker's time range, the
+  // contents of the MIDI files which overlap it, the contents of the score
+  // file and the 'dynRef' table.  Only the markers which are not in the
+  // cache are measured - each in its own job so that its rows can be stored.
+
+  enum
+  {
+    kOkMgRC = cmOkRC,
+    kRsrcFailMgRC,
+    kTimeLineFailMgRC,
+    kFileFailMgRC,
+    kMeasFailMgRC
+  };
+
+  typedef cmRC_t cmtMgRC_t;
+
+  enum
+  {
+    kMgJobsPerWorker = 4   // marker groups per worker - smaller groups balance the load
+  };
+
+  // Measure the performance described by 'pgmRsrcFn' on 'workerN' worker
+  // processes (0 = one per CPU) and write the measurements to 'outFn'.
+  // Set 'cacheDir' to NULL to measure every marker.
+  cmtMgRC_t cmtMgMeasGen( cmCtx_t* ctx, const cmChar_t* pgmRsrcFn, const cmChar_t* outFn, unsigned workerN, const cmChar_t* cacheDir );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
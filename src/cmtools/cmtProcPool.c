@@ -0,0 +1,194 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtProcPool.h"
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+double _cmtPpSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+unsigned cmtPpCpuCount()
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : (unsigned)n;
+}
+
+const cmChar_t* cmtPpStateLabel( unsigned stateId )
+{
+  switch( stateId )
+  {
+    case kPendingPpId: return "pending";
+    case kRunningPpId: return "running";
+    case kDonePpId:    return "ok";
+    case kFailPpId:    return "failed";
+    case kSkipPpId:    return "skipped";
+  }
+  return "<unknown>";
+}
+
+// Wait for one child to exit and record its result.  *jobFlRef is set to false
+// if the child was not one of the running jobs (e.g. a child of the caller).
+cmtPpRC_t _cmtPpReap( cmErr_t* err, cmtPpJob_t* jobV, unsigned jobN, bool* jobFlRef )
+{
+  int      status;
+  pid_t    pid;
+  unsigned i;
+
+  *jobFlRef = false;
+
+  while((pid = waitpid(-1,&status,0)) == -1 )
+    if( errno != EINTR )
+      return cmErrSysMsg(err,kWaitFailPpRC,errno,"Worker process wait failed.");
+
+  for(i=0; i<jobN; ++i)
+    if( jobV[i].stateId == kRunningPpId && jobV[i].pid == pid )
+    {
+      cmtPpJob_t* j = jobV + i;
+
+      j->secs = _cmtPpSecs() - j->begSecs;
+
+      if( WIFSIGNALED(status) )
+      {
+        j->sigNo   = WTERMSIG(status);
+        j->rc      = cmInvalidId;
+        j->stateId = kFailPpId;
+      }
+      else
+      {
+        j->rc      = WEXITSTATUS(status);
+        j->stateId = j->rc == kOkPpRC ? kDonePpId : kFailPpId;
+      }
+
+      *jobFlRef = true;
+      break;
+    }
+
+  return kOkPpRC;
+}
+
+cmtPpRC_t cmtPpRun( cmCtx_t* ctx, cmtPpJob_t* jobV, unsigned jobN, unsigned workerN, cmtPpJobFunc_t jobFunc, cmtPpDepFunc_t depFunc, void* arg )
+{
+  cmtPpRC_t rc       = kOkPpRC;
+  cmtPpRC_t forkRC   = kOkPpRC; // kForkFailPpRC after a fork failure
+  unsigned  runningN = 0;
+  unsigned  doneN    = 0;
+  bool      startFl  = true;   // false after a fork failure
+  bool      jobFl;
+  unsigned  i;
+  cmErr_t   err;
+
+  cmErrSetup(&err,&ctx->rpt,"Process Pool");
+
+  if( workerN == 0 )
+    workerN = cmtPpCpuCount();
+
+  for(i=0; i<jobN; ++i)
+  {
+    memset(jobV+i,0,sizeof(jobV[i]));
+    jobV[i].stateId = kPendingPpId;
+  }
+
+  while( doneN < jobN )
+  {
+    bool changeFl = false;
+
+    // start or skip the pending jobs whose dependencies are resolved
+    for(i=0; startFl && i<jobN && runningN<workerN; ++i)
+    {
+      cmtPpJob_t* j = jobV + i;
+
+      if( j->stateId != kPendingPpId )
+        continue;
+
+      switch( depFunc == NULL ? kRunningPpId : depFunc(arg,i,jobV) )
+      {
+        case kRunningPpId:
+          {
+            // flush buffered output so that it is not written again by the child
+            fflush(NULL);
+
+            j->begSecs = _cmtPpSecs();
+
+            if((j->pid = fork()) == -1 )
+            {
+              forkRC  = cmErrSysMsg(&err,kForkFailPpRC,errno,"A worker process could not be started.");
+              startFl = false;
+              break;
+            }
+
+            if( j->pid == 0 )
+            {
+              cmRC_t jobRC = jobFunc(arg,i);
+              fflush(NULL);
+              _exit( jobRC == kOkPpRC ? 0 : (jobRC > 0 && jobRC < 256 ? (int)jobRC : 255) );
+            }
+
+            j->stateId = kRunningPpId;
+            ++runningN;
+            changeFl   = true;
+          }
+          break;
+
+        case kSkipPpId:
+          j->stateId = kSkipPpId;
+          ++doneN;
+          changeFl   = true;
+          break;
+      }
+    }
+
+    if( runningN == 0 )
+    {
+      // a skipped job may resolve the dependencies of later jobs
+      if( changeFl && startFl )
+        continue;
+
+      // the remaining jobs can never be started
+      for(i=0; i<jobN; ++i)
+        if( jobV[i].stateId == kPendingPpId )
+        {
+          jobV[i].stateId = kSkipPpId;
+          ++doneN;
+        }
+      break;
+    }
+
+    if((rc = _cmtPpReap(&err,jobV,jobN,&jobFl)) != kOkPpRC )
+      break;
+
+    if( jobFl )
+    {
+      --runningN;
+      ++doneN;
+    }
+  }
+
+  // a wait failure leaves jobs running - reap them before returning
+  for(i=0; i<jobN && runningN>0; ++i)
+    if( jobV[i].stateId == kRunningPpId )
+    {
+      while( waitpid(jobV[i].pid,NULL,0) == -1 && errno == EINTR )
+      {}
+
+      jobV[i].stateId = kFailPpId;
+      --runningN;
+    }
+
+  return rc != kOkPpRC ? rc : forkRC;
+}
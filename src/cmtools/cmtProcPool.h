@@ -0,0 +1,69 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtProcPool_h
+#define cmtProcPool_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Run a set of jobs in a pool of forked worker processes.
+  //
+  // libcm keeps its error, memory and file system state in process globals
+  // and is not thread safe. Each job is therefore run in its own child
+  // process which inherits (copy-on-write) everything the parent has already
+  // initialized.  The child's exit status is the job result code.
+
+  enum
+  {
+    kOkPpRC = cmOkRC,
+    kForkFailPpRC,
+    kWaitFailPpRC
+  };
+
+  typedef cmRC_t cmtPpRC_t;
+
+  // Job states.
+  enum
+  {
+    kPendingPpId,
+    kRunningPpId,
+    kDonePpId,     // the job returned kOkPpRC
+    kFailPpId,     // the job returned an error code or was killed by a signal
+    kSkipPpId      // the job was not run (See cmtPpDepFunc_t)
+  };
+
+  typedef struct
+  {
+    unsigned stateId;   // kPendingPpId ... kSkipPpId
+    cmRC_t   rc;        // child exit status
+    int      sigNo;     // signal which killed the child or 0
+    int      pid;
+    double   begSecs;
+    double   secs;      // wall time from fork to exit
+  } cmtPpJob_t;
+
+  // Run job 'jobIdx'. Called in the child process.
+  typedef cmRC_t (*cmtPpJobFunc_t)( void* arg, unsigned jobIdx );
+
+  // Return the next state of the pending job 'jobIdx' given the state of all
+  // jobs in jobV[]: kRunningPpId to start it, kPendingPpId to wait or kSkipPpId
+  // to not run it (e.g. because a job it depends on failed).
+  typedef unsigned (*cmtPpDepFunc_t)( void* arg, unsigned jobIdx, const cmtPpJob_t* jobV );
+
+  // Run jobV[jobN] with at most 'workerN' jobs at once (0 = count of online CPUs).
+  // Jobs are started in index order as their dependencies allow. 'depFunc' may be
+  // NULL if the jobs are independent.  Jobs which can never become ready are skipped.
+  // The result code reports pool failures only - the job results are in jobV[].
+  cmtPpRC_t cmtPpRun( cmCtx_t* ctx, cmtPpJob_t* jobV, unsigned jobN, unsigned workerN, cmtPpJobFunc_t jobFunc, cmtPpDepFunc_t depFunc, void* arg );
+
+  // Return the count of online CPUs.
+  unsigned cmtPpCpuCount();
+
+  const cmChar_t* cmtPpStateLabel( unsigned stateId );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
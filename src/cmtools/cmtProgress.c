@@ -0,0 +1,235 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtProgress.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+cmtPrgH_t cmtPrgNullHandle = cmSTATIC_NULL_HANDLE;
+
+enum
+{
+  kPrgBufCharCnt = 2048
+};
+
+#define kPrgIntervalSecs (0.5)
+
+typedef struct
+{
+  cmErr_t err;
+  int     fd;
+  bool    closeFl;  // true if fd was opened by cmtPrgCreate()
+  bool    failFl;   // true after a write failure - later events are dropped
+} cmtPrg_t;
+
+double _cmtPrgSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+cmtPrg_t* _cmtPrgHandleToPtr( cmtPrgH_t h )
+{
+  cmtPrg_t* p = (cmtPrg_t*)h.h;
+  assert( p != NULL );
+  return p;
+}
+
+cmtPrgRC_t _cmtPrgFree( cmtPrg_t* p )
+{
+  cmtPrgRC_t rc = kOkPrgRC;
+
+  if( p->closeFl && p->fd != -1 && close(p->fd) != 0 )
+    rc = cmErrSysMsg(&p->err,kFileFailPrgRC,errno,"The progress file close failed.");
+
+  cmMemFree(p);
+  return rc;
+}
+
+cmtPrgRC_t cmtPrgCreate( cmCtx_t* ctx, cmtPrgH_t* hp, int fd, const cmChar_t* fn )
+{
+  cmtPrgRC_t rc;
+
+  if((rc = cmtPrgDestroy(hp)) != kOkPrgRC )
+    return rc;
+
+  cmtPrg_t* p = cmMemAllocZ(cmtPrg_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"Progress");
+  p->fd = fd;
+
+  if( fd < 0 )
+  {
+    if((p->fd = open(fn==NULL ? "" : fn, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) == -1 )
+    {
+      rc = cmErrSysMsg(&p->err,kFileFailPrgRC,errno,"The progress file '%s' could not be created.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
+
+    p->closeFl = true;
+  }
+
+  hp->h = p;
+
+ errLabel:
+  if( rc != kOkPrgRC )
+    _cmtPrgFree(p);
+
+  return rc;
+}
+
+cmtPrgRC_t cmtPrgDestroy( cmtPrgH_t* hp )
+{
+  cmtPrgRC_t rc = kOkPrgRC;
+
+  if( hp == NULL || cmtPrgIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtPrgFree(_cmtPrgHandleToPtr(*hp))) != kOkPrgRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtPrgIsValid( cmtPrgH_t h )
+{ return h.h != NULL; }
+
+// Append 'str' as a JSON string (or null) to buf[n] at *iRef.
+void _cmtPrgPrintStr( cmChar_t* buf, unsigned n, unsigned* iRef, const cmChar_t* str )
+{
+  unsigned i = *iRef;
+
+  if( str == NULL )
+    i += snprintf(buf+i, i<n ? n-i : 0, "null");
+  else
+  {
+    if( i < n )
+      buf[i] = '"';
+    ++i;
+
+    for(; *str; ++str)
+    {
+      unsigned char c = (unsigned char)*str;
+
+      if( c == '"' || c == '\\' )
+        i += snprintf(buf+i, i<n ? n-i : 0, "\\%c",c);
+      else
+        if( c < 0x20 )
+          i += snprintf(buf+i, i<n ? n-i : 0, "\\u%04x",c);
+        else
+        {
+          if( i < n )
+            buf[i] = c;
+          ++i;
+        }
+    }
+
+    if( i < n )
+      buf[i] = '"';
+    ++i;
+  }
+
+  *iRef = i;
+}
+
+void _cmtPrgWrite( cmtPrgStage_t* s, const cmChar_t* event, double nowSecs, bool rcFl, cmRC_t rc )
+{
+  cmtPrg_t* p           = _cmtPrgHandleToPtr(s->h);
+  double    elapsedSecs = nowSecs - s->begSecs;
+  double    smpPerSec   = elapsedSecs > 0 ? s->smpCnt / elapsedSecs : 0;
+  cmChar_t  buf[ kPrgBufCharCnt ];
+  unsigned  n           = kPrgBufCharCnt - 1;  // leave room for the newline
+  unsigned  i           = 0;
+
+  if( p->failFl )
+    return;
+
+  i += snprintf(buf+i, i<n ? n-i : 0, "{\"event\":\"%s\",\"stage\":",event);
+  _cmtPrgPrintStr(buf,n,&i,s->label);
+  i += snprintf(buf+i, i<n ? n-i : 0, ",\"file\":");
+  _cmtPrgPrintStr(buf,n,&i,s->fn);
+  i += snprintf(buf+i, i<n ? n-i : 0, ",\"smpCnt\":%llu,\"totalSmpCnt\":%llu,\"rdByteCnt\":%llu,\"wrByteCnt\":%llu,\"elapsedSecs\":%f,\"smpPerSec\":%f,\"etaSecs\":",
+    s->smpCnt,s->totalSmpCnt,s->rdByteCnt,s->wrByteCnt,elapsedSecs,smpPerSec);
+
+  if( s->totalSmpCnt > 0 && smpPerSec > 0 )
+    i += snprintf(buf+i, i<n ? n-i : 0, "%f", s->smpCnt >= s->totalSmpCnt ? 0 : (s->totalSmpCnt - s->smpCnt) / smpPerSec);
+  else
+    i += snprintf(buf+i, i<n ? n-i : 0, "null");
+
+  if( rcFl )
+    i += snprintf(buf+i, i<n ? n-i : 0, ",\"rc\":%i",rc);
+
+  i += snprintf(buf+i, i<n ? n-i : 0, "}");
+
+  // an event which does not fit in the buffer is dropped rather than split
+  if( i > n )
+  {
+    cmErrWarnMsg(&p->err,kFileFailPrgRC,"A progress event was too long and was dropped.");
+    return;
+  }
+
+  buf[i++] = '\n';
+
+  if( write(p->fd,buf,i) != (ssize_t)i )
+  {
+    cmErrSysMsg(&p->err,kFileFailPrgRC,errno,"Progress event write failed. No more progress events will be written.");
+    p->failFl = true;
+  }
+
+  s->lastSecs = nowSecs;
+}
+
+void cmtPrgBegin( cmtPrgH_t h, cmtPrgStage_t* s, cmtPrgStage_t* parent, const cmChar_t* label, const cmChar_t* fn, unsigned long long totalSmpCnt )
+{
+  memset(s,0,sizeof(*s));
+  s->h = h;
+
+  if( cmtPrgIsValid(h) == false )
+    return;
+
+  s->parent      = parent;
+  s->label       = label;
+  s->fn          = fn;
+  s->totalSmpCnt = totalSmpCnt;
+  s->begSecs     = _cmtPrgSecs();
+
+  _cmtPrgWrite(s,"begin",s->begSecs,false,kOkPrgRC);
+}
+
+void cmtPrgUpdate( cmtPrgStage_t* s, unsigned long long smpCnt, unsigned long long rdByteCnt, unsigned long long wrByteCnt )
+{
+  if( cmtPrgIsValid(s->h) == false )
+    return;
+
+  s->smpCnt    += smpCnt;
+  s->rdByteCnt += rdByteCnt;
+  s->wrByteCnt += wrByteCnt;
+
+  double nowSecs = _cmtPrgSecs();
+
+  if( nowSecs - s->lastSecs >= kPrgIntervalSecs )
+    _cmtPrgWrite(s,"progress",nowSecs,false,kOkPrgRC);
+
+  if( s->parent != NULL )
+    cmtPrgUpdate(s->parent,smpCnt,rdByteCnt,wrByteCnt);
+}
+
+void cmtPrgEnd( cmtPrgStage_t* s, cmRC_t rc )
+{
+  if( cmtPrgIsValid(s->h) == false )
+    return;
+
+  _cmtPrgWrite(s,"end",_cmtPrgSecs(),true,rc);
+}
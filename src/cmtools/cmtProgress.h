@@ -0,0 +1,66 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtProgress_h
+#define cmtProgress_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Machine readable progress events.
+  //
+  // Each event is written as a single line JSON object (newline delimited JSON):
+  //
+  // {"event":"progress","stage":"convolve","file":"1.aif","smpCnt":96000,"totalSmpCnt":960000,
+  //  "rdByteCnt":288000,"wrByteCnt":288000,"elapsedSecs":0.25,"smpPerSec":384000,"etaSecs":2.25}
+  //
+  // 'event' is "begin", "progress" or "end". The "end" event also includes the
+  // result code 'rc'. 'file' and 'etaSecs' are null when they are not known.
+  // "progress" events are written at most once every kPrgIntervalSecs for each stage.
+  //
+  // Each event is written with a single write() so that events from several
+  // processes sharing one descriptor are not interleaved.
+
+  enum
+  {
+    kOkPrgRC = cmOkRC,
+    kFileFailPrgRC
+  };
+
+  typedef cmRC_t cmtPrgRC_t;
+
+  typedef struct { void* h; } cmtPrgH_t;
+
+  extern cmtPrgH_t cmtPrgNullHandle;
+
+  // Write the events to the open file descriptor 'fd' or, if 'fd' is negative, to the file 'fn'.
+  cmtPrgRC_t cmtPrgCreate(  cmCtx_t* ctx, cmtPrgH_t* hp, int fd, const cmChar_t* fn );
+  cmtPrgRC_t cmtPrgDestroy( cmtPrgH_t* hp );
+  bool       cmtPrgIsValid( cmtPrgH_t h );
+
+  // A stage is one processing step on one file (or on a set of files).
+  // The counts of a stage are also added to its parent stage.
+  typedef struct cmtPrgStage_str
+  {
+    cmtPrgH_t                h;
+    struct cmtPrgStage_str*  parent;
+    const cmChar_t*          label;
+    const cmChar_t*          fn;
+    unsigned long long       totalSmpCnt; // 0 if the count of samples to process is not known
+    unsigned long long       smpCnt;      // count of samples processed
+    unsigned long long       rdByteCnt;   // count of bytes read
+    unsigned long long       wrByteCnt;   // count of bytes written
+    double                   begSecs;
+    double                   lastSecs;    // time of the last event
+  } cmtPrgStage_t;
+
+  // All stage functions do nothing if 'h' is not valid.
+  void cmtPrgBegin(  cmtPrgH_t h, cmtPrgStage_t* s, cmtPrgStage_t* parent, const cmChar_t* label, const cmChar_t* fn, unsigned long long totalSmpCnt );
+  void cmtPrgUpdate( cmtPrgStage_t* s, unsigned long long smpCnt, unsigned long long rdByteCnt, unsigned long long wrByteCnt );
+  void cmtPrgEnd(    cmtPrgStage_t* s, cmRC_t rc );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,829 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmFile.h"
+#include "cmFileSys.h"
+#include "cmJson.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmMidiFile.h"
+#include "cmAudioFile.h"
+#include "cmTimeLine.h"
+
+#include "cmtHash.h"
+#include "cmtTlBin.h"
+#include "cmtTrace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+cmtTlbH_t   cmtTlbNullHandle   = cmSTATIC_NULL_HANDLE;
+cmtTlbWrH_t cmtTlbWrNullHandle = cmSTATIC_NULL_HANDLE;
+
+static const cmChar_t _cmtTlbMagic[4] = { 'C','M','T','L' };
+
+typedef struct
+{
+  unsigned        typeId;
+  const cmChar_t* label;
+} cmtTlbType_t;
+
+// time line object type labels as used in the JSON time line file
+static const cmtTlbType_t _cmtTlbTypeArray[] =
+{
+  { kAudioFileTlId, "af" },
+  { kMidiFileTlId,  "mf" },
+  { kMidiEvtTlId,   "me" },
+  { kAudioEvtTlId,  "ae" },
+  { kMarkerTlId,    "mk" },
+  { cmInvalidId,    NULL }
+};
+
+const cmChar_t* _cmtTlbTypeIdToLabel( unsigned typeId )
+{
+  unsigned i;
+  for(i=0; _cmtTlbTypeArray[i].label!=NULL; ++i)
+    if( _cmtTlbTypeArray[i].typeId == typeId )
+      return _cmtTlbTypeArray[i].label;
+  return "";
+}
+
+unsigned cmtTlbTypeLabelToId( const cmChar_t* label )
+{
+  unsigned i;
+  if( label != NULL )
+    for(i=0; _cmtTlbTypeArray[i].label!=NULL; ++i)
+      if( strcmp(_cmtTlbTypeArray[i].label,label) == 0 )
+        return _cmtTlbTypeArray[i].typeId;
+  return cmInvalidId;
+}
+
+bool cmtTlbIsBinFn( const cmChar_t* fn )
+{
+  const cmChar_t* ext;
+
+  if( fn == NULL || (ext = strrchr(fn,'.')) == NULL )
+    return false;
+
+  return strcmp(ext+1,"tlb") == 0;
+}
+
+//======================================================================================================
+// Memory mapped reader
+//
+
+typedef struct
+{
+  cmErr_t            err;
+  int                fd;
+  void*              base;     // base of the mapped file
+  size_t             byteCnt;  // size of the mapped file
+  const cmtTlbHdr_t* hdr;
+  const cmtTlbObj_t* objA;     // objA[ hdr->objCnt ]
+  const cmChar_t*    strTbl;   // strTbl[ hdr->strByteCnt ]
+} cmtTlb_t;
+
+cmtTlb_t* _cmtTlbHandleToPtr( cmtTlbH_t h )
+{
+  cmtTlb_t* p = (cmtTlb_t*)h.h;
+  assert(p != NULL);
+  return p;
+}
+
+cmtTlbRC_t _cmtTlbFree( cmtTlb_t* p )
+{
+  cmtTlbRC_t rc = kOkTlbRC;
+
+  if( p->base != NULL && munmap(p->base,p->byteCnt) != 0 )
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line unmap failed.");
+
+  if( p->fd != -1 )
+    close(p->fd);
+
+  cmMemFree(p);
+  return rc;
+}
+
+// Verify that the header and all object records reference valid memory.
+cmtTlbRC_t _cmtTlbValidate( cmtTlb_t* p, const cmChar_t* fn )
+{
+  const cmtTlbHdr_t* h = p->hdr;
+  unsigned           i;
+
+  if( memcmp(h->magic,_cmtTlbMagic,sizeof(_cmtTlbMagic)) != 0 )
+    return cmErrMsg(&p->err,kFormatFailTlbRC,"The file '%s' is not a binary time line file.",cmStringNullGuard(fn));
+
+  if( h->version != kTlbVersion || h->hdrByteCnt != sizeof(cmtTlbHdr_t) || h->objByteCnt != sizeof(cmtTlbObj_t) )
+    return cmErrMsg(&p->err,kFormatFailTlbRC,"The binary time line file '%s' has an incompatible version (%i) or record size.",cmStringNullGuard(fn),h->version);
+
+  // the checks are written so that corrupt offsets and counts can not overflow
+  if( h->objOffs > p->byteCnt || h->objCnt > (p->byteCnt - h->objOffs) / sizeof(cmtTlbObj_t)
+    || h->strOffs > p->byteCnt || h->strByteCnt > p->byteCnt - h->strOffs
+    || h->strByteCnt == 0 )
+    return cmErrMsg(&p->err,kFormatFailTlbRC,"The binary time line file '%s' is truncated.",cmStringNullGuard(fn));
+
+  // the object records are accessed in place
+  if( h->objOffs % __alignof__(cmtTlbObj_t) != 0 )
+    return cmErrMsg(&p->err,kFormatFailTlbRC,"The object array in the binary time line file '%s' is misaligned.",cmStringNullGuard(fn));
+
+  p->objA   = (const cmtTlbObj_t*)((const char*)p->base + h->objOffs);
+  p->strTbl = (const cmChar_t*)   ((const char*)p->base + h->strOffs);
+
+  if( p->strTbl[0] != 0 || p->strTbl[ h->strByteCnt-1 ] != 0 )
+    return cmErrMsg(&p->err,kFormatFailTlbRC,"The string table in the binary time line file '%s' is corrupt.",cmStringNullGuard(fn));
+
+  for(i=0; i<h->objCnt; ++i)
+  {
+    const cmtTlbObj_t* o = p->objA + i;
+
+    if( o->labelOffs >= h->strByteCnt || o->typeOffs >= h->strByteCnt || o->refOffs >= h->strByteCnt || o->textOffs >= h->strByteCnt
+      || (o->refIdx != cmInvalidIdx && o->refIdx >= h->objCnt) )
+      return cmErrMsg(&p->err,kFormatFailTlbRC,"The object record at index %i in the binary time line file '%s' is corrupt.",i,cmStringNullGuard(fn));
+  }
+
+  return kOkTlbRC;
+}
+
+cmtTlbRC_t cmtTlbOpen( cmCtx_t* ctx, cmtTlbH_t* hp, const cmChar_t* fn )
+{
+  cmtTlbRC_t  rc;
+  struct stat st;
+  cmtTrSpan_t sp;
+
+  if((rc = cmtTlbClose(hp)) != kOkTlbRC )
+    return rc;
+
+  cmtTrBegin(&sp,kPhaseTrCat,"open",fn);
+
+  cmtTlb_t* p = cmMemAllocZ(cmtTlb_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"TL Binary");
+  p->fd = -1;
+
+  if((p->fd = open(fn,O_RDONLY)) == -1 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line open failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if( fstat(p->fd,&st) != 0 )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line stat failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if( (size_t)st.st_size < sizeof(cmtTlbHdr_t) )
+  {
+    rc = cmErrMsg(&p->err,kFormatFailTlbRC,"The file '%s' is too short to be a binary time line.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  p->byteCnt = st.st_size;
+
+  if((p->base = mmap(NULL,p->byteCnt,PROT_READ,MAP_SHARED,p->fd,0)) == MAP_FAILED )
+  {
+    p->base = NULL;
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line mmap failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  p->hdr = (const cmtTlbHdr_t*)p->base;
+
+  if((rc = _cmtTlbValidate(p,fn)) != kOkTlbRC )
+    goto errLabel;
+
+  hp->h = p;
+
+ errLabel:
+  if( rc != kOkTlbRC )
+    _cmtTlbFree(p);
+
+  cmtTrEnd(&sp);
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbClose( cmtTlbH_t* hp )
+{
+  cmtTlbRC_t rc = kOkTlbRC;
+
+  if( hp == NULL || cmtTlbIsValid(*hp) == false )
+    return rc;
+
+  cmtTlb_t* p = _cmtTlbHandleToPtr(*hp);
+
+  if((rc = _cmtTlbFree(p)) != kOkTlbRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtTlbIsValid( cmtTlbH_t h )
+{ return h.h != NULL; }
+
+double cmtTlbSampleRate( cmtTlbH_t h )
+{ return _cmtTlbHandleToPtr(h)->hdr->srate; }
+
+unsigned cmtTlbObjCount( cmtTlbH_t h )
+{ return _cmtTlbHandleToPtr(h)->hdr->objCnt; }
+
+const cmtTlbObj_t* cmtTlbObj( cmtTlbH_t h, unsigned idx )
+{
+  cmtTlb_t* p = _cmtTlbHandleToPtr(h);
+  assert( idx < p->hdr->objCnt );
+  return p->objA + idx;
+}
+
+const cmChar_t* cmtTlbStr( cmtTlbH_t h, unsigned strOffs )
+{
+  cmtTlb_t* p = _cmtTlbHandleToPtr(h);
+  return strOffs < p->hdr->strByteCnt ? p->strTbl + strOffs : "";
+}
+
+long long cmtTlbObjAbsSmpIdx( cmtTlbH_t h, unsigned idx )
+{
+  cmtTlb_t* p = _cmtTlbHandleToPtr(h);
+  long long smpIdx = 0;
+  unsigned  i;
+
+  assert( idx < p->hdr->objCnt );
+
+  // follow the reference chain - the iteration limit guards against reference cycles
+  for(i=0; idx!=cmInvalidIdx && idx<p->hdr->objCnt && i<p->hdr->objCnt; ++i)
+  {
+    smpIdx += p->objA[idx].offset;
+    idx     = p->objA[idx].refIdx;
+  }
+
+  return smpIdx;
+}
+
+//======================================================================================================
+// Time line builder
+//
+
+typedef struct
+{
+  cmErr_t      err;
+  cmCtx_t*     ctx;
+  double       srate;
+
+  cmtTlbObj_t* objA;        // objA[objAllocCnt]
+  unsigned     objCnt;
+  unsigned     objAllocCnt;
+
+  cmChar_t**   strV;        // strV[strAllocCnt] unique strings in string table order
+  unsigned*    strOffsV;    // strOffsV[strAllocCnt] string table offset of strV[i]
+  unsigned     strCnt;
+  unsigned     strAllocCnt;
+  unsigned     strByteCnt;  // total bytes in the string table
+  cmtStrMap_t  strMap;      // string -> string table offset
+} cmtTlbWr_t;
+
+cmtTlbWr_t* _cmtTlbWrHandleToPtr( cmtTlbWrH_t h )
+{
+  cmtTlbWr_t* p = (cmtTlbWr_t*)h.h;
+  assert(p != NULL);
+  return p;
+}
+
+// Return the string table offset of 's' - adding it to the table if necessary.
+unsigned _cmtTlbWrString( cmtTlbWr_t* p, const cmChar_t* s )
+{
+  unsigned offs;
+
+  if( s == NULL )
+    s = "";
+
+  if((offs = cmtStrMapFind(&p->strMap,s)) != cmInvalidIdx )
+    return offs;
+
+  if( p->strCnt == p->strAllocCnt )
+  {
+    p->strAllocCnt = p->strAllocCnt==0 ? 64 : 2*p->strAllocCnt;
+    p->strV        = cmMemResizeZ(cmChar_t*,p->strV,p->strAllocCnt);
+    p->strOffsV    = cmMemResizeZ(unsigned, p->strOffsV,p->strAllocCnt);
+  }
+
+  offs                     = p->strByteCnt;
+  p->strV[    p->strCnt ]  = cmMemAllocStr(s);
+  p->strOffsV[ p->strCnt ] = offs;
+  p->strByteCnt           += strlen(s) + 1;
+
+  cmtStrMapInsert(&p->strMap,p->strV[p->strCnt],offs);
+
+  p->strCnt += 1;
+
+  return offs;
+}
+
+// Return the string at string table offset 'offs'.
+const cmChar_t* _cmtTlbWrOffsToStr( const cmtTlbWr_t* p, unsigned offs )
+{
+  unsigned i0 = 0;
+  unsigned i1 = p->strCnt;
+
+  // strOffsV[] is in increasing order - binary search for 'offs'
+  while( i0 < i1 )
+  {
+    unsigned i = (i0 + i1) / 2;
+
+    if( p->strOffsV[i] == offs )
+      return p->strV[i];
+
+    if( p->strOffsV[i] < offs )
+      i0 = i + 1;
+    else
+      i1 = i;
+  }
+
+  return "";
+}
+
+cmtTlbRC_t _cmtTlbWrFree( cmtTlbWr_t* p )
+{
+  unsigned i;
+  for(i=0; i<p->strCnt; ++i)
+    cmMemFree(p->strV[i]);
+
+  cmMemFree(p->strV);
+  cmMemFree(p->strOffsV);
+  cmMemFree(p->objA);
+  cmtStrMapFree(&p->strMap);
+  cmMemFree(p);
+  return kOkTlbRC;
+}
+
+cmtTlbRC_t cmtTlbWrCreate( cmCtx_t* ctx, cmtTlbWrH_t* hp, double srate )
+{
+  cmtTlbRC_t rc;
+
+  if((rc = cmtTlbWrDestroy(hp)) != kOkTlbRC )
+    return rc;
+
+  cmtTlbWr_t* p = cmMemAllocZ(cmtTlbWr_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"TL Binary Writer");
+  p->ctx   = ctx;
+  p->srate = srate;
+
+  cmtStrMapInit(&p->strMap,256);
+
+  // strTbl[0] is always the empty string
+  _cmtTlbWrString(p,"");
+
+  hp->h = p;
+
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbWrDestroy( cmtTlbWrH_t* hp )
+{
+  cmtTlbRC_t rc = kOkTlbRC;
+
+  if( hp == NULL || cmtTlbWrIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtTlbWrFree(_cmtTlbWrHandleToPtr(*hp))) != kOkTlbRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtTlbWrIsValid( cmtTlbWrH_t h )
+{ return h.h != NULL; }
+
+unsigned cmtTlbWrObjCount( cmtTlbWrH_t h )
+{ return _cmtTlbWrHandleToPtr(h)->objCnt; }
+
+cmtTlbRC_t cmtTlbWrInsert(
+  cmtTlbWrH_t     h,
+  const cmChar_t* label,
+  const cmChar_t* typeLabel,
+  const cmChar_t* refLabel,
+  long long       offset,
+  long long       smpCnt,
+  unsigned        trackId,
+  const cmChar_t* text )
+{
+  cmtTlbWr_t* p = _cmtTlbWrHandleToPtr(h);
+
+  if( label == NULL || typeLabel == NULL )
+    return cmErrMsg(&p->err,kInvalidArgTlbRC,"Time line objects must have a label and a type.");
+
+  if( p->objCnt == p->objAllocCnt )
+  {
+    p->objAllocCnt = p->objAllocCnt==0 ? 64 : 2*p->objAllocCnt;
+    p->objA        = cmMemResizeZ(cmtTlbObj_t,p->objA,p->objAllocCnt);
+  }
+
+  cmtTlbObj_t* o = p->objA + p->objCnt;
+
+  o->labelOffs = _cmtTlbWrString(p,label);
+  o->typeOffs  = _cmtTlbWrString(p,typeLabel);
+  o->refOffs   = _cmtTlbWrString(p,refLabel);
+  o->refIdx    = cmInvalidIdx;  // resolved by cmtTlbWrWriteBin()
+  o->textOffs  = _cmtTlbWrString(p,text);
+  o->trackId   = trackId;
+  o->offset    = offset;
+  o->smpCnt    = smpCnt;
+
+  p->objCnt += 1;
+
+  return kOkTlbRC;
+}
+
+cmtTlbRC_t cmtTlbWrInsertTlb( cmtTlbWrH_t h, cmtTlbH_t tlbH )
+{
+  cmtTlbRC_t rc = kOkTlbRC;
+  unsigned   i;
+  unsigned   n  = cmtTlbObjCount(tlbH);
+
+  for(i=0; i<n && rc==kOkTlbRC; ++i)
+  {
+    const cmtTlbObj_t* o = cmtTlbObj(tlbH,i);
+
+    rc = cmtTlbWrInsert(h,
+      cmtTlbStr(tlbH,o->labelOffs),
+      cmtTlbStr(tlbH,o->typeOffs),
+      cmtTlbStr(tlbH,o->refOffs),
+      o->offset,
+      o->smpCnt,
+      o->trackId,
+      cmtTlbStr(tlbH,o->textOffs));
+  }
+
+  return rc;
+}
+
+// Return the file name or marker text assoc'd with a libcm time line object.
+const cmChar_t* _cmtTlbTimeLineObjText( cmTlH_t tlH, cmTlObj_t* op )
+{
+  switch( op->typeId )
+  {
+    case kAudioFileTlId:
+      {
+        cmTlAudioFile_t* ap = cmTimeLineAudioFileObjPtr(tlH,op);
+        return ap==NULL ? op->text : ap->fn;
+      }
+
+    case kMidiFileTlId:
+      {
+        cmTlMidiFile_t* mp = cmTimeLineMidiFileObjPtr(tlH,op);
+        return mp==NULL ? op->text : mp->fn;
+      }
+
+    case kMarkerTlId:
+      {
+        cmTlMarker_t* kp = cmTimeLineMarkerObjPtr(tlH,op);
+        return kp==NULL ? op->text : kp->text;
+      }
+  }
+
+  return op->text;
+}
+
+cmtTlbRC_t cmtTlbWrInsertTimeLine( cmtTlbWrH_t h, cmTlH_t tlH )
+{
+  cmtTlbRC_t rc     = kOkTlbRC;
+  unsigned   seqCnt = cmTimeLineSeqCount(tlH);
+  unsigned   seqId;
+
+  for(seqId=0; seqId<seqCnt && rc==kOkTlbRC; ++seqId)
+  {
+    cmTlObj_t* op = NULL;
+
+    while( rc==kOkTlbRC && (op = cmTimeLineNextObj(tlH,op,seqId)) != NULL )
+      rc = cmtTlbWrInsert(h,
+        op->name,
+        _cmtTlbTypeIdToLabel(op->typeId),
+        op->ref==NULL ? "" : op->ref->name,
+        op->begSmpIdx,
+        op->durSmpCnt,
+        op->seqId,
+        _cmtTlbTimeLineObjText(tlH,op));
+  }
+
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbWrWriteBin( cmtTlbWrH_t h, const cmChar_t* fn )
+{
+  cmtTlbWr_t* p  = _cmtTlbWrHandleToPtr(h);
+  cmtTlbRC_t  rc = kOkTlbRC;
+  FILE*       fp = NULL;
+  cmtStrMap_t labelMap;
+  cmtTlbHdr_t hdr;
+  unsigned    i;
+
+  // resolve the reference labels to object indexes
+  cmtStrMapInit(&labelMap,p->objCnt);
+
+  for(i=0; i<p->objCnt; ++i)
+    cmtStrMapInsert(&labelMap,_cmtTlbWrOffsToStr(p,p->objA[i].labelOffs),i);
+
+  for(i=0; i<p->objCnt; ++i)
+    p->objA[i].refIdx = p->objA[i].refOffs == 0 ? cmInvalidIdx : cmtStrMapFind(&labelMap,_cmtTlbWrOffsToStr(p,p->objA[i].refOffs));
+
+  memset(&hdr,0,sizeof(hdr));
+  memcpy(hdr.magic,_cmtTlbMagic,sizeof(hdr.magic));
+  hdr.version    = kTlbVersion;
+  hdr.hdrByteCnt = sizeof(cmtTlbHdr_t);
+  hdr.objByteCnt = sizeof(cmtTlbObj_t);
+  hdr.objCnt     = p->objCnt;
+  hdr.strByteCnt = p->strByteCnt;
+  hdr.objOffs    = sizeof(cmtTlbHdr_t);
+  hdr.strOffs    = hdr.objOffs + (unsigned long long)p->objCnt * sizeof(cmtTlbObj_t);
+  hdr.srate      = p->srate;
+
+  if((fp = fopen(fn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line create failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  if( fwrite(&hdr,sizeof(hdr),1,fp) != 1 || (p->objCnt>0 && fwrite(p->objA,sizeof(cmtTlbObj_t),p->objCnt,fp) != p->objCnt) )
+  {
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line write failed on '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  for(i=0; i<p->strCnt; ++i)
+    if( fwrite(p->strV[i],strlen(p->strV[i])+1,1,fp) != 1 )
+    {
+      rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line string table write failed on '%s'.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
+
+ errLabel:
+  if( fp != NULL && fclose(fp) != 0 && rc == kOkTlbRC )
+    rc = cmErrSysMsg(&p->err,kFileFailTlbRC,errno,"Binary time line close failed on '%s'.",cmStringNullGuard(fn));
+
+  cmtStrMapFree(&labelMap);
+
+  return rc;
+}
+
+// Write the builder contents using the same JSON format as masWriteJsonTimeLine().
+cmtTlbRC_t cmtTlbWrWriteJson( cmtTlbWrH_t h, const cmChar_t* fn )
+{
+  cmtTlbWr_t*   p   = _cmtTlbWrHandleToPtr(h);
+  cmtTlbRC_t    rc  = kJsonFailTlbRC;
+  cmJsonH_t     jsH = cmJsonNullHandle;
+  cmJsonNode_t* jnp;
+  unsigned      i;
+
+  if( cmJsonInitialize(&jsH, p->ctx ) != kOkJsRC )
+    goto errLabel;
+
+  if((jnp = cmJsonCreateObject(jsH,NULL)) == NULL )
+    goto errLabel;
+
+  if((jnp = cmJsonInsertPairObject(jsH,jnp,"time_line")) == NULL )
+    goto errLabel;
+
+  if( cmJsonInsertPairs(jsH,jnp,"srate",kRealTId,p->srate,NULL) != kOkJsRC )
+    goto errLabel;
+
+  if((jnp = cmJsonInsertPairArray(jsH,jnp,"objArray")) == NULL )
+    goto errLabel;
+
+  for(i=0; i<p->objCnt; ++i)
+  {
+    const cmtTlbObj_t* o = p->objA + i;
+
+    // the JSON time line stores positions as 32 bit integers
+    if( o->offset < INT_MIN || o->offset > INT_MAX || o->smpCnt < 0 || o->smpCnt > INT_MAX )
+    {
+      cmErrMsg(&p->err,kJsonFailTlbRC,"The time line position of '%s' is outside the range of a JSON time line. Use a binary time line ('.tlb') instead.",_cmtTlbWrOffsToStr(p,o->labelOffs));
+      goto errLabel;
+    }
+
+    if( cmJsonCreateFilledObject(jsH,jnp,
+        "label",  kStringTId,_cmtTlbWrOffsToStr(p,o->labelOffs),
+        "type",   kStringTId,_cmtTlbWrOffsToStr(p,o->typeOffs),
+        "ref",    kStringTId,_cmtTlbWrOffsToStr(p,o->refOffs),
+        "offset", kIntTId,   (int)o->offset,
+        "smpCnt", kIntTId,   (int)o->smpCnt,
+        "trackId",kIntTId,   o->trackId,
+        "textStr",kStringTId,_cmtTlbWrOffsToStr(p,o->textOffs),
+        NULL) == NULL )
+    {
+      goto errLabel;
+    }
+  }
+
+  if( cmJsonWrite(jsH,cmJsonRoot(jsH),fn) != kOkJsRC )
+    goto errLabel;
+
+  rc = kOkTlbRC;
+
+ errLabel:
+  if( cmJsonFinalize(&jsH) != kOkJsRC || rc != kOkTlbRC )
+    rc = cmErrMsg(&p->err,kJsonFailTlbRC,"JSON time line write failed on '%s'.",cmStringNullGuard(fn));
+
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbWrWrite( cmtTlbWrH_t h, const cmChar_t* fn )
+{
+  cmtTlbRC_t  rc;
+  cmtTrSpan_t sp;
+  bool        binFl = cmtTlbIsBinFn(fn);
+
+  cmtTrBegin(&sp,kPhaseTrCat,binFl ? "write" : "json_emit",fn);
+
+  rc = binFl ? cmtTlbWrWriteBin(h,fn) : cmtTlbWrWriteJson(h,fn);
+
+  cmtTrEnd(&sp);
+  return rc;
+}
+
+//======================================================================================================
+// Conversion
+//
+
+// Load a JSON time line file (as written by masWriteJsonTimeLine() or
+// cmtTlbWrWriteJson()) into a time line builder.
+cmtTlbRC_t _cmtTlbReadJson( cmCtx_t* ctx, cmtTlbWrH_t* wrHp, const cmChar_t* jsonFn )
+{
+  cmtTlbRC_t      rc          = kOkTlbRC;
+  cmJsonH_t       jsH         = cmJsonNullHandle;
+  cmJsonNode_t*   tlnp        = NULL;
+  cmJsonNode_t*   anp         = NULL;
+  const cmChar_t* errLabelPtr = NULL;
+  double          srate       = 0;
+  unsigned        i,n;
+
+  if( cmJsonInitializeFromFile(&jsH,jsonFn,ctx) != kOkJsRC )
+  {
+    rc = cmErrMsg(&ctx->err,kJsonFailTlbRC,"JSON time line open failed on '%s'.",cmStringNullGuard(jsonFn));
+    goto errLabel;
+  }
+
+  if((tlnp = cmJsonFindValue(jsH,"time_line",cmJsonRoot(jsH),kObjectTId)) == NULL )
+  {
+    rc = cmErrMsg(&ctx->err,kJsonFailTlbRC,"The file '%s' does not contain a 'time_line' object.",cmStringNullGuard(jsonFn));
+    goto errLabel;
+  }
+
+  if( cmJsonMemberValues(tlnp,&errLabelPtr,
+      "srate",   kRealTId,  &srate,
+      "objArray",kArrayTId, &anp,
+      NULL) != kOkJsRC )
+  {
+    rc = cmErrMsg(&ctx->err,kJsonFailTlbRC,"The 'time_line' field '%s' is missing in '%s'.",cmStringNullGuard(errLabelPtr),cmStringNullGuard(jsonFn));
+    goto errLabel;
+  }
+
+  if((rc = cmtTlbWrCreate(ctx,wrHp,srate)) != kOkTlbRC )
+    goto errLabel;
+
+  n = cmJsonChildCount(anp);
+
+  for(i=0; i<n; ++i)
+  {
+    const cmChar_t* label   = NULL;
+    const cmChar_t* type    = NULL;
+    const cmChar_t* ref     = NULL;
+    const cmChar_t* text    = NULL;
+    int             offset  = 0;
+    int             smpCnt  = 0;
+    int             trackId = 0;
+
+    if( cmJsonMemberValues(cmJsonArrayElementC(anp,i),&errLabelPtr,
+        "label",  kStringTId, &label,
+        "type",   kStringTId, &type,
+        "ref",    kStringTId, &ref,
+        "offset", kIntTId,    &offset,
+        "smpCnt", kIntTId,    &smpCnt,
+        "trackId",kIntTId,    &trackId,
+        "textStr",kStringTId, &text,
+        NULL) != kOkJsRC )
+    {
+      rc = cmErrMsg(&ctx->err,kJsonFailTlbRC,"The field '%s' is missing from the time line object at index %i in '%s'.",cmStringNullGuard(errLabelPtr),i,cmStringNullGuard(jsonFn));
+      goto errLabel;
+    }
+
+    if((rc = cmtTlbWrInsert(*wrHp,label,type,ref,offset,smpCnt,trackId,text)) != kOkTlbRC )
+      goto errLabel;
+  }
+
+ errLabel:
+  cmJsonFinalize(&jsH);
+
+  if( rc != kOkTlbRC )
+    cmtTlbWrDestroy(wrHp);
+
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbJsonToBin( cmCtx_t* ctx, const cmChar_t* jsonFn, const cmChar_t* binFn )
+{
+  cmtTlbRC_t  rc;
+  cmtTlbWrH_t wrH = cmtTlbWrNullHandle;
+
+  if((rc = _cmtTlbReadJson(ctx,&wrH,jsonFn)) == kOkTlbRC )
+    rc = cmtTlbWrWriteBin(wrH,binFn);
+
+  cmtTlbWrDestroy(&wrH);
+
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbBinToJson( cmCtx_t* ctx, const cmChar_t* binFn, const cmChar_t* jsonFn )
+{
+  cmtTlbRC_t  rc;
+  cmtTlbH_t   tlbH = cmtTlbNullHandle;
+  cmtTlbWrH_t wrH  = cmtTlbWrNullHandle;
+
+  if((rc = cmtTlbOpen(ctx,&tlbH,binFn)) != kOkTlbRC )
+    goto errLabel;
+
+  if((rc = cmtTlbWrCreate(ctx,&wrH,cmtTlbSampleRate(tlbH))) != kOkTlbRC )
+    goto errLabel;
+
+  if((rc = cmtTlbWrInsertTlb(wrH,tlbH)) != kOkTlbRC )
+    goto errLabel;
+
+  rc = cmtTlbWrWriteJson(wrH,jsonFn);
+
+ errLabel:
+  cmtTlbWrDestroy(&wrH);
+  cmtTlbClose(&tlbH);
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbWriteTimeLine( cmCtx_t* ctx, cmTlH_t tlH, const cmChar_t* binFn )
+{
+  cmtTlbRC_t  rc;
+  cmtTlbWrH_t wrH = cmtTlbWrNullHandle;
+
+  if((rc = cmtTlbWrCreate(ctx,&wrH,cmTimeLineSampleRate(tlH))) != kOkTlbRC )
+    goto errLabel;
+
+  if((rc = cmtTlbWrInsertTimeLine(wrH,tlH)) != kOkTlbRC )
+    goto errLabel;
+
+  rc = cmtTlbWrWriteBin(wrH,binFn);
+
+ errLabel:
+  cmtTlbWrDestroy(&wrH);
+  return rc;
+}
+
+cmtTlbRC_t cmtTlbReport( cmCtx_t* ctx, const cmChar_t* binFn, const cmChar_t* rptFn )
+{
+  cmtTlbRC_t rc;
+  cmtTlbH_t  tlbH = cmtTlbNullHandle;
+  cmFileH_t  fH   = cmFileNullHandle;
+  unsigned   i,n;
+
+  if((rc = cmtTlbOpen(ctx,&tlbH,binFn)) != kOkTlbRC )
+    return rc;
+
+  if( rptFn != NULL && cmFileOpen(&fH,rptFn,kWriteFileFl,&ctx->rpt) != kOkFileRC )
+  {
+    rc = cmErrMsg(&ctx->err,kFileFailTlbRC,"Unable to create the time line report file '%s'.",rptFn);
+    goto errLabel;
+  }
+
+  n = cmtTlbObjCount(tlbH);
+
+  #define _cmtTlbPrintf(fmt,...) do{ if(cmFileIsValid(fH)) cmFilePrintf(fH,fmt,__VA_ARGS__); else cmRptPrintf(&ctx->rpt,fmt,__VA_ARGS__); }while(0)
+
+  _cmtTlbPrintf("srate:%f objects:%i\n",cmtTlbSampleRate(tlbH),n);
+  _cmtTlbPrintf("%5s %-10s %-4s %-10s %12s %12s %5s %s\n","index","label","type","ref","offset","smpCnt","track","text");
+
+  for(i=0; i<n; ++i)
+  {
+    const cmtTlbObj_t* o = cmtTlbObj(tlbH,i);
+
+    _cmtTlbPrintf("%5i %-10s %-4s %-10s %12lli %12lli %5i %s\n",
+      i,
+      cmtTlbStr(tlbH,o->labelOffs),
+      cmtTlbStr(tlbH,o->typeOffs),
+      cmtTlbStr(tlbH,o->refOffs),
+      o->offset,
+      o->smpCnt,
+      o->trackId,
+      cmtTlbStr(tlbH,o->textOffs));
+  }
+
+  #undef _cmtTlbPrintf
+
+ errLabel:
+  cmFileClose(&fH);
+  cmtTlbClose(&tlbH);
+  return rc;
+}
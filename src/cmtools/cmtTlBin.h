@@ -0,0 +1,139 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtTlBin_h
+#define cmtTlBin_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Binary time line file format.
+  //
+  // The binary time line holds the same information as the JSON time line
+  // written by masWriteJsonTimeLine() and cmTimeLineWrite() but can be
+  // loaded with a single mmap() and no per-object allocation.
+  //
+  // File layout:
+  //   cmtTlbHdr_t                 - file header
+  //   cmtTlbObj_t objArray[objCnt] - fixed size object records
+  //   char        strTbl[strByteCnt] - zero terminated strings referenced by byte offset.
+  //                                   strTbl[0] is always the empty string.
+  //
+  // All values are stored in host (little-endian) byte order.
+  // Files are identified by the extension 'tlb'.
+
+  enum
+  {
+    kOkTlbRC = cmOkRC,
+    kFileFailTlbRC,
+    kFormatFailTlbRC,
+    kJsonFailTlbRC,
+    kTimeLineFailTlbRC,
+    kInvalidArgTlbRC
+  };
+
+  typedef cmRC_t cmtTlbRC_t;
+
+  typedef struct { void* h; } cmtTlbH_t;
+  typedef struct { void* h; } cmtTlbWrH_t;
+
+  extern cmtTlbH_t   cmtTlbNullHandle;
+  extern cmtTlbWrH_t cmtTlbWrNullHandle;
+
+  enum { kTlbVersion = 1 };
+
+  typedef struct
+  {
+    char               magic[4];    // "CMTL"
+    unsigned           version;     // kTlbVersion
+    unsigned           hdrByteCnt;  // sizeof(cmtTlbHdr_t)
+    unsigned           objByteCnt;  // sizeof(cmtTlbObj_t)
+    unsigned           objCnt;      // count of records in objArray[]
+    unsigned           strByteCnt;  // count of bytes in strTbl[]
+    unsigned long long objOffs;     // file byte offset to objArray[]
+    unsigned long long strOffs;     // file byte offset to strTbl[]
+    double             srate;       // time line sample rate
+  } cmtTlbHdr_t;
+
+  typedef struct
+  {
+    unsigned  labelOffs;  // object label (e.g. 'af-0')
+    unsigned  typeOffs;   // type label ('af','mf','mk' ...)
+    unsigned  refOffs;    // label of the reference object ("" if the object has no reference)
+    unsigned  refIdx;     // index of the reference object in objArray[] or cmInvalidIdx
+    unsigned  textOffs;   // file name or marker text
+    unsigned  trackId;    // time line sequence id
+    long long offset;     // offset in samples from the reference object
+    long long smpCnt;     // duration in samples
+  } cmtTlbObj_t;
+
+  // Return true if 'fn' uses the binary time line file extension.
+  bool cmtTlbIsBinFn( const cmChar_t* fn );
+
+  //
+  // Memory mapped reader.
+  //
+  cmtTlbRC_t         cmtTlbOpen(  cmCtx_t* ctx, cmtTlbH_t* hp, const cmChar_t* fn );
+  cmtTlbRC_t         cmtTlbClose( cmtTlbH_t* hp );
+  bool               cmtTlbIsValid( cmtTlbH_t h );
+  double             cmtTlbSampleRate( cmtTlbH_t h );
+  unsigned           cmtTlbObjCount( cmtTlbH_t h );
+  const cmtTlbObj_t* cmtTlbObj( cmtTlbH_t h, unsigned idx );
+  const cmChar_t*    cmtTlbStr( cmtTlbH_t h, unsigned strOffs );
+
+  // Return the begin of object 'idx' relative to the start of its sequence by
+  // summing the offsets along the object's reference chain.
+  long long          cmtTlbObjAbsSmpIdx( cmtTlbH_t h, unsigned idx );
+
+  // Convert a type label ('af','mf','me','ae','mk') to a kXXXTlId value.
+  // Returns cmInvalidId if the label is not recognized.
+  unsigned           cmtTlbTypeLabelToId( const cmChar_t* label );
+
+  //
+  // Time line builder. Objects are inserted one at a time and then
+  // written as either a binary or a JSON time line.
+  //
+  cmtTlbRC_t cmtTlbWrCreate(  cmCtx_t* ctx, cmtTlbWrH_t* hp, double srate );
+  cmtTlbRC_t cmtTlbWrDestroy( cmtTlbWrH_t* hp );
+  bool       cmtTlbWrIsValid( cmtTlbWrH_t h );
+  unsigned   cmtTlbWrObjCount( cmtTlbWrH_t h );
+
+  cmtTlbRC_t cmtTlbWrInsert(
+    cmtTlbWrH_t     h,
+    const cmChar_t* label,
+    const cmChar_t* typeLabel,
+    const cmChar_t* refLabel,
+    long long       offset,
+    long long       smpCnt,
+    unsigned        trackId,
+    const cmChar_t* text );
+
+  // Insert all of the objects from an existing binary time line.
+  cmtTlbRC_t cmtTlbWrInsertTlb( cmtTlbWrH_t h, cmtTlbH_t tlbH );
+
+  // Insert all of the objects from a libcm time line.
+  cmtTlbRC_t cmtTlbWrInsertTimeLine( cmtTlbWrH_t h, cmTlH_t tlH );
+
+  cmtTlbRC_t cmtTlbWrWriteBin(  cmtTlbWrH_t h, const cmChar_t* fn );
+  cmtTlbRC_t cmtTlbWrWriteJson( cmtTlbWrH_t h, const cmChar_t* fn );
+
+  // Write as binary if 'fn' has the 'tlb' extension otherwise write JSON.
+  cmtTlbRC_t cmtTlbWrWrite(     cmtTlbWrH_t h, const cmChar_t* fn );
+
+  //
+  // Conversion between the JSON and binary forms.
+  //
+  cmtTlbRC_t cmtTlbJsonToBin( cmCtx_t* ctx, const cmChar_t* jsonFn, const cmChar_t* binFn );
+  cmtTlbRC_t cmtTlbBinToJson( cmCtx_t* ctx, const cmChar_t* binFn,  const cmChar_t* jsonFn );
+
+  // Write a libcm time line to a binary time line file.
+  cmtTlbRC_t cmtTlbWriteTimeLine( cmCtx_t* ctx, cmTlH_t tlH, const cmChar_t* binFn );
+
+  // Generate a human readable report of a binary time line.
+  cmtTlbRC_t cmtTlbReport( cmCtx_t* ctx, const cmChar_t* binFn, const cmChar_t* rptFn );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,397 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmFile.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmMidiFile.h"
+#include "cmAudioFile.h"
+#include "cmTimeLine.h"
+
+#include "cmtTlBin.h"
+#include "cmtTlIndex.h"
+
+cmtTlIdxH_t cmtTlIdxNullHandle = cmSTATIC_NULL_HANDLE;
+
+typedef struct
+{
+  cmErr_t          err;
+  cmtTlIdxEntry_t* eV;        // eV[eAllocN] entries sorted by seqId and begin time
+  long long*       maxEndV;   // maxEndV[eN] max. end time of the subtree rooted at eV[i]
+  unsigned         eN;
+  unsigned         eAllocN;
+  unsigned*        seqBegV;   // seqBegV[seqN+1] index of the first entry of each sequence
+  unsigned         seqN;
+  bool             buildFl;   // true if the index has been built
+} cmtTlIdx_t;
+
+typedef struct
+{
+  const cmtTlIdx_t*       p;
+  long long               begSmpIdx;
+  long long               endSmpIdx;
+  unsigned                typeMask;
+  const cmtTlIdxEntry_t** eV;
+  unsigned                eN;
+  unsigned                n;   // count of matches
+} cmtTlIdxQuery_t;
+
+cmtTlIdx_t* _cmtTlIdxHandleToPtr( cmtTlIdxH_t h )
+{
+  cmtTlIdx_t* p = (cmtTlIdx_t*)h.h;
+  assert(p != NULL);
+  return p;
+}
+
+cmtTlIdxRC_t _cmtTlIdxFree( cmtTlIdx_t* p )
+{
+  cmMemFree(p->eV);
+  cmMemFree(p->maxEndV);
+  cmMemFree(p->seqBegV);
+  cmMemFree(p);
+  return kOkTlIdxRC;
+}
+
+cmtTlIdxRC_t cmtTlIdxCreate( cmCtx_t* ctx, cmtTlIdxH_t* hp, unsigned allocCnt )
+{
+  cmtTlIdxRC_t rc;
+
+  if((rc = cmtTlIdxDestroy(hp)) != kOkTlIdxRC )
+    return rc;
+
+  cmtTlIdx_t* p = cmMemAllocZ(cmtTlIdx_t,1);
+  cmErrSetup(&p->err,&ctx->rpt,"TL Index");
+
+  p->eAllocN = allocCnt == 0 ? 64 : allocCnt;
+  p->eV      = cmMemAllocZ(cmtTlIdxEntry_t,p->eAllocN);
+
+  hp->h = p;
+  return rc;
+}
+
+cmtTlIdxRC_t cmtTlIdxDestroy( cmtTlIdxH_t* hp )
+{
+  cmtTlIdxRC_t rc = kOkTlIdxRC;
+
+  if( hp == NULL || cmtTlIdxIsValid(*hp) == false )
+    return rc;
+
+  if((rc = _cmtTlIdxFree(_cmtTlIdxHandleToPtr(*hp))) != kOkTlIdxRC )
+    return rc;
+
+  hp->h = NULL;
+  return rc;
+}
+
+bool cmtTlIdxIsValid( cmtTlIdxH_t h )
+{ return h.h != NULL; }
+
+cmtTlIdxRC_t cmtTlIdxInsert( cmtTlIdxH_t h, long long begSmpIdx, long long smpCnt, unsigned seqId, unsigned typeId, unsigned objIdx, const void* objPtr )
+{
+  cmtTlIdx_t* p = _cmtTlIdxHandleToPtr(h);
+
+  if( seqId == cmInvalidId )
+    return cmErrMsg(&p->err,kInvalidArgTlIdxRC,"Time line index objects must belong to a sequence.");
+
+  if( p->eN == p->eAllocN )
+  {
+    p->eAllocN *= 2;
+    p->eV       = cmMemResizeZ(cmtTlIdxEntry_t,p->eV,p->eAllocN);
+  }
+
+  cmtTlIdxEntry_t* e = p->eV + p->eN;
+
+  e->begSmpIdx = begSmpIdx;
+  e->endSmpIdx = begSmpIdx + (smpCnt > 0 ? smpCnt : 1);
+  e->seqId     = seqId;
+  e->typeId    = typeId;
+  e->objIdx    = objIdx;
+  e->objPtr    = objPtr;
+
+  p->eN      += 1;
+  p->buildFl  = false;
+
+  return kOkTlIdxRC;
+}
+
+int _cmtTlIdxCompare( const void* p0, const void* p1 )
+{
+  const cmtTlIdxEntry_t* e0 = (const cmtTlIdxEntry_t*)p0;
+  const cmtTlIdxEntry_t* e1 = (const cmtTlIdxEntry_t*)p1;
+
+  if( e0->seqId != e1->seqId )
+    return e0->seqId < e1->seqId ? -1 : 1;
+
+  if( e0->begSmpIdx != e1->begSmpIdx )
+    return e0->begSmpIdx < e1->begSmpIdx ? -1 : 1;
+
+  return e0->objIdx < e1->objIdx ? -1 : (e0->objIdx > e1->objIdx ? 1 : 0);
+}
+
+// Fill maxEndV[] for the implicit tree over eV[lo:hi) whose root is at (lo+hi)/2.
+long long _cmtTlIdxBuildTree( cmtTlIdx_t* p, unsigned lo, unsigned hi )
+{
+  if( lo >= hi )
+    return LLONG_MIN;
+
+  unsigned  mid = lo + (hi - lo) / 2;
+  long long l   = _cmtTlIdxBuildTree(p,lo,mid);
+  long long r   = _cmtTlIdxBuildTree(p,mid+1,hi);
+  long long m   = p->eV[mid].endSmpIdx;
+
+  if( l > m ) m = l;
+  if( r > m ) m = r;
+
+  p->maxEndV[mid] = m;
+
+  return m;
+}
+
+cmtTlIdxRC_t cmtTlIdxBuild( cmtTlIdxH_t h )
+{
+  cmtTlIdx_t* p = _cmtTlIdxHandleToPtr(h);
+  unsigned    i,j;
+
+  qsort(p->eV,p->eN,sizeof(cmtTlIdxEntry_t),_cmtTlIdxCompare);
+
+  p->seqN    = p->eN == 0 ? 0 : p->eV[ p->eN-1 ].seqId + 1;
+  p->seqBegV = cmMemResizeZ(unsigned, p->seqBegV,p->seqN+1);
+  p->maxEndV = cmMemResizeZ(long long,p->maxEndV,p->eN==0 ? 1 : p->eN);
+
+  // locate the first entry of each sequence
+  for(i=0,j=0; i<=p->seqN; ++i)
+  {
+    while( j<p->eN && p->eV[j].seqId < i )
+      ++j;
+
+    p->seqBegV[i] = j;
+  }
+
+  // build a tree for each sequence
+  for(i=0; i<p->seqN; ++i)
+    _cmtTlIdxBuildTree(p,p->seqBegV[i],p->seqBegV[i+1]);
+
+  p->buildFl = true;
+
+  return kOkTlIdxRC;
+}
+
+cmtTlIdxRC_t cmtTlIdxFromTimeLine( cmCtx_t* ctx, cmtTlIdxH_t* hp, cmTlH_t tlH )
+{
+  cmtTlIdxRC_t rc;
+  unsigned     seqCnt = cmTimeLineSeqCount(tlH);
+  unsigned     seqId;
+  unsigned     objIdx = 0;
+
+  if((rc = cmtTlIdxCreate(ctx,hp,0)) != kOkTlIdxRC )
+    return rc;
+
+  for(seqId=0; seqId<seqCnt && rc==kOkTlIdxRC; ++seqId)
+  {
+    cmTlObj_t* op = NULL;
+
+    while( rc==kOkTlIdxRC && (op = cmTimeLineNextObj(tlH,op,seqId)) != NULL )
+      rc = cmtTlIdxInsert(*hp,op->seqSmpIdx,op->durSmpCnt,op->seqId,op->typeId,objIdx++,op);
+  }
+
+  if( rc == kOkTlIdxRC )
+    rc = cmtTlIdxBuild(*hp);
+
+  if( rc != kOkTlIdxRC )
+    cmtTlIdxDestroy(hp);
+
+  return rc;
+}
+
+cmtTlIdxRC_t cmtTlIdxFromTlb( cmCtx_t* ctx, cmtTlIdxH_t* hp, cmtTlbH_t tlbH )
+{
+  cmtTlIdxRC_t rc;
+  unsigned     n = cmtTlbObjCount(tlbH);
+  unsigned     i;
+
+  if((rc = cmtTlIdxCreate(ctx,hp,n)) != kOkTlIdxRC )
+    return rc;
+
+  for(i=0; i<n && rc==kOkTlIdxRC; ++i)
+  {
+    const cmtTlbObj_t* o = cmtTlbObj(tlbH,i);
+    rc = cmtTlIdxInsert(*hp,cmtTlbObjAbsSmpIdx(tlbH,i),o->smpCnt,o->trackId,cmtTlbTypeLabelToId(cmtTlbStr(tlbH,o->typeOffs)),i,o);
+  }
+
+  if( rc == kOkTlIdxRC )
+    rc = cmtTlIdxBuild(*hp);
+
+  if( rc != kOkTlIdxRC )
+    cmtTlIdxDestroy(hp);
+
+  return rc;
+}
+
+unsigned cmtTlIdxCount( cmtTlIdxH_t h )
+{ return _cmtTlIdxHandleToPtr(h)->eN; }
+
+const cmtTlIdxEntry_t* cmtTlIdxEntry( cmtTlIdxH_t h, unsigned idx )
+{
+  cmtTlIdx_t* p = _cmtTlIdxHandleToPtr(h);
+  assert( idx < p->eN );
+  return p->eV + idx;
+}
+
+// In-order traversal of the implicit tree over eV[lo:hi) which skips
+// subtrees that cannot contain an overlapping interval.
+void _cmtTlIdxQuery( cmtTlIdxQuery_t* q, unsigned lo, unsigned hi )
+{
+  const cmtTlIdx_t* p = q->p;
+
+  while( lo < hi )
+  {
+    unsigned mid = lo + (hi - lo) / 2;
+
+    // if no interval in this subtree ends after the query begin
+    if( p->maxEndV[mid] <= q->begSmpIdx )
+      return;
+
+    _cmtTlIdxQuery(q,lo,mid);
+
+    const cmtTlIdxEntry_t* e = p->eV + mid;
+
+    // entries to the right begin at or after eV[mid]
+    if( e->begSmpIdx >= q->endSmpIdx )
+      return;
+
+    if( e->endSmpIdx > q->begSmpIdx && (q->typeMask==0 || cmIsFlag(q->typeMask,e->typeId)) )
+    {
+      if( q->n < q->eN )
+        q->eV[ q->n ] = e;
+      ++q->n;
+    }
+
+    // iterate on the right subtree
+    lo = mid + 1;
+  }
+}
+
+unsigned cmtTlIdxRange( cmtTlIdxH_t h, unsigned seqId, long long begSmpIdx, long long endSmpIdx, unsigned typeMask, const cmtTlIdxEntry_t** eV, unsigned eN )
+{
+  cmtTlIdx_t*     p = _cmtTlIdxHandleToPtr(h);
+  cmtTlIdxQuery_t q;
+  unsigned        i;
+
+  assert( p->buildFl );
+
+  q.p         = p;
+  q.begSmpIdx = begSmpIdx;
+  q.endSmpIdx = endSmpIdx;
+  q.typeMask  = typeMask;
+  q.eV        = eV;
+  q.eN        = eV==NULL ? 0 : eN;
+  q.n         = 0;
+
+  if( endSmpIdx <= begSmpIdx )
+    return 0;
+
+  for(i=0; i<p->seqN; ++i)
+    if( seqId == cmInvalidId || seqId == i )
+      _cmtTlIdxQuery(&q,p->seqBegV[i],p->seqBegV[i+1]);
+
+  return q.n;
+}
+
+unsigned cmtTlIdxPoint( cmtTlIdxH_t h, unsigned seqId, long long smpIdx, unsigned typeMask, const cmtTlIdxEntry_t** eV, unsigned eN )
+{ return cmtTlIdxRange(h,seqId,smpIdx,smpIdx+1,typeMask,eV,eN); }
+
+cmtTlIdxRC_t cmtTlIdxReport( cmCtx_t* ctx, const cmChar_t* tlFn, const cmChar_t* tlPrefixPath, double begSecs, double endSecs, const cmChar_t* rptFn )
+{
+  cmtTlIdxRC_t            rc   = kOkTlIdxRC;
+  cmtTlbH_t               tlbH = cmtTlbNullHandle;
+  cmTlH_t                 tlH  = cmTimeLineNullHandle;
+  cmtTlIdxH_t             h    = cmtTlIdxNullHandle;
+  cmFileH_t               fH   = cmFileNullHandle;
+  const cmtTlIdxEntry_t** eV   = NULL;
+  bool                    binFl = cmtTlbIsBinFn(tlFn);
+  double                  srate;
+  unsigned                i,n;
+
+  // binary time lines are indexed directly from the memory mapped file
+  if( binFl )
+  {
+    if( cmtTlbOpen(ctx,&tlbH,tlFn) != kOkTlbRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailTlIdxRC,"The binary time line '%s' could not be opened.",tlFn);
+      goto errLabel;
+    }
+
+    srate = cmtTlbSampleRate(tlbH);
+    rc    = cmtTlIdxFromTlb(ctx,&h,tlbH);
+  }
+  else
+  {
+    if( cmTimeLineInitializeFromFile(ctx,&tlH,NULL,NULL,tlFn,tlPrefixPath) != kOkTlRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailTlIdxRC,"The time line '%s' could not be loaded.",tlFn);
+      goto errLabel;
+    }
+
+    srate = cmTimeLineSampleRate(tlH);
+    rc    = cmtTlIdxFromTimeLine(ctx,&h,tlH);
+  }
+
+  if( rc != kOkTlIdxRC )
+    goto errLabel;
+
+  if( rptFn != NULL && cmFileOpen(&fH,rptFn,kWriteFileFl,&ctx->rpt) != kOkFileRC )
+  {
+    rc = cmErrMsg(&ctx->err,kFileFailTlIdxRC,"Unable to create the time line report file '%s'.",rptFn);
+    goto errLabel;
+  }
+
+  long long begSmpIdx = (long long)floor(begSecs * srate);
+  long long endSmpIdx = endSecs < begSecs ? begSmpIdx+1 : (long long)ceil(endSecs * srate);
+
+  // count the matches and then retrieve them
+  n  = cmtTlIdxRange(h,cmInvalidId,begSmpIdx,endSmpIdx,0,NULL,0);
+  eV = cmMemAllocZ(const cmtTlIdxEntry_t*,n==0 ? 1 : n);
+  cmtTlIdxRange(h,cmInvalidId,begSmpIdx,endSmpIdx,0,eV,n);
+
+  #define _cmtTlIdxPrintf(fmt,...) do{ if(cmFileIsValid(fH)) cmFilePrintf(fH,fmt,__VA_ARGS__); else cmRptPrintf(&ctx->rpt,fmt,__VA_ARGS__); }while(0)
+
+  _cmtTlIdxPrintf("srate:%f range:%lli-%lli objects:%i of %i\n",srate,begSmpIdx,endSmpIdx,n,cmtTlIdxCount(h));
+  _cmtTlIdxPrintf("%3s %12s %12s %10s %10s %-4s %-10s\n","seq","beg smp","end smp","beg sec","end sec","type","label");
+
+  for(i=0; i<n; ++i)
+  {
+    const cmtTlIdxEntry_t* e     = eV[i];
+    const cmChar_t*        label = NULL;
+
+    if( binFl )
+      label = cmtTlbStr(tlbH,((const cmtTlbObj_t*)e->objPtr)->labelOffs);
+    else
+      label = ((const cmTlObj_t*)e->objPtr)->name;
+
+    _cmtTlIdxPrintf("%3i %12lli %12lli %10.3f %10.3f %4x %-10s\n",
+      e->seqId,
+      e->begSmpIdx,
+      e->endSmpIdx,
+      e->begSmpIdx / srate,
+      e->endSmpIdx / srate,
+      e->typeId,
+      label==NULL ? "" : label);
+  }
+
+  #undef _cmtTlIdxPrintf
+
+ errLabel:
+  cmMemFree(eV);
+  cmFileClose(&fH);
+  cmtTlIdxDestroy(&h);
+  cmtTlbClose(&tlbH);
+  cmTimeLineFinalize(&tlH);
+  return rc;
+}
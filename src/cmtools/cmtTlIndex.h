@@ -0,0 +1,78 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtTlIndex_h
+#define cmtTlIndex_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Static interval index over the objects in a time line.
+  //
+  // The index is built once after the time line is loaded. Each sequence is
+  // stored as an array sorted by begin time which is treated as an implicit
+  // balanced binary tree where every node holds the maximum end time of its
+  // subtree.  Range and point queries are O(log n + k).
+  //
+  // Objects cover the sample range [begSmpIdx, begSmpIdx+smpCnt).  Zero
+  // length objects (e.g. point markers) are treated as covering their begin sample.
+
+  enum
+  {
+    kOkTlIdxRC = cmOkRC,
+    kInvalidArgTlIdxRC,
+    kFileFailTlIdxRC,
+    kTimeLineFailTlIdxRC
+  };
+
+  typedef cmRC_t cmtTlIdxRC_t;
+
+  typedef struct { void* h; } cmtTlIdxH_t;
+
+  extern cmtTlIdxH_t cmtTlIdxNullHandle;
+
+  typedef struct
+  {
+    long long   begSmpIdx; // absolute begin sample index within the sequence
+    long long   endSmpIdx; // absolute end sample index (one past the last sample)
+    unsigned    seqId;     // time line sequence id
+    unsigned    typeId;    // kXXXTlId (See cmTimeLine.h)
+    unsigned    objIdx;    // index of the object in the source time line
+    const void* objPtr;    // cmTlObj_t* or cmtTlbObj_t*
+  } cmtTlIdxEntry_t;
+
+  // Create an empty index.  Insert objects with cmtTlIdxInsert() and then call cmtTlIdxBuild().
+  cmtTlIdxRC_t cmtTlIdxCreate(  cmCtx_t* ctx, cmtTlIdxH_t* hp, unsigned allocCnt );
+  cmtTlIdxRC_t cmtTlIdxDestroy( cmtTlIdxH_t* hp );
+  bool         cmtTlIdxIsValid( cmtTlIdxH_t h );
+
+  cmtTlIdxRC_t cmtTlIdxInsert( cmtTlIdxH_t h, long long begSmpIdx, long long smpCnt, unsigned seqId, unsigned typeId, unsigned objIdx, const void* objPtr );
+  cmtTlIdxRC_t cmtTlIdxBuild(  cmtTlIdxH_t h );
+
+  // Create and build an index from a libcm time line or a binary time line.
+  cmtTlIdxRC_t cmtTlIdxFromTimeLine( cmCtx_t* ctx, cmtTlIdxH_t* hp, cmTlH_t tlH );
+  cmtTlIdxRC_t cmtTlIdxFromTlb(      cmCtx_t* ctx, cmtTlIdxH_t* hp, cmtTlbH_t tlbH );
+
+  unsigned               cmtTlIdxCount( cmtTlIdxH_t h );
+  const cmtTlIdxEntry_t* cmtTlIdxEntry( cmtTlIdxH_t h, unsigned idx );
+
+  // Locate the objects in sequence 'seqId' which overlap [begSmpIdx,endSmpIdx) and
+  // whose type is included in 'typeMask' (kXXXTlId flags or 0 for all types).
+  // Set seqId to cmInvalidId to search all sequences.
+  // Up to 'eN' pointers to matching entries are returned in eV[] in order of begin time.
+  // The return value is the total count of matching entries which may be greater than eN.
+  unsigned cmtTlIdxRange( cmtTlIdxH_t h, unsigned seqId, long long begSmpIdx, long long endSmpIdx, unsigned typeMask, const cmtTlIdxEntry_t** eV, unsigned eN );
+
+  // Locate the objects which contain the sample 'smpIdx'.
+  unsigned cmtTlIdxPoint( cmtTlIdxH_t h, unsigned seqId, long long smpIdx, unsigned typeMask, const cmtTlIdxEntry_t** eV, unsigned eN );
+
+  // Report the objects in the time line file 'tlFn' (JSON or binary) which overlap
+  // the time range [begSecs,endSecs).  If endSecs is less than begSecs then the
+  // objects which contain the time begSecs are reported.
+  cmtTlIdxRC_t cmtTlIdxReport( cmCtx_t* ctx, const cmChar_t* tlFn, const cmChar_t* tlPrefixPath, double begSecs, double endSecs, const cmChar_t* rptFn );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
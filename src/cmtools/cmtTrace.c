@@ -0,0 +1,239 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtTrace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+const cmChar_t kActionTrCat[] = "action";
+const cmChar_t kFileTrCat[]   = "file";
+const cmChar_t kPhaseTrCat[]  = "phase";
+const cmChar_t kIoTrCat[]     = "io";
+
+typedef struct
+{
+  const cmChar_t* cat;
+  const cmChar_t* name;
+  cmChar_t*       arg;   // malloc'd copy of the span argument or NULL
+  double          begUs;
+  double          durUs;
+  unsigned        tid;
+  unsigned        opCnt;   // count of aggregated operations or 0
+  double          busyUs;  // busy time of the aggregated operations
+} cmtTrEvt_t;
+
+// The event array is extended from the audio file I/O threads and is
+// therefore allocated with malloc() rather than the (single threaded) cmMem
+// functions.
+typedef struct
+{
+  cmErr_t         err;
+  cmChar_t*       fn;
+  double          baseUs;   // trace time origin
+  cmtTrEvt_t*     evtV;     // evtV[evtAllocN]
+  unsigned        evtN;
+  unsigned        evtAllocN;
+  pthread_mutex_t mutex;
+} cmtTr_t;
+
+static cmtTr_t _cmtTr;
+static bool    _cmtTrEnableFl = false;
+
+double _cmtTrMicros()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec * 1000000.0 + t.tv_nsec / 1000.0;
+}
+
+unsigned _cmtTrThreadId()
+{ return (unsigned)syscall(SYS_gettid); }
+
+cmtTrRC_t cmtTrInitialize( cmCtx_t* ctx, const cmChar_t* fn )
+{
+  cmtTrRC_t rc;
+
+  if((rc = cmtTrFinalize()) != kOkTrRC )
+    return rc;
+
+  memset(&_cmtTr,0,sizeof(_cmtTr));
+  cmErrSetup(&_cmtTr.err,&ctx->rpt,"Trace");
+
+  if( fn == NULL )
+    return cmErrMsg(&_cmtTr.err,kFileFailTrRC,"A trace file name was not given.");
+
+  _cmtTr.fn     = cmMemAllocStr(fn);
+  _cmtTr.baseUs = _cmtTrMicros();
+  pthread_mutex_init(&_cmtTr.mutex,NULL);
+
+  _cmtTrEnableFl = true;
+  return rc;
+}
+
+void _cmtTrPrintStr( FILE* fp, const cmChar_t* str )
+{
+  fputc('"',fp);
+
+  for(; *str; ++str)
+  {
+    unsigned char c = (unsigned char)*str;
+
+    if( c == '"' || c == '\\' )
+      fprintf(fp,"\\%c",c);
+    else
+      if( c < 0x20 )
+        fprintf(fp,"\\u%04x",c);
+      else
+        fputc(c,fp);
+  }
+
+  fputc('"',fp);
+}
+
+cmtTrRC_t _cmtTrWrite( const cmChar_t* fn )
+{
+  cmtTrRC_t rc  = kOkTrRC;
+  unsigned  pid = getpid();
+  unsigned  i;
+  FILE*     fp;
+
+  if((fp = fopen(fn,"w")) == NULL )
+    return cmErrSysMsg(&_cmtTr.err,kFileFailTrRC,errno,"The trace file '%s' could not be created.",fn);
+
+  fprintf(fp,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  for(i=0; i<_cmtTr.evtN; ++i)
+  {
+    const cmtTrEvt_t* e = _cmtTr.evtV + i;
+
+    fprintf(fp,"{\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"cat\":\"%s\",\"name\":",pid,e->tid,e->begUs,e->durUs,e->cat);
+    _cmtTrPrintStr(fp,e->name);
+
+    if( e->arg != NULL || e->opCnt > 0 )
+    {
+      fprintf(fp,",\"args\":{");
+
+      if( e->arg != NULL )
+      {
+        fprintf(fp,"\"file\":");
+        _cmtTrPrintStr(fp,e->arg);
+      }
+
+      if( e->opCnt > 0 )
+        fprintf(fp,"%s\"ops\":%u,\"busy_ms\":%.3f",e->arg != NULL ? "," : "",e->opCnt,e->busyUs/1000.0);
+
+      fputc('}',fp);
+    }
+
+    fprintf(fp,"}%s\n", i+1 < _cmtTr.evtN ? "," : "");
+  }
+
+  fprintf(fp,"]}\n");
+
+  if( ferror(fp) )
+    rc = cmErrMsg(&_cmtTr.err,kFileFailTrRC,"The trace file '%s' write failed.",fn);
+
+  if( fclose(fp) != 0 && rc == kOkTrRC )
+    rc = cmErrSysMsg(&_cmtTr.err,kFileFailTrRC,errno,"The trace file '%s' close failed.",fn);
+
+  return rc;
+}
+
+cmtTrRC_t cmtTrFinalize()
+{
+  cmtTrRC_t rc = kOkTrRC;
+  unsigned  i;
+
+  if( _cmtTrEnableFl == false )
+    return rc;
+
+  // all I/O threads have been joined by the time the program finalizes the trace
+  _cmtTrEnableFl = false;
+
+  rc = _cmtTrWrite(_cmtTr.fn);
+
+  for(i=0; i<_cmtTr.evtN; ++i)
+    free(_cmtTr.evtV[i].arg);
+
+  free(_cmtTr.evtV);
+  cmMemFree(_cmtTr.fn);
+  pthread_mutex_destroy(&_cmtTr.mutex);
+  memset(&_cmtTr,0,sizeof(_cmtTr));
+
+  return rc;
+}
+
+bool cmtTrIsEnabled()
+{ return _cmtTrEnableFl; }
+
+void cmtTrBegin( cmtTrSpan_t* s, const cmChar_t* cat, const cmChar_t* name, const cmChar_t* arg )
+{
+  if( _cmtTrEnableFl == false )
+    return;
+
+  s->cat   = cat;
+  s->name  = name;
+  s->arg   = arg;
+  s->begUs = _cmtTrMicros();
+}
+
+void _cmtTrEnd( cmtTrSpan_t* s, unsigned opCnt, double busyUs )
+{
+  if( _cmtTrEnableFl == false )
+    return;
+
+  double    endUs = _cmtTrMicros();
+  cmChar_t* arg   = NULL;
+
+  if( s->arg != NULL && (arg = malloc(strlen(s->arg)+1)) != NULL )
+    strcpy(arg,s->arg);
+
+  pthread_mutex_lock(&_cmtTr.mutex);
+
+  if( _cmtTr.evtN == _cmtTr.evtAllocN )
+  {
+    unsigned    n = _cmtTr.evtAllocN == 0 ? 1024 : 2*_cmtTr.evtAllocN;
+    cmtTrEvt_t* v = realloc(_cmtTr.evtV,n*sizeof(cmtTrEvt_t));
+
+    // on allocation failure the event is dropped
+    if( v == NULL )
+    {
+      pthread_mutex_unlock(&_cmtTr.mutex);
+      free(arg);
+      return;
+    }
+
+    _cmtTr.evtV      = v;
+    _cmtTr.evtAllocN = n;
+  }
+
+  cmtTrEvt_t* e = _cmtTr.evtV + _cmtTr.evtN++;
+
+  e->cat    = s->cat;
+  e->name   = s->name;
+  e->arg    = arg;
+  e->begUs  = s->begUs - _cmtTr.baseUs;
+  e->durUs  = endUs - s->begUs;
+  e->tid    = _cmtTrThreadId();
+  e->opCnt  = opCnt;
+  e->busyUs = busyUs;
+
+  pthread_mutex_unlock(&_cmtTr.mutex);
+}
+
+void cmtTrEnd( cmtTrSpan_t* s )
+{ _cmtTrEnd(s,0,0); }
+
+void cmtTrEndAgg( cmtTrSpan_t* s, unsigned opCnt, double busySecs )
+{ _cmtTrEnd(s,opCnt,busySecs * 1000000.0); }
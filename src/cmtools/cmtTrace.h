@@ -0,0 +1,65 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtTrace_h
+#define cmtTrace_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Wall time span tracing.
+  //
+  // Spans are recorded as Chrome trace-event 'complete' events and written by
+  // cmtTrFinalize() as a JSON trace file which can be loaded by chrome://tracing
+  // or https://ui.perfetto.dev.  Spans which are begun and ended on the same
+  // thread nest according to their times.  Spans may be recorded on any thread.
+  //
+  // Tracing is process wide. Until cmtTrInitialize() is called cmtTrBegin() and
+  // cmtTrEnd() only test a flag and return.
+  //
+  // Usage:
+  //  cmtTrSpan_t sp;
+  //  cmtTrBegin(&sp,kPhaseTrCat,"decode",fn);
+  //  ...
+  //  cmtTrEnd(&sp);
+
+  enum
+  {
+    kOkTrRC = cmOkRC,
+    kFileFailTrRC
+  };
+
+  typedef cmRC_t cmtTrRC_t;
+
+  // Span categories (the trace event 'cat' field).
+  extern const cmChar_t kActionTrCat[];  // a program command (e.g. score_gen, sync)
+  extern const cmChar_t kFileTrCat[];    // processing of one file
+  extern const cmChar_t kPhaseTrCat[];   // open, decode, search, write, json_emit ...
+  extern const cmChar_t kIoTrCat[];      // the asynchronous file I/O of one stream
+
+  typedef struct
+  {
+    const cmChar_t* cat;
+    const cmChar_t* name;  // must remain valid until cmtTrFinalize()
+    const cmChar_t* arg;   // optional file name - copied by cmtTrEnd()
+    double          begUs;
+  } cmtTrSpan_t;
+
+  // Start recording spans. The trace file 'fn' is written by cmtTrFinalize().
+  cmtTrRC_t cmtTrInitialize( cmCtx_t* ctx, const cmChar_t* fn );
+  cmtTrRC_t cmtTrFinalize();
+  bool      cmtTrIsEnabled();
+
+  void cmtTrBegin( cmtTrSpan_t* s, const cmChar_t* cat, const cmChar_t* name, const cmChar_t* arg );
+  void cmtTrEnd(   cmtTrSpan_t* s );
+
+  // End a span which aggregates 'opCnt' operations (e.g. the block reads of an
+  // audio file stream) which were busy for 'busySecs' of the span.  Use this
+  // rather than a span per operation for frequent operations.
+  void cmtTrEndAgg( cmtTrSpan_t* s, unsigned opCnt, double busySecs );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,673 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+
+#include "cmtXmlExcerpt.h"
+
+#include <ctype.h>
+#include <errno.h>
+
+typedef struct
+{
+  cmChar_t* buf;     // buf[allocN]
+  unsigned  n;
+  unsigned  allocN;
+} cmtXeBuf_t;
+
+typedef struct
+{
+  cmErr_t    err;
+  FILE*      ofp;
+  cmtXeBuf_t tag;       // current markup
+  cmtXeBuf_t meas;      // first or last measure of the excerpt
+  bool       measFl;    // true while a measure is read into 'meas'
+  bool       firstFl;   // 'meas' is the first measure of the excerpt
+  bool       lastFl;    // 'meas' is the last measure of the excerpt
+
+  // state of a measure before the excerpt
+  bool       leadFl;    // true while a measure before the excerpt is read
+  unsigned   depth;     // element depth inside the measure
+  bool       keepFl;    // true while an element which is kept is copied
+  bool       durFl;     // true while the text of a <duration> is read into 'text'
+  cmtXeBuf_t text;
+  int        dur;       // duration of the current note, backup or forward
+  bool       chordFl;   // the current note is a chord note
+  bool       graceFl;   // the current note is a grace note
+  int        pos;       // position in the measure in divisions
+  int        noteBeg;   // position of the last non-chord note
+  int        len;       // length of the measure in divisions
+} cmtXe_t;
+
+// A note in the last measure.
+typedef struct
+{
+  unsigned begIdx;    // offset of '<note' in cmtXe_t.meas
+  unsigned endIdx;    // offset following '</note>'
+  cmChar_t key[64];   // step, alter, octave and voice
+  bool     startFl;   // the note has a tie start
+  bool     stopFl;    // the note has a tie stop
+} cmtXeNote_t;
+
+void _cmtXeBufPush( cmtXeBuf_t* b, const cmChar_t* s, unsigned n )
+{
+  if( b->n + n + 1 > b->allocN )
+  {
+    b->allocN = cmMax(2*b->allocN,b->n + n + 1024);
+    b->buf    = cmMemResize(cmChar_t,b->buf,b->allocN);
+  }
+
+  memcpy(b->buf + b->n,s,n);
+  b->n += n;
+  b->buf[ b->n ] = 0;
+}
+
+void _cmtXeWrite( cmtXe_t* p, const cmChar_t* s, unsigned n )
+{
+  if( p->measFl )
+    _cmtXeBufPush(&p->meas,s,n);
+  else
+    fwrite(s,1,n,p->ofp);
+}
+
+bool _cmtXeEndsWith( const cmtXeBuf_t* b, const cmChar_t* s )
+{
+  unsigned n = strlen(s);
+  return b->n >= n && strncmp(b->buf + b->n - n,s,n) == 0;
+}
+
+// Read the remainder of a markup which begins with '<'. Comments and CDATA
+// sections end at their own terminators and '>' is ignored inside attribute values.
+bool _cmtXeReadMarkup( FILE* fp, cmtXeBuf_t* b )
+{
+  const cmChar_t* term = NULL;
+  cmChar_t        q    = 0;
+  int             c;
+
+  b->n = 0;
+  _cmtXeBufPush(b,"<",1);
+
+  while((c = getc(fp)) != EOF )
+  {
+    cmChar_t ch = c;
+    _cmtXeBufPush(b,&ch,1);
+
+    if( term != NULL )
+    {
+      if( _cmtXeEndsWith(b,term) )
+        return true;
+      continue;
+    }
+
+    if( b->n == 4 && strncmp(b->buf,"<!--",4) == 0 )
+    {
+      term = "-->";
+      continue;
+    }
+
+    if( b->n == 9 && strncmp(b->buf,"<![CDATA[",9) == 0 )
+    {
+      term = "]]>";
+      continue;
+    }
+
+    if( q != 0 )
+    {
+      if( ch == q )
+        q = 0;
+      continue;
+    }
+
+    if( ch == '"' || ch == '\'' )
+      q = ch;
+    else
+      if( ch == '>' )
+        return true;
+  }
+
+  return false;
+}
+
+// Return true if the markup at 's' is the start tag (or end tag if 'endFl' is set) of element 'name'.
+bool _cmtXeIsTag( const cmChar_t* s, const cmChar_t* name, bool endFl )
+{
+  unsigned n = strlen(name);
+
+  if( *s++ != '<' )
+    return false;
+
+  if( endFl && *s++ != '/' )
+    return false;
+
+  return strncmp(s,name,n) == 0 && (isspace((unsigned char)s[n]) || s[n] == '>' || s[n] == '/');
+}
+
+// Copy the value of attribute 'attr' of the tag 's' to val[valN]. Returns false if the attribute does not exist.
+bool _cmtXeAttr( const cmChar_t* s, const cmChar_t* attr, cmChar_t* val, unsigned valN )
+{
+  unsigned n = strlen(attr);
+
+  for(; (s = strstr(s,attr)) != NULL; s += n)
+  {
+    const cmChar_t* v = s + n;
+    cmChar_t        q;
+    unsigned        i;
+
+    if( !isspace((unsigned char)s[-1]) )
+      continue;
+
+    while( isspace((unsigned char)*v) )
+      ++v;
+
+    if( *v++ != '=' )
+      continue;
+
+    while( isspace((unsigned char)*v) )
+      ++v;
+
+    if( (q = *v++) != '"' && q != '\'' )
+      continue;
+
+    for(i=0; i<valN-1 && v[i] && v[i]!=q; ++i)
+      val[i] = v[i];
+
+    val[i] = 0;
+    return true;
+  }
+
+  return false;
+}
+
+// Parse a measure number. Returns false if 's' is not an integer.
+bool _cmtXeMeasNumb( const cmChar_t* s, int* numbRef )
+{
+  cmChar_t* ep = NULL;
+  long      v  = strtol(s,&ep,10);
+
+  if( ep == s || *ep != 0 )
+    return false;
+
+  *numbRef = (int)v;
+  return true;
+}
+
+// Copy the text of the first element 'name' in s[begIdx:endIdx] to val[valN].
+void _cmtXeElemText( const cmChar_t* s, unsigned begIdx, unsigned endIdx, const cmChar_t* name, cmChar_t* val, unsigned valN )
+{
+  unsigned i,j;
+  unsigned n = strlen(name);
+
+  val[0] = 0;
+
+  for(i=begIdx; i+n+2<endIdx; ++i)
+    if( s[i] == '<' && strncmp(s+i+1,name,n) == 0 && s[i+n+1] == '>' )
+    {
+      for(i+=n+2,j=0; i<endIdx && s[i]!='<' && j<valN-1; ++i)
+        if( !isspace((unsigned char)s[i]) )
+          val[j++] = s[i];
+
+      val[j] = 0;
+      return;
+    }
+}
+
+// Return true if s[begIdx:endIdx] contains a <tie> or <tied> element of type 'type'.
+// If 'rmV' is not NULL the extent of each such element is appended to rmV[rmAllocN] as a begin,end pair.
+bool _cmtXeFindTies( const cmChar_t* s, unsigned begIdx, unsigned endIdx, const cmChar_t* type, unsigned* rmV, unsigned* rmNRef, unsigned rmAllocN )
+{
+  bool     fl = false;
+  unsigned i;
+
+  for(i=begIdx; i<endIdx; ++i)
+    if( s[i] == '<' && (_cmtXeIsTag(s+i,"tie",false) || _cmtXeIsTag(s+i,"tied",false)) )
+    {
+      const cmChar_t* e = strchr(s+i,'>');
+      cmChar_t        tag[ 128 ];
+      cmChar_t        val[ 16 ];
+      unsigned        n;
+
+      if( e == NULL || (unsigned)(e-s) >= endIdx )
+        break;
+
+      n = cmMin((unsigned)(e-(s+i))+1,sizeof(tag)-1);
+      strncpy(tag,s+i,n);
+      tag[n] = 0;
+
+      if( _cmtXeAttr(tag,"type",val,sizeof(val)) && strcmp(val,type) == 0 )
+      {
+        unsigned k = (e-s) + 1;
+
+        // a <tied> element with content ends at </tied>
+        if( e[-1] != '/' )
+        {
+          const cmChar_t* ee = strstr(e,"</tied>");
+          if( ee != NULL && (unsigned)(ee-s) < endIdx )
+            k = (ee-s) + strlen("</tied>");
+        }
+
+        if( rmV != NULL && *rmNRef + 2 <= rmAllocN )
+        {
+          rmV[ (*rmNRef)++ ] = i;
+          rmV[ (*rmNRef)++ ] = k;
+        }
+
+        fl = true;
+      }
+
+      i = (e-s);
+    }
+
+  return fl;
+}
+
+int _cmtXeRangeCompare( const void* p0, const void* p1 )
+{
+  unsigned v0 = *(const unsigned*)p0;
+  unsigned v1 = *(const unsigned*)p1;
+  return v0 < v1 ? -1 : (v0 > v1 ? 1 : 0);
+}
+
+// Write the first or last measure of the excerpt without the ties which would
+// begin before or end after the excerpt.
+void _cmtXeFlushMeasure( cmtXe_t* p )
+{
+  const cmChar_t* s      = p->meas.buf;
+  cmtXeNote_t*    noteV  = NULL;
+  unsigned        noteN  = 0;
+  unsigned        allocN = 0;
+  unsigned*       rmV    = NULL;
+  unsigned        rmN    = 0;
+  unsigned        i,j;
+
+  p->measFl = false;
+
+  // locate the notes
+  for(i=0; i<p->meas.n; ++i)
+    if( s[i] == '<' && _cmtXeIsTag(s+i,"note",false) )
+    {
+      const cmChar_t* e = strstr(s+i,"</note>");
+      cmChar_t        step[8],alter[8],octave[8],voice[8];
+
+      if( e == NULL )
+        break;
+
+      if( noteN == allocN )
+      {
+        allocN = cmMax(2*allocN,32);
+        noteV  = cmMemResize(cmtXeNote_t,noteV,allocN);
+      }
+
+      cmtXeNote_t* n = noteV + noteN++;
+      n->begIdx = i;
+      n->endIdx = (e-s) + strlen("</note>");
+
+      _cmtXeElemText(s,n->begIdx,n->endIdx,"step",  step,  sizeof(step));
+      _cmtXeElemText(s,n->begIdx,n->endIdx,"alter", alter, sizeof(alter));
+      _cmtXeElemText(s,n->begIdx,n->endIdx,"octave",octave,sizeof(octave));
+      _cmtXeElemText(s,n->begIdx,n->endIdx,"voice", voice, sizeof(voice));
+      snprintf(n->key,sizeof(n->key),"%s/%s/%s/%s",step,alter,octave,voice);
+
+      n->startFl = _cmtXeFindTies(s,n->begIdx,n->endIdx,"start",NULL,NULL,0);
+      n->stopFl  = _cmtXeFindTies(s,n->begIdx,n->endIdx,"stop", NULL,NULL,0);
+
+      i = n->endIdx - 1;
+    }
+
+  // a note normally has at most a <tie> and a <tied> element of each type
+  rmV = cmMemAllocZ(unsigned,8*noteN+1);
+
+  for(i=0; i<noteN; ++i)
+  {
+    // a tie which starts in the last measure must end in it
+    if( p->lastFl && noteV[i].startFl )
+    {
+      for(j=i+1; j<noteN; ++j)
+        if( noteV[j].stopFl && strcmp(noteV[i].key,noteV[j].key) == 0 )
+          break;
+
+      if( j == noteN )
+        _cmtXeFindTies(s,noteV[i].begIdx,noteV[i].endIdx,"start",rmV,&rmN,8*noteN);
+    }
+
+    // a tie which ends in the first measure must start in it
+    if( p->firstFl && noteV[i].stopFl )
+    {
+      for(j=0; j<i; ++j)
+        if( noteV[j].startFl && strcmp(noteV[i].key,noteV[j].key) == 0 )
+          break;
+
+      if( j == i )
+        _cmtXeFindTies(s,noteV[i].begIdx,noteV[i].endIdx,"stop",rmV,&rmN,8*noteN);
+    }
+  }
+
+  // the start and stop ranges of a note may be out of order
+  qsort(rmV,rmN/2,2*sizeof(rmV[0]),_cmtXeRangeCompare);
+
+  // write the measure without the removed ranges
+  for(i=0,j=0; j<rmN; j+=2)
+  {
+    fwrite(s+i,1,rmV[j]-i,p->ofp);
+    i = rmV[j+1];
+  }
+
+  fwrite(s+i,1,p->meas.n-i,p->ofp);
+
+  p->meas.n  = 0;
+  p->firstFl = false;
+  p->lastFl  = false;
+  cmMemFree(rmV);
+  cmMemFree(noteV);
+}
+
+// Process a markup of a measure before the excerpt.  Only the <attributes>, <direction>
+// and <sound> elements are copied. The durations of the other elements are summed to
+// find the length of the measure.
+void _cmtXeLeadMarkup( cmtXe_t* p )
+{
+  const cmChar_t* s       = p->tag.buf;
+  bool            endFl   = s[1] == '/';
+  bool            emptyFl = _cmtXeEndsWith(&p->tag,"/>");
+
+  // comments and processing instructions
+  if( s[1] == '!' || s[1] == '?' )
+  {
+    if( p->keepFl )
+      _cmtXeWrite(p,s,p->tag.n);
+    return;
+  }
+
+  if( endFl && p->depth > 0 )
+    --p->depth;
+
+  if( !endFl && p->depth == 0 )
+  {
+    p->keepFl  = _cmtXeIsTag(s,"attributes",false) || _cmtXeIsTag(s,"direction",false) || _cmtXeIsTag(s,"sound",false);
+    p->dur     = 0;
+    p->chordFl = false;
+    p->graceFl = false;
+  }
+
+  if( p->keepFl )
+    _cmtXeWrite(p,s,p->tag.n);
+
+  if( !endFl )
+  {
+    if( _cmtXeIsTag(s,"chord",false) )
+      p->chordFl = true;
+    else
+      if( _cmtXeIsTag(s,"grace",false) )
+        p->graceFl = true;
+      else
+        if( _cmtXeIsTag(s,"duration",false) && !emptyFl )
+        {
+          p->durFl  = true;
+          p->text.n = 0;
+        }
+
+    if( !emptyFl )
+      ++p->depth;
+    else
+      if( p->depth == 0 )
+        p->keepFl = false;
+
+    return;
+  }
+
+  if( _cmtXeIsTag(s,"duration",true) )
+  {
+    p->durFl = false;
+    p->dur   = p->text.n == 0 ? 0 : atoi(p->text.buf);
+  }
+
+  if( p->depth > 0 )
+    return;
+
+  p->keepFl = false;
+
+  if( _cmtXeIsTag(s,"note",true) && !p->graceFl )
+  {
+    if( p->chordFl )
+      p->len = cmMax(p->len,p->noteBeg + p->dur);
+    else
+    {
+      p->noteBeg = p->pos;
+      p->pos    += p->dur;
+    }
+  }
+  else
+    if( _cmtXeIsTag(s,"backup",true) )
+      p->pos = cmMax(0,p->pos - p->dur);
+    else
+      if( _cmtXeIsTag(s,"forward",true) )
+        p->pos += p->dur;
+
+  p->len = cmMax(p->len,p->pos);
+}
+
+// End a measure before the excerpt with one rest as long as the notes which were
+// removed so that the ticks of the following events do not change.
+void _cmtXeEndLeadMeasure( cmtXe_t* p )
+{
+  if( p->len > 0 )
+  {
+    cmChar_t buf[ 128 ];
+    int      n = snprintf(buf,sizeof(buf),"<note><rest/><duration>%i</duration><voice>1</voice><type>whole</type></note>",p->len);
+    _cmtXeWrite(p,buf,n);
+  }
+
+  _cmtXeWrite(p,p->tag.buf,p->tag.n);
+  p->leadFl = false;
+}
+
+cmtXeRC_t cmtXeMusicXml( cmCtx_t* ctx, const cmChar_t* xmlFn, int begMeasNumb, int endMeasNumb, const cmChar_t* outFn, unsigned* skipMeasNRef )
+{
+  cmtXeRC_t rc      = kOkXeRC;
+  FILE*     ifp     = NULL;
+  bool      skipFl  = false;
+  bool      firstFl = true;  // the first measure of the excerpt in the current part is pending
+  unsigned  skipN   = 0;
+  int       c;
+  cmtXe_t   x;
+
+  memset(&x,0,sizeof(x));
+  cmErrSetup(&x.err,&ctx->rpt,"XML Excerpt");
+
+  if((ifp = fopen(xmlFn,"rb")) == NULL )
+  {
+    rc = cmErrSysMsg(&x.err,kFileFailXeRC,errno,"The MusicXML file '%s' could not be opened.",xmlFn);
+    goto errLabel;
+  }
+
+  if((x.ofp = fopen(outFn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&x.err,kFileFailXeRC,errno,"The MusicXML excerpt file '%s' could not be created.",outFn);
+    goto errLabel;
+  }
+
+  while((c = getc(ifp)) != EOF )
+  {
+    if( c != '<' )
+    {
+      cmChar_t ch = c;
+
+      if( x.leadFl )
+      {
+        if( x.durFl )
+          _cmtXeBufPush(&x.text,&ch,1);
+
+        if( x.keepFl || x.depth == 0 )
+          _cmtXeWrite(&x,&ch,1);
+      }
+      else
+        if( !skipFl )
+          _cmtXeWrite(&x,&ch,1);
+      continue;
+    }
+
+    if( !_cmtXeReadMarkup(ifp,&x.tag) )
+    {
+      rc = cmErrMsg(&x.err,kSyntaxFailXeRC,"The MusicXML file '%s' ends inside a markup.",xmlFn);
+      goto errLabel;
+    }
+
+    if( _cmtXeIsTag(x.tag.buf,"part",false) )
+      firstFl = true;
+    else
+      if( _cmtXeIsTag(x.tag.buf,"measure",false) )
+      {
+        cmChar_t val[ 32 ] = "";
+        int      measNumb;
+        bool     emptyFl = _cmtXeEndsWith(&x.tag,"/>");
+
+        // the range is given by measure numbers so every measure must have an integer number
+        if( !_cmtXeAttr(x.tag.buf,"number",val,sizeof(val)) || !_cmtXeMeasNumb(val,&measNumb) )
+        {
+          rc = cmErrMsg(&x.err,kSyntaxFailXeRC,"The measure number '%s' in '%s' is not an integer. An excerpt can only be made of a score whose measures have integer numbers.",val,xmlFn);
+          goto errLabel;
+        }
+
+        if( endMeasNumb > 0 && measNumb > endMeasNumb )
+        {
+          ++skipN;
+          skipFl = !emptyFl;
+          continue;
+        }
+
+        if( measNumb < begMeasNumb )
+        {
+          ++skipN;
+          x.leadFl = !emptyFl;
+          x.depth  = 0;
+          x.keepFl = false;
+          x.pos    = 0;
+          x.len    = 0;
+        }
+        else
+        {
+          x.firstFl = firstFl && begMeasNumb > 1;
+          x.lastFl  = measNumb == endMeasNumb;
+          x.measFl  = !emptyFl && (x.firstFl || x.lastFl);
+          firstFl   = false;
+        }
+      }
+      else
+        if( _cmtXeIsTag(x.tag.buf,"measure",true) )
+        {
+          if( skipFl )
+          {
+            skipFl = false;
+            continue;
+          }
+
+          if( x.leadFl )
+          {
+            _cmtXeEndLeadMeasure(&x);
+            continue;
+          }
+
+          if( x.measFl )
+          {
+            _cmtXeWrite(&x,x.tag.buf,x.tag.n);
+            _cmtXeFlushMeasure(&x);
+            continue;
+          }
+        }
+        else
+          if( x.leadFl )
+          {
+            _cmtXeLeadMarkup(&x);
+            continue;
+          }
+
+    if( !skipFl )
+      _cmtXeWrite(&x,x.tag.buf,x.tag.n);
+  }
+
+  // an unterminated measure is written as it is
+  if( x.measFl )
+    _cmtXeFlushMeasure(&x);
+
+  if( skipMeasNRef != NULL )
+    *skipMeasNRef = skipN;
+
+ errLabel:
+  if( ifp != NULL )
+    fclose(ifp);
+
+  if( x.ofp != NULL && fclose(x.ofp) != 0 && rc == kOkXeRC )
+    rc = cmErrSysMsg(&x.err,kFileFailXeRC,errno,"The MusicXML excerpt file '%s' could not be written.",outFn);
+
+  cmMemFree(x.tag.buf);
+  cmMemFree(x.meas.buf);
+  cmMemFree(x.text.buf);
+  return rc;
+}
+
+cmtXeRC_t cmtXeEditFile( cmCtx_t* ctx, const cmChar_t* editFn, int begMeasNumb, int endMeasNumb, const cmChar_t* outFn )
+{
+  cmtXeRC_t rc      = kOkXeRC;
+  FILE*     ifp     = NULL;
+  FILE*     ofp     = NULL;
+  char*     line    = NULL;
+  size_t    lineN   = 0;
+  bool      keepFl  = true;
+  cmErr_t   err;
+
+  cmErrSetup(&err,&ctx->rpt,"Edit Excerpt");
+
+  if((ifp = fopen(editFn,"rb")) == NULL )
+  {
+    rc = cmErrSysMsg(&err,kFileFailXeRC,errno,"The edit file '%s' could not be opened.",editFn);
+    goto errLabel;
+  }
+
+  if((ofp = fopen(outFn,"wb")) == NULL )
+  {
+    rc = cmErrSysMsg(&err,kFileFailXeRC,errno,"The edit excerpt file '%s' could not be created.",outFn);
+    goto errLabel;
+  }
+
+  // a part begins with a 'Part:<id>' line and each measure with a '<numb> : ...' line
+  while( getline(&line,&lineN,ifp) != -1 )
+  {
+    const cmChar_t* s = line;
+    cmChar_t*       ep;
+    long            measNumb;
+
+    while( isspace((unsigned char)*s) )
+      ++s;
+
+    if( strncmp(s,"Part:",5) == 0 )
+      keepFl = true;
+    else
+      if( isdigit((unsigned char)*s) )
+      {
+        measNumb = strtol(s,&ep,10);
+
+        while( *ep == ' ' || *ep == '\t' )
+          ++ep;
+
+        if( *ep == ':' )
+          keepFl = measNumb >= begMeasNumb && (endMeasNumb <= 0 || measNumb <= endMeasNumb);
+      }
+
+    if( keepFl )
+      fputs(line,ofp);
+  }
+
+ errLabel:
+  if( ifp != NULL )
+    fclose(ifp);
+
+  if( ofp != NULL && fclose(ofp) != 0 && rc == kOkXeRC )
+    rc = cmErrSysMsg(&err,kFileFailXeRC,errno,"The edit excerpt file '%s' could not be written.",outFn);
+
+  free(line);
+  return rc;
+}
@@ -0,0 +1,47 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#ifndef cmtXmlExcerpt_h
+#define cmtXmlExcerpt_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Streaming excerpts of MusicXML and score edit files.
+  //
+  // The excerpt holds the measures of each part from 'begMeasNumb' up to and
+  // including 'endMeasNumb'.  The measures after the excerpt are removed.  Of
+  // each measure before the excerpt only the <attributes>, <direction> and
+  // <sound> elements are kept, followed by one rest as long as the measure, so
+  // that the tempo, key, time signature and pedal state and the event ticks of
+  // the excerpt are the same as in the complete score.  The file is read once
+  // as a stream of markup and text and the skipped measures are never stored.
+  //
+  // A tie which starts in the last measure of the excerpt and does not end in
+  // that measure, or ends in the first measure and does not start in it, is
+  // removed from the excerpt.
+
+  enum
+  {
+    kOkXeRC = cmOkRC,
+    kFileFailXeRC,
+    kSyntaxFailXeRC
+  };
+
+  typedef cmRC_t cmtXeRC_t;
+
+  // Write the measures 'begMeasNumb' to 'endMeasNumb' of the partwise MusicXML file 'xmlFn' to 'outFn'.
+  // If 'endMeasNumb' is 0 the excerpt ends with the last measure.
+  // Fails with kSyntaxFailXeRC if a measure number is not an integer.
+  // *skipMeasNRef is set to the count of measures which were removed or reduced.
+  cmtXeRC_t cmtXeMusicXml( cmCtx_t* ctx, const cmChar_t* xmlFn, int begMeasNumb, int endMeasNumb, const cmChar_t* outFn, unsigned* skipMeasNRef );
+
+  // Write the measures 'begMeasNumb' to 'endMeasNumb' of the score edit file 'editFn' to 'outFn'.
+  // If 'endMeasNumb' is 0 the excerpt ends with the last measure.
+  cmtXeRC_t cmtXeEditFile( cmCtx_t* ctx, const cmChar_t* editFn, int begMeasNumb, int endMeasNumb, const cmChar_t* outFn );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,6 +28,29 @@
 #include "cmFloatTypes.h"
 #include "cmAudioFile.h"
 #include "cmTimeLine.h"
+#include "cmJson.h"
+
+#include "cmtTlBin.h"
+#include "cmtTlIndex.h"
+#include "cmtTrace.h"
+#include "cmtProcPool.h"
+#include "cmtCache.h"
+#include "cmtFollow.h"
+#include "cmtXmlExcerpt.h"
+#include "cmtMeasGen.h"
+
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 
 enum
 {
@@ -39,198 +62,1914 @@ enum
  kScoreFollowFailedCtRC,
  kMidiFileRptFailedCtRC,
  kTimeLineRptFailedCtRC,
- kAudioFileRptFailedCtRC
+ kAudioFileRptFailedCtRC,
+ kBatchFailedCtRC,
+ kServeFailedCtRC,
+ kMeasGenFailedCtRC
 };
 
+enum {
+      kNoSelId,
+      kScoreGenSelId,
+      kScoreEditMergeSelId,
+      kScoreFollowSelId,
+      kMeasGenSelId,
+      kScoreReportSelId,
+      kMidiReportSelId,
+      kTimelineReportSelId,
+      kAudioReportSelId,
+      kScoreFollowLiveSelId,
+      kScoreFollowTableSelId,
+      kSelIdCnt
+};
+
+// trace span and batch manifest labels indexed by the action selector id's
+const cmChar_t* actionLabelArray[] =
+{
+  "none",
+  "score_gen",
+  "merge_edit",
+  "score_follow",
+  "meas_gen",
+  "score_report",
+  "midi_report",
+  "timeline_report",
+  "audio_report",
+  "score_follow_live",
+  "score_follow_table"   // batch and service only
+};
+
+// Action arguments.  The field names follow the command line option names
+// which are also the keys of the batch manifest entries.
+typedef struct
+{
+  unsigned        actionSelId;
+  const cmChar_t* xmlFn;           // music_xml_fn
+  const cmChar_t* editFn;          // edit_fn
+  const cmChar_t* keyEditFn;       // key_edit_fn
+  const cmChar_t* outEditFn;       // out_edit_fn
+  const cmChar_t* pgmRsrcFn;       // pgm_rsrc_fn
+  const cmChar_t* csvScoreFn;      // score_csv_fn
+  const cmChar_t* midiOutFn;       // midi_out_fn
+  const cmChar_t* midiInFn;        // midi_in_fn
+  const cmChar_t* audioFn;         // audio_fn
+  const cmChar_t* svgOutFn;        // svg_fn
+  const cmChar_t* timelineFn;      // timeline_fn
+  const cmChar_t* timelinePrefix;  // tl_prefix
+  const cmChar_t* rptFn;           // report_fn
+  unsigned        reportFl;        // debug_fl
+  unsigned        svgStandAloneFl; // svg_stand_alone_fl
+  unsigned        svgPanZoomFl;    // svg_pan_zoom_fl
+  int             begMeasNumb;     // beg_meas
+  int             endMeasNumb;     // end_meas
+  int             keyMeasNumb;     // key_meas
+  int             begTempoBPM;     // beg_bpm
+  unsigned        damperRptFl;     // damper
+  unsigned        begMidiUId;      // beg_midi_uid
+  unsigned        endMidiUId;      // end_midi_uid
+  double          tlBegSecs;       // tl_beg_secs
+  double          tlEndSecs;       // tl_end_secs
+  const cmChar_t* cacheDir;        // cache_dir
+  unsigned        workerCnt;       // workers
+  unsigned        beamN;           // beam
+} ctArgs_t;
+
+
+const cmChar_t poEndHelpStr[] = "";
+const cmChar_t poBegHelpStr[] =
+  "xscore_proc Music XML to electronic score generator\n"
+  "\n"
+  "USAGE:\n"
+  "\n"
+  "Parse an XML score file and 'edit' file to produce a score file in CSV format.\n"
+  "\n"
+  "cmtool --score_gen -x <xml_file> -d <edit_fn> {-c <csvScoreOutFn} {-m <midiOutFn>} {-s <svgOutFn>} {-r report} {-b begMeasNumb} {-j endMeasNumb} {t begTempoBPM}\n"
+  "\n"
+  "Notes:\n"
+  "1.  If <edit_fn> does not exist then a edit template file will be generated based on the MusicXML file. \n"
+  "2.  Along with the CSV score file MIDI and HTML/SVG files will also be produced based on the contents of the MusicXML and edit file.\n"
+  "3. See README.md for a detailed description of the how to edit the edit file.\n"
+  "4. The measures following <endMeasNumb> are skipped without being parsed. Of the measures preceding\n"
+  "   <begMeasNumb> only the tempo, key, time signature and pedal markings are parsed. Measure numbers must be integers.\n"
+  "\n"
+  "\n"
+  "Use the score follower to generate a timeline configuration file.\n"
+  "\n"
+  "cmtool --timeline_gen -c <csvScoreFn> -i <midiInFn> -r <matchRptFn> -s <matchSvgFn> {-m <midiOutFn>} {-t timelineOutFn} \n"
+  "\n"
+  "Follow a performance with a beam and write the note-by-note match report of the beamed follower.\n"
+  "\n"
+  "cmtool --score_follow -c <csvScoreFn> -i <midiInFn> {-r <matchRptFn>} -K <beam>\n"
+  "\n"
+  "Follow many performances of the same score on <workerCnt> worker processes.\n"
+  "\n"
+  "cmtool --score_follow -c <csvScoreFn> -i <midiDir|midiListFn> {-r <matchRptDir>} {-N <workerCnt>} {-K <beam>}\n"
+  "\n"
+  "<midiListFn> is a '.txt' or '.lst' file with one MIDI file name per line. <matchRptDir> receives the match\n"
+  "report of each performance. A table of the match rate of each performance is printed.\n"
+  "\n"
+  "<beam> is the count of score locations the follower examines around its last match. It is\n"
+  "widened while notes are not matched. A narrow beam is faster on long scores.\n"
+  "\n"
+  "Follow a live MIDI event stream read from stdin or a named pipe.\n"
+  "\n"
+  "cmtool --score_follow_live -c <csvScoreFn> {-i <streamFn>} {-r <matchRptFn>} {-K <beam>}\n"
+  "\n"
+  "Each line of the stream is a MIDI event: {<secs>} <status> <d0> <d1>\n"
+  "A histogram of the per-note processing latency is printed at the end of the stream.\n"
+  "\n"
+  "Measure some perforamance attributes:\n"
+  "\n"
+  "cmtool --meas_gen -g <pgmRsrcFn> -r <measRptFn> {-N <workerCnt>} {-C <cacheDir>}\n"
+  "\n"
+  "The time line markers are measured on <workerCnt> worker processes (default: one per CPU).\n"
+  "If <cacheDir> is given the measurements of each marker are stored there and only the markers\n"
+  "whose time range, MIDI files, score or 'dynRef' table changed are measured again.\n"
+  "\n"
+  "Generate a score file report\n"
+  "\n"
+  "cmtool --score_report -c <csvScoreFn> -r <scoreRptFn>\n"
+  "\n"
+  "Generate a MIDI file report and optional SVG piano roll image\n"
+  "\n"
+  "cmtool --midi_report -i <midiInFn> -r <midiRptFn> {-s <svgOutFn>}\n"
+  "\n"
+  "Generate a timeline report\n"
+  "\n"
+  "cmtool --timeline_report -t <timelineFn> -r <timelineRptFn>\n"
+  "\n"
+  "If <timelineFn> uses the extension '.tlb' it is read as a binary timeline file.\n"
+  "\n"
+  "Report the timeline objects which overlap a time range or contain a point in time.\n"
+  "\n"
+  "cmtool --timeline_report -t <timelineFn> -G <begSecs> {-H <endSecs>} {-r <timelineRptFn>}\n"
+  "\n"
+  "Generate an audio file report\n"
+  "\n"
+  "cmtool --audiofile_report -a <audioFn> -r <rptFn>\n"
+  "\n"
+  "Any action may also record where its wall time is spent as a Chrome trace-event file\n"
+  "which can be viewed with chrome://tracing or https://ui.perfetto.dev.\n"
+  "\n"
+  "cmtool <action> ... --trace <traceFn.json>\n"
+  "\n"
+  "Run a list of actions from a JSON manifest file in one process.\n"
+  "\n"
+  "cmtool --batch <manifestFn.json> {-N <workerCnt>}\n"
+  "\n"
+  "Each manifest entry names an action and its arguments using the long option names.\n"
+  "Independent entries run in parallel on <workerCnt> worker processes (default: one per CPU).\n"
+  "See README.md for the manifest format.\n"
+  "\n"
+  "Run as a service which answers JSON action requests on a Unix domain socket.\n"
+  "\n"
+  "cmtool --serve <socketFn>\n"
+  "\n"
+  "The score, MIDI and timeline files used by score_report, score_follow_table, midi_report\n"
+  "and timeline_report requests remain loaded between requests until their files change.\n"
+  "score_follow_table follows one MIDI file and prints a table of the match of each note.\n"
+  "See README.md for the request and response format.\n"
+  "\n";
+
+
+void print( void* arg, const char* text )
+{
+  printf("%s",text);
+}
+
+bool verify_file_exists( cmCtx_t* ctx, const cmChar_t* fn, const cmChar_t* msg )
+{
+  if( fn == NULL || cmFsIsFile(fn)==false )
+    return cmErrMsg(&ctx->err,kMissingRequiredFileNameCtRC,"The required file <%s> does not exist.",msg);
+
+  return kOkCtRC;
+}
+
+bool verify_non_null_filename( cmCtx_t* ctx, const cmChar_t* fn, const cmChar_t* msg )
+{
+  if( fn == NULL )
+    return cmErrMsg(&ctx->err,kMissingRequiredFileNameCtRC,"The required file name <%s> is blank.",msg);
+
+  return kOkCtRC;
+}
+
+double wall_secs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+// score_gen outputs
+enum
+{
+  kCsvGenOutId,
+  kMidiGenOutId,
+  kSvgGenOutId,
+  kGenOutCnt
+};
+
+const cmChar_t* genOutLabelArray[] = { "csv", "midi", "svg" };
+
+// Print the size of each score_gen output and the time taken to parse the score and
+// write all of the outputs.
+//
+// libcm only writes the MIDI and SVG outputs from within cmXScoreTest(), which parses
+// the MusicXML and edit files itself. The outputs are therefore all written by one
+// call from one parse of the score and only their total time can be measured.
+void _score_gen_report( cmCtx_t* ctx, const cmChar_t** outFnV, double secs )
+{
+  unsigned i;
+
+  cmRptPrintf(&ctx->rpt,"\n%-6s %-8s %10s %s\n","output","status","bytes","file");
+
+  for(i=0; i<kGenOutCnt; ++i)
+    if( outFnV[i] != NULL )
+    {
+      struct stat st;
+
+      if( stat(outFnV[i],&st) == 0 )
+        cmRptPrintf(&ctx->rpt,"%-6s %-8s %10lli %s\n",genOutLabelArray[i],"ok",(long long)st.st_size,outFnV[i]);
+      else
+        cmRptPrintf(&ctx->rpt,"%-6s %-8s %10s %s\n",genOutLabelArray[i],"missing","-",outFnV[i]);
+    }
+
+  cmRptPrintf(&ctx->rpt,"%-6s %-8s %10s secs:%f\n","wall","","",secs);
+}
+
+// Create an empty temporary file and return its name. Release the name with cmMemFree().
+cmChar_t* make_temp_fn( cmCtx_t* ctx, const cmChar_t* label )
+{
+  const cmChar_t* dir = getenv("TMPDIR");
+  unsigned        n   = (dir == NULL ? 4 : strlen(dir)) + strlen(label) + 32;
+  cmChar_t*       fn  = cmMemAllocZ(cmChar_t,n);
+  int             fd;
+
+  snprintf(fn,n,"%s/cmtools_%s_XXXXXX",dir == NULL ? "/tmp" : dir,label);
+
+  if((fd = mkstemp(fn)) == -1 )
+  {
+    cmErrSysMsg(&ctx->err,kMissingRequiredFileNameCtRC,errno,"The temporary file '%s' could not be created.",fn);
+    cmMemFree(fn);
+    return NULL;
+  }
+
+  close(fd);
+  return fn;
+}
+
+// Write the measures 'begMeasNumb' to 'endMeasNumb' of the XML and edit files to temporary files.
+cmRC_t _score_gen_excerpt( cmCtx_t* ctx, const cmChar_t* xmlFn, const cmChar_t* editFn, int begMeasNumb, int endMeasNumb, cmChar_t** xmlExFnRef, cmChar_t** editExFnRef )
+{
+  cmRC_t      rc        = kOkCtRC;
+  unsigned    skipMeasN = 0;
+  double      begSecs   = wall_secs();
+  cmtTrSpan_t sp;
+
+  if((*xmlExFnRef = make_temp_fn(ctx,"xml")) == NULL )
+    return kScoreGenFailedCtRC;
+
+  if( editFn != NULL && (*editExFnRef = make_temp_fn(ctx,"edit")) == NULL )
+    return kScoreGenFailedCtRC;
+
+  cmtTrBegin(&sp,kPhaseTrCat,"excerpt",xmlFn);
+
+  if( cmtXeMusicXml(ctx,xmlFn,begMeasNumb,endMeasNumb,*xmlExFnRef,&skipMeasN) != kOkXeRC )
+    rc = cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"The MusicXML excerpt could not be created.");
+  else if( editFn != NULL && cmtXeEditFile(ctx,editFn,begMeasNumb,endMeasNumb,*editExFnRef) != kOkXeRC )
+    rc = cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"The edit file excerpt could not be created.");
+  else
+    cmRptPrintf(&ctx->rpt,"Excerpt: measures %i to %i skipped:%i secs:%f\n",begMeasNumb,endMeasNumb > 0 ? endMeasNumb : -1,skipMeasN,wall_secs()-begSecs);
+
+  cmtTrEnd(&sp);
+
+  return rc;
+}
+
+// If 'begMeasNumb' is greater than 1 or 'endMeasNumb' is greater than 0 the measures
+// outside of the range are removed or reduced before the score is parsed (See cmtXmlExcerpt.h).
+cmRC_t score_gen( cmCtx_t* ctx, const cmChar_t* xmlFn, const cmChar_t* editFn, const cmChar_t* csvOutFn, const cmChar_t* midiOutFn, const cmChar_t* svgOutFn, unsigned reportFl, int begMeasNumb, int endMeasNumb, int begTempoBPM, bool svgStandAloneFl, bool svgPanZoomFl, bool damperRptFl )
+{
+  cmRC_t          rc;
+  const cmChar_t* outFnV[] = { csvOutFn, midiOutFn, svgOutFn };
+  double          begSecs;
+  cmtTrSpan_t     sp;
+  cmChar_t*       xmlExFn  = NULL;
+  cmChar_t*       editExFn = NULL;
+  
+  if((rc = verify_file_exists(ctx,xmlFn,"XML file")) != kOkCtRC )
+    return rc;
+
+  if( endMeasNumb > 0 && endMeasNumb < begMeasNumb )
+    return cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"The end measure %i precedes the begin measure %i.",endMeasNumb,begMeasNumb);
+
+  // an edit file template generated from an excerpt would be incomplete
+  if( endMeasNumb > 0 && editFn != NULL && !cmFsIsFile(editFn) )
+    return cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"The edit file must exist when an end measure is given.");
+
+  // the template is generated from the complete score when only a begin measure is given
+  if( (endMeasNumb > 0 || begMeasNumb > 1) && (editFn == NULL || cmFsIsFile(editFn)) )
+  {
+    if((rc = _score_gen_excerpt(ctx,xmlFn,editFn,begMeasNumb,endMeasNumb,&xmlExFn,&editExFn)) != kOkCtRC )
+      goto errLabel;
+
+    xmlFn  = xmlExFn;
+    editFn = editExFn;
+  }
+
+  begSecs = wall_secs();
+
+  cmtTrBegin(&sp,kPhaseTrCat,"outputs",xmlFn);
+
+  // the score is parsed once and all of the requested outputs are written from it
+  if( cmXScoreTest( ctx, xmlFn, editFn, csvOutFn, midiOutFn, svgOutFn, reportFl, begMeasNumb, begTempoBPM, svgStandAloneFl, svgPanZoomFl, damperRptFl ) != kOkXsRC )
+    rc = cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"score_gen failed.");
+
+  cmtTrEnd(&sp);
+
+  // no outputs are written when the edit file template is generated
+  if( editFn == NULL || cmFsIsFile(editFn) )
+    _score_gen_report(ctx,outFnV,wall_secs() - begSecs);
+
+ errLabel:
+  if( xmlExFn != NULL )
+  {
+    remove(xmlExFn);
+    cmMemFree(xmlExFn);
+  }
+
+  if( editExFn != NULL )
+  {
+    remove(editExFn);
+    cmMemFree(editExFn);
+  }
+    
+  return rc;
+}
+
+cmRC_t score_edit_merge( cmCtx_t* ctx, const cmChar_t* xmlFn, const cmChar_t* editFn, unsigned begMeasNumb, const cmChar_t* keyEditFn, unsigned keyMeasNumb, const cmChar_t* outFn )
+{
+  cmRC_t rc;
+  
+  if((rc = verify_file_exists(ctx,xmlFn,"XML file")) != kOkCtRC )
+    return rc;
+  
+  if((rc = verify_file_exists(ctx,editFn,"reference edit file")) != kOkCtRC )
+    return rc;
+
+  if((rc = verify_file_exists(ctx,editFn,"key edit file")) != kOkCtRC )
+    return rc;
+
+  if( cmXScoreMergeEditFiles( ctx, xmlFn, editFn, begMeasNumb, keyEditFn, keyMeasNumb, outFn ) != kOkXsRC )
+    return cmErrMsg(&ctx->err,kScoreEditMergeFailedCtRC,"Score merge failed failed.");
+    
+  return kOkCtRC;      
+}
+
+
+//----------------------------------------------------------------------------------------------------
+// Score following of many performances
+//
+// The score is loaded once before the worker processes are forked.  Each worker
+// follows one MIDI file against its copy-on-write view of the score and writes
+// its match counts to memory which is shared with the parent.  The SVG, MIDI and
+// time line outputs are only made by cmMidiScoreFollowMain(), which loads its own
+// copy of the score and does not return match counts, so they are not available
+// in this mode.
+
+typedef struct
+{
+  unsigned noteN;    // count of performed note-ons
+  unsigned matchN;   // count of note-ons matched to a score event
+  unsigned widenN;   // count of times the beam was widened
+  unsigned scanN;    // count of re-sync scans
+} ctFollowStat_t;
+
+typedef struct
+{
+  cmCtx_t*        ctx;
+  cmScH_t         scH;
+  const cmChar_t* csvScoreFn;
+  const cmChar_t* rptDir;       // report output directory or NULL
+  cmChar_t**      fnV;          // fnV[fnN] performance MIDI files
+  unsigned        fnN;
+  ctFollowStat_t* statV;        // statV[fnN] shared with the workers
+  unsigned        beamN;        // follower beam or 0 for the matcher default
+} ctFollowMulti_t;
+
+bool is_midi_fn( const cmChar_t* fn )
+{
+  const cmChar_t* ext = fn == NULL ? NULL : strrchr(fn,'.');
+  return ext != NULL && (strcasecmp(ext,".mid") == 0 || strcasecmp(ext,".midi") == 0);
+}
+
+// A MIDI file list is named by a '.txt' or '.lst' extension. Any other file is a MIDI file.
+bool is_midi_list_fn( const cmChar_t* fn )
+{
+  const cmChar_t* ext = fn == NULL ? NULL : strrchr(fn,'.');
+  return ext != NULL && (strcasecmp(ext,".txt") == 0 || strcasecmp(ext,".lst") == 0);
+}
+
+// cmRpt_t print function which writes to the FILE* 'arg'.
+void file_print( void* arg, const char* text )
+{
+  fputs(text,(FILE*)arg);
+}
+
+int _follow_fn_compare( const void* p0, const void* p1 )
+{ return strcmp(*(cmChar_t* const*)p0,*(cmChar_t* const*)p1); }
+
+void _follow_free_file_list( cmChar_t** fnV, unsigned fnN )
+{
+  unsigned i;
+
+  for(i=0; i<fnN; ++i)
+    cmMemFree(fnV[i]);
+
+  cmMemFree(fnV);
+}
+
+// Return the MIDI files in the directory 'fn' or listed one per line in the text file 'fn'.
+// Blank lines and lines beginning with '#' are ignored in a list file.
+cmRC_t _follow_file_list( cmCtx_t* ctx, const cmChar_t* fn, cmChar_t*** fnVRef, unsigned* fnNRef )
+{
+  cmChar_t** fnV    = NULL;
+  unsigned   fnN    = 0;
+  unsigned   allocN = 0;
+  unsigned   i;
+
+  if( cmFsIsDir(fn) )
+  {
+    cmFileSysDirEntry_t* dep;
+    unsigned             dirEntryCnt = 0;
+
+    if((dep = cmFsDirEntries( fn, kFileFsFl | kFullPathFsFl, &dirEntryCnt )) == NULL )
+      return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"Unable to iterate the MIDI directory '%s'.",fn);
+
+    fnV = cmMemAllocZ(cmChar_t*,dirEntryCnt+1);
+
+    for(i=0; i<dirEntryCnt; ++i)
+      if( is_midi_fn(dep[i].name) )
+        fnV[ fnN++ ] = cmMemAllocStr(dep[i].name);
+
+    cmFsDirFreeEntries(dep);
+
+    qsort(fnV,fnN,sizeof(fnV[0]),_follow_fn_compare);
+  }
+  else
+  {
+    FILE*  fp;
+    char*  line  = NULL;
+    size_t lineN = 0;
+
+    if((fp = fopen(fn,"r")) == NULL )
+      return cmErrSysMsg(&ctx->err,kScoreFollowFailedCtRC,errno,"The MIDI file list '%s' could not be opened.",fn);
+
+    while( getline(&line,&lineN,fp) != -1 )
+    {
+      unsigned n = strlen(line);
+
+      while( n > 0 && isspace((unsigned char)line[n-1]) )
+        line[--n] = 0;
+
+      if( n == 0 || line[0] == '#' )
+        continue;
+
+      if( fnN == allocN )
+      {
+        allocN = cmMax(2*allocN,64);
+        fnV    = cmMemResize(cmChar_t*,fnV,allocN);
+      }
+
+      fnV[ fnN++ ] = cmMemAllocStr(line);
+    }
+
+    free(line);
+    fclose(fp);
+  }
+
+  if( fnN == 0 )
+  {
+    cmMemFree(fnV);
+    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"No MIDI files were found in '%s'.",fn);
+  }
+
+  *fnVRef = fnV;
+  *fnNRef = fnN;
+  return kOkCtRC;
+}
+
+// Return the length of the file name of 'fn' without its directory and extension in *nRef.
+const cmChar_t* _follow_base_name( const cmChar_t* fn, unsigned* nRef )
+{
+  const cmChar_t* s   = strrchr(fn,'/');
+  const cmChar_t* ext;
+
+  s     = s == NULL ? fn : s + 1;
+  ext   = strrchr(s,'.');
+  *nRef = ext == NULL ? strlen(s) : (unsigned)(ext - s);
+  return s;
+}
+
+int _follow_base_name_compare( const void* p0, const void* p1 )
+{
+  unsigned        n0,n1;
+  const cmChar_t* s0 = _follow_base_name(*(cmChar_t* const*)p0,&n0);
+  const cmChar_t* s1 = _follow_base_name(*(cmChar_t* const*)p1,&n1);
+  int             c  = strncmp(s0,s1,cmMin(n0,n1));
+
+  return c != 0 ? c : (int)n0 - (int)n1;
+}
+
+// The output files are named after the MIDI files. Fail if two MIDI files have the
+// same name without their directory and extension since their outputs would collide.
+cmRC_t _follow_check_base_names( cmCtx_t* ctx, cmChar_t** fnV, unsigned fnN )
+{
+  cmRC_t     rc = kOkCtRC;
+  cmChar_t** v  = cmMemAllocZ(cmChar_t*,fnN);
+  unsigned   i;
+
+  memcpy(v,fnV,fnN*sizeof(v[0]));
+  qsort(v,fnN,sizeof(v[0]),_follow_base_name_compare);
+
+  for(i=1; i<fnN; ++i)
+    if( _follow_base_name_compare(v+i-1,v+i) == 0 )
+    {
+      rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The MIDI files '%s' and '%s' would write the same output files. Rename one of them.",v[i-1],v[i]);
+      break;
+    }
+
+  cmMemFree(v);
+  return rc;
+}
+
+// Return the name of the output file for 'midiFn' in 'dir' or NULL if 'dir' is NULL.
+const cmChar_t* _follow_out_fn( const cmChar_t* dir, const cmChar_t* midiFn, const cmChar_t* ext )
+{
+  cmFileSysPathPart_t* pp;
+  const cmChar_t*      fn;
+
+  if( dir == NULL || (pp = cmFsPathParts(midiFn)) == NULL )
+    return NULL;
+
+  fn = cmFsMakeFn(dir,pp->fnStr,ext,NULL);
+  cmFsFreePathParts(pp);
+  return fn;
+}
+
+// Follow one performance. Called in a worker process.
+cmRC_t _follow_job( void* arg, unsigned idx )
+{
+  ctFollowMulti_t* f         = (ctFollowMulti_t*)arg;
+  cmRC_t           rc        = kOkCtRC;
+  const cmChar_t*  midiFn    = f->fnV[idx];
+  cmMidiFileH_t    mfH       = cmMidiFileNullHandle;
+  cmtFlwH_t        flwH      = cmtFlwNullHandle;
+  const cmChar_t*  rptFn     = _follow_out_fn(f->rptDir,midiFn,"txt");
+  cmtFlwStats_t    fs;
+
+  if( cmMidiFileOpen(f->ctx,&mfH,midiFn) != kOkMfRC )
+  {
+    rc = cmErrMsg(&f->ctx->err,kScoreFollowFailedCtRC,"The MIDI file '%s' could not be opened.",midiFn);
+    goto errLabel;
+  }
+
+  if( cmtFlwCreate(f->ctx,&flwH,f->scH,kFlwSrate,kFlwScWndN,kFlwMidiWndN) != kOkFlwRC || cmtFlwSetBeam(flwH,f->beamN,0) != kOkFlwRC || cmtFlwMidiFile(flwH,mfH) != kOkFlwRC )
+  {
+    rc = cmErrMsg(&f->ctx->err,kScoreFollowFailedCtRC,"Score following failed on '%s'.",midiFn);
+    goto errLabel;
+  }
+
+  cmtFlwStats(flwH,&fs);
+  f->statV[idx].noteN   = fs.noteN;
+  f->statV[idx].matchN  = fs.matchN;
+  f->statV[idx].widenN  = fs.widenN;
+  f->statV[idx].scanN   = fs.scanN;
+
+  if( rptFn != NULL )
+  {
+    FILE*   fp;
+    cmRpt_t rpt;
+
+    if((fp = fopen(rptFn,"w")) == NULL )
+    {
+      rc = cmErrSysMsg(&f->ctx->err,kScoreFollowFailedCtRC,errno,"The match report '%s' could not be created.",rptFn);
+      goto errLabel;
+    }
+
+    cmRptSetup(&rpt,file_print,file_print,fp);
+    cmtFlwReport(flwH,&rpt);
+    fclose(fp);
+  }
+
+ errLabel:
+  cmtFlwDestroy(&flwH);
+  cmMidiFileClose(&mfH);
+
+  if( rptFn != NULL )
+    cmFsFreeFn(rptFn);
+
+  return rc;
+}
+
+// Follow each MIDI file in the directory or list file 'midiInFn' on 'workerN' worker processes.
+// The optional 'rptDir' names the directory which receives the per-file match reports.
+cmRC_t score_follow_multi( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* midiInFn, const cmChar_t* rptDir, unsigned workerN, unsigned beamN )
+{
+  cmRC_t           rc        = kOkCtRC;
+  cmtPpJob_t*      jobV      = NULL;
+  unsigned         okN       = 0;
+  unsigned         noteN     = 0;
+  unsigned         matchN    = 0;
+  unsigned         widenN    = 0;
+  unsigned         scanN     = 0;
+  double           begSecs   = wall_secs();
+  ctFollowMulti_t  f;
+  cmtTrSpan_t      sp;
+  unsigned         i;
+
+  memset(&f,0,sizeof(f));
+  f.ctx         = ctx;
+  f.scH         = cmScNullHandle;
+  f.csvScoreFn  = csvScoreFn;
+  f.rptDir      = rptDir;
+  f.beamN       = beamN;
+
+  if( rptDir != NULL && !cmFsIsDir(rptDir) && cmFsMkDir(rptDir) != kOkFsRC )
+    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The output directory '%s' could not be created.",rptDir);
+
+  if((rc = _follow_file_list(ctx,midiInFn,&f.fnV,&f.fnN)) != kOkCtRC )
+    return rc;
+
+  if( rptDir != NULL && (rc = _follow_check_base_names(ctx,f.fnV,f.fnN)) != kOkCtRC )
+    goto errLabel;
+
+  cmtTrBegin(&sp,kPhaseTrCat,"score_load",csvScoreFn);
+
+  if( cmScoreInitialize(ctx,&f.scH,csvScoreFn,kFlwSrate,NULL,0,NULL,NULL,cmSymTblNullHandle) != kOkScRC )
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The score '%s' could not be loaded.",csvScoreFn);
+
+  cmtTrEnd(&sp);
+
+  if( rc != kOkCtRC )
+    goto errLabel;
+
+  if((f.statV = mmap(NULL,f.fnN*sizeof(ctFollowStat_t),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_ANONYMOUS,-1,0)) == MAP_FAILED )
+  {
+    f.statV = NULL;
+    rc      = cmErrSysMsg(&ctx->err,kScoreFollowFailedCtRC,errno,"The worker result memory could not be allocated.");
+    goto errLabel;
+  }
+
+  memset(f.statV,0,f.fnN*sizeof(ctFollowStat_t));
+
+  jobV = cmMemAllocZ(cmtPpJob_t,f.fnN);
+
+  cmRptPrintf(&ctx->rpt,"Score follow: %i performances on %i workers.\n",f.fnN,workerN==0 ? cmtPpCpuCount() : workerN);
+
+  if( cmtPpRun(ctx,jobV,f.fnN,workerN,_follow_job,NULL,&f) != kOkPpRC )
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The score follow worker pool failed.");
+
+  // print the aggregate report
+  cmRptPrintf(&ctx->rpt,"\n%5s %-10s %6s %6s %6s %7s %6s %6s %10s %s\n","index","status","notes","match","miss","match%","widen","scans","secs","file");
+
+  for(i=0; i<f.fnN; ++i)
+  {
+    const cmtPpJob_t*     j = jobV + i;
+    const ctFollowStat_t* s = f.statV + i;
+    cmChar_t              status[32];
+
+    if( j->sigNo != 0 )
+      snprintf(status,sizeof(status),"signal %i",j->sigNo);
+    else
+      snprintf(status,sizeof(status),"%s",cmtPpStateLabel(j->stateId));
+
+    cmRptPrintf(&ctx->rpt,"%5i %-10s %6i %6i %6i %7.2f %6i %6i %10.3f %s\n",i,status,s->noteN,s->matchN,s->noteN-s->matchN,s->noteN==0 ? 0.0 : 100.0*s->matchN/s->noteN,s->widenN,s->scanN,j->secs,f.fnV[i]);
+
+    if( j->stateId == kDonePpId )
+      ++okN;
+
+    noteN  += s->noteN;
+    matchN += s->matchN;
+    widenN += s->widenN;
+    scanN  += s->scanN;
+  }
+
+  cmRptPrintf(&ctx->rpt,"ok:%i failed:%i notes:%i match:%i miss:%i match%%:%.2f widen:%i scans:%i wall secs:%f\n",okN,f.fnN-okN,noteN,matchN,noteN-matchN,noteN==0 ? 0.0 : 100.0*matchN/noteN,widenN,scanN,wall_secs()-begSecs);
+
+  if( beamN == 0 )
+    cmRptPrintf(&ctx->rpt,"beam:default\n");
+  else
+    cmRptPrintf(&ctx->rpt,"beam:%i max:%i\n",beamN,kFlwBeamWidenN*beamN);
+
+  if( rc == kOkCtRC && okN < f.fnN )
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"Score following failed on %i of %i performances.",f.fnN-okN,f.fnN);
+
+ errLabel:
+  if( f.statV != NULL )
+    munmap(f.statV,f.fnN*sizeof(ctFollowStat_t));
+
+  cmMemFree(jobV);
+  cmScoreFinalize(&f.scH);
+  _follow_free_file_list(f.fnV,f.fnN);
+  return rc;
+}
+
+// Follow one performance with a beam of 'beamN' score locations (0 for the matcher
+// default) and write the note-by-note match table followed by the accuracy and beam
+// cost lines to 'matchRptOutFn' or print them if 'matchRptOutFn' is NULL.
+cmRC_t score_follow_table( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* midiInFn, const cmChar_t* matchRptOutFn, unsigned beamN )
+{
+  cmRC_t        rc   = kOkCtRC;
+  cmScH_t       scH  = cmScNullHandle;
+  cmMidiFileH_t mfH  = cmMidiFileNullHandle;
+  cmtFlwH_t     flwH = cmtFlwNullHandle;
+  FILE*         fp   = NULL;
+  cmRpt_t       rpt;
+
+  if( cmScoreInitialize(ctx,&scH,csvScoreFn,kFlwSrate,NULL,0,NULL,NULL,cmSymTblNullHandle) != kOkScRC )
+    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The score '%s' could not be loaded.",csvScoreFn);
+
+  if( cmMidiFileOpen(ctx,&mfH,midiInFn) != kOkMfRC )
+  {
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The MIDI file '%s' could not be opened.",midiInFn);
+    goto errLabel;
+  }
+
+  if( cmtFlwCreate(ctx,&flwH,scH,kFlwSrate,kFlwScWndN,kFlwMidiWndN) != kOkFlwRC || cmtFlwSetBeam(flwH,beamN,0) != kOkFlwRC || cmtFlwMidiFile(flwH,mfH) != kOkFlwRC )
+  {
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"Score following failed on '%s'.",midiInFn);
+    goto errLabel;
+  }
+
+  if( matchRptOutFn == NULL )
+    rpt = ctx->rpt;
+  else if((fp = fopen(matchRptOutFn,"w")) == NULL )
+  {
+    rc = cmErrSysMsg(&ctx->err,kScoreFollowFailedCtRC,errno,"The match report '%s' could not be created.",matchRptOutFn);
+    goto errLabel;
+  }
+  else
+    cmRptSetup(&rpt,file_print,file_print,fp);
+
+  cmtFlwReport(flwH,&rpt);
+
+ errLabel:
+  if( fp != NULL )
+    fclose(fp);
+
+  cmtFlwDestroy(&flwH);
+  cmMidiFileClose(&mfH);
+  cmScoreFinalize(&scH);
+  return rc;
+}
+
+// If 'midiInFn' is a directory or a list of MIDI files (a file with a '.txt' or
+// '.lst' extension) the performances are followed by score_follow_multi().
+// If 'beamN' is non-zero the performance is followed only by score_follow_table().
+// The SVG, MIDI and time line outputs are made by the matcher, which has no beam,
+// and are therefore not made with a beam.
+cmRC_t score_follow( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* midiInFn, const cmChar_t* matchRptOutFn, const cmChar_t* matchSvgOutFn,  const cmChar_t* midiOutFn, const cmChar_t* timelineFn, unsigned workerN, unsigned beamN )
+{
+  cmRC_t rc;
+  
+  if((rc = verify_file_exists(ctx,csvScoreFn,"Score CSV file")) != kOkCtRC )
+    return rc;
+
+  if( midiInFn != NULL && (cmFsIsDir(midiInFn) || (cmFsIsFile(midiInFn) && is_midi_list_fn(midiInFn))) )
+  {
+    if( matchSvgOutFn != NULL || midiOutFn != NULL || timelineFn != NULL )
+      return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The SVG (-s), MIDI (-m) and time line (-t) outputs are only made for a single performance. Only -r may be given with a MIDI directory or list file.");
+
+    return score_follow_multi(ctx, csvScoreFn, midiInFn, matchRptOutFn, workerN, beamN );
+  }
+
+  if((rc = verify_file_exists(ctx,midiInFn,"MIDI input file")) != kOkCtRC )
+    return rc;
+
+  if( beamN != 0 )
+  {
+    if( matchSvgOutFn != NULL || midiOutFn != NULL || timelineFn != NULL )
+      return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The beam (-K) cannot be combined with the SVG (-s), MIDI (-m) or time line (-t) outputs of a single performance.");
+
+    return score_follow_table(ctx, csvScoreFn, midiInFn, matchRptOutFn, beamN);
+  }
+
+  //if((rc = verify_file_exists(ctx,matchRptOutFn,"Match report file")) != kOkCtRC )
+  //  return rc;
+
+  //if((rc = verify_file_exists(ctx,matchSvgOutFn,"Match HTML/SVG file")) != kOkCtRC )
+  //  return rc;
+  
+  if(cmMidiScoreFollowMain(ctx, csvScoreFn, midiInFn, matchRptOutFn, matchSvgOutFn, midiOutFn, timelineFn) != kOkMsfRC )
+    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"score_follow failed.");
+    
+  return rc;         
+}
+
+//----------------------------------------------------------------------------------------------------
+// Live score following
+//
+// MIDI events are read one per line from a stream:
+//
+//   [<secs>] <status> <d0> <d1>
+//
+// <secs> is the time of the event. If it is omitted the time the line was read is used.
+// <status> is a decimal or 0x prefixed hexadecimal MIDI status byte - the channel is ignored.
+// Blank lines and lines beginning with '#' are ignored.
+//
+// Each note-on which the follower locates in the score is printed as it is found:
+//
+//   loc <locIdx> evt <scEvtIdx> muid <muid> pitch <d0> secs <secs> usecs <latency>
+//
+// On the end of the stream (or SIGINT) a histogram of the time the follower took
+// to process each note-on is printed.
+
+volatile sig_atomic_t _live_stop_fl = 0;
+
+void _live_on_signal( int signo )
+{ _live_stop_fl = 1; }
+
+int _live_dbl_compare( const void* p0, const void* p1 )
+{
+  double v0 = *(const double*)p0;
+  double v1 = *(const double*)p1;
+  return v0 < v1 ? -1 : (v0 > v1 ? 1 : 0);
+}
+
+// Print a histogram of the note processing latencies latV[latN] in microseconds.
+void _live_latency_report( cmRpt_t* rpt, double* latV, unsigned latN )
+{
+  const double edgeV[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+  unsigned     edgeN   = sizeof(edgeV)/sizeof(edgeV[0]);
+  unsigned     cntV[ edgeN+1 ];
+  unsigned     cumN    = 0;
+  double       sum     = 0;
+  unsigned     i,j;
+
+  if( latN == 0 )
+  {
+    cmRptPrintf(rpt,"No note-on events were followed.\n");
+    return;
+  }
+
+  memset(cntV,0,sizeof(cntV));
+
+  for(i=0; i<latN; ++i)
+  {
+    for(j=0; j<edgeN; ++j)
+      if( latV[i] < edgeV[j] )
+        break;
+
+    ++cntV[j];
+    sum += latV[i];
+  }
+
+  cmRptPrintf(rpt,"\nlatency usecs   count      pct   cum pct\n");
+
+  for(j=0; j<=edgeN; ++j)
+  {
+    cmChar_t label[32];
+
+    cumN += cntV[j];
+
+    if( j == edgeN )
+      snprintf(label,sizeof(label),">= %g",edgeV[j-1]);
+    else
+      snprintf(label,sizeof(label),"%g - %g",j==0 ? 0 : edgeV[j-1],edgeV[j]);
+
+    cmRptPrintf(rpt,"%-13s %7i %8.2f %9.2f\n",label,cntV[j],100.0*cntV[j]/latN,100.0*cumN/latN);
+  }
+
+  qsort(latV,latN,sizeof(latV[0]),_live_dbl_compare);
+
+  cmRptPrintf(rpt,"notes:%i usecs min:%.1f mean:%.1f p50:%.1f p99:%.1f max:%.1f\n",latN,latV[0],sum/latN,latV[latN/2],latV[ (unsigned)(0.99*(latN-1)) ],latV[latN-1]);
+}
+
+// Follow the MIDI event stream read from 'streamFn' (stdin if 'streamFn' is NULL or "-").
+cmRC_t score_follow_live( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* streamFn, const cmChar_t* rptFn, unsigned beamN )
+{
+  cmRC_t           rc      = kOkCtRC;
+  cmScH_t          scH     = cmScNullHandle;
+  cmtFlwH_t        flwH    = cmtFlwNullHandle;
+  FILE*            ifp     = stdin;
+  char*            line    = NULL;
+  size_t           lineN   = 0;
+  unsigned         muid    = 0;
+  unsigned         lineIdx = 0;
+  unsigned         locN    = 0;
+  double*          latV    = NULL;
+  unsigned         latN    = 0;
+  unsigned         latAllocN = 0;
+  double           begSecs = wall_secs();
+  struct sigaction sa;
+
+  if((rc = verify_file_exists(ctx,csvScoreFn,"Score CSV file")) != kOkCtRC )
+    return rc;
+
+  if( cmScoreInitialize(ctx,&scH,csvScoreFn,kFlwSrate,NULL,0,NULL,NULL,cmSymTblNullHandle) != kOkScRC )
+    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The score '%s' could not be loaded.",csvScoreFn);
+
+  if( cmtFlwCreate(ctx,&flwH,scH,kFlwSrate,kFlwScWndN,kFlwMidiWndN) != kOkFlwRC || cmtFlwSetBeam(flwH,beamN,0) != kOkFlwRC )
+  {
+    rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"The score follower could not be created.");
+    goto errLabel;
+  }
+
+  // a named pipe blocks here until a writer opens it
+  if( streamFn != NULL && strcmp(streamFn,"-") != 0 && (ifp = fopen(streamFn,"r")) == NULL )
+  {
+    rc = cmErrSysMsg(&ctx->err,kScoreFollowFailedCtRC,errno,"The MIDI event stream '%s' could not be opened.",streamFn);
+    goto errLabel;
+  }
+
+  // SA_RESTART is not set so that SIGINT ends a blocked read and the report is still printed
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler = _live_on_signal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT,&sa,NULL);
+
+  cmRptPrintf(&ctx->rpt,"Following '%s'.\n",streamFn==NULL ? "<stdin>" : streamFn);
+  fflush(stdout);
+
+  while( !_live_stop_fl && getline(&line,&lineN,ifp) != -1 )
+  {
+    double          fieldV[4];
+    unsigned        fieldN = 0;
+    const cmChar_t* s      = line;
+    cmChar_t*       ep;
+    double          secs;
+    unsigned        status;
+    unsigned        locIdx;
+    struct timespec t0,t1;
+
+    ++lineIdx;
+
+    while( isspace((unsigned char)*s) )
+      ++s;
+
+    if( *s == 0 || *s == '#' )
+      continue;
+
+    // strtod() also reads 0x prefixed status bytes
+    for(; fieldN<4; ++fieldN)
+    {
+      fieldV[fieldN] = strtod(s,&ep);
+
+      if( ep == s )
+        break;
+
+      s = ep;
+    }
+
+    if( fieldN < 3 )
+    {
+      cmErrWarnMsg(&ctx->err,kScoreFollowFailedCtRC,"Line %i of the MIDI event stream is not a MIDI event.",lineIdx);
+      continue;
+    }
+
+    secs   = fieldN == 4 ? fieldV[0] : wall_secs() - begSecs;
+    status = (unsigned)fieldV[fieldN-3] & 0xf0;
+
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    if( cmtFlwExec(flwH,(unsigned)(secs*kFlwSrate),muid,status,(cmMidiByte_t)fieldV[fieldN-2],(cmMidiByte_t)fieldV[fieldN-1],&locIdx) != kOkFlwRC )
+    {
+      rc = cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"Score following failed on line %i of the MIDI event stream.",lineIdx);
+      break;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+
+    if( status == kNoteOnMdId && fieldV[fieldN-1] > 0 )
+    {
+      double usecs = (t1.tv_sec - t0.tv_sec) * 1000000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000.0;
+
+      if( latN == latAllocN )
+      {
+        latAllocN = cmMax(2*latAllocN,1024);
+        latV      = cmMemResize(double,latV,latAllocN);
+      }
+
+      latV[ latN++ ] = usecs;
+
+      if( locIdx != cmInvalidIdx )
+      {
+        unsigned              resultN = 0;
+        const cmtFlwResult_t* r       = cmtFlwResults(flwH,&resultN) + resultN - 1;
+
+        cmRptPrintf(&ctx->rpt,"loc %i evt %i muid %i pitch %i secs %f usecs %.1f\n",locIdx,r->scEvtIdx,muid,(unsigned)fieldV[fieldN-2],secs,usecs);
+        fflush(stdout);
+        ++locN;
+      }
+    }
+
+    ++muid;
+  }
+
+  _live_latency_report(&ctx->rpt,latV,latN);
+  cmRptPrintf(&ctx->rpt,"events:%i located:%i matched:%i\n",muid,locN,cmtFlwMatchCount(flwH));
+
+  if( rptFn != NULL )
+  {
+    FILE*   fp;
+    cmRpt_t rpt;
+
+    if((fp = fopen(rptFn,"w")) == NULL )
+      rc = cmErrSysMsg(&ctx->err,kScoreFollowFailedCtRC,errno,"The match report '%s' could not be created.",rptFn);
+    else
+    {
+      cmRptSetup(&rpt,file_print,file_print,fp);
+      cmtFlwReport(flwH,&rpt);
+      fclose(fp);
+    }
+  }
+
+ errLabel:
+  if( ifp != NULL && ifp != stdin )
+    fclose(ifp);
+
+  free(line);
+  cmMemFree(latV);
+  cmtFlwDestroy(&flwH);
+  cmScoreFinalize(&scH);
+  return rc;
+}
+
+// The time line markers are measured on 'workerN' worker processes (0 = one per CPU).
+// If 'cacheDir' is given only the markers whose inputs changed since the last run are measured.
+cmRC_t meas_gen( cmCtx_t* ctx, const cmChar_t* pgmRsrcFn, const cmChar_t* outFn, unsigned workerN, const cmChar_t* cacheDir )
+{
+  cmRC_t rc;
+  
+  if((rc = verify_file_exists(ctx,pgmRsrcFn,"Program resource file")) != kOkCtRC )
+    return rc;
+
+  if((rc = verify_non_null_filename( ctx,outFn,"Measurements output file.")) != kOkCtRC )
+    return rc;
+  
+  if( workerN != 1 || cacheDir != NULL )
+  {
+    if( cmtMgMeasGen(ctx, pgmRsrcFn, outFn, workerN, cacheDir ) != kOkMgRC )
+      return cmErrMsg(&ctx->err,kMeasGenFailedCtRC,"meas_gen failed.");
+
+    return kOkCtRC;
+  }
+
+  return cmScoreProc(ctx, "meas", pgmRsrcFn, outFn );
+}
+
+cmRC_t score_report( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* rptFn )
+{
+  cmRC_t rc;
+  
+  if((rc = verify_file_exists(ctx,csvScoreFn,"Score CSV file")) != kOkCtRC )
+    return rc;
+
+  cmScoreReport(ctx,csvScoreFn,rptFn);
+  
+  return rc;
+}
+
+
+cmRC_t midi_file_report( cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* rptFn, const cmChar_t* svgFn, bool standAloneFl, bool panZoomFl )
+{
+  cmRC_t rc ;
+
+  if((rc = verify_file_exists(ctx,midiFn,"MIDI file")) != kOkCtRC )
+    return rc;
+  
+  if((rc = cmMidiFileReport(ctx, midiFn, rptFn )) != kOkMfRC )
+    return cmErrMsg(&ctx->err,kMidiFileRptFailedCtRC,"MIDI file report generation failed.");  
+
+  if( svgFn != NULL )
+    if((rc = cmMidiFileGenSvgFile(ctx, midiFn, svgFn, "midi_file_svg.css", standAloneFl, panZoomFl )) != kOkMfRC )
+      return cmErrMsg(&ctx->err,kMidiFileRptFailedCtRC,"MIDI file SVG output generation failed.");
+  
+  return kOkCtRC;
+}
+
+cmRC_t timeline_report( cmCtx_t* ctx, const cmChar_t* timelineFn, const cmChar_t* tlPrefixPath, const cmChar_t* rptFn, double begSecs, double endSecs )
+{
+  cmRC_t rc ;
+
+  if((rc = verify_file_exists(ctx,timelineFn,"Timeline file")) != kOkCtRC )
+    return rc;
+
+  // range and point queries are answered from the time line index
+  if( begSecs >= 0 )
+  {
+    if( cmtTlIdxReport( ctx, timelineFn, tlPrefixPath, begSecs, endSecs, rptFn ) != kOkTlIdxRC )
+      return cmErrMsg(&ctx->err,kTimeLineRptFailedCtRC,"The timeline range report failed.");
+    return kOkCtRC;
+  }
+
+  // binary time line files are reported directly from the memory mapped file
+  if( cmtTlbIsBinFn(timelineFn) )
+  {
+    if( cmtTlbReport( ctx, timelineFn, rptFn ) != kOkTlbRC )
+      return cmErrMsg(&ctx->err,kTimeLineRptFailedCtRC,"The binary timeline file report failed.");
+    return kOkCtRC;
+  }
+
+  if((rc = cmTimeLineReport( ctx, timelineFn, tlPrefixPath, rptFn  )) != kOkTlRC )
+    return cmErrMsg(&ctx->err,kTimeLineRptFailedCtRC,"The timeline file report failed.");
+
+  return rc;
+}
+
+cmRC_t audio_file_report( cmCtx_t* ctx, const cmChar_t* audioFn, const cmChar_t* rptFn )
+{
+  cmRC_t rc;
+
+  if((rc = verify_file_exists(ctx,audioFn,"Audio file")) != kOkCtRC )
+    return rc;
+
+  if((rc = cmAudioFileReportInfo( ctx, audioFn, rptFn  )) != kOkTlRC )
+    return cmErrMsg(&ctx->err,kAudioFileRptFailedCtRC,"The audio file report failed.");
+
+  return rc;
+}
+
+
+// Return the primary input file of an action.
+const cmChar_t* action_input_fn( const ctArgs_t* a )
+{
+  const cmChar_t* fnArray[] = { NULL, a->xmlFn, a->xmlFn, a->midiInFn, a->pgmRsrcFn, a->csvScoreFn, a->midiInFn, a->timelineFn, a->audioFn, a->midiInFn, a->midiInFn };
+  return a->actionSelId < kSelIdCnt ? fnArray[ a->actionSelId ] : NULL;
+}
+
+cmRC_t run_action( cmCtx_t* ctx, const ctArgs_t* a )
+{
+  cmRC_t      rc = kOkCtRC;
+  cmtTrSpan_t sp;
+
+  cmtTrBegin(&sp,kActionTrCat,actionLabelArray[ a->actionSelId < kSelIdCnt ? a->actionSelId : kNoSelId ],action_input_fn(a));
+
+  switch( a->actionSelId )
+  {
+    case kScoreGenSelId:
+      rc = score_gen( ctx, a->xmlFn, a->editFn, a->csvScoreFn, a->midiOutFn, a->svgOutFn, a->reportFl, a->begMeasNumb, a->endMeasNumb, a->begTempoBPM, a->svgStandAloneFl, a->svgPanZoomFl, a->damperRptFl );
+      break;
+
+    case kScoreEditMergeSelId:
+      rc = score_edit_merge( ctx, a->xmlFn, a->editFn, a->begMeasNumb, a->keyEditFn, a->keyMeasNumb, a->outEditFn );
+      break;
+
+    case kScoreFollowSelId:
+      rc = score_follow( ctx, a->csvScoreFn, a->midiInFn, a->rptFn, a->svgOutFn,  a->midiOutFn, a->timelineFn, a->workerCnt, a->beamN );
+      break;
+
+    case kMeasGenSelId:
+      rc = meas_gen(ctx, a->pgmRsrcFn, a->rptFn, a->workerCnt, a->cacheDir);
+      break;
+
+    case kScoreReportSelId:
+      rc = score_report(ctx, a->csvScoreFn, a->rptFn );
+      break;
+
+    case kMidiReportSelId:
+      rc = midi_file_report(ctx, a->midiInFn, a->rptFn, a->svgOutFn, a->svgStandAloneFl, a->svgPanZoomFl );
+      break;
+
+    case kTimelineReportSelId:
+      rc = timeline_report(ctx, a->timelineFn, a->timelinePrefix, a->rptFn, a->tlBegSecs, a->tlEndSecs );
+      break;
+
+    case kAudioReportSelId:
+      rc = audio_file_report(ctx, a->audioFn, a->rptFn );
+      break;
+
+    case kScoreFollowLiveSelId:
+      rc = score_follow_live(ctx, a->csvScoreFn, a->midiInFn, a->rptFn, a->beamN );
+      break;
+
+    case kScoreFollowTableSelId:
+      if((rc = verify_file_exists(ctx,a->csvScoreFn,"Score CSV file")) == kOkCtRC && (rc = verify_file_exists(ctx,a->midiInFn,"MIDI input file")) == kOkCtRC )
+        rc = score_follow_table(ctx, a->csvScoreFn, a->midiInFn, a->rptFn, a->beamN );
+      break;
+
+    default:
+      rc = cmErrMsg(&ctx->err, kNoActionIdSelectedCtRC,"No action selector was selected.");
+  }
+
+  cmtTrEnd(&sp);
+  return rc;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batch manifest processing
+//
+// Each entry is run by run_action() in a forked worker process (See cmtProcPool.h).
+// The process initialization is therefore paid once for the whole batch.
+
+typedef struct
+{
+  ctArgs_t        args;
+  const cmChar_t* logFn;    // optional file to receive the entry's stdout and stderr
+  unsigned*       afterV;   // afterV[afterN] indexes of the entries which must succeed before this entry is run
+  unsigned        afterN;
+} ctBatchEntry_t;
+
+typedef struct
+{
+  cmCtx_t*        ctx;
+  ctBatchEntry_t* entryV;   // entryV[entryN]
+  unsigned        entryN;
+} ctBatch_t;
+
+// Parse a batch manifest entry or a service request into 'e'.
+// 'srcLabel' names the manifest file or the socket in error messages.
+cmRC_t parse_action_entry( cmCtx_t* ctx, const cmChar_t* srcLabel, const cmJsonNode_t* np, unsigned idx, ctBatchEntry_t* e )
+{
+  const cmChar_t* errLabelPtr     = NULL;
+  const cmChar_t* actionLabel     = NULL;
+  cmJsonNode_t*   afterNp         = NULL;
+  ctArgs_t*       a               = &e->args;
+  bool            reportFl        = a->reportFl;
+  bool            svgStandAloneFl = a->svgStandAloneFl;
+  bool            svgPanZoomFl    = a->svgPanZoomFl;
+  bool            damperRptFl     = a->damperRptFl;
+  int             begMidiUId      = a->begMidiUId;
+  int             endMidiUId      = a->endMidiUId;
+  int             workerCnt       = a->workerCnt;
+  int             beamN           = a->beamN;
+  unsigned        i;
+
+  if( cmJsonMemberValues( np, &errLabelPtr,
+      "action",             kStringTId,                 &actionLabel,
+      "music_xml_fn",       kStringTId | kOptArgJsFl,   &a->xmlFn,
+      "edit_fn",            kStringTId | kOptArgJsFl,   &a->editFn,
+      "key_edit_fn",        kStringTId | kOptArgJsFl,   &a->keyEditFn,
+      "out_edit_fn",        kStringTId | kOptArgJsFl,   &a->outEditFn,
+      "pgm_rsrc_fn",        kStringTId | kOptArgJsFl,   &a->pgmRsrcFn,
+      "score_csv_fn",       kStringTId | kOptArgJsFl,   &a->csvScoreFn,
+      "midi_out_fn",        kStringTId | kOptArgJsFl,   &a->midiOutFn,
+      "midi_in_fn",         kStringTId | kOptArgJsFl,   &a->midiInFn,
+      "audio_fn",           kStringTId | kOptArgJsFl,   &a->audioFn,
+      "svg_fn",             kStringTId | kOptArgJsFl,   &a->svgOutFn,
+      "timeline_fn",        kStringTId | kOptArgJsFl,   &a->timelineFn,
+      "tl_prefix",          kStringTId | kOptArgJsFl,   &a->timelinePrefix,
+      "report_fn",          kStringTId | kOptArgJsFl,   &a->rptFn,
+      "debug_fl",           kBoolTId   | kOptArgJsFl,   &reportFl,
+      "svg_stand_alone_fl", kBoolTId   | kOptArgJsFl,   &svgStandAloneFl,
+      "svg_pan_zoom_fl",    kBoolTId   | kOptArgJsFl,   &svgPanZoomFl,
+      "damper",             kBoolTId   | kOptArgJsFl,   &damperRptFl,
+      "beg_meas",           kIntTId    | kOptArgJsFl,   &a->begMeasNumb,
+      "end_meas",           kIntTId    | kOptArgJsFl,   &a->endMeasNumb,
+      "key_meas",           kIntTId    | kOptArgJsFl,   &a->keyMeasNumb,
+      "beg_bpm",            kIntTId    | kOptArgJsFl,   &a->begTempoBPM,
+      "beg_midi_uid",       kIntTId    | kOptArgJsFl,   &begMidiUId,
+      "end_midi_uid",       kIntTId    | kOptArgJsFl,   &endMidiUId,
+      "tl_beg_secs",        kRealTId   | kOptArgJsFl,   &a->tlBegSecs,
+      "tl_end_secs",        kRealTId   | kOptArgJsFl,   &a->tlEndSecs,
+      "cache_dir",          kStringTId | kOptArgJsFl,   &a->cacheDir,
+      "workers",            kIntTId    | kOptArgJsFl,   &workerCnt,
+      "beam",               kIntTId    | kOptArgJsFl,   &beamN,
+      "log_fn",             kStringTId | kOptArgJsFl,   &e->logFn,
+      "after",              kArrayTId  | kOptArgJsFl,   &afterNp,
+      NULL ) != kOkJsRC )
+  {
+    return cmErrMsg(&ctx->err,kBatchFailedCtRC,"The action entry at index %i is missing or has an invalid '%s' field in '%s'.",idx,cmStringNullGuard(errLabelPtr),srcLabel);
+  }
+
+  // these are stored in unsigned fields
+  if( workerCnt < 0 || beamN < 0 )
+    return cmErrMsg(&ctx->err,kBatchFailedCtRC,"The action entry at index %i has a negative '%s' field in '%s'.",idx,workerCnt < 0 ? "workers" : "beam",srcLabel);
+
+  a->reportFl        = reportFl;
+  a->svgStandAloneFl = svgStandAloneFl;
+  a->svgPanZoomFl    = svgPanZoomFl;
+  a->damperRptFl     = damperRptFl;
+  a->begMidiUId      = begMidiUId;
+  a->endMidiUId      = endMidiUId;
+  a->workerCnt       = workerCnt;
+  a->beamN           = beamN;
+
+  // locate the action selector
+  for(a->actionSelId=kNoSelId+1; a->actionSelId<kSelIdCnt; ++a->actionSelId)
+    if( strcmp(actionLabel,actionLabelArray[a->actionSelId]) == 0 )
+      break;
+
+  if( a->actionSelId == kSelIdCnt )
+    return cmErrMsg(&ctx->err,kBatchFailedCtRC,"The action entry at index %i has the unknown action '%s' in '%s'.",idx,actionLabel,srcLabel);
+
+  // read the dependencies - an entry may only depend on earlier entries
+  if( afterNp != NULL && (e->afterN = cmJsonChildCount(afterNp)) > 0 )
+  {
+    e->afterV = cmMemAllocZ(unsigned,e->afterN);
+
+    for(i=0; i<e->afterN; ++i)
+      if( cmJsonUIntValue(cmJsonArrayElementC(afterNp,i),e->afterV+i) != kOkJsRC || e->afterV[i] >= idx )
+        return cmErrMsg(&ctx->err,kBatchFailedCtRC,"The 'after' array of the action entry at index %i must contain the indexes of earlier entries in '%s'.",idx,srcLabel);
+  }
+
+  return kOkCtRC;
+}
+
+// Run a batch entry. Called in the worker process.
+cmRC_t _batch_job( void* arg, unsigned idx )
+{
+  ctBatch_t*            b = (ctBatch_t*)arg;
+  const ctBatchEntry_t* e = b->entryV + idx;
+
+  if( e->logFn != NULL )
+  {
+    int fd;
+
+    if((fd = open(e->logFn,O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1 )
+      return cmErrSysMsg(&b->ctx->err,kBatchFailedCtRC,errno,"The batch log file '%s' could not be created.",e->logFn);
+
+    dup2(fd,STDOUT_FILENO);
+    dup2(fd,STDERR_FILENO);
+    close(fd);
+  }
+
+  return run_action(b->ctx,&e->args);
+}
+
+unsigned _batch_dep( void* arg, unsigned idx, const cmtPpJob_t* jobV )
+{
+  const ctBatchEntry_t* e      = ((ctBatch_t*)arg)->entryV + idx;
+  bool                  waitFl = false;
+  unsigned              i;
+
+  for(i=0; i<e->afterN; ++i)
+    switch( jobV[ e->afterV[i] ].stateId )
+    {
+      case kDonePpId:
+        break;
+
+      case kFailPpId:
+      case kSkipPpId:
+        return kSkipPpId;
+
+      default:
+        waitFl = true;
+    }
+
+  return waitFl ? kPendingPpId : kRunningPpId;
+}
+
+// Run the actions listed in a JSON manifest file.
+//
+// {
+//   "batch": {
+//     "workers": 4,                  // optional - count of worker processes
+//     "actions": [
+//       { "action":"score_gen", "music_xml_fn":"score.xml", "edit_fn":"edit.txt", "score_csv_fn":"score.csv" },
+//       { "action":"score_report", "score_csv_fn":"score.csv", "report_fn":"score_rpt.txt", "after":[0] }
+//     ]
+//   }
+// }
+//
+// Fields which are not given take their value from the command line.
+cmRC_t batch( cmCtx_t* ctx, const ctArgs_t* dfltArgs, const cmChar_t* manifestFn, unsigned workerN )
+{
+  cmRC_t          rc          = kOkCtRC;
+  cmJsonH_t       jsH         = cmJsonNullHandle;
+  cmJsonNode_t*   bnp         = NULL;
+  cmJsonNode_t*   anp         = NULL;
+  const cmChar_t* errLabelPtr = NULL;
+  cmtPpJob_t*     jobV        = NULL;
+  int             jsWorkerN   = 0;
+  unsigned        okN         = 0;
+  unsigned        failN       = 0;
+  unsigned        skipN       = 0;
+  double          totalSecs   = 0;
+  ctBatch_t       b;
+  unsigned        i;
+
+  memset(&b,0,sizeof(b));
+  b.ctx = ctx;
+
+  if((rc = verify_file_exists(ctx,manifestFn,"Batch manifest file")) != kOkCtRC )
+    return rc;
+
+  if( cmJsonInitializeFromFile(&jsH, manifestFn, ctx ) != kOkJsRC )
+  {
+    rc = cmErrMsg(&ctx->err,kBatchFailedCtRC,"The batch manifest '%s' could not be parsed.",manifestFn);
+    goto errLabel;
+  }
+
+  if((bnp = cmJsonFindValue(jsH,"batch",cmJsonRoot(jsH),kObjectTId)) == NULL )
+  {
+    rc = cmErrMsg(&ctx->err,kBatchFailedCtRC,"The batch manifest '%s' does not have a 'batch' object.",manifestFn);
+    goto errLabel;
+  }
+
+  if( cmJsonMemberValues( bnp, &errLabelPtr,
+      "actions", kArrayTId,               &anp,
+      "workers", kIntTId | kOptArgJsFl,   &jsWorkerN,
+      NULL ) != kOkJsRC )
+  {
+    rc = cmErrMsg(&ctx->err,kBatchFailedCtRC,"The 'batch' object is missing or has an invalid '%s' field in '%s'.",cmStringNullGuard(errLabelPtr),manifestFn);
+    goto errLabel;
+  }
+
+  // the command line worker count overrides the manifest
+  if( workerN == 0 && jsWorkerN > 0 )
+    workerN = jsWorkerN;
+
+  if((b.entryN = cmJsonChildCount(anp)) == 0 )
+    goto errLabel;
+
+  b.entryV = cmMemAllocZ(ctBatchEntry_t,b.entryN);
+  jobV     = cmMemAllocZ(cmtPpJob_t,b.entryN);
+
+  for(i=0; i<b.entryN; ++i)
+  {
+    b.entryV[i].args = *dfltArgs;
+
+    if((rc = parse_action_entry(ctx,manifestFn,cmJsonArrayElementC(anp,i),i,b.entryV+i)) != kOkCtRC )
+      goto errLabel;
+  }
+
+  cmRptPrintf(&ctx->rpt,"Batch: %i actions on %i workers.\n",b.entryN,workerN==0 ? cmtPpCpuCount() : workerN);
+
+  if((rc = cmtPpRun(ctx,jobV,b.entryN,workerN,_batch_job,_batch_dep,&b)) != kOkPpRC )
+    rc = cmErrMsg(&ctx->err,kBatchFailedCtRC,"The batch worker pool failed.");
+
+  // print the summary report
+  cmRptPrintf(&ctx->rpt,"\n%5s %-16s %-10s %5s %10s %s\n","index","action","status","rc","secs","input");
+
+  for(i=0; i<b.entryN; ++i)
+  {
+    const cmtPpJob_t* j = jobV + i;
+    cmChar_t          status[32];
+
+    if( j->sigNo != 0 )
+      snprintf(status,sizeof(status),"signal %i",j->sigNo);
+    else
+      snprintf(status,sizeof(status),"%s",cmtPpStateLabel(j->stateId));
+
+    cmRptPrintf(&ctx->rpt,"%5i %-16s %-10s %5i %10.3f %s\n",i,actionLabelArray[b.entryV[i].args.actionSelId],status,j->sigNo!=0 ? -1 : (int)j->rc,j->secs,cmStringNullGuard(action_input_fn(&b.entryV[i].args)));
+
+    switch( j->stateId )
+    {
+      case kDonePpId: ++okN;   break;
+      case kFailPpId: ++failN; break;
+      default:        ++skipN; break;
+    }
+
+    totalSecs += j->secs;
+  }
+
+  cmRptPrintf(&ctx->rpt,"ok:%i failed:%i skipped:%i total:%i action secs:%f\n",okN,failN,skipN,b.entryN,totalSecs);
+
+  if( rc == kOkCtRC && (failN > 0 || skipN > 0) )
+    rc = cmErrMsg(&ctx->err,kBatchFailedCtRC,"%i of %i batch actions failed and %i were skipped.",failN,b.entryN,skipN);
+
+ errLabel:
+  if( b.entryV != NULL )
+    for(i=0; i<b.entryN; ++i)
+      cmMemFree(b.entryV[i].afterV);
+
+  cmMemFree(b.entryV);
+  cmMemFree(jobV);
+  cmJsonFinalize(&jsH);
+  return rc;
+}
 
-const cmChar_t poEndHelpStr[] = "";
-const cmChar_t poBegHelpStr[] =
-  "xscore_proc Music XML to electronic score generator\n"
-  "\n"
-  "USAGE:\n"
-  "\n"
-  "Parse an XML score file and 'edit' file to produce a score file in CSV format.\n"
-  "\n"
-  "cmtool --score_gen -x <xml_file> -d <edit_fn> {-c <csvScoreOutFn} {-m <midiOutFn>} {-s <svgOutFn>} {-r report} {-b begMeasNumb} {t begTempoBPM}\n"
-  "\n"
-  "Notes:\n"
-  "1.  If <edit_fn> does not exist then a edit template file will be generated based on the MusicXML file. \n"
-  "2.  Along with the CSV score file MIDI and HTML/SVG files will also be produced based on the contents of the MusicXML and edit file.\n"
-  "3. See README.md for a detailed description of the how to edit the edit file.\n"
-  "\n"
-  "\n"
-  "Use the score follower to generate a timeline configuration file.\n"
-  "\n"
-  "cmtool --timeline_gen -c <csvScoreFn> -i <midiInFn> -r <matchRptFn> -s <matchSvgFn> {-m <midiOutFn>} {-t timelineOutFn} \n"
-  "\n"
-  "Measure some perforamance attributes:\n"
-  "\n"
-  "cmtool --meas_gen -g <pgmRsrcFn> -r <measRptFn>\n"
-  "\n"
-  "Generate a score file report\n"
-  "\n"
-  "cmtool --score_report -c <csvScoreFn> -r <scoreRptFn>\n"
-  "\n"
-  "Generate a MIDI file report and optional SVG piano roll image\n"
-  "\n"
-  "cmtool --midi_report -i <midiInFn> -r <midiRptFn> {-s <svgOutFn>}\n"
-  "\n"
-  "Generate a timeline report\n"
-  "\n"
-  "cmtool --timeline_report -t <timelineFn> -r <timelineRptFn>\n"
-  "\n"
-  "Generate an audio file report\n"
-  "\n"
-  "cmtool --audiofile_report -a <audioFn> -r <rptFn>\n"
-  "\n";
+//----------------------------------------------------------------------------------------------------
+// Service mode
+//
+// Each connection to the service socket carries one request: a JSON object with
+// the fields of a batch manifest entry followed by a newline or the end of the
+// connection.  The response is one line:
+//
+// { "rc":0, "secs":0.004, "cached":true, "output":"..." }
+//
+// where 'output' is the text the action printed and 'cached' is true if every
+// file the action used was already loaded.  The score, MIDI and time line files
+// used by score_report, score_follow_table, midi_report and timeline_report requests
+// are kept in a cmtCache between requests.  All other requests, score_follow included,
+// are run by run_action() and print what they print from the command line.
+//
+// { "action":"stats" } returns the cache contents and { "action":"shutdown" } stops the service.
+//
+// Trust model: a request runs with the privileges of the service and may read and
+// write any file the service user can.  The socket is therefore created with mode
+// 0600 so that only the service user (and root) can connect.  The service must not
+// be run on a socket in a directory which other users can replace files in.
 
+enum
+{
+  kServeCacheEntryN = 16,         // count of parsed files kept loaded
+  kServeMaxRequestByteCnt = 65536,
+  kServeIoTimeoutSecs = 5         // a client which does not send or receive for this long is dropped
+};
 
-void print( void* arg, const char* text )
+typedef struct
 {
-  printf("%s",text);
-}
+  cmChar_t* buf;     // buf[allocN] zero terminated
+  unsigned  n;
+  unsigned  allocN;
+} ctText_t;
 
-bool verify_file_exists( cmCtx_t* ctx, const cmChar_t* fn, const cmChar_t* msg )
+volatile sig_atomic_t _serve_stop_fl = 0;
+
+void _serve_on_signal( int signo )
+{ _serve_stop_fl = 1; }
+
+void _text_append( ctText_t* t, const cmChar_t* s, unsigned n )
 {
-  if( fn == NULL || cmFsIsFile(fn)==false )
-    return cmErrMsg(&ctx->err,kMissingRequiredFileNameCtRC,"The required file <%s> does not exist.",msg);
+  if( t->n + n + 1 > t->allocN )
+  {
+    t->allocN = cmMax(2*t->allocN,t->n + n + 1024);
+    t->buf    = cmMemResize(cmChar_t,t->buf,t->allocN);
+  }
 
-  return kOkCtRC;
+  memcpy(t->buf + t->n,s,n);
+  t->n += n;
+  t->buf[ t->n ] = 0;
 }
 
-bool verify_non_null_filename( cmCtx_t* ctx, const cmChar_t* fn, const cmChar_t* msg )
+// cmRpt_t print function used to capture the output of a request
+void _serve_capture( void* arg, const char* text )
+{ _text_append((ctText_t*)arg,text,strlen(text)); }
+
+// Append 'n' characters of 's' as the contents of a JSON string.
+void _text_append_json_str( ctText_t* t, const cmChar_t* s, unsigned n )
 {
-  if( fn == NULL )
-    return cmErrMsg(&ctx->err,kMissingRequiredFileNameCtRC,"The required file name <%s> is blank.",msg);
+  unsigned i,j;
 
-  return kOkCtRC;
+  for(i=0,j=0; i<n; ++i)
+  {
+    unsigned char c = s[i];
+    cmChar_t      esc[8];
+
+    if( c != '"' && c != '\\' && c >= 0x20 )
+      continue;
+
+    _text_append(t,s+j,i-j);
+    j = i + 1;
+
+    switch( c )
+    {
+      case '"':  _text_append(t,"\\\"",2); break;
+      case '\\': _text_append(t,"\\\\",2); break;
+      case '\n': _text_append(t,"\\n",2);  break;
+      case '\t': _text_append(t,"\\t",2);  break;
+      case '\r': _text_append(t,"\\r",2);  break;
+      default:
+        snprintf(esc,sizeof(esc),"\\u%04x",c);
+        _text_append(t,esc,strlen(esc));
+    }
+  }
+
+  _text_append(t,s+j,i-j);
 }
 
-cmRC_t score_gen( cmCtx_t* ctx, const cmChar_t* xmlFn, const cmChar_t* editFn, const cmChar_t* csvOutFn, const cmChar_t* midiOutFn, const cmChar_t* svgOutFn, unsigned reportFl, int begMeasNumb, int begTempoBPM, bool svgStandAloneFl, bool svgPanZoomFl, bool damperRptFl )
+// Write the text printed by a cached report action to its report file.
+cmRC_t _serve_write_report( cmCtx_t* ctx, const cmChar_t* rptFn, const ctText_t* out, unsigned begN )
 {
-  cmRC_t rc;
-  if((rc = verify_file_exists(ctx,xmlFn,"XML file")) != kOkCtRC )
-    return rc;
-  
-  if( cmXScoreTest( ctx, xmlFn, editFn, csvOutFn, midiOutFn, svgOutFn, reportFl, begMeasNumb, begTempoBPM, svgStandAloneFl, svgPanZoomFl, damperRptFl ) != kOkXsRC )
-    return cmErrMsg(&ctx->err,kScoreGenFailedCtRC,"score_gen failed.");
-    
+  FILE* fp;
+
+  if((fp = fopen(rptFn,"w")) == NULL )
+    return cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The report file '%s' could not be created.",rptFn);
+
+  fwrite(out->buf + begN,1,out->n - begN,fp);
+  fclose(fp);
   return kOkCtRC;
 }
 
-cmRC_t score_edit_merge( cmCtx_t* ctx, const cmChar_t* xmlFn, const cmChar_t* editFn, unsigned begMeasNumb, const cmChar_t* keyEditFn, unsigned keyMeasNumb, const cmChar_t* outFn )
+// Run a report action on cached files.  Returns false if the action cannot be run
+// from the cache and must be run by run_action().
+bool _serve_cached_action( cmCtx_t* ctx, cmtCacheH_t cacheH, const ctArgs_t* a, const ctText_t* out, cmRC_t* rcRef, bool* hitFlRef )
 {
-  cmRC_t rc;
-  
-  if((rc = verify_file_exists(ctx,xmlFn,"XML file")) != kOkCtRC )
-    return rc;
-  
-  if((rc = verify_file_exists(ctx,editFn,"reference edit file")) != kOkCtRC )
-    return rc;
+  cmRC_t        rc      = kOkCtRC;
+  unsigned      begN    = out->n;
+  bool          hitFl   = false;
+  bool          mfHitFl = false;
+  cmScH_t       scH     = cmScNullHandle;
+  cmMidiFileH_t mfH     = cmMidiFileNullHandle;
+  cmTlH_t       tlH     = cmTimeLineNullHandle;
+  cmtFlwH_t     flwH    = cmtFlwNullHandle;
+
+  // let run_action() report the missing file name
+  if( action_input_fn(a) == NULL )
+    return false;
+
+  switch( a->actionSelId )
+  {
+    case kScoreReportSelId:
+      if((rc = cmtCacheScore(cacheH,a->csvScoreFn,0,&scH,&hitFl)) == kOkCacheRC )
+        cmScorePrint(scH,&ctx->rpt);
+      break;
 
-  if((rc = verify_file_exists(ctx,editFn,"key edit file")) != kOkCtRC )
-    return rc;
+    case kScoreFollowTableSelId:
+      if((rc = cmtCacheScore(cacheH,a->csvScoreFn,kFlwSrate,&scH,&hitFl)) != kOkCacheRC )
+        break;
 
-  if( cmXScoreMergeEditFiles( ctx, xmlFn, editFn, begMeasNumb, keyEditFn, keyMeasNumb, outFn ) != kOkXsRC )
-    return cmErrMsg(&ctx->err,kScoreEditMergeFailedCtRC,"Score merge failed failed.");
-    
-  return kOkCtRC;      
-}
+      if((rc = cmtCacheMidiFile(cacheH,a->midiInFn,&mfH,&mfHitFl)) != kOkCacheRC )
+        break;
 
+      hitFl = hitFl && mfHitFl;
 
+      if((rc = cmtFlwCreate(ctx,&flwH,scH,kFlwSrate,kFlwScWndN,kFlwMidiWndN)) == kOkFlwRC )
+        if((rc = cmtFlwSetBeam(flwH,a->beamN,0)) == kOkFlwRC && (rc = cmtFlwMidiFile(flwH,mfH)) == kOkFlwRC )
+          cmtFlwReport(flwH,&ctx->rpt);
 
-cmRC_t score_follow( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* midiInFn, const cmChar_t* matchRptOutFn, const cmChar_t* matchSvgOutFn,  const cmChar_t* midiOutFn, const cmChar_t* timelineFn )
-{
-  cmRC_t rc;
-  
-  if((rc = verify_file_exists(ctx,csvScoreFn,"Score CSV file")) != kOkCtRC )
-    return rc;
+      cmtFlwDestroy(&flwH);
+      break;
 
-  if((rc = verify_file_exists(ctx,midiInFn,"MIDI input file")) != kOkCtRC )
-    return rc;
+    case kMidiReportSelId:
+      if((rc = cmtCacheMidiFile(cacheH,a->midiInFn,&mfH,&hitFl)) != kOkCacheRC )
+        break;
 
-  //if((rc = verify_file_exists(ctx,matchRptOutFn,"Match report file")) != kOkCtRC )
-  //  return rc;
+      cmMidiFilePrintMsgs(mfH,&ctx->rpt);
 
-  //if((rc = verify_file_exists(ctx,matchSvgOutFn,"Match HTML/SVG file")) != kOkCtRC )
-  //  return rc;
-  
-  if(cmMidiScoreFollowMain(ctx, csvScoreFn, midiInFn, matchRptOutFn, matchSvgOutFn, midiOutFn, timelineFn) != kOkMsfRC )
-    return cmErrMsg(&ctx->err,kScoreFollowFailedCtRC,"score_follow failed.");
-    
-  return kOkCtRC;         
+      if( a->svgOutFn != NULL )
+        if( cmMidiFileGenSvgFile(ctx, a->midiInFn, a->svgOutFn, "midi_file_svg.css", a->svgStandAloneFl, a->svgPanZoomFl ) != kOkMfRC )
+          rc = cmErrMsg(&ctx->err,kMidiFileRptFailedCtRC,"MIDI file SVG output generation failed.");
+      break;
+
+    case kTimelineReportSelId:
+      // range queries and binary time line files are not parsed
+      if( a->tlBegSecs >= 0 || cmtTlbIsBinFn(a->timelineFn) )
+        return false;
+
+      if((rc = cmtCacheTimeLine(cacheH,a->timelineFn,a->timelinePrefix,&tlH,&hitFl)) == kOkCacheRC )
+        cmTimeLinePrint(tlH,&ctx->rpt);
+      break;
+
+    default:
+      return false;
+  }
+
+  if( rc == kOkCtRC && a->rptFn != NULL )
+    rc = _serve_write_report(ctx,a->rptFn,out,begN);
+
+  *rcRef    = rc;
+  *hitFlRef = hitFl;
+  return true;
 }
 
-cmRC_t meas_gen( cmCtx_t* ctx, const cmChar_t* pgmRsrcFn, const cmChar_t* outFn )
+// Read a request terminated by a newline or the end of the connection.  Requests
+// are answered one at a time so the connection reads and writes time out rather
+// than letting an idle client stall the service.
+cmRC_t _serve_read_request( cmCtx_t* ctx, int fd, ctText_t* req )
 {
-  cmRC_t rc;
-  
-  if((rc = verify_file_exists(ctx,pgmRsrcFn,"Program resource file")) != kOkCtRC )
-    return rc;
+  cmChar_t       buf[ 4096 ];
+  ssize_t        n;
+  struct timeval tv = { kServeIoTimeoutSecs, 0 };
 
-  if((rc = verify_non_null_filename( ctx,outFn,"Measurements output file.")) != kOkCtRC )
-    return rc;
-  
-  return cmScoreProc(ctx, "meas", pgmRsrcFn, outFn );
+  if( setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv)) == -1 || setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv)) == -1 )
+    return cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The connection timeout could not be set.");
+
+  while( req->n == 0 || req->buf[ req->n-1 ] != '\n' )
+  {
+    if((n = read(fd,buf,sizeof(buf))) == 0 )
+      break;
+
+    if( n == -1 )
+    {
+      if( errno == EINTR && !_serve_stop_fl )
+        continue;
+
+      if( errno == EAGAIN || errno == EWOULDBLOCK )
+        return cmErrMsg(&ctx->err,kServeFailedCtRC,"The request was not received within %i seconds.",kServeIoTimeoutSecs);
+
+      return cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The request read failed.");
+    }
+
+    if( req->n + n > kServeMaxRequestByteCnt )
+      return cmErrMsg(&ctx->err,kServeFailedCtRC,"The request is longer than %i bytes.",kServeMaxRequestByteCnt);
+
+    _text_append(req,buf,n);
+  }
+
+  return kOkCtRC;
 }
 
-cmRC_t score_report( cmCtx_t* ctx, const cmChar_t* csvScoreFn, const cmChar_t* rptFn )
+cmRC_t _serve_write( cmCtx_t* ctx, int fd, const ctText_t* t )
 {
-  cmRC_t rc;
-  
-  if((rc = verify_file_exists(ctx,csvScoreFn,"Score CSV file")) != kOkCtRC )
-    return rc;
+  unsigned i = 0;
+  ssize_t  n;
 
-  cmScoreReport(ctx,csvScoreFn,rptFn);
-  
-  return rc;
-}
+  while( i < t->n )
+  {
+    if((n = write(fd,t->buf + i,t->n - i)) == -1 )
+    {
+      if( errno == EINTR )
+        continue;
 
+      if( errno == EAGAIN || errno == EWOULDBLOCK )
+        return cmErrMsg(&ctx->err,kServeFailedCtRC,"The response was not read within %i seconds.",kServeIoTimeoutSecs);
 
-cmRC_t midi_file_report( cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* rptFn, const cmChar_t* svgFn, bool standAloneFl, bool panZoomFl )
-{
-  cmRC_t rc ;
+      return cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The response write failed.");
+    }
 
-  if((rc = verify_file_exists(ctx,midiFn,"MIDI file")) != kOkCtRC )
-    return rc;
-  
-  if((rc = cmMidiFileReport(ctx, midiFn, rptFn )) != kOkMfRC )
-    return cmErrMsg(&ctx->err,kMidiFileRptFailedCtRC,"MIDI file report generation failed.");  
+    i += n;
+  }
 
-  if( svgFn != NULL )
-    if((rc = cmMidiFileGenSvgFile(ctx, midiFn, svgFn, "midi_file_svg.css", standAloneFl, panZoomFl )) != kOkMfRC )
-      return cmErrMsg(&ctx->err,kMidiFileRptFailedCtRC,"MIDI file SVG output generation failed.");
-  
   return kOkCtRC;
 }
 
-cmRC_t timeline_report( cmCtx_t* ctx, const cmChar_t* timelineFn, const cmChar_t* tlPrefixPath, const cmChar_t* rptFn )
+// Answer the request on the connection 'fd'.
+void _serve_request( cmCtx_t* ctx, cmtCacheH_t cacheH, const ctArgs_t* dfltArgs, const cmChar_t* socketFn, int fd )
 {
-  cmRC_t rc ;
+  cmRC_t          rc          = kOkCtRC;
+  cmRpt_t         rpt         = ctx->rpt;
+  cmJsonH_t       jsH         = cmJsonNullHandle;
+  cmJsonNode_t*   anp         = NULL;
+  const cmChar_t* actionLabel = NULL;
+  bool            cachedFl    = false;
+  double          begSecs     = wall_secs();
+  double          secs;
+  ctText_t        req;
+  ctText_t        out;
+  ctText_t        rsp;
+  ctBatchEntry_t  e;
+  cmtTrSpan_t     sp;
+  cmChar_t        hdr[ 128 ];
+
+  memset(&req,0,sizeof(req));
+  memset(&out,0,sizeof(out));
+  memset(&rsp,0,sizeof(rsp));
+  memset(&e,0,sizeof(e));
+
+  // capture everything printed while the request is processed
+  cmRptSetup(&ctx->rpt,_serve_capture,_serve_capture,&out);
+
+  if((rc = _serve_read_request(ctx,fd,&req)) != kOkCtRC )
+    goto errLabel;
+
+  if( cmJsonInitializeFromBuf(&jsH,ctx,req.buf,req.n) != kOkJsRC || cmJsonRoot(jsH) == NULL )
+  {
+    rc = cmErrMsg(&ctx->err,kServeFailedCtRC,"The request is not a valid JSON object.");
+    goto errLabel;
+  }
 
-  if((rc = verify_file_exists(ctx,timelineFn,"Timeline file")) != kOkCtRC )
-    return rc;
+  if((anp = cmJsonFindValue(jsH,"action",cmJsonRoot(jsH),kStringTId)) != NULL )
+    cmJsonStringValue(anp,&actionLabel);
 
-  if((rc = cmTimeLineReport( ctx, timelineFn, tlPrefixPath, rptFn  )) != kOkTlRC )
-    return cmErrMsg(&ctx->err,kTimeLineRptFailedCtRC,"The timeline file report failed.");
+  cmtTrBegin(&sp,kActionTrCat,"request",actionLabel);
 
-  return rc;
+  if( actionLabel != NULL && strcmp(actionLabel,"stats") == 0 )
+  {
+    cmtCacheReport(cacheH,&ctx->rpt);
+    cachedFl = true;
+  }
+  else if( actionLabel != NULL && strcmp(actionLabel,"shutdown") == 0 )
+  {
+    cmRptPrintf(&ctx->rpt,"Shutting down.\n");
+    _serve_stop_fl = 1;
+  }
+  else
+  {
+    e.args = *dfltArgs;
+
+    if((rc = parse_action_entry(ctx,socketFn,cmJsonRoot(jsH),0,&e)) == kOkCtRC )
+      if( !_serve_cached_action(ctx,cacheH,&e.args,&out,&rc,&cachedFl) )
+        rc = run_action(ctx,&e.args);
+  }
+
+  cmtTrEnd(&sp);
+
+ errLabel:
+  ctx->rpt = rpt;
+  secs     = wall_secs() - begSecs;
+
+  snprintf(hdr,sizeof(hdr),"{\"rc\":%i,\"secs\":%f,\"cached\":%s,\"output\":\"",rc,secs,cachedFl ? "true" : "false");
+  _text_append(&rsp,hdr,strlen(hdr));
+  _text_append_json_str(&rsp,out.buf,out.n);
+  _text_append(&rsp,"\"}\n",3);
+
+  _serve_write(ctx,fd,&rsp);
+
+  cmRptPrintf(&ctx->rpt,"%-16s rc:%2i %s secs:%f\n",cmStringNullGuard(actionLabel),rc,cachedFl ? "cached" : "loaded",secs);
+
+  cmMemFree(e.afterV);
+  cmJsonFinalize(&jsH);
+  cmMemFree(req.buf);
+  cmMemFree(out.buf);
+  cmMemFree(rsp.buf);
 }
 
-cmRC_t audio_file_report( cmCtx_t* ctx, const cmChar_t* audioFn, const cmChar_t* rptFn )
+// Return true if a service is accepting connections on 'addr'.
+bool _serve_is_live( const struct sockaddr_un* addr )
 {
-  cmRC_t rc;
+  int  fd;
+  bool fl;
 
-  if((rc = verify_file_exists(ctx,audioFn,"Audio file")) != kOkCtRC )
-    return rc;
+  if((fd = socket(AF_UNIX,SOCK_STREAM,0)) == -1 )
+    return false;
 
-  if((rc = cmAudioFileReportInfo( ctx, audioFn, rptFn  )) != kOkTlRC )
-    return cmErrMsg(&ctx->err,kAudioFileRptFailedCtRC,"The audio file report failed.");
+  fl = connect(fd,(const struct sockaddr*)addr,sizeof(*addr)) == 0;
+  close(fd);
+  return fl;
+}
+
+// Answer requests on the Unix domain socket 'socketFn' until a 'shutdown' request,
+// SIGINT or SIGTERM is received.  Options given on the command line are the defaults for each request.
+cmRC_t serve( cmCtx_t* ctx, const ctArgs_t* dfltArgs, const cmChar_t* socketFn )
+{
+  cmRC_t             rc     = kOkCtRC;
+  cmtCacheH_t        cacheH = cmtCacheNullHandle;
+  int                fd     = -1;
+  int                bindRC;
+  bool               bindFl = false;
+  mode_t             mask;
+  unsigned           reqN   = 0;
+  struct sockaddr_un addr;
+  struct sigaction   sa;
+  struct stat        st;
+
+  if( strlen(socketFn) >= sizeof(addr.sun_path) )
+    return cmErrMsg(&ctx->err,kServeFailedCtRC,"The socket file name '%s' is too long.",socketFn);
+
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path,socketFn);
+
+  // remove the socket file left by a service which did not exit cleanly
+  if( stat(socketFn,&st) == 0 )
+  {
+    if( !S_ISSOCK(st.st_mode) || _serve_is_live(&addr) )
+      return cmErrMsg(&ctx->err,kServeFailedCtRC,"The socket file '%s' is in use.",socketFn);
+
+    unlink(socketFn);
+  }
+
+  // SA_RESTART is not set so that the signals interrupt accept()
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler = _serve_on_signal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT,&sa,NULL);
+  sigaction(SIGTERM,&sa,NULL);
+
+  // a client which closes its connection early must not stop the service
+  signal(SIGPIPE,SIG_IGN);
+
+  if((rc = cmtCacheCreate(ctx,&cacheH,kServeCacheEntryN)) != kOkCacheRC )
+    goto errLabel;
+
+  if((fd = socket(AF_UNIX,SOCK_STREAM,0)) == -1 )
+  {
+    rc = cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The service socket could not be created.");
+    goto errLabel;
+  }
+
+  // the socket is created with mode 0600 - see the trust model above
+  mask = umask(0177);
+  bindRC = bind(fd,(struct sockaddr*)&addr,sizeof(addr));
+  umask(mask);
+
+  if( bindRC == -1 )
+  {
+    rc = cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The service socket could not be bound to '%s'.",socketFn);
+    goto errLabel;
+  }
+
+  bindFl = true;
+
+  if( chmod(socketFn,S_IRUSR | S_IWUSR) == -1 )
+  {
+    rc = cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The mode of the service socket '%s' could not be set.",socketFn);
+    goto errLabel;
+  }
+
+  if( listen(fd,16) == -1 )
+  {
+    rc = cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The service socket '%s' could not listen.",socketFn);
+    goto errLabel;
+  }
+
+  cmRptPrintf(&ctx->rpt,"Serving on '%s'.\n",socketFn);
+
+  while( !_serve_stop_fl )
+  {
+    int cfd;
+
+    if((cfd = accept(fd,NULL,NULL)) == -1 )
+    {
+      if( errno == EINTR || errno == ECONNABORTED )
+        continue;
+
+      rc = cmErrSysMsg(&ctx->err,kServeFailedCtRC,errno,"The service socket accept failed.");
+      break;
+    }
+
+    _serve_request(ctx,cacheH,dfltArgs,socketFn,cfd);
+    close(cfd);
+    ++reqN;
+  }
+
+  cmRptPrintf(&ctx->rpt,"Served %i requests.\n",reqN);
 
+ errLabel:
+  if( fd != -1 )
+    close(fd);
+
+  if( bindFl )
+    unlink(socketFn);
+
+  cmtCacheDestroy(&cacheH);
   return rc;
 }
 
-
 int main( int argc, char* argv[] )
 {
   cmRC_t rc = cmOkRC;
@@ -256,25 +1995,21 @@ int main( int argc, char* argv[] )
    kSvgStandAloneFlPoId,
    kSvgPanZoomFlPoId,
    kBegMeasPoId,
+   kEndMeasPoId,
    kBegBpmPoId,
    kDamperRptPoId,
    kBegMidiUidPoId,
-   kEndMidiUidPoId
+   kEndMidiUidPoId,
+   kTlBegSecsPoId,
+   kTlEndSecsPoId,
+   kTraceFileNamePoId,
+   kBatchFileNamePoId,
+   kWorkerCntPoId,
+   kServeFileNamePoId,
+   kCacheDirPoId,
+   kBeamPoId
   };
 
-  enum {
-        kNoSelId,
-        kScoreGenSelId,
-        kScoreEditMergeSelId,
-        kScoreFollowSelId,
-        kMeasGenSelId,
-        kScoreReportSelId,
-        kMidiReportSelId,
-        kTimelineReportSelId,
-        kAudioReportSelId
-  };
-    
-  
   // initialize the heap check library
   bool            memDebugFl      = 0; //cmDEBUG_FL;
   unsigned        memGuardByteCnt = memDebugFl ? 8 : 0;
@@ -283,29 +2018,20 @@ int main( int argc, char* argv[] )
   cmPgmOptH_t     poH             = cmPgmOptNullHandle;
   const cmChar_t* appTitle        = "cmtools";
   cmCtx_t         ctx;
-  const cmChar_t* xmlFn           = NULL;
-  const cmChar_t* editFn          = NULL;
-  const cmChar_t* keyEditFn       = NULL;
-  const cmChar_t* outEditFn       = NULL;
-  const cmChar_t* pgmRsrcFn       = NULL;
-  const cmChar_t* csvScoreFn      = NULL;
-  const cmChar_t* midiOutFn       = NULL;
-  const cmChar_t* midiInFn        = NULL;
-  const cmChar_t* audioFn         = NULL;
-  const cmChar_t* svgOutFn        = NULL;
-  const cmChar_t* timelineFn      = NULL;
-  const cmChar_t* timelinePrefix  = NULL;
-  const cmChar_t* rptFn           = NULL;
-  unsigned        reportFl        = 0;
-  unsigned        svgStandAloneFl = 1;
-  unsigned        svgPanZoomFl    = 1;
-  int             begMeasNumb     = 0;
-  int             keyMeasNumb     = 0;
-  int             begTempoBPM     = 60;
-  unsigned        damperRptFl     = 0;
-  unsigned        begMidiUId      = cmInvalidId;
-  unsigned        endMidiUId      = cmInvalidId;
-  unsigned        actionSelId     = kNoSelId;
+  const cmChar_t* traceFn         = NULL;
+  const cmChar_t* batchFn         = NULL;
+  const cmChar_t* serveFn         = NULL;
+  ctArgs_t        args;
+
+  memset(&args,0,sizeof(args));
+  args.svgStandAloneFl = 1;
+  args.svgPanZoomFl    = 1;
+  args.begTempoBPM     = 60;
+  args.begMidiUId      = cmInvalidId;
+  args.endMidiUId      = cmInvalidId;
+  args.tlBegSecs       = -1;
+  args.tlEndSecs       = -1;
+  args.actionSelId     = kNoSelId;
     
   cmCtxSetup(&ctx,appTitle,print,print,NULL,memGuardByteCnt,memAlignByteCnt,memFlags);
 
@@ -317,148 +2043,156 @@ int main( int argc, char* argv[] )
 
   cmPgmOptInitialize(&ctx, &poH, poBegHelpStr, poEndHelpStr );
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'S', "score_gen",    0, kScoreGenSelId,    kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'S', "score_gen",    0, kScoreGenSelId,    kNoSelId,  &args.actionSelId, 1,
     "Run the score generation tool.","Action selector");
   
-  cmPgmOptInstallEnum( poH, kActionPoId, 'D', "merge_edit",    0, kScoreEditMergeSelId,    kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'D', "merge_edit",    0, kScoreEditMergeSelId,    kNoSelId,  &args.actionSelId, 1,
     "Synchronize and copy the edit information from one edit file into another.","Action selector");
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'F', "score_follow", 0, kScoreFollowSelId, kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'F', "score_follow", 0, kScoreFollowSelId, kNoSelId,  &args.actionSelId, 1,
     "Run the time line marker generation tool.",NULL);
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'M', "meas_gen",     0, kMeasGenSelId,     kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'M', "meas_gen",     0, kMeasGenSelId,     kNoSelId,  &args.actionSelId, 1,
     "Generate perfomance measurements.",NULL);
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'R', "score_report", 0, kScoreReportSelId, kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'R', "score_report", 0, kScoreReportSelId, kNoSelId,  &args.actionSelId, 1,
     "Generate a score file report.",NULL);
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'I', "midi_report", 0, kMidiReportSelId, kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'V', "score_follow_live", 0, kScoreFollowLiveSelId, kNoSelId,  &args.actionSelId, 1,
+    "Follow a MIDI event stream read from stdin or a named pipe and print the score locations as they are found.",NULL);
+
+  cmPgmOptInstallEnum( poH, kActionPoId, 'I', "midi_report", 0, kMidiReportSelId, kNoSelId,  &args.actionSelId, 1,
     "Generate a MIDI file report and optional SVG piano roll output.",NULL);
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'E', "timeline_report", 0, kTimelineReportSelId, kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'E', "timeline_report", 0, kTimelineReportSelId, kNoSelId,  &args.actionSelId, 1,
     "Generate a timeline report.",NULL);
 
-  cmPgmOptInstallEnum( poH, kActionPoId, 'A', "audio_report",    0, kAudioReportSelId, kNoSelId,  &actionSelId, 1,
+  cmPgmOptInstallEnum( poH, kActionPoId, 'A', "audio_report",    0, kAudioReportSelId, kNoSelId,  &args.actionSelId, 1,
     "Generate an audio file report.",NULL);
 
   
-  cmPgmOptInstallStr( poH, kXmlFileNamePoId,      'x', "music_xml_fn",0,    NULL,         &xmlFn,        1, 
+  cmPgmOptInstallStr( poH, kXmlFileNamePoId,      'x', "music_xml_fn",0,    NULL,         &args.xmlFn,        1, 
     "Name of the input MusicXML file.");
 
-  cmPgmOptInstallStr( poH, kEditFileNamePoId,      'd', "edit_fn",    0,    NULL,         &editFn,        1, 
+  cmPgmOptInstallStr( poH, kEditFileNamePoId,      'd', "edit_fn",    0,    NULL,         &args.editFn,        1, 
     "Name of a score edit file.");
 
-  cmPgmOptInstallStr( poH, kKeyEditFileNamePoId,   'k', "key_edit_fn", 0,    NULL,      &keyEditFn,     1, 
+  cmPgmOptInstallStr( poH, kKeyEditFileNamePoId,   'k', "key_edit_fn", 0,    NULL,      &args.keyEditFn,     1, 
     "Name of a score edit key file.");
 
-  cmPgmOptInstallInt( poH, kKeyMeasNumbPoId,       'q', "key_meas",     0,       1,         &keyMeasNumb,   1,
+  cmPgmOptInstallInt( poH, kKeyMeasNumbPoId,       'q', "key_meas",     0,       1,         &args.keyMeasNumb,   1,
     "Number of the first measure number to merge in the edit key filke (see --key_edit_fn)." );
   
 
-  cmPgmOptInstallStr( poH, kOutEditFileNamePoId,   'o', "out_edit_fn", 0,    NULL,      &outEditFn,     1, 
+  cmPgmOptInstallStr( poH, kOutEditFileNamePoId,   'o', "out_edit_fn", 0,    NULL,      &args.outEditFn,     1, 
     "Name of a score edit merge file.");
   
-  cmPgmOptInstallStr( poH, kCsvOutFileNamePoId,   'c', "score_csv_fn",0,    NULL,         &csvScoreFn,    1, 
+  cmPgmOptInstallStr( poH, kCsvOutFileNamePoId,   'c', "score_csv_fn",0,    NULL,         &args.csvScoreFn,    1, 
     "Name of a CSV score file.");
 
-  cmPgmOptInstallStr( poH, kPgmRsrcFileNamePoId,  'g', "pgm_rsrc_fn", 0,     NULL,         &pgmRsrcFn,     1, 
+  cmPgmOptInstallStr( poH, kPgmRsrcFileNamePoId,  'g', "pgm_rsrc_fn", 0,     NULL,         &args.pgmRsrcFn,     1, 
     "Name of program resource file.");
   
-  cmPgmOptInstallStr( poH, kMidiOutFileNamePoId,  'm', "midi_out_fn",  0,    NULL,         &midiOutFn,     1, 
+  cmPgmOptInstallStr( poH, kMidiOutFileNamePoId,  'm', "midi_out_fn",  0,    NULL,         &args.midiOutFn,     1, 
     "Name of a MIDI file to generate as output.");
   
-  cmPgmOptInstallStr( poH, kMidiInFileNamePoId,   'i', "midi_in_fn",   0,    NULL,         &midiInFn,      1, 
+  cmPgmOptInstallStr( poH, kMidiInFileNamePoId,   'i', "midi_in_fn",   0,    NULL,         &args.midiInFn,      1, 
     "Name of a MIDI file to generate as output.");
   
-  cmPgmOptInstallStr( poH, kSvgOutFileNamePoId,   's', "svg_fn",       0,    NULL,         &svgOutFn,      1, 
+  cmPgmOptInstallStr( poH, kSvgOutFileNamePoId,   's', "svg_fn",       0,    NULL,         &args.svgOutFn,      1, 
     "Name of a HTML/SVG file to generate as output.");
 
-  cmPgmOptInstallStr( poH, kTimelineFileNamePoId, 't', "timeline_fn",  0,    NULL,         &timelineFn,    1,
+  cmPgmOptInstallStr( poH, kTimelineFileNamePoId, 't', "timeline_fn",  0,    NULL,         &args.timelineFn,    1,
     "Name of a timeline to generate as output.");
   
-  cmPgmOptInstallStr( poH, kTimelinePrefixPoId,   'l', "tl_prefix",    0,    NULL,         &timelinePrefix,1,
+  cmPgmOptInstallStr( poH, kTimelinePrefixPoId,   'l', "tl_prefix",    0,    NULL,         &args.timelinePrefix,1,
     "Timeline data path prefix.");
 
-  cmPgmOptInstallStr( poH, kAudioFileNamePoId,    'a', "audio_fn",    0,    NULL,          &audioFn,       1,
+  cmPgmOptInstallStr( poH, kAudioFileNamePoId,    'a', "audio_fn",    0,    NULL,          &args.audioFn,       1,
     "Audio file name.");
   
-  cmPgmOptInstallStr( poH, kStatusOutFileNamePoId,'r', "report_fn",    0,    NULL,         &rptFn,         1, 
+  cmPgmOptInstallStr( poH, kStatusOutFileNamePoId,'r', "report_fn",    0,    NULL,         &args.rptFn,         1, 
     "Name of a status file to generate as output.");
   
-  cmPgmOptInstallFlag( poH, kReportFlagPoId,      'f', "debug_fl",     0,       1,         &reportFl,      1,
+  cmPgmOptInstallFlag( poH, kReportFlagPoId,      'f', "debug_fl",     0,       1,         &args.reportFl,      1,
     "Print a report of the score following processing." );
 
-  cmPgmOptInstallInt( poH, kBegMeasPoId,          'b', "beg_meas",     0,       1,         &begMeasNumb,   1,
+  cmPgmOptInstallInt( poH, kBegMeasPoId,          'b', "beg_meas",     0,       1,         &args.begMeasNumb,   1,
     "The first measure the to be written to the output CSV, MIDI and SVG files." );
 
-  cmPgmOptInstallInt( poH, kBegBpmPoId,           'e', "beg_bpm",      0,       0,          &begTempoBPM,  1,
+  cmPgmOptInstallInt( poH, kEndMeasPoId,          'j', "end_meas",     0,       0,         &args.endMeasNumb,   1,
+    "The last measure to be parsed and written to the output files. Set to 0 to use the whole score." );
+
+  cmPgmOptInstallInt( poH, kBegBpmPoId,           'e', "beg_bpm",      0,       0,          &args.begTempoBPM,  1,
     "Set to 0 to use the tempo from the score otherwise set to use the tempo at begMeasNumb." );
 
-  cmPgmOptInstallFlag( poH, kDamperRptPoId,        'u', "damper",       0,      1,          &damperRptFl,  1,
+  cmPgmOptInstallFlag( poH, kDamperRptPoId,        'u', "damper",       0,      1,          &args.damperRptFl,  1,
     "Print the pedal events during 'score_gen' processing.");
 
-  cmPgmOptInstallFlag( poH, kSvgStandAloneFlPoId,  'n', "svg_stand_alone_fl",0, 1,          &svgStandAloneFl, 1,
+  cmPgmOptInstallFlag( poH, kSvgStandAloneFlPoId,  'n', "svg_stand_alone_fl",0, 1,          &args.svgStandAloneFl, 1,
     "Write the SVG file as a stand alone HTML file. Enabled by default." );
 
-  cmPgmOptInstallFlag( poH, kSvgPanZoomFlPoId,     'z', "svg_pan_zoom_fl", 0,   1,          &svgPanZoomFl, 1,
+  cmPgmOptInstallFlag( poH, kSvgPanZoomFlPoId,     'z', "svg_pan_zoom_fl", 0,   1,          &args.svgPanZoomFl, 1,
     "Include the pan-zoom control. Enabled by default." );
 
-  cmPgmOptInstallUInt( poH, kBegMidiUidPoId,        'w', "beg_midi_uid",    0,   1,          &begMidiUId,   1,
+  cmPgmOptInstallUInt( poH, kBegMidiUidPoId,        'w', "beg_midi_uid",    0,   1,          &args.begMidiUId,   1,
     "Begin MIDI msg. uuid." );
 
-  cmPgmOptInstallUInt( poH, kEndMidiUidPoId,        'y', "end_midi_uid",    0,   1,          &endMidiUId,   1,
+  cmPgmOptInstallUInt( poH, kEndMidiUidPoId,        'y', "end_midi_uid",    0,   1,          &args.endMidiUId,   1,
     "End MIDI msg. uuid." );
-  
-  // parse the command line arguments
-  if( cmPgmOptParse(poH, argc, argv ) == kOkPoRC )
-  {
-    // handle the built-in arg's (e.g. -v,-p,-h)
-    // (returns false if only built-in options were selected)
-    if( cmPgmOptHandleBuiltInActions(poH, &ctx.rpt ) == false )
-      goto errLabel;
 
-    switch( actionSelId )
-    {
-      case kScoreGenSelId:
-        rc = score_gen( &ctx, xmlFn, editFn, csvScoreFn, midiOutFn, svgOutFn, reportFl, begMeasNumb, begTempoBPM, svgStandAloneFl, svgPanZoomFl, damperRptFl );
-        break;
+  cmPgmOptInstallDbl( poH, kTlBegSecsPoId,          'G', "tl_beg_secs",     0,  -1,          &args.tlBegSecs,    1,
+    "Timeline report range begin in seconds. Only objects which overlap the range are reported." );
 
-      case kScoreEditMergeSelId:
-        rc = score_edit_merge( &ctx, xmlFn, editFn, begMeasNumb, keyEditFn, keyMeasNumb, outEditFn );
-        break;
+  cmPgmOptInstallDbl( poH, kTlEndSecsPoId,          'H', "tl_end_secs",     0,  -1,          &args.tlEndSecs,    1,
+    "Timeline report range end in seconds. If not given the objects which contain 'tl_beg_secs' are reported." );
 
-      case kScoreFollowSelId:
-        rc = score_follow( &ctx, csvScoreFn, midiInFn, rptFn, svgOutFn,  midiOutFn, timelineFn );
-        break;
+  cmPgmOptInstallStr( poH, kTraceFileNamePoId,      'L', "trace",           0,  NULL,        &traceFn,      1,
+    "Write a Chrome trace-event JSON file of the time spent in the action and its processing phases." );
 
-      case kMeasGenSelId:
-        rc = meas_gen(&ctx, pgmRsrcFn, rptFn);
-        break;
+  cmPgmOptInstallStr( poH, kBatchFileNamePoId,      'B', "batch",           0,  NULL,        &batchFn,      1,
+    "Run the actions listed in a JSON manifest file. Options given on the command line are the defaults for each action." );
 
-      case kScoreReportSelId:
-        rc = score_report(&ctx, csvScoreFn, rptFn );
-        break;
+  cmPgmOptInstallUInt( poH, kWorkerCntPoId,         'N', "workers",         0,   0,          &args.workerCnt, 1,
+    "Count of batch or score follow worker processes. Set to 0 to use the batch manifest 'workers' value or one worker per CPU." );
 
-      case kMidiReportSelId:
-        rc = midi_file_report(&ctx, midiInFn, rptFn, svgOutFn, svgStandAloneFl, svgPanZoomFl );
-        break;
+  cmPgmOptInstallStr( poH, kServeFileNamePoId,      'U', "serve",           0,  NULL,        &serveFn,      1,
+    "Answer JSON action requests on this Unix domain socket until a 'shutdown' request, SIGINT or SIGTERM is received." );
 
-      case kTimelineReportSelId:
-        rc = timeline_report(&ctx, timelineFn, timelinePrefix, rptFn );
-        break;
+  cmPgmOptInstallStr( poH, kCacheDirPoId,           'C', "cache_dir",       0,  NULL,        &args.cacheDir, 1,
+    "Directory of the 'meas_gen' per marker cache. The measurements of a marker are copied from it when its inputs are unchanged." );
 
-      case kAudioReportSelId:
-        rc = audio_file_report(&ctx, audioFn, rptFn );
-        break;
+  cmPgmOptInstallUInt( poH, kBeamPoId,              'K', "beam",            0,   0,          &args.beamN,    1,
+    "Count of score locations the score follower examines around its last match. The beam widens while notes are missed. Set to 0 to use the matcher default." );
+  
+  // parse the command line arguments
+  if( cmPgmOptParse(poH, argc, argv ) == kOkPoRC )
+  {
+    // handle the built-in arg's (e.g. -v,-p,-h)
+    // (returns false if only built-in options were selected)
+    if( cmPgmOptHandleBuiltInActions(poH, &ctx.rpt ) == false )
+      goto errLabel;
 
-        
-      default:
-        rc = cmErrMsg(&ctx.err, kNoActionIdSelectedCtRC,"No action selector was selected.");
+    if( traceFn != NULL )
+      if((rc = cmtTrInitialize(&ctx,traceFn)) != kOkTrRC )
+        goto errLabel;
 
+    if( batchFn != NULL )
+    {
+      // the batch entries run in worker processes - only the batch as a whole is traced
+      cmtTrSpan_t sp;
+      cmtTrBegin(&sp,kActionTrCat,"batch",batchFn);
+      rc = batch( &ctx, &args, batchFn, args.workerCnt );
+      cmtTrEnd(&sp);
     }
+    else if( serveFn != NULL )
+      rc = serve( &ctx, &args, serveFn );
+    else
+      rc = run_action( &ctx, &args );
   }
   
  errLabel:
+  cmtTrFinalize();
   cmPgmOptFinalize(&poH);
   cmTsFinalize();
   cmFsFinalize();
@@ -0,0 +1,539 @@
+//| Copyright: (C) 2009-2020 Kevin Larke <contact AT larke DOT org>
+//| License: GNU GPL version 3.0 or above. See the accompanying LICENSE file.
+#include "cmPrefix.h"
+#include "cmGlobal.h"
+#include "cmFloatTypes.h"
+#include "cmComplexTypes.h"
+#include "cmRpt.h"
+#include "cmErr.h"
+#include "cmCtx.h"
+#include "cmMem.h"
+#include "cmMallocDebug.h"
+#include "cmLinkedHeap.h"
+#include "cmSymTbl.h"
+#include "cmFileSys.h"
+#include "cmText.h"
+#include "cmTime.h"
+#include "cmMidi.h"
+#include "cmAudioFile.h"
+
+#include "cmProcObj.h"
+#include "cmProcTemplateMain.h"
+#include "cmVectOpsTemplateMain.h"
+#include "cmProc.h"
+
+#include "cmPgmOpts.h"
+
+#include "cmtKernels.h"
+
+#include <time.h>
+
+enum
+{
+  kOkKbRC = cmOkRC,
+  kFailKbRC,
+  kRegressionKbRC
+};
+
+typedef cmRC_t kbRC_t;
+
+const cmChar_t* poBegHelpStr =
+  "kernbench Time the inner loops of the mas processing stages.\n"
+  "\n"
+  "kernbench [-r <reps>] [-b <baseline_fn>] [-t <tolerance_pct>] [-w <baseline_fn>] [-f <audio_fn>]\n"
+  "\n"
+  "Each kernel is run on synthetic buffers of the size used by mas at 48 kHz.\n"
+  "Each kernel is run twice to warm the caches and then <reps> times. The fastest\n"
+  "repetition is reported as ns/sample and GB/s.  With -b the results are compared\n"
+  "to a baseline file written by -w and the program exits with a non-zero status\n"
+  "if any kernel is more than <tolerance_pct> percent slower than its baseline.\n"
+  "\n";
+
+const cmChar_t* poEndHelpStr = "";
+
+#define kKbSrate (48000.0)
+
+enum
+{
+  kKbWarmUpCnt     = 2,
+  kKbMaxKernelCnt  = 16,
+  kKbWndMs         = 42,       // mas default convolution and filter window
+  kKbDistSmpCnt    = 480000,   // 10 second sync reference window
+  kKbDistLagCnt    = 16,       // count of lags compared per repetition
+  kKbDistStride    = 8,        // coarse pass sample stride (See kCoarseSmpStride in mas.c)
+  kKbFillSecs      = 600,      // length of the MIDI impulse file
+  kKbFillBlkSmpCnt = 1024,     // midiToAudio() buffer size
+  kKbStreamSecs    = 60,       // length of the convolve, filter and audio file streams
+  kKbAfBits        = 16,
+  kKbAfBlkSmpCnt   = 65536
+};
+
+typedef struct
+{
+  const cmChar_t* label;
+  double          nsPerSmp;
+  double          gbPerSec;
+} kbResult_t;
+
+typedef struct
+{
+  cmCtx_t*        ctx;
+  unsigned        repCnt;
+  const cmChar_t* audioFn;
+  kbResult_t      resultV[ kKbMaxKernelCnt ];
+  unsigned        resultN;
+} kb_t;
+
+// Function to time. Returns the count of bytes read and written.
+typedef double (*kbFunc_t)( void* arg );
+
+// Results are added to this sink so that the kernels are not optimized away.
+static volatile double _kbSink = 0;
+
+double _kbSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+kbRC_t _kbTime( kb_t* p, const cmChar_t* label, kbFunc_t func, void* arg, unsigned long long smpCnt )
+{
+  double   minSecs  = DBL_MAX;
+  double   byteCnt  = 0;
+  unsigned i;
+
+  if( p->resultN >= kKbMaxKernelCnt )
+    return cmErrMsg(&p->ctx->err,kFailKbRC,"Too many kernels.");
+
+  for(i=0; i<kKbWarmUpCnt; ++i)
+    func(arg);
+
+  for(i=0; i<p->repCnt; ++i)
+  {
+    double t0 = _kbSecs();
+    byteCnt   = func(arg);
+    minSecs   = cmMin(minSecs,_kbSecs() - t0);
+  }
+
+  kbResult_t* r = p->resultV + p->resultN++;
+  r->label    = label;
+  r->nsPerSmp = minSecs * 1000000000.0 / smpCnt;
+  r->gbPerSec = minSecs > 0 ? byteCnt / minSecs / 1000000000.0 : 0;
+
+  cmRptPrintf(&p->ctx->rpt,"%-16s %12.3f ns/smp %10.3f GB/s\n",r->label,r->nsPerSmp,r->gbPerSec);
+  return kOkKbRC;
+}
+
+//----------------------------------------------------------------------------------------------------
+// cmtKnDistance() and cmtKnDistanceStrided() as used by slide_match()
+
+typedef struct
+{
+  cmSample_t* key;  // key[ kKbDistSmpCnt + kKbDistLagCnt ]
+  cmSample_t* ref;  // ref[ kKbDistSmpCnt ]
+} kbDist_t;
+
+double _kbDistance( void* arg )
+{
+  kbDist_t* d = (kbDist_t*)arg;
+  unsigned  i;
+
+  // maxDist is never reached so that every sample is compared
+  for(i=0; i<kKbDistLagCnt; ++i)
+    _kbSink += cmtKnDistance(d->key + i, d->ref, kKbDistSmpCnt, DBL_MAX);
+
+  return 2.0 * kKbDistLagCnt * kKbDistSmpCnt * sizeof(cmSample_t);
+}
+
+double _kbDistanceStrided( void* arg )
+{
+  kbDist_t* d = (kbDist_t*)arg;
+  unsigned  i;
+
+  for(i=0; i<kKbDistLagCnt; ++i)
+    _kbSink += cmtKnDistanceStrided(d->key + i, d->ref, kKbDistSmpCnt, kKbDistStride, DBL_MAX);
+
+  return 2.0 * kKbDistLagCnt * (kKbDistSmpCnt / kKbDistStride) * sizeof(cmSample_t);
+}
+
+//----------------------------------------------------------------------------------------------------
+// cmtKnImpulseFill() as used by midiToAudio()
+
+typedef struct
+{
+  cmtKnImpulse_t* impV;
+  unsigned        impN;
+  long long       smpCnt;
+  cmSample_t      buf[ kKbFillBlkSmpCnt ];
+} kbFill_t;
+
+double _kbFill( void* arg )
+{
+  kbFill_t* f      = (kbFill_t*)arg;
+  unsigned  impIdx = 0;
+  long long bi;
+
+  for(bi=0; bi<f->smpCnt; bi+=kKbFillBlkSmpCnt)
+  {
+    impIdx   = cmtKnImpulseFill(f->buf,kKbFillBlkSmpCnt,bi,f->impV,f->impN,impIdx);
+    _kbSink += f->buf[0];
+  }
+
+  return (double)f->smpCnt * sizeof(cmSample_t);
+}
+
+//----------------------------------------------------------------------------------------------------
+// cmConvolveExec() and the one-pole cmVOS_Filter() as used by convolve() and filter()
+
+typedef struct
+{
+  cmConvolve* cnvp;
+  cmSample_t* x;      // x[smpCnt]
+  cmSample_t* y;      // y[procSmpCnt]
+  unsigned    smpCnt;
+  unsigned    procSmpCnt;
+} kbStream_t;
+
+double _kbConvolve( void* arg )
+{
+  kbStream_t* s = (kbStream_t*)arg;
+  unsigned    i;
+
+  for(i=0; i+s->procSmpCnt<=s->smpCnt; i+=s->procSmpCnt)
+  {
+    cmConvolveExec(s->cnvp,s->x + i,s->procSmpCnt);
+    _kbSink += s->cnvp->outV[0];
+  }
+
+  return 2.0 * s->smpCnt * sizeof(cmSample_t);
+}
+
+double _kbFilter( void* arg )
+{
+  kbStream_t* s   = (kbStream_t*)arg;
+  cmReal_t    a[] = {-0.7 };
+  cmReal_t    b0  = 1.0;
+  cmReal_t    b[] = {0,};
+  cmReal_t    d[] = {0,0};
+  unsigned    i;
+
+  for(i=0; i+s->procSmpCnt<=s->smpCnt; i+=s->procSmpCnt)
+  {
+    cmVOS_Filter( s->y, s->procSmpCnt, s->x + i, s->procSmpCnt, b0, b, a, d, 1 );
+    _kbSink += s->y[0];
+  }
+
+  return 2.0 * s->smpCnt * sizeof(cmSample_t);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Audio file read and sample format conversion
+
+typedef struct
+{
+  cmCtx_t*        ctx;
+  const cmChar_t* fn;
+  cmSample_t*     buf;   // buf[ kKbAfBlkSmpCnt ]
+  kbRC_t          rc;
+} kbAf_t;
+
+double _kbAfRead( void* arg )
+{
+  kbAf_t*           a      = (kbAf_t*)arg;
+  cmAudioFileH_t    afH    = cmNullAudioFileH;
+  cmAudioFileInfo_t info;
+  cmRC_t            afRC;
+  unsigned          actFrmCnt;
+  double            byteCnt = 0;
+
+  if( cmAudioFileIsValid( afH = cmAudioFileNewOpen(a->fn,&info,&afRC,&a->ctx->rpt)) == false )
+  {
+    a->rc = cmErrMsg(&a->ctx->err,kFailKbRC,"The audio file '%s' could not be opened.",a->fn);
+    return 0;
+  }
+
+  do
+  {
+    actFrmCnt = 0;
+    if( cmAudioFileReadSample(afH,kKbAfBlkSmpCnt,0,1,&a->buf,&actFrmCnt) != kOkAfRC )
+      break;
+
+    byteCnt += (double)actFrmCnt * (info.bits/8 + sizeof(cmSample_t));
+    _kbSink += a->buf[0];
+
+  }while( actFrmCnt == kKbAfBlkSmpCnt );
+
+  cmAudioFileDelete(&afH);
+  return byteCnt;
+}
+
+kbRC_t _kbAfCreate( kb_t* p, const cmChar_t* fn, unsigned smpCnt )
+{
+  kbRC_t         rc  = kOkKbRC;
+  cmRC_t         afRC;
+  cmAudioFileH_t afH = cmNullAudioFileH;
+  cmSample_t*    buf = cmMemAllocZ(cmSample_t,kKbAfBlkSmpCnt);
+  unsigned       i;
+
+  if( cmAudioFileIsValid( afH = cmAudioFileNewCreate(fn,kKbSrate,kKbAfBits,1,&afRC,&p->ctx->rpt)) == false )
+  {
+    rc = cmErrMsg(&p->ctx->err,kFailKbRC,"The audio file '%s' could not be created.",fn);
+    goto errLabel;
+  }
+
+  for(i=0; i<smpCnt; i+=kKbAfBlkSmpCnt)
+  {
+    unsigned n = cmMin(kKbAfBlkSmpCnt,smpCnt-i);
+
+    cmVOS_Random(buf,n,-0.5,0.5);
+
+    if( cmAudioFileWriteSample(afH,n,1,&buf) != kOkAfRC )
+    {
+      rc = cmErrMsg(&p->ctx->err,kFailKbRC,"The audio file '%s' write failed.",fn);
+      goto errLabel;
+    }
+  }
+
+ errLabel:
+  if( cmAudioFileIsValid(afH) )
+    cmAudioFileDelete(&afH);
+
+  cmMemFree(buf);
+  return rc;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+kbRC_t kbRun( kb_t* p )
+{
+  kbRC_t      rc         = kOkKbRC;
+  unsigned    wndSmpCnt  = floor(kKbSrate * kKbWndMs / 1000);
+  unsigned    streamN    = (unsigned)(kKbStreamSecs * kKbSrate);
+  cmCtx*      ctxp       = NULL;
+  kbDist_t    dist;
+  kbFill_t*   fill       = cmMemAllocZ(kbFill_t,1);
+  kbStream_t  strm;
+  kbAf_t      af;
+  unsigned    i;
+
+  memset(&strm,0,sizeof(strm));
+
+  // distance
+  dist.key = cmMemAllocZ(cmSample_t,kKbDistSmpCnt + kKbDistLagCnt);
+  dist.ref = cmMemAllocZ(cmSample_t,kKbDistSmpCnt);
+  cmVOS_Random(dist.key,kKbDistSmpCnt + kKbDistLagCnt,0,1);
+  cmVOS_Random(dist.ref,kKbDistSmpCnt,0,1);
+
+  if((rc = _kbTime(p,"distance",_kbDistance,&dist,(unsigned long long)kKbDistLagCnt*kKbDistSmpCnt)) != kOkKbRC )
+    goto errLabel;
+
+  if((rc = _kbTime(p,"distance_strided",_kbDistanceStrided,&dist,(unsigned long long)kKbDistLagCnt*kKbDistSmpCnt)) != kOkKbRC )
+    goto errLabel;
+
+  // impulse fill - one note every 200 ms
+  fill->smpCnt = (long long)(kKbFillSecs * kKbSrate);
+  fill->impN   = kKbFillSecs * 5;
+  fill->impV   = cmMemAllocZ(cmtKnImpulse_t,fill->impN);
+  for(i=0; i<fill->impN; ++i)
+  {
+    fill->impV[i].smpIdx = (long long)(i * 0.2 * kKbSrate);
+    fill->impV[i].gain   = 0.5;
+  }
+
+  if((rc = _kbTime(p,"impulse_fill",_kbFill,fill,fill->smpCnt)) != kOkKbRC )
+    goto errLabel;
+
+  // convolve and filter - the processing block is the window length as in convolve() and filter()
+  {
+    cmSample_t wnd[ wndSmpCnt ];
+
+    cmVOS_Hann(wnd,wndSmpCnt);
+    cmVOS_DivVS(wnd,wndSmpCnt,4);
+
+    strm.smpCnt     = streamN;
+    strm.procSmpCnt = wndSmpCnt;
+    strm.x          = cmMemAllocZ(cmSample_t,streamN);
+    strm.y          = cmMemAllocZ(cmSample_t,wndSmpCnt);
+    cmVOS_Random(strm.x,streamN,-1,1);
+
+    ctxp      = cmCtxAlloc(NULL,&p->ctx->rpt,cmLHeapNullHandle,cmSymTblNullHandle);
+    strm.cnvp = cmConvolveAlloc(ctxp,NULL,wnd,wndSmpCnt,wndSmpCnt);
+
+    if((rc = _kbTime(p,"convolve",_kbConvolve,&strm,streamN)) != kOkKbRC )
+      goto errLabel;
+
+    if((rc = _kbTime(p,"filter",_kbFilter,&strm,streamN)) != kOkKbRC )
+      goto errLabel;
+  }
+
+  // audio file read and convert
+  if((rc = _kbAfCreate(p,p->audioFn,streamN)) != kOkKbRC )
+    goto errLabel;
+
+  af.ctx = p->ctx;
+  af.fn  = p->audioFn;
+  af.buf = cmMemAllocZ(cmSample_t,kKbAfBlkSmpCnt);
+  af.rc  = kOkKbRC;
+
+  rc = _kbTime(p,"audio_file_read",_kbAfRead,&af,streamN);
+
+  if( rc == kOkKbRC )
+    rc = af.rc;
+
+  cmMemFree(af.buf);
+  remove(p->audioFn);
+
+ errLabel:
+  cmConvolveFree(&strm.cnvp);
+  cmCtxFree(&ctxp);
+  cmMemFree(strm.x);
+  cmMemFree(strm.y);
+  cmMemFree(fill->impV);
+  cmMemFree(fill);
+  cmMemFree(dist.key);
+  cmMemFree(dist.ref);
+  return rc;
+}
+
+// Baseline file format: one '<label> <ns_per_smp>' line per kernel.
+kbRC_t kbWriteBaseline( kb_t* p, const cmChar_t* fn )
+{
+  FILE*    fp;
+  unsigned i;
+
+  if((fp = fopen(fn,"w")) == NULL )
+    return cmErrMsg(&p->ctx->err,kFailKbRC,"The baseline file '%s' could not be created.",fn);
+
+  for(i=0; i<p->resultN; ++i)
+    fprintf(fp,"%s %f\n",p->resultV[i].label,p->resultV[i].nsPerSmp);
+
+  fclose(fp);
+  return kOkKbRC;
+}
+
+kbRC_t kbCompareBaseline( kb_t* p, const cmChar_t* fn, double tolPct )
+{
+  kbRC_t   rc = kOkKbRC;
+  FILE*    fp;
+  cmChar_t label[64];
+  double   nsPerSmp;
+  unsigned i;
+
+  if((fp = fopen(fn,"r")) == NULL )
+    return cmErrMsg(&p->ctx->err,kFailKbRC,"The baseline file '%s' could not be opened.",fn);
+
+  while( fscanf(fp,"%63s %lf",label,&nsPerSmp) == 2 )
+  {
+    for(i=0; i<p->resultN; ++i)
+      if( strcmp(label,p->resultV[i].label) == 0 )
+        break;
+
+    if( i == p->resultN )
+    {
+      cmErrWarnMsg(&p->ctx->err,kFailKbRC,"The baseline kernel '%s' was not run.",label);
+      continue;
+    }
+
+    double pct = nsPerSmp > 0 ? 100.0 * (p->resultV[i].nsPerSmp - nsPerSmp) / nsPerSmp : 0;
+
+    cmRptPrintf(&p->ctx->rpt,"%-16s baseline:%12.3f ns/smp %+8.1f%%%s\n",label,nsPerSmp,pct,pct > tolPct ? " REGRESSION" : "");
+
+    if( pct > tolPct )
+      rc = kRegressionKbRC;
+  }
+
+  fclose(fp);
+
+  if( rc == kRegressionKbRC )
+    cmErrMsg(&p->ctx->err,rc,"One or more kernels are more than %f%% slower than the baseline '%s'.",tolPct,fn);
+
+  return rc;
+}
+
+void print( void* arg, const char* text )
+{
+  printf("%s",text);
+}
+
+int main( int argc, char* argv[] )
+{
+  enum
+  {
+    kRepCntPoId = kBasePoId,
+    kBaselinePoId,
+    kTolPctPoId,
+    kWrBaselinePoId,
+    kAudioFnPoId
+  };
+
+  kbRC_t          rc              = kOkKbRC;
+  bool            memDebugFl      = cmDEBUG_FL;
+  unsigned        memGuardByteCnt = memDebugFl ? 8 : 0;
+  unsigned        memAlignByteCnt = 16;
+  unsigned        memFlags        = memDebugFl ? kTrackMmFl | kDeferFreeMmFl | kFillUninitMmFl : 0;
+  cmPgmOptH_t     poH             = cmPgmOptNullHandle;
+  const cmChar_t* appTitle        = "kernbench";
+  const cmChar_t* baselineFn      = NULL;
+  const cmChar_t* wrBaselineFn    = NULL;
+  double          tolPct          = 10;
+  cmCtx_t         ctx;
+  kb_t            kb;
+
+  memset(&kb,0,sizeof(kb));
+
+  cmCtxSetup(&ctx,appTitle,print,print,NULL,memGuardByteCnt,memAlignByteCnt,memFlags);
+
+  cmMdInitialize( memGuardByteCnt, memAlignByteCnt, memFlags, &ctx.rpt );
+
+  cmFsInitialize( &ctx, appTitle );
+
+  cmTsInitialize(&ctx );
+
+  cmPgmOptInitialize(&ctx, &poH, poBegHelpStr, poEndHelpStr );
+
+  cmPgmOptInstallUInt( poH, kRepCntPoId,     'r', "reps",          0,     5,                 &kb.repCnt,    1,
+    "Count of timed repetitions of each kernel." );
+
+  cmPgmOptInstallStr(  poH, kBaselinePoId,   'b', "baseline",      0,     NULL,              &baselineFn,   1,
+    "Compare the results to this baseline file." );
+
+  cmPgmOptInstallDbl(  poH, kTolPctPoId,     't', "tolerance_pct", 0,     10,                &tolPct,       1,
+    "Percent a kernel may be slower than its baseline before it is reported as a regression." );
+
+  cmPgmOptInstallStr(  poH, kWrBaselinePoId, 'w', "write_baseline",0,     NULL,              &wrBaselineFn, 1,
+    "Write the results as a baseline file." );
+
+  cmPgmOptInstallStr(  poH, kAudioFnPoId,    'f', "audio_fn",      0,     "kernbench.aif",   &kb.audioFn,   1,
+    "Temporary audio file used by the audio file read kernel." );
+
+  // parse the command line arguments
+  if( cmPgmOptParse(poH, argc, argv ) == kOkPoRC )
+  {
+    // handle the built-in arg's (e.g. -v,-p,-h)
+    // (returns false if only built-in options were selected)
+    if( cmPgmOptHandleBuiltInActions(poH, &ctx.rpt ) == false )
+      goto errLabel;
+
+    kb.ctx    = &ctx;
+    kb.repCnt = cmMax(kb.repCnt,1);
+
+    if((rc = kbRun(&kb)) != kOkKbRC )
+      goto errLabel;
+
+    if( wrBaselineFn != NULL && (rc = kbWriteBaseline(&kb,wrBaselineFn)) != kOkKbRC )
+      goto errLabel;
+
+    if( baselineFn != NULL )
+      rc = kbCompareBaseline(&kb,baselineFn,tolPct);
+  }
+
+ errLabel:
+  cmPgmOptFinalize(&poH);
+  cmTsFinalize();
+  cmFsFinalize();
+  cmMdReport( kIgnoreNormalMmFl );
+  cmMdFinalize();
+
+  return rc;
+}
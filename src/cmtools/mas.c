@@ -31,6 +31,18 @@
 #include "cmPgmOpts.h"
 #include "cmScore.h"
 
+#include "cmtHash.h"
+#include "cmtTlBin.h"
+#include "cmtTlIndex.h"
+#include "cmtFpIndex.h"
+#include "cmtAfStream.h"
+#include "cmtF32File.h"
+#include "cmtProgress.h"
+#include "cmtTrace.h"
+#include "cmtKernels.h"
+
+#include <time.h>
+
 typedef cmRC_t masRC_t;
 
 enum
@@ -50,9 +62,27 @@ enum
   kSyncSelId,
   kGenTimeLineSelId,
   kLoadMarkersSelId,
+  kConvertTimeLineSelId,
+  kMergeSyncSelId,
+  kBenchSelId,
   kTestStubSelId
 };
 
+// Trace span labels indexed by the selector id's above.
+const cmChar_t* _masSelLabelArray[] =
+{
+  "midi_to_impulse",
+  "onsets",
+  "convolve",
+  "sync",
+  "gen_time_line",
+  "markers",
+  "convert_time_line",
+  "merge_sync",
+  "bench",
+  "test"
+};
+
 
 typedef struct
 {
@@ -67,9 +97,22 @@ typedef struct
   const cmChar_t* refExt;
   const cmChar_t* keyExt;
   const cmChar_t* markFn;
+  const cmChar_t* afFmt;
   const cmChar_t* prefixPath;
+  unsigned        f32Fl;
+  const cmChar_t* shard;
+  unsigned        progressFd;
+  const cmChar_t* metricsFn;
+  const cmChar_t* traceFn;
 } masPgmArgs_t;
 
+// Sample indexes and counts are 64 bit so that the sync and time line
+// positions of day long recordings do not overflow.
+enum
+{
+  kInvalidSmpIdx = -1   // invalid 64 bit sample index
+};
+
 typedef struct
 {
   const char* refFn;
@@ -78,27 +121,93 @@ typedef struct
   const char* keyFn;
   double      keyBegSecs;       // offset into audio file of first sliding window
   double      keyEndSecs;       // offset into audio file of the last sliding window
-  unsigned    keySyncIdx;       // index into audio file of best matched sliding window
+  long long   keySyncIdx;       // index into audio file of best matched sliding window (kInvalidSmpIdx if no match)
   double      syncDist;         // distance (matching score) to the ref window of the best matched sliding window
-  unsigned    refSmpCnt;        // count of samples in the midi file 
-  unsigned    keySmpCnt;        // count of samples in the audio file
+  long long   refSmpCnt;        // count of samples in the midi file 
+  long long   keySmpCnt;        // count of samples in the audio file
   double      srate;            // sample rate of audio and midi file
+  bool        fpFl;             // true if keyFn and the search range were proposed by the fingerprint index
+  double      searchEndSecs;    // end of the key search range used by slide_match() (See _masSetSearchEnds())
 } syncRecd_t;
 // Notes:
 // audioBegSecs
 //  != 0  - audio file is locked to midi file  
 //  == 0  - midi  file is locked to audio file 
 
+// One reference window of a multi-anchor sync record.
 typedef struct
 {
-  cmJsonH_t       jsH;
-  syncRecd_t*     syncArray;
-  unsigned        syncArrayCnt;
-  const cmChar_t* refDir;
-  const cmChar_t* keyDir;
-  double          hopMs;
+  double      refWndBegSecs;    // location of the ref window in the midi file (0=center of the file)
+  double      refWndSecs;       // length of the ref window
+  long long   refSmpIdx;        // index into the midi file of the ref window actually used
+  long long   keySyncIdx;       // index into audio file of best matched sliding window (kInvalidSmpIdx if no match)
+  double      syncDist;         // distance (matching score) to the ref window of the best matched sliding window
+  double      offsetSecs;       // keySyncIdx - refSmpIdx in seconds
+  double      residSecs;        // difference between the measured and the fitted key location
+} anchorRecd_t;
+
+// Multi-anchor sync record. All anchors are matched against a single key search range.
+typedef struct
+{
+  const char*   refFn;
+  const char*   keyFn;
+  double        keyBegSecs;     // offset into audio file of first sliding window
+  double        keyEndSecs;     // offset into audio file of the last sliding window (0=end of file)
+  anchorRecd_t* anchorArray;    // anchorArray[anchorCnt]
+  unsigned      anchorCnt;
+  double        driftOffsSecs;  // fitted line: keySecs = driftOffsSecs + driftRate * refSecs
+  double        driftRate;      //
+  long long     refSmpCnt;      // count of samples in the midi file
+  long long     keySmpCnt;      // count of samples in the audio file
+  double        srate;          // sample rate of audio and midi file
+} anchorSetRecd_t;
+
+typedef struct
+{
+  cmJsonH_t        jsH;
+  syncRecd_t*      syncArray;
+  unsigned         syncArrayCnt;
+  anchorSetRecd_t* anchorSetArray;
+  unsigned         anchorSetCnt;
+  unsigned         anchorDecim;  // key and ref signal decimation factor used by anchor_match()
+  cmtFpH_t         fpH;          // onset fingerprint index of the key directory
+  cmtFpCfg_t       fpCfg;        // fingerprint index parameters
+  const cmChar_t*  fpIndexFn;    // optional fingerprint index cache file
+  double           fpMarginSecs; // search range margin around a proposed key location
+  const cmChar_t*  refDir;
+  const cmChar_t*  keyDir;
+  double           hopMs;
 } syncCtx_t;
 
+// The subset of the sync and anchor records processed by a 'mas -y --shard i/N' process.
+// Each shard is given a contiguous range of records so that the search order
+// prediction from the previous record on the same key file is usually available.
+typedef struct
+{
+  unsigned idx;           // index of this shard
+  unsigned cnt;           // count of shards
+  unsigned syncBegIdx;    // syncArray[syncBegIdx:syncEndIdx] is processed by this shard
+  unsigned syncEndIdx;
+  unsigned anchorBegIdx;  // anchorSetArray[anchorBegIdx:anchorEndIdx] is processed by this shard
+  unsigned anchorEndIdx;
+} masShard_t;
+
+// Machine readable progress events (See cmtProgress.h and the 'progress_fd' and 'metrics' options).
+// The handle is only valid if one of the options was given.
+cmtPrgH_t      _masPrgH      = cmSTATIC_NULL_HANDLE;
+cmtPrgStage_t* _masPrgParent = NULL;  // stage (e.g. a directory of files) which the current file stage is part of
+
+// Set the record range of shard 'idx' of 'cnt' shards.
+void _masShardSetup( masShard_t* sh, unsigned idx, unsigned cnt, unsigned syncArrayCnt, unsigned anchorSetCnt )
+{
+  sh->idx          = idx;
+  sh->cnt          = cnt;
+  sh->syncBegIdx   = (unsigned)((unsigned long long)syncArrayCnt *  idx    / cnt);
+  sh->syncEndIdx   = (unsigned)((unsigned long long)syncArrayCnt * (idx+1) / cnt);
+  sh->anchorBegIdx = (unsigned)((unsigned long long)anchorSetCnt *  idx    / cnt);
+  sh->anchorEndIdx = (unsigned)((unsigned long long)anchorSetCnt * (idx+1) / cnt);
+}
+
 enum
 {
   kMidiFl = 0x01,
@@ -124,11 +233,11 @@ typedef struct file_str
   const char*      fullFn;        // path and name
   unsigned         refIdx;        // index into file array of recd pointed to by refPtr 
   struct file_str* refPtr;        // ptr to the file that this file is positioned relative to (set to NULL for master files)
-  int              refSmpIdx;     // index into the reference file that is synced to keySmpIdx
-  int              keySmpIdx;     // index into this file which is synced to refSmpIdx
-  int              absSmpIdx;     // abs smp idx of sync location
-  int              absBegSmpIdx;  // file beg smp idx - the earliest file in the group is set to 0.
-  int              smpCnt;        // file duration
+  long long        refSmpIdx;     // index into the reference file that is synced to keySmpIdx
+  long long        keySmpIdx;     // index into this file which is synced to refSmpIdx
+  long long        absSmpIdx;     // abs smp idx of sync location
+  long long        absBegSmpIdx;  // file beg smp idx - the earliest file in the group is set to 0.
+  long long        smpCnt;        // file duration
   double           srate;         // file sample rate
   unsigned         groupId;       // every file belongs to a group - a group is a set of files referencing a common master  
 
@@ -239,6 +348,12 @@ masRC_t midiStringSearch( cmCtx_t* ctx, const cmChar_t* srcDir, cmMidiByte_t* x,
 
 
 // Generate an audio file containing impulses at the location of each note-on message. 
+enum
+{
+  kMasAfsBlkCnt    = 3,     // count of blocks in the asynchronous audio file read/write rings
+  kMasAfsWrSmpCnt  = 65536  // write block size used by midiToAudio()
+};
+
 masRC_t midiToAudio(  cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* audioFn, double srate )
 {
   cmMidiFileH_t            mfH        = cmMidiFileNullHandle;
@@ -250,10 +365,12 @@ masRC_t midiToAudio(  cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* audi
   masRC_t                  rc         = kFailMasRC;
   cmRC_t                   afRC       = kOkAfRC;
   cmAudioFileH_t           afH        = cmNullAudioFileH;
+  cmtAfWrH_t               wrH        = cmtAfWrNullHandle;
   unsigned                 bufSmpCnt  = 1024;
   cmSample_t               buf[ bufSmpCnt ];
-  cmSample_t              *bufPtr     = buf;
   unsigned                 noteOnCnt  = 0;
+  cmtKnImpulse_t*          impV       = NULL;
+  cmtPrgStage_t            prg;
   
   // open the MIDI file
   if( cmMidiFileOpen(ctx,&mfH,midiFn) != kOkMfRC )
@@ -265,6 +382,8 @@ masRC_t midiToAudio(  cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* audi
   double mfDurSecs = cmMidiFileDurSecs(mfH);
   cmRptPrintf(&ctx->rpt,"Secs:%f \n",mfDurSecs);
 
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"midi_to_impulse",midiFn,(unsigned long long)floor(mfDurSecs*srate));
+
   msgCnt    = cmMidiFileMsgCount(mfH);        // get the count of messages in the MIDI file
   msgPtrPtr = cmMidiFileMsgArray(mfH);        // get a ptr to the base of the the MIDI msg array
   //cmMidiFileTickToMicros(mfH);                // convert the MIDI msg time base from ticks to microseconds
@@ -282,48 +401,58 @@ masRC_t midiToAudio(  cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* audi
     goto errLabel;
   }
 
-  unsigned msgIdx      = 0;
-  unsigned msgSmpIdx   = floor( msgPtrPtr[msgIdx]->dtick  * srate / 1000000.0);
-  unsigned begSmpIdx   = 0;
-
-  do
-  {
-
-    // zero the audio buffer
-    cmVOS_Zero(buf,bufSmpCnt);
+  // write the audio file on a separate thread
+  if( cmtAfWrCreate(ctx,&wrH,afH,audioFn,kMasAfsWrSmpCnt,kMasAfsBlkCnt) != kOkAfsRC )
+    goto errLabel;
 
-    // for each msg which falls inside the current buffer
-    while( begSmpIdx <= msgSmpIdx && msgSmpIdx < begSmpIdx + bufSmpCnt )
-    {
+  unsigned  msgIdx    = 0;
+  unsigned  impIdx    = 0;
+  long long msgSmpIdx = 0;
+  long long begSmpIdx = 0;
 
-      // put an impulse representing this note-on msg in the buffer
-      if( msgPtrPtr[msgIdx]->status == kNoteOnMdId )
-      {
-        buf[ msgSmpIdx - begSmpIdx ] = (cmSample_t)msgPtrPtr[msgIdx]->u.chMsgPtr->d1 / 127;
-        ++noteOnCnt;
-      }
-      
-      // advance to the next msg
-      ++msgIdx;
+  // represent each note-on msg by a velocity scaled impulse
+  impV = cmMemAllocZ(cmtKnImpulse_t,msgCnt);
 
-      if( msgIdx == msgCnt )
-        break;
+  for(msgIdx=0; msgIdx<msgCnt; ++msgIdx)
+  {
+    // update the current msg time
+    msgSmpIdx += floor( msgPtrPtr[msgIdx]->dtick  * srate / 1000000.0);
 
-      // update the current msg time
-      msgSmpIdx += floor( msgPtrPtr[msgIdx]->dtick  * srate / 1000000.0);
+    if( msgPtrPtr[msgIdx]->status == kNoteOnMdId )
+    {
+      impV[noteOnCnt].smpIdx = msgSmpIdx;
+      impV[noteOnCnt].gain   = (cmSample_t)msgPtrPtr[msgIdx]->u.chMsgPtr->d1 / 127;
+      ++noteOnCnt;
     }
+  }
+
+  // msgSmpIdx is now the time of the last msg
+  do
+  {
+    // zero the audio buffer and put the impulses which fall inside it in the buffer
+    impIdx = cmtKnImpulseFill(buf,bufSmpCnt,begSmpIdx,impV,noteOnCnt,impIdx);
 
     // write the audio buffer
-    if( cmAudioFileWriteFloat(afH, bufSmpCnt, chCnt, &bufPtr ) != kOkAfRC )
+    if( cmtAfWrWrite(wrH, buf, bufSmpCnt ) != kOkAfsRC )
     {
       cmErrMsg(&ctx->err,kFailMasRC,"Audio file write failed on '%s'.",audioFn);
       goto errLabel;
     }
+
+    cmtPrgUpdate(&prg,bufSmpCnt,0,bufSmpCnt*chCnt*sampleBits/8);
     
     // advance the buffer position
     begSmpIdx += bufSmpCnt;
 
-  }while(msgIdx < msgCnt);
+  }while(begSmpIdx <= msgSmpIdx);
+
+  if( cmtAfWrFlush(wrH) != kOkAfsRC )
+  {
+    cmErrMsg(&ctx->err,kFailMasRC,"Audio file write failed on '%s'.",audioFn);
+    goto errLabel;
+  }
+
+  cmtAfsReport(&ctx->rpt,"I/O",cmtAfRdNullHandle,wrH);
   
   /*
   // for each MIDI msg
@@ -360,6 +489,12 @@ masRC_t midiToAudio(  cmCtx_t* ctx, const cmChar_t* midiFn, const cmChar_t* audi
 
   //cmMemFree(sV);
 
+  cmMemPtrFree(&impV);
+
+  cmtPrgEnd(&prg,rc);
+
+  cmtAfWrDestroy(&wrH);
+
   if( cmAudioFileIsValid(afH) )
     cmAudioFileDelete(&afH);
 
@@ -374,16 +509,21 @@ masRC_t filter( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAudi
 {
   cmAudioFileH_t    iafH = cmNullAudioFileH;
   cmAudioFileH_t    oafH = cmNullAudioFileH;
+  cmtAfRdH_t        rdH  = cmtAfRdNullHandle;
+  cmtAfWrH_t        wrH  = cmtAfWrNullHandle;
   masRC_t           rc   = kFailMasRC;
   cmAudioFileInfo_t afInfo;
   cmRC_t            afRC;
   double            prog = 0.1;
   unsigned          progIdx = 0;
+  cmtPrgStage_t     prg;
 
   // open the input audio file
   if( cmAudioFileIsValid( iafH = cmAudioFileNewOpen(inAudioFn,&afInfo,&afRC, &ctx->rpt ))==false)
     return kFailMasRC;
 
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"filter",inAudioFn,afInfo.frameCnt);
+
   // create the output audio file
   if( cmAudioFileIsValid( oafH = cmAudioFileNewCreate(outAudioFn,afInfo.srate,afInfo.bits,1,&afRC,&ctx->rpt)) == false )
     goto errLabel;
@@ -391,35 +531,40 @@ masRC_t filter( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAudi
   {
     unsigned   wndSmpCnt  = floor(afInfo.srate * wndMs / 1000);
     unsigned   procSmpCnt = wndSmpCnt;
-    cmSample_t procBuf[procSmpCnt];
     unsigned   actFrmCnt;
     cmReal_t   a[] = {-feedbackCoeff };
     cmReal_t   b0  = 1.0;
     cmReal_t   b[] = {0,};
     cmReal_t   d[] = {0,0};
 
+    // read and write the audio files on separate threads
+    if( cmtAfRdCreate(ctx,&rdH,iafH,inAudioFn,0,procSmpCnt,kMasAfsBlkCnt,0) != kOkAfsRC )
+      goto errLabel;
+
+    if( cmtAfWrCreate(ctx,&wrH,oafH,outAudioFn,procSmpCnt,kMasAfsBlkCnt) != kOkAfsRC )
+      goto errLabel;
+
     do
     {
-      unsigned chIdx = 0;
-      unsigned chCnt = 1;
-
-      cmSample_t* procBufPtr = procBuf;
+      const cmSample_t* procBuf = NULL;
 
       actFrmCnt = 0;
 
-      // read the next procSmpCnt samples from the input file into procBuf[]
-      cmAudioFileReadSample(iafH, procSmpCnt, chIdx, chCnt, &procBufPtr, &actFrmCnt );
+      // get the next procSmpCnt samples from the input file
+      if( cmtAfRdGet(rdH, &procBuf, &actFrmCnt ) != kOkAfsRC )
+        goto errLabel;
      
       if( actFrmCnt > 0 )
       {
         
         cmSample_t y[actFrmCnt];
-        cmSample_t* yp = y;
         cmVOS_Filter( y, actFrmCnt, procBuf, actFrmCnt, b0, b, a, d, 1 );
 
         // write the output audio file
-        if( cmAudioFileWriteSample(oafH, actFrmCnt, chCnt, &yp ) != kOkAfRC )
+        if( cmtAfWrWrite(wrH, y, actFrmCnt ) != kOkAfsRC )
           goto errLabel;
+
+        cmtPrgUpdate(&prg,actFrmCnt,(unsigned long long)actFrmCnt*afInfo.chCnt*afInfo.bits/8,(unsigned long long)actFrmCnt*afInfo.bits/8);
       }
 
       progIdx += actFrmCnt;
@@ -433,12 +578,21 @@ masRC_t filter( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAudi
     }while(actFrmCnt==procSmpCnt);
 
     cmRptPrint(&ctx->rpt,"\n");
+
+    if( cmtAfWrFlush(wrH) != kOkAfsRC )
+      goto errLabel;
+
+    cmtAfsReport(&ctx->rpt,"I/O",rdH,wrH);
   }
   
 
   rc = kOkMasRC;
 
  errLabel:
+  cmtPrgEnd(&prg,rc);
+  cmtAfRdDestroy(&rdH);
+  cmtAfWrDestroy(&wrH);
+
 
   if( cmAudioFileIsValid(iafH) )
     cmAudioFileDelete(&iafH);
@@ -454,6 +608,9 @@ masRC_t convolve( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAu
 {
   cmAudioFileH_t    iafH = cmNullAudioFileH;
   cmAudioFileH_t    oafH = cmNullAudioFileH;
+  cmtAfRdH_t        rdH  = cmtAfRdNullHandle;
+  cmtAfWrH_t        wrH  = cmtAfWrNullHandle;
+  cmtF32WrH_t       f32H = cmtF32WrNullHandle;
   cmCtx*            ctxp = NULL;
   cmConvolve*       cnvp = NULL;
   masRC_t           rc   = kFailMasRC;
@@ -461,20 +618,28 @@ masRC_t convolve( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAu
   cmRC_t            afRC;
   double            prog = 0.1;
   unsigned          progIdx = 0;
+  cmtPrgStage_t     prg;
 
   // open the input audio file
   if( cmAudioFileIsValid( iafH = cmAudioFileNewOpen(inAudioFn,&afInfo,&afRC, &ctx->rpt ))==false)
     return kFailMasRC;
 
-  // create the output audio file
-  if( cmAudioFileIsValid( oafH = cmAudioFileNewCreate(outAudioFn,afInfo.srate,afInfo.bits,1,&afRC,&ctx->rpt)) == false )
-    goto errLabel;
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"convolve",inAudioFn,afInfo.frameCnt);
+
+  // create the output file - '.f32' files are written as raw float32 samples (See cmtF32File.h)
+  if( cmtF32IsFile(outAudioFn) )
+  {
+    if( cmtF32WrCreate(ctx,&f32H,outAudioFn,afInfo.srate) != kOkF32RC )
+      goto errLabel;
+  }
   else
+    if( cmAudioFileIsValid( oafH = cmAudioFileNewCreate(outAudioFn,afInfo.srate,afInfo.bits,1,&afRC,&ctx->rpt)) == false )
+      goto errLabel;
+
   {
     unsigned   wndSmpCnt  = floor(afInfo.srate * wndMs / 1000);
     unsigned   procSmpCnt = wndSmpCnt;
     cmSample_t wnd[wndSmpCnt];
-    cmSample_t procBuf[procSmpCnt];
     unsigned   actFrmCnt;
 
     cmVOS_Hann(wnd,wndSmpCnt);
@@ -484,17 +649,23 @@ masRC_t convolve( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAu
     ctxp = cmCtxAlloc(NULL,&ctx->rpt,cmLHeapNullHandle,cmSymTblNullHandle);  // alloc a cmCtx object
     cnvp = cmConvolveAlloc(ctxp,NULL,wnd,wndSmpCnt,procSmpCnt);              // alloc a convolver object
 
+    // read and write the audio files on separate threads
+    if( cmtAfRdCreate(ctx,&rdH,iafH,inAudioFn,0,procSmpCnt,kMasAfsBlkCnt,0) != kOkAfsRC )
+      goto errLabel;
+
+    if( cmtF32WrIsValid(f32H) == false )
+      if( cmtAfWrCreate(ctx,&wrH,oafH,outAudioFn,procSmpCnt,kMasAfsBlkCnt) != kOkAfsRC )
+        goto errLabel;
+
     do
     {
-      unsigned chIdx = 0;
-      unsigned chCnt = 1;
-
-      cmSample_t* procBufPtr = procBuf;
+      const cmSample_t* procBuf = NULL;
 
       actFrmCnt = 0;
 
-      // read the next procSmpCnt samples from the input file into procBuf[]
-      cmAudioFileReadSample(iafH, procSmpCnt, chIdx, chCnt, &procBufPtr, &actFrmCnt );
+      // get the next procSmpCnt samples from the input file
+      if( cmtAfRdGet(rdH, &procBuf, &actFrmCnt ) != kOkAfsRC )
+        goto errLabel;
      
       if( actFrmCnt > 0 )
       {
@@ -503,9 +674,17 @@ masRC_t convolve( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAu
 
         //cmVOS_AddVV( cnvp->outV, cnvp->outN, procBufPtr );
 
-        // write the output audio file
-        if( cmAudioFileWriteSample(oafH, cnvp->outN, chCnt, &cnvp->outV ) != kOkAfRC )
-          goto errLabel;
+        // write the output file
+        if( cmtF32WrIsValid(f32H) )
+        {
+          if( cmtF32WrWrite(f32H, cnvp->outV, cnvp->outN ) != kOkF32RC )
+            goto errLabel;
+        }
+        else
+          if( cmtAfWrWrite(wrH, cnvp->outV, cnvp->outN ) != kOkAfsRC )
+            goto errLabel;
+
+        cmtPrgUpdate(&prg,actFrmCnt,(unsigned long long)actFrmCnt*afInfo.chCnt*afInfo.bits/8,(unsigned long long)cnvp->outN*(cmtF32WrIsValid(f32H) ? sizeof(cmSample_t) : afInfo.bits/8));
       }
 
       progIdx += actFrmCnt;
@@ -519,12 +698,26 @@ masRC_t convolve( cmCtx_t* ctx, const cmChar_t* inAudioFn, const cmChar_t* outAu
     }while(actFrmCnt==procSmpCnt);
 
     cmRptPrint(&ctx->rpt,"\n");
+
+    if( cmtAfWrIsValid(wrH) && cmtAfWrFlush(wrH) != kOkAfsRC )
+      goto errLabel;
+
+    // write the float32 header
+    if( cmtF32WrIsValid(f32H) && cmtF32WrDestroy(&f32H) != kOkF32RC )
+      goto errLabel;
+
+    cmtAfsReport(&ctx->rpt,"I/O",rdH,wrH);
   }
   
 
   rc = kOkMasRC;
 
  errLabel:
+  cmtPrgEnd(&prg,rc);
+  cmtAfRdDestroy(&rdH);
+  cmtAfWrDestroy(&wrH);
+  cmtF32WrDestroy(&f32H);
+
     cmCtxFree(&ctxp);
     cmConvolveFree(&cnvp);
 
@@ -543,6 +736,10 @@ masRC_t audioToOnset( cmCtx_t* ctx, const cmChar_t* ifn, const cmChar_t* ofn, co
   cmOnH_t              onH  = cmOnsetNullHandle;
   cmFileSysPathPart_t* ofsp = NULL;
   const cmChar_t*      tfn  = NULL;
+  cmtPrgStage_t        prg;
+
+  // the onset detector does not report its progress and so only the begin and end events are written
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"onsets",ifn,0);
 
   // parse the output file name
   if((ofsp = cmFsPathParts(ofn)) == NULL )
@@ -591,6 +788,8 @@ masRC_t audioToOnset( cmCtx_t* ctx, const cmChar_t* ifn, const cmChar_t* ofn, co
   if( cmOnsetFinalize(&onH) != kOkOnRC )
     rc = cmErrMsg(&ctx->err,kFailMasRC,"The onset detector finalization failed on %s.",cmStringNullGuard(ifn));
 
+  cmtPrgEnd(&prg,rc);
+
   cmFsFreeFn(tfn);
   cmFsFreePathParts(ofsp);
 
@@ -657,12 +856,13 @@ masRC_t audioFileStartTimes( cmCtx_t* ctx, const char* dirStr )
 // srate - only used when sel == kMidiToAudioSelId
 // wndMs - only used when sel == kConvolveSelId
 // onsetCfgPtr - only used when sel == kAudioOnsetSelId
-masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cmChar_t* dstDir, double srate, double wndMs, const cmOnsetCfg_t* onsetCfgPtr )
+masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cmChar_t* dstDir, const cmChar_t* dstExt, double srate, double wndMs, const cmOnsetCfg_t* onsetCfgPtr )
 {
   cmFileSysDirEntry_t* dep         = NULL;
   unsigned             dirEntryCnt = 0;
   unsigned             i;
   masRC_t              rc          = kOkMasRC;
+  cmtPrgStage_t        prg;
 
   // verify / create the destination directory
   if( !cmFsIsDir(dstDir) )
@@ -674,6 +874,20 @@ masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cm
     return cmErrMsg(&ctx->err,kFailMasRC,"Unable to iterate the source directory '%s'.",srcDir);
   else
   {
+    unsigned long long totalSmpCnt = 0;
+
+    // the directory ETA is based on the total count of audio samples to convolve
+    if( sel == kConvolveSelId && cmtPrgIsValid(_masPrgH) )
+      for(i=0; i<dirEntryCnt; ++i)
+      {
+        cmAudioFileInfo_t afInfo;
+        if( cmAudioFileGetInfo( dep[i].name, &afInfo, &ctx->rpt ) == kOkAfRC )
+          totalSmpCnt += afInfo.frameCnt;
+      }
+
+    cmtPrgBegin(_masPrgH,&prg,NULL,"directory",srcDir,totalSmpCnt);
+    _masPrgParent = &prg;
+
     // for each file in the source directory
     for(i=0; i<dirEntryCnt; ++i)
     {
@@ -681,10 +895,13 @@ masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cm
       cmFileSysPathPart_t* pp = cmFsPathParts( dep[i].name );
 
       // combine the dstDir and source file name to form the dest. file name
-      const cmChar_t* dstFn = cmFsMakeFn( dstDir, pp->fnStr, "aif", NULL );
+      const cmChar_t* dstFn = cmFsMakeFn( dstDir, pp->fnStr, dstExt, NULL );
 
       cmRptPrintf(&ctx->rpt,"Source File:%s\n", dep[i].name);
 
+      cmtTrSpan_t sp;
+      cmtTrBegin(&sp,kFileTrCat,_masSelLabelArray[sel],dep[i].name);
+
       switch( sel )
       {
         case kMidiToAudioSelId:
@@ -705,11 +922,16 @@ masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cm
           break;
       }
 
+      cmtTrEnd(&sp);
+
       cmFsFreeFn(dstFn);
       
       cmFsFreePathParts(pp);
     }
 
+    _masPrgParent = NULL;
+    cmtPrgEnd(&prg,rc);
+
     cmFsDirFreeEntries(dep);
   }
   
@@ -717,31 +939,35 @@ masRC_t fileDriver( cmCtx_t* ctx, unsigned sel, const cmChar_t* srcDir, const cm
 }
 
 
-// b0 = base of window to compare.
-// b0[i] = location of sample in b0[] to compare to b1[0].
-// b1[n] = reference window
-double distance( const cmSample_t* b0, const cmSample_t* b1, unsigned n, double maxDist )
+void _masAnchorSetArrayFree( syncCtx_t* scp )
 {
-  double            sum = 0;
-  const cmSample_t* ep  = b1 + n;
-  
-  while(b1 < ep && sum < maxDist )
-  {
-    sum += ((*b0)-(*b1)) * ((*b0)-(*b1));
-    ++b0;
-    ++b1;
-  }
-  return sum;
-}
+  unsigned i;
 
+  if( scp->anchorSetArray != NULL )
+    for(i=0; i<scp->anchorSetCnt; ++i)
+      cmMemFree(scp->anchorSetArray[i].anchorArray);
 
-// write a syncCtx_t record as a JSON file
-masRC_t write_sync_json( cmCtx_t* ctx, const syncCtx_t* scp, const cmChar_t* outJsFn )
+  cmMemPtrFree(&scp->anchorSetArray);
+  scp->anchorSetCnt = 0;
+}
+
+// Write a syncCtx_t record as a JSON file. If 'shard' is non-NULL then only the
+// records of the shard are written along with a 'shard' object which
+// is used by masMergeSync() to combine the partial files.
+masRC_t write_sync_json( cmCtx_t* ctx, const syncCtx_t* scp, const cmChar_t* outJsFn, const masShard_t* shard )
 {
   masRC_t       rc  = kOkMasRC;
-  unsigned      i;
+  unsigned      i,j;
   cmJsonH_t     jsH = cmJsonNullHandle;
   cmJsonNode_t* jnp;
+  cmJsonNode_t* snp;
+  masShard_t    all;
+
+  if( shard == NULL )
+  {
+    _masShardSetup(&all,0,1,scp->syncArrayCnt,scp->anchorSetCnt);
+    shard = &all;
+  }
 
   // create a JSON tree
   if( cmJsonInitialize(&jsH,ctx) != kOkJsRC )
@@ -755,7 +981,7 @@ masRC_t write_sync_json( cmCtx_t* ctx, const syncCtx_t* scp, const cmChar_t* out
     goto errLabel;
 
   // create the 'sync' object
-  if((jnp = cmJsonInsertPairObject(jsH,jnp,"sync")) == NULL )
+  if((snp = jnp = cmJsonInsertPairObject(jsH,jnp,"sync")) == NULL )
     goto errLabel;
 
   if( cmJsonInsertPairs(jsH,jnp,
@@ -767,10 +993,28 @@ masRC_t write_sync_json( cmCtx_t* ctx, const syncCtx_t* scp, const cmChar_t* out
     goto errLabel;
   }
 
+  if( shard != &all )
+  {
+    cmJsonNode_t* hnp;
+
+    if((hnp = cmJsonInsertPairObject(jsH,snp,"shard")) == NULL )
+      goto errLabel;
+
+    if( cmJsonInsertPairs(jsH,hnp,
+        "idx",          kIntTId, shard->idx,
+        "cnt",          kIntTId, shard->cnt,
+        "syncArrayCnt", kIntTId, scp->syncArrayCnt,
+        "anchorSetCnt", kIntTId, scp->anchorSetCnt,
+        NULL) != kOkJsRC )
+    {
+      goto errLabel;
+    }
+  }
+
   if((jnp = cmJsonInsertPairArray(jsH,jnp,"array")) == NULL )
     goto errLabel;
 
-  for(i=0; i<scp->syncArrayCnt; ++i)
+  for(i=shard->syncBegIdx; i<shard->syncEndIdx; ++i)
   {
     const syncRecd_t* s = scp->syncArray + i;
 
@@ -781,24 +1025,79 @@ masRC_t write_sync_json( cmCtx_t* ctx, const syncCtx_t* scp, const cmChar_t* out
         "keyFn",        kStringTId, s->keyFn,
         "keyBegSecs",   kRealTId,   s->keyBegSecs,
         "keyEndSecs",   kRealTId,   s->keyEndSecs,
-        "keySyncIdx",   kIntTId,    s->keySyncIdx,
+        "keySyncIdx",   kRealTId,   (double)s->keySyncIdx,
         "syncDist",     kRealTId,   s->syncDist,
-        "refSmpCnt",    kIntTId,    s->refSmpCnt,
-        "keySmpCnt",    kIntTId,    s->keySmpCnt,
+        "refSmpCnt",    kRealTId,   (double)s->refSmpCnt,
+        "keySmpCnt",    kRealTId,   (double)s->keySmpCnt,
         "srate",        kRealTId,   s->srate,
+        "fpFl",         kBoolTId,   s->fpFl,
         NULL) == NULL )
     {
       goto errLabel;
     }
   }
 
+  // write the multi-anchor records
+  if( shard->anchorEndIdx > shard->anchorBegIdx )
+  {
+    if((jnp = cmJsonInsertPairArray(jsH,snp,"anchorArray")) == NULL )
+      goto errLabel;
+
+    for(i=shard->anchorBegIdx; i<shard->anchorEndIdx; ++i)
+    {
+      const anchorSetRecd_t* a = scp->anchorSetArray + i;
+      cmJsonNode_t*          anp;
+
+      if((anp = cmJsonCreateFilledObject(jsH,jnp,
+          "refFn",        kStringTId, a->refFn,
+          "keyFn",        kStringTId, a->keyFn,
+          "keyBegSecs",   kRealTId,   a->keyBegSecs,
+          "keyEndSecs",   kRealTId,   a->keyEndSecs,
+          "driftOffsSecs",kRealTId,   a->driftOffsSecs,
+          "driftRate",    kRealTId,   a->driftRate,
+          "refSmpCnt",    kRealTId,   (double)a->refSmpCnt,
+          "keySmpCnt",    kRealTId,   (double)a->keySmpCnt,
+          "srate",        kRealTId,   a->srate,
+          NULL)) == NULL )
+      {
+        goto errLabel;
+      }
+
+      if((anp = cmJsonInsertPairArray(jsH,anp,"anchors")) == NULL )
+        goto errLabel;
+
+      for(j=0; j<a->anchorCnt; ++j)
+      {
+        const anchorRecd_t* ar = a->anchorArray + j;
+
+        if( cmJsonCreateFilledObject(jsH,anp,
+            "refWndBegSecs",kRealTId,   ar->refWndBegSecs,
+            "refWndSecs",   kRealTId,   ar->refWndSecs,
+            "refSmpIdx",    kRealTId,   (double)ar->refSmpIdx,
+            "keySyncIdx",   kRealTId,   (double)ar->keySyncIdx,
+            "syncDist",     kRealTId,   ar->syncDist,
+            "offsetSecs",   kRealTId,   ar->offsetSecs,
+            "residSecs",    kRealTId,   ar->residSecs,
+            NULL) == NULL )
+        {
+          goto errLabel;
+        }
+      }
+    }
+  }
+
  errLabel:
   if( cmJsonErrorCode(jsH) != kOkJsRC )
     rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"JSON tree construction failed on '%s'.",cmStringNullGuard(outJsFn));
   else
   {
+    cmtTrSpan_t sp;
+    cmtTrBegin(&sp,kPhaseTrCat,"json_emit",outJsFn);
+
     if( cmJsonWrite(jsH,cmJsonRoot(jsH),outJsFn) != kOkJsRC )
       rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"JSON write failed on '%s.",cmStringNullGuard(outJsFn));
+
+    cmtTrEnd(&sp);
   }
   
   if( cmJsonFinalize(&jsH) != kOkJsRC )
@@ -820,20 +1119,34 @@ masRC_t _masJsonFieldNotFoundError( cmCtx_t* c, const char* msg, const char* err
   return rc;
 }
 
+// Sample indexes are written as JSON reals because JSON integers are 32 bits.
+// Files written with integer sample indexes are also accepted.
+long long _masJsonSmpIdx( double v )
+{ return v < 0 ? kInvalidSmpIdx : (long long)llround(v); }
+
 // Initialize a syncCtx_t record from a JSON file.
 masRC_t read_sync_json( cmCtx_t* ctx, syncCtx_t* scp, const cmChar_t* jsFn )
 {
   masRC_t         rc          = kOkMasRC;
   cmJsonNode_t*   jnp;
+  cmJsonNode_t*   anp         = NULL;
   const cmChar_t* errLabelPtr = NULL;
-  unsigned        i;
+  unsigned        i,j;
+  cmJsRC_t        jsRC;
+  cmtTrSpan_t     sp;
 
   // if the JSON tree already exists then finalize it
   if( cmJsonFinalize(&scp->jsH) != kOkJsRC )
     return cmErrMsg(&ctx->err,kJsonFailMasRC,"JSON object finalization failed.");
   
+  cmtTrBegin(&sp,kPhaseTrCat,"json_parse",jsFn);
+
   // initialize a JSON tree from a file
-  if( cmJsonInitializeFromFile(&scp->jsH, jsFn, ctx ) != kOkJsRC )
+  jsRC = cmJsonInitializeFromFile(&scp->jsH, jsFn, ctx );
+
+  cmtTrEnd(&sp);
+
+  if( jsRC != kOkJsRC )
   {
     rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"Initializatoin from JSON file failed on '%s'.",cmStringNullGuard(jsFn));
     goto errLabel;
@@ -852,6 +1165,7 @@ masRC_t read_sync_json( cmCtx_t* ctx, syncCtx_t* scp, const cmChar_t* jsFn )
       "keyDir", kStringTId, &scp->keyDir,
       "hopMs",  kRealTId,   &scp->hopMs,
       "array",  kArrayTId,  &jnp,
+      "anchorArray", kArrayTId | kOptArgJsFl, &anp,
       NULL ) != kOkJsRC )
   {
     rc = _masJsonFieldNotFoundError(ctx, "sync", errLabelPtr, jsFn );
@@ -867,6 +1181,8 @@ masRC_t read_sync_json( cmCtx_t* ctx, syncCtx_t* scp, const cmChar_t* jsFn )
   {
     const cmJsonNode_t* cnp = cmJsonArrayElementC(jnp,i);
     syncRecd_t*         s   = scp->syncArray + i;
+    double              keySyncIdx,refSmpCnt,keySmpCnt;
+    bool                fpFl = false;
 
     if( cmJsonMemberValues(cnp, &errLabelPtr,
         "refFn",        kStringTId, &s->refFn,
@@ -875,16 +1191,82 @@ masRC_t read_sync_json( cmCtx_t* ctx, syncCtx_t* scp, const cmChar_t* jsFn )
         "keyFn",        kStringTId, &s->keyFn,
         "keyBegSecs",   kRealTId,   &s->keyBegSecs,
         "keyEndSecs",   kRealTId,   &s->keyEndSecs,
-        "keySyncIdx",   kIntTId,    &s->keySyncIdx,
+        "keySyncIdx",   kRealTId,   &keySyncIdx,
         "syncDist",     kRealTId,   &s->syncDist,
-        "refSmpCnt",    kIntTId,    &s->refSmpCnt,
-        "keySmpCnt",    kIntTId,    &s->keySmpCnt,
+        "refSmpCnt",    kRealTId,   &refSmpCnt,
+        "keySmpCnt",    kRealTId,   &keySmpCnt,
         "srate",        kRealTId,   &s->srate,
+        "fpFl",         kBoolTId | kOptArgJsFl, &fpFl,
         NULL) != kOkJsRC )
     {
       rc = _masJsonFieldNotFoundError(ctx, "sync record", errLabelPtr, jsFn );
       goto errLabel;
     }
+
+    s->keySyncIdx = _masJsonSmpIdx(keySyncIdx);
+    s->refSmpCnt  = _masJsonSmpIdx(refSmpCnt);
+    s->keySmpCnt  = _masJsonSmpIdx(keySmpCnt);
+    s->fpFl       = fpFl;
+  }
+
+  // read the optional multi-anchor records
+  if( anp != NULL && (scp->anchorSetCnt = cmJsonChildCount(anp)) > 0 )
+  {
+    scp->anchorSetArray = cmMemAllocZ(anchorSetRecd_t,scp->anchorSetCnt);
+
+    for(i=0; i<scp->anchorSetCnt; ++i)
+    {
+      const cmJsonNode_t* cnp = cmJsonArrayElementC(anp,i);
+      anchorSetRecd_t*    a   = scp->anchorSetArray + i;
+      cmJsonNode_t*       arp = NULL;
+      double              refSmpCnt,keySmpCnt;
+
+      if( cmJsonMemberValues(cnp, &errLabelPtr,
+          "refFn",        kStringTId, &a->refFn,
+          "keyFn",        kStringTId, &a->keyFn,
+          "keyBegSecs",   kRealTId,   &a->keyBegSecs,
+          "keyEndSecs",   kRealTId,   &a->keyEndSecs,
+          "driftOffsSecs",kRealTId,   &a->driftOffsSecs,
+          "driftRate",    kRealTId,   &a->driftRate,
+          "refSmpCnt",    kRealTId,   &refSmpCnt,
+          "keySmpCnt",    kRealTId,   &keySmpCnt,
+          "srate",        kRealTId,   &a->srate,
+          "anchors",      kArrayTId,  &arp,
+          NULL) != kOkJsRC )
+      {
+        rc = _masJsonFieldNotFoundError(ctx, "anchor record", errLabelPtr, jsFn );
+        goto errLabel;
+      }
+
+      a->refSmpCnt = _masJsonSmpIdx(refSmpCnt);
+      a->keySmpCnt = _masJsonSmpIdx(keySmpCnt);
+
+      if((a->anchorCnt = cmJsonChildCount(arp)) > 0 )
+        a->anchorArray = cmMemAllocZ(anchorRecd_t,a->anchorCnt);
+
+      for(j=0; j<a->anchorCnt; ++j)
+      {
+        anchorRecd_t* ar = a->anchorArray + j;
+        double        refSmpIdx,keySyncIdx;
+
+        if( cmJsonMemberValues(cmJsonArrayElementC(arp,j), &errLabelPtr,
+            "refWndBegSecs",kRealTId,   &ar->refWndBegSecs,
+            "refWndSecs",   kRealTId,   &ar->refWndSecs,
+            "refSmpIdx",    kRealTId,   &refSmpIdx,
+            "keySyncIdx",   kRealTId,   &keySyncIdx,
+            "syncDist",     kRealTId,   &ar->syncDist,
+            "offsetSecs",   kRealTId,   &ar->offsetSecs,
+            "residSecs",    kRealTId,   &ar->residSecs,
+            NULL) != kOkJsRC )
+        {
+          rc = _masJsonFieldNotFoundError(ctx, "anchor", errLabelPtr, jsFn );
+          goto errLabel;
+        }
+
+        ar->refSmpIdx  = _masJsonSmpIdx(refSmpIdx);
+        ar->keySyncIdx = _masJsonSmpIdx(keySyncIdx);
+      }
+    }
   }
 
  errLabel:
@@ -895,147 +1277,539 @@ masRC_t read_sync_json( cmCtx_t* ctx, syncCtx_t* scp, const cmChar_t* jsFn )
       rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"JSON finalization failed.");
 
     cmMemPtrFree(&scp->syncArray);
+    _masAnchorSetArrayFree(scp);
   }
   return rc;
 }
 
-// Form a reference window from file 0 at refBegMs:refBegMs + wndMs.
-// Compare each wndMs window in file 1 to this window and 
-// record the closest match.
-// Notes:
-// fn0 = midi file
-// fn1 = audio file
-masRC_t slide_match( cmCtx_t* ctx, const cmChar_t* fn0, const cmChar_t* fn1, syncRecd_t* s, unsigned hopMs, unsigned keyEndMs )
+enum
 {
-  masRC_t            rc        = kOkMasRC;
-  cmAudioFileInfo_t  afInfo0;
-  cmAudioFileInfo_t  afInfo1;
-  cmRC_t             afRC;
-  unsigned           wndMs     = s->refWndSecs    * 1000;
-  unsigned           refBegMs  = s->refWndBegSecs * 1000; 
-  unsigned           keyBegMs  = s->keyBegSecs   * 1000;
-  cmAudioFileH_t     af0H      = cmNullAudioFileH;
-  cmAudioFileH_t     af1H      = cmNullAudioFileH;
-  cmSample_t        *buf0      = NULL;
-  cmSample_t        *buf1      = NULL;
-  unsigned           minSmpIdx = cmInvalidIdx;
-  double             minDist   = DBL_MAX;
+  kMaxKeyRgnSmpCnt = 1 << 20,  // largest key search region (in samples, 4 MiB) which is held in memory - larger regions are streamed
+  kCoarseLagStep   = 4,        // coarse pass lag increment (in hops)
+  kCoarseSmpStride = 8         // coarse pass sample stride
+};
 
-  if( cmAudioFileIsValid( af0H = cmAudioFileNewOpen(fn0,&afInfo0,&afRC, &ctx->rpt ))==false)
-    return cmErrMsg(&ctx->err,kFailMasRC,"The ref. audio file could not be opened.",cmStringNullGuard(fn0));
+// Key search region held in memory.
+typedef struct
+{
+  const cmSample_t* buf;    // buf[smpCnt]
+  long long   begSmpIdx;    // key file index of buf[0]
+  long long   smpCnt;
+} masKeyRgn_t;
 
-  if( cmAudioFileIsValid( af1H = cmAudioFileNewOpen(fn1,&afInfo1,&afRC, &ctx->rpt ))==false)
-  {
-    rc =  cmErrMsg(&ctx->err,kFailMasRC,"The key audio file could not be opened.",cmStringNullGuard(fn1));
-    goto errLabel;
-  }
+// Return the lag with the minimum distance from a sparse scan of the key region.
+unsigned _masCoarseLag( const masKeyRgn_t* r, unsigned lagCnt, unsigned hopSmpCnt, const cmSample_t* ref, unsigned wndSmpCnt )
+{
+  double   minDist = DBL_MAX;
+  unsigned minLag  = 0;
+  unsigned j;
 
-  assert( afInfo0.srate == afInfo1.srate );
+  for(j=0; j<lagCnt; j+=kCoarseLagStep)
+  {
+    double dist = cmtKnDistanceStrided(r->buf + (size_t)j*hopSmpCnt, ref, wndSmpCnt, kCoarseSmpStride, minDist+1);
 
-  unsigned chCnt          = 1;
-  unsigned chIdx          = 0;
-  unsigned actFrmCnt      = 0;
-  unsigned wndSmpCnt      = floor(wndMs * afInfo0.srate / 1000);
-  unsigned hopSmpCnt      = floor(hopMs * afInfo0.srate / 1000);
-  unsigned smpIdx         = 0;
-  double   progIdx        = 0.01;
-  unsigned keyBegSmpIdx = floor(keyBegMs * afInfo1.srate / 1000);
-  unsigned keyEndSmpIdx = floor(keyEndMs * afInfo1.srate / 1000);
-  unsigned hopCnt       = keyEndSmpIdx==0 ? afInfo1.frameCnt / hopSmpCnt : (keyEndSmpIdx-keyBegSmpIdx) / hopSmpCnt;
+    if( dist < minDist )
+    {
+      minDist = dist;
+      minLag  = j;
+    }
+  }
 
-  // make wndSmpCnt an even multiple of hopSmpCnt
-  wndSmpCnt = (wndSmpCnt/hopSmpCnt) * hopSmpCnt;
+  return minLag;
+}
 
-  if( refBegMs != 0 )
-    smpIdx = floor(refBegMs * afInfo0.srate / 1000);
-  else
+// Score the lags of an in-memory key region beginning with the lag nearest the
+// predicted location 'predLag' and then fanning outward. The early abort bound
+// becomes tight after the first few windows so most later windows abort early.
+// Ties are resolved to the earliest lag so that the result is independent of the visiting order.
+void _masSlideMatchRgn( const masKeyRgn_t* r, unsigned lagCnt, unsigned hopSmpCnt, const cmSample_t* ref, unsigned wndSmpCnt, unsigned predLag, cmtPrgStage_t* prg, unsigned* minLagRef, double* minDistRef )
+{
+  double   minDist = DBL_MAX;
+  unsigned minLag  = 0;
+  int      lo      = (int)predLag - 1;
+  unsigned hi      = predLag;
+  unsigned visitCnt= 0;
+  unsigned prgCnt  = 0;  // count of visits already reported to 'prg'
+  double   progIdx = 0.01;
+
+  while( lo >= 0 || hi < lagCnt )
   {
-    if( afInfo0.frameCnt >= wndSmpCnt )
-      smpIdx = floor(afInfo0.frameCnt / 2 - wndSmpCnt/2);
-    else
+    unsigned k;
+
+    // visit predLag, predLag+1, predLag-1, predLag+2, predLag-2 ...
+    for(k=0; k<2; ++k)
     {
-      wndSmpCnt = afInfo0.frameCnt;
-      smpIdx    = 0;
+      unsigned j;
+
+      if( k == 0 )
+      {
+        if( hi >= lagCnt )
+          continue;
+        j = hi++;
+      }
+      else
+      {
+        if( lo < 0 )
+          continue;
+        j = lo--;
+      }
+
+      double dist = cmtKnDistance(r->buf + (size_t)j*hopSmpCnt, ref, wndSmpCnt, minDist+1);
+
+      if( dist < minDist || (dist == minDist && j < minLag) )
+      {
+        minDist = dist;
+        minLag  = j;
+      }
+
+      ++visitCnt;
+
+      if( visitCnt > progIdx*lagCnt )
+      {
+        printf("%i ",(int)(round(progIdx*100)));
+        fflush(stdout);
+        progIdx += 0.01;
+
+        cmtPrgUpdate(prg,(unsigned long long)(visitCnt-prgCnt)*hopSmpCnt,0,0);
+        prgCnt = visitCnt;
+      }
     }
   }
 
-  printf("wnd:%i hop:%i cnt:%i ref:%i\n",wndSmpCnt,hopSmpCnt,hopCnt,smpIdx);
+  cmtPrgUpdate(prg,(unsigned long long)(visitCnt-prgCnt)*hopSmpCnt,0,0);
 
+  *minLagRef  = minLag;
+  *minDistRef = minDist;
+}
 
-  // seek to the location of the reference window
-  if( cmAudioFileSeek( af0H, smpIdx ) != kOkAfRC )
-  {
-    rc = cmErrMsg(&ctx->err,kFailMasRC,"File seek failed while moving to ref. window in '%s'.",cmStringNullGuard(fn0));
-    goto errLabel;
-  }
+// Sync input file. Float32 (.f32) files are memory mapped and
+// their samples are used in place.  Other files are read through libcm.
+// The frame count of a float32 file may exceed the 32 bit info.frameCnt
+// and so src->frameCnt should be used in place of info.frameCnt.
+typedef struct
+{
+  cmAudioFileH_t    afH;
+  cmtF32H_t         f32H;
+  cmAudioFileInfo_t info;
+  long long         frameCnt;
+} masSrc_t;
 
-  // take the center of file 1 as the key window
-  if( cmAudioFileSeek( af1H, keyBegSmpIdx ) != kOkAfRC )
-  {
-    rc = cmErrMsg(&ctx->err,kFailMasRC,"File seek failed while moving to search begin location in '%s'.",cmStringNullGuard(fn1));
-    goto errLabel;
-  }
+masRC_t _masSrcOpen( cmCtx_t* ctx, masSrc_t* src, const cmChar_t* fn )
+{
+  masRC_t     rc = kOkMasRC;
+  cmRC_t      afRC;
+  cmtTrSpan_t sp;
 
-  // allocate the window buffers
-  buf0 = cmMemAllocZ(cmSample_t,wndSmpCnt); // reference window
-  buf1 = cmMemAllocZ(cmSample_t,wndSmpCnt); // sliding window
+  memset(src,0,sizeof(*src));
+  src->afH  = cmNullAudioFileH;
+  src->f32H = cmtF32NullHandle;
 
-  cmSample_t* bp0 = buf0;
-  cmSample_t* bp1 = buf1;
+  cmtTrBegin(&sp,kPhaseTrCat,"open",fn);
 
-  // fill the reference window - the other buffer will be compared to this widow
-  if( cmAudioFileReadSample(af0H, wndSmpCnt, chIdx, chCnt, &bp0, &actFrmCnt ) != kOkAfRC )
+  if( cmtF32IsFile(fn) )
   {
-    rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while reading the ref. window in '%s'.",cmStringNullGuard(fn0));
-    goto errLabel;
+    if( cmtF32Open(ctx,&src->f32H,fn) != kOkF32RC )
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The float32 file '%s' could not be mapped.",cmStringNullGuard(fn));
+    else
+    {
+      src->frameCnt      = cmtF32Info(src->f32H)->frameCnt;
+      src->info.srate    = cmtF32Info(src->f32H)->srate;
+      src->info.frameCnt = (unsigned)cmMin(src->frameCnt,(long long)UINT_MAX);
+      src->info.chCnt    = 1;
+      src->info.bits     = 32;
+    }
   }
-
-  // fill all except the last hopSmpCnt samples in the sliding window
-  if( cmAudioFileReadSample(af1H, wndSmpCnt-hopSmpCnt, chIdx, chCnt, &bp1, &actFrmCnt ) != kOkAfRC )
+  else
   {
-    rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while making the first search area read in '%s'.",cmStringNullGuard(fn1));
-    goto errLabel;
+    if( cmAudioFileIsValid( src->afH = cmAudioFileNewOpen(fn,&src->info,&afRC, &ctx->rpt ))==false)
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The audio file '%s' could not be opened.",cmStringNullGuard(fn));
+    else
+      src->frameCnt = src->info.frameCnt;
   }
 
-  smpIdx    = keyBegSmpIdx;
-  bp1       = buf1 + (wndSmpCnt - hopSmpCnt);
-  minSmpIdx = smpIdx;
+  cmtTrEnd(&sp);
+  return rc;
+}
 
-  unsigned i         = 0;
+void _masSrcClose( masSrc_t* src )
+{
+  cmtF32Close(&src->f32H);
 
-  do
-  {
-    // read the new samples into the last hopSmpCnt ele's of the sliding buffer 
-    if( cmAudioFileReadSample(af1H, hopSmpCnt, chIdx, chCnt, &bp1, &actFrmCnt ) != kOkAfRC )
-      break;
+  if( cmAudioFileIsValid(src->afH) )
+    cmAudioFileDelete(&src->afH);
+}
 
-    // compare the sliding window to the ref. window
-    double dist = distance(buf1,buf0,wndSmpCnt,minDist+1);
+bool _masSrcIsMapped( const masSrc_t* src )
+{ return cmtF32IsValid(src->f32H); }
 
-    // record the min dist
-    if( dist < minDist )
-    {
-      //printf("%i %f %f %f\n",minSmpIdx,minDist,dist,minDist-dist);
-      minSmpIdx = smpIdx;
-      minDist   = dist;
-    }
+// Count of file bytes which hold 'smpCnt' frames of 'src'.
+unsigned long long _masSrcByteCnt( const masSrc_t* src, long long smpCnt )
+{
+  if( _masSrcIsMapped(src) )
+    return (unsigned long long)smpCnt * sizeof(cmSample_t);
 
-    smpIdx += hopSmpCnt;
+  return (unsigned long long)smpCnt * src->info.chCnt * src->info.bits / 8;
+}
 
-    // shift off the expired samples
-    memmove(buf1, buf1 + hopSmpCnt, (wndSmpCnt-hopSmpCnt)*sizeof(cmSample_t));
-        
-    ++i;
+// Return the samples [smpIdx,smpIdx+smpCnt). Mapped files return a pointer into
+// the file otherwise the samples are read into buf[smpCnt].
+// Returns NULL if the samples could not be read.
+// Note that the frame indexes of audio files are limited to 32 bits by
+// libcm and so only mapped files may be longer than 2^32 samples.
+const cmSample_t* _masSrcSamples( masSrc_t* src, long long smpIdx, long long smpCnt, cmSample_t* buf )
+{
+  unsigned actFrmCnt = 0;
 
-    if( i > progIdx*hopCnt  )
-    {
-      printf("%i ",(int)(round(progIdx*100)));
-      fflush(stdout);
-      progIdx += 0.01;
-    }
+  if( smpIdx < 0 || smpCnt < 0 || smpIdx + smpCnt > src->frameCnt )
+    return NULL;
 
-    
-  }while(i<hopCnt && actFrmCnt == hopSmpCnt && (keyEndSmpIdx==0 || smpIdx < keyEndSmpIdx) );
+  if( _masSrcIsMapped(src) )
+    return cmtF32Samples(src->f32H) + smpIdx;
+
+  cmtTrSpan_t sp;
+  cmtTrBegin(&sp,kPhaseTrCat,"decode",NULL);
+
+  bool fl = cmAudioFileSeek(src->afH,(unsigned)smpIdx) == kOkAfRC && cmAudioFileReadSample(src->afH, (unsigned)smpCnt, 0, 1, &buf, &actFrmCnt ) == kOkAfRC && actFrmCnt == smpCnt;
+
+  cmtTrEnd(&sp);
+
+  return fl ? buf : NULL;
+}
+
+// Refine the hop aligned match at *minSmpIdxRef to the sample level.
+// Every window which begins within one hop of the match is compared.  The
+// windows are first scanned at kRefineStepMs intervals so that the best
+// step bounds the distance and most of the remaining windows are abandoned
+// early by cmtKnDistance().  The search is limited to [loSmpIdx, frameCnt-wndSmpCnt].
+masRC_t _masRefineLag( cmCtx_t* ctx, masSrc_t* src, const cmChar_t* fn, const cmSample_t* ref, unsigned wndSmpCnt, unsigned hopSmpCnt, long long loSmpIdx, long long* minSmpIdxRef, double* minDistRef )
+{
+  enum { kRefineStepMs = 1 };
+
+  long long         frameCnt  = src->frameCnt;
+  long long         c         = *minSmpIdxRef;
+  unsigned          stepSmpCnt= cmMax(1, cmMin(hopSmpCnt, (unsigned)floor(kRefineStepMs * src->info.srate / 1000)));
+  cmSample_t*       rdBuf     = NULL;
+  const cmSample_t* buf       = NULL;
+  masRC_t           rc        = kOkMasRC;
+
+  if( hopSmpCnt <= 1 || frameCnt < wndSmpCnt )
+    return rc;
+
+  // the range of window begin indexes [bi,ei]
+  long long bi = c >= loSmpIdx + hopSmpCnt ? c - hopSmpCnt : cmMin(c,loSmpIdx);
+  long long ei = cmMin(c + hopSmpCnt, frameCnt - wndSmpCnt);
+
+  if( ei <= bi )
+    return rc;
+
+  unsigned n = ei - bi + wndSmpCnt;
+
+  if( _masSrcIsMapped(src) == false )
+    rdBuf = cmMemAllocZ(cmSample_t,n);
+
+  if((buf = _masSrcSamples(src,bi,n,rdBuf)) == NULL )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while refining the match in '%s'.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  // scan the range in steps which include the hop aligned match
+  double    minDist = DBL_MAX;
+  long long minIdx  = c;
+  long long k       = c - ((c - bi) / stepSmpCnt) * stepSmpCnt;
+
+  for(; k<=ei; k+=stepSmpCnt)
+  {
+    double dist = cmtKnDistance(buf + (k-bi), ref, wndSmpCnt, minDist+1);
+
+    if( dist < minDist )
+    {
+      minDist = dist;
+      minIdx  = k;
+    }
+  }
+
+  // compare every window in the range - the first minimum is kept
+  for(k=bi; k<=ei; ++k)
+  {
+    double dist = cmtKnDistance(buf + (k-bi), ref, wndSmpCnt, minDist+1);
+
+    if( dist < minDist || (dist == minDist && k < minIdx) )
+    {
+      minDist = dist;
+      minIdx  = k;
+    }
+  }
+
+  // the refined match replaces the hop aligned match only if it is closer
+  if( minDist < *minDistRef )
+  {
+    *minSmpIdxRef = minIdx;
+    *minDistRef   = minDist;
+  }
+
+ errLabel:
+  cmMemFree(rdBuf);
+  return rc;
+}
+
+// Form a reference window from file 0 at s->refWndBegSecs:s->refWndBegSecs + s->refWndSecs.
+// Compare each window in file 1 to this window and record the closest match.
+// The search ends at keyEndSecs (or the end of file 1 if keyEndSecs is 0).
+//
+// If the key search region is mapped or is no longer than kMaxKeyRgnSmpCnt it is read once and the
+// windows are visited beginning at 'predSecs' (the predicted location
+// in file 1 of the reference window). If 'predSecs' is negative a coarse
+// pass over the region is used to form the prediction. Larger regions are
+// scanned from left to right while streaming file 1.
+// Notes:
+// fn0 = midi file
+// fn1 = audio file
+masRC_t slide_match( cmCtx_t* ctx, const cmChar_t* fn0, const cmChar_t* fn1, syncRecd_t* s, double hopMs, double keyEndSecs, double predSecs )
+{
+  masRC_t            rc        = kOkMasRC;
+  masSrc_t           src0;
+  masSrc_t           src1;
+  cmtAfRdH_t         rdH       = cmtAfRdNullHandle;
+  cmSample_t        *buf0      = NULL;
+  cmSample_t        *buf1      = NULL;
+  cmSample_t        *rgnBuf    = NULL;
+  const cmSample_t  *ref       = NULL;
+  long long          minSmpIdx = kInvalidSmpIdx;
+  double             minDist   = DBL_MAX;
+  masKeyRgn_t        rgn;
+  cmtPrgStage_t      prg;
+
+  memset(&rgn,0,sizeof(rgn));
+
+  // the stage samples are the key samples searched
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"slide_match",fn1,0);
+
+  if( _masSrcOpen(ctx,&src0,fn0) != kOkMasRC )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The ref. audio file could not be opened.",cmStringNullGuard(fn0));
+    cmtPrgEnd(&prg,rc);
+    return rc;
+  }
+
+  if( _masSrcOpen(ctx,&src1,fn1) != kOkMasRC )
+  {
+    rc =  cmErrMsg(&ctx->err,kFailMasRC,"The key audio file could not be opened.",cmStringNullGuard(fn1));
+    goto errLabel;
+  }
+
+  cmAudioFileInfo_t afInfo0 = src0.info;
+  cmAudioFileInfo_t afInfo1 = src1.info;
+
+  assert( afInfo0.srate == afInfo1.srate );
+
+  // the window locations are calculated from seconds to retain sub-millisecond precision
+  unsigned  chCnt        = 1;
+  unsigned  chIdx        = 0;
+  unsigned  actFrmCnt    = 0;
+  unsigned  wndSmpCnt    = floor(s->refWndSecs * afInfo0.srate);
+  unsigned  hopSmpCnt    = floor(hopMs * afInfo0.srate / 1000);
+  long long smpIdx       = 0;
+  double    progIdx      = 0.01;
+  long long keyBegSmpIdx = floor(s->keyBegSecs * afInfo1.srate);
+  long long keyEndSmpIdx = floor(keyEndSecs    * afInfo1.srate);
+  long long hopCnt       = 0;
+
+  if( hopSmpCnt == 0 )
+  {
+    rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The sync hop is shorter than one sample.");
+    goto errLabel;
+  }
+
+  hopCnt = keyEndSmpIdx==0 ? src1.frameCnt / hopSmpCnt : (keyEndSmpIdx-keyBegSmpIdx) / hopSmpCnt;
+
+  // the lags are counted with 32 bit integers
+  if( hopCnt > UINT_MAX )
+  {
+    rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The sync hop (%f ms) is too short for the key search range in '%s'.",hopMs,cmStringNullGuard(fn1));
+    goto errLabel;
+  }
+
+  // make wndSmpCnt an even multiple of hopSmpCnt
+  wndSmpCnt = (wndSmpCnt/hopSmpCnt) * hopSmpCnt;
+
+  if( s->refWndBegSecs != 0 )
+    smpIdx = floor(s->refWndBegSecs * afInfo0.srate);
+  else
+  {
+    if( src0.frameCnt >= wndSmpCnt )
+      smpIdx = src0.frameCnt / 2 - wndSmpCnt/2;
+    else
+    {
+      wndSmpCnt = src0.frameCnt;
+      smpIdx    = 0;
+    }
+  }
+
+  printf("wnd:%i hop:%i cnt:%lli ref:%lli\n",wndSmpCnt,hopSmpCnt,hopCnt,smpIdx);
+
+  prg.totalSmpCnt = hopCnt * hopSmpCnt;
+
+
+  // allocate the window buffers
+  buf0 = cmMemAllocZ(cmSample_t,wndSmpCnt); // reference window
+  buf1 = cmMemAllocZ(cmSample_t,wndSmpCnt); // sliding window
+
+  cmSample_t* bp1 = buf1;
+
+  // fill the reference window - the other buffer will be compared to this widow
+  if((ref = _masSrcSamples(&src0,smpIdx,wndSmpCnt,buf0)) == NULL )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while reading the ref. window in '%s'.",cmStringNullGuard(fn0));
+    goto errLabel;
+  }
+
+  cmtPrgUpdate(&prg,0,_masSrcByteCnt(&src0,wndSmpCnt),0);
+
+  // count the lags which begin before keyEndSmpIdx and whose window fits in file 1
+  unsigned lagCnt = hopCnt;
+
+  if( keyEndSmpIdx != 0 )
+    lagCnt = cmMin((long long)lagCnt, (keyEndSmpIdx - keyBegSmpIdx + hopSmpCnt - 1) / hopSmpCnt);
+
+  if( keyBegSmpIdx + wndSmpCnt <= src1.frameCnt )
+    lagCnt = cmMin((long long)lagCnt, (src1.frameCnt - keyBegSmpIdx - wndSmpCnt) / hopSmpCnt + 1);
+  else
+    lagCnt = 0;
+
+  // if the key search region is mapped or fits in memory then search it in order of likelihood
+  if( lagCnt > 0 && (_masSrcIsMapped(&src1) || (long long)(lagCnt-1) * hopSmpCnt + wndSmpCnt <= kMaxKeyRgnSmpCnt) )
+  {
+    unsigned predLag;
+
+    rgn.begSmpIdx = keyBegSmpIdx;
+    rgn.smpCnt    = (long long)(lagCnt-1) * hopSmpCnt + wndSmpCnt;
+
+    if( _masSrcIsMapped(&src1) == false )
+      rgnBuf = cmMemAllocZ(cmSample_t,rgn.smpCnt);
+
+    if((rgn.buf = _masSrcSamples(&src1,keyBegSmpIdx,rgn.smpCnt,rgnBuf)) == NULL )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while reading the search area in '%s'.",cmStringNullGuard(fn1));
+      goto errLabel;
+    }
+
+    cmtPrgUpdate(&prg,0,_masSrcByteCnt(&src1,rgn.smpCnt),0);
+
+    // convert the predicted location to a lag or make a coarse pass to predict it
+    if( predSecs >= 0 )
+    {
+      double lag = (predSecs * afInfo1.srate - (double)keyBegSmpIdx) / hopSmpCnt;
+      predLag = lag <= 0 ? 0 : cmMin(lagCnt-1, (unsigned)round(lag));
+    }
+    else
+    {
+      predLag = _masCoarseLag(&rgn,lagCnt,hopSmpCnt,ref,wndSmpCnt);
+    }
+
+    unsigned    minLag;
+    cmtTrSpan_t sp;
+
+    cmtTrBegin(&sp,kPhaseTrCat,"search",fn1);
+    _masSlideMatchRgn(&rgn,lagCnt,hopSmpCnt,ref,wndSmpCnt,predLag,&prg,&minLag,&minDist);
+    cmtTrEnd(&sp);
+
+    minSmpIdx = keyBegSmpIdx + (long long)minLag*hopSmpCnt;
+  }
+  else
+  {
+    // move to the start of the search area (unmapped files are shorter than 2^32 samples)
+    if( cmAudioFileSeek( src1.afH, (unsigned)keyBegSmpIdx ) != kOkAfRC )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"File seek failed while moving to search begin location in '%s'.",cmStringNullGuard(fn1));
+      goto errLabel;
+    }
+
+    // fill all except the last hopSmpCnt samples in the sliding window
+    if( cmAudioFileReadSample(src1.afH, wndSmpCnt-hopSmpCnt, chIdx, chCnt, &bp1, &actFrmCnt ) != kOkAfRC )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while making the first search area read in '%s'.",cmStringNullGuard(fn1));
+      goto errLabel;
+    }
+
+    smpIdx    = keyBegSmpIdx;
+    bp1       = buf1 + (wndSmpCnt - hopSmpCnt);
+    minSmpIdx = smpIdx;
+
+    // read the remainder of the search area on a separate thread
+    if( cmtAfRdCreate(ctx,&rdH,src1.afH,fn1,chIdx,hopSmpCnt,kMasAfsBlkCnt,(unsigned)cmMin(hopCnt*hopSmpCnt,(long long)UINT_MAX)) != kOkAfsRC )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The search area reader could not be created for '%s'.",cmStringNullGuard(fn1));
+      goto errLabel;
+    }
+
+    unsigned    i      = 0;
+    unsigned    prgIdx = 0;  // count of hops already reported to 'prg'
+    cmtTrSpan_t sp;
+
+    cmtTrBegin(&sp,kPhaseTrCat,"search",fn1);
+
+    cmtPrgUpdate(&prg,0,_masSrcByteCnt(&src1,actFrmCnt),0);
+
+    do
+    {
+      const cmSample_t* hopBuf = NULL;
+
+      // copy the new samples into the last hopSmpCnt ele's of the sliding buffer 
+      if( cmtAfRdGet(rdH, &hopBuf, &actFrmCnt ) != kOkAfsRC || actFrmCnt == 0 )
+        break;
+
+      memcpy(bp1, hopBuf, actFrmCnt*sizeof(cmSample_t));
+
+      // compare the sliding window to the ref. window
+      double dist = cmtKnDistance(buf1,ref,wndSmpCnt,minDist+1);
+
+      // record the min dist
+      if( dist < minDist )
+      {
+        //printf("%i %f %f %f\n",minSmpIdx,minDist,dist,minDist-dist);
+        minSmpIdx = smpIdx;
+        minDist   = dist;
+      }
+
+      smpIdx += hopSmpCnt;
+
+      // shift off the expired samples
+      memmove(buf1, buf1 + hopSmpCnt, (wndSmpCnt-hopSmpCnt)*sizeof(cmSample_t));
+        
+      ++i;
+
+      if( i > progIdx*hopCnt  )
+      {
+        printf("%i ",(int)(round(progIdx*100)));
+        fflush(stdout);
+        progIdx += 0.01;
+
+        cmtPrgUpdate(&prg,(unsigned long long)(i-prgIdx)*hopSmpCnt,_masSrcByteCnt(&src1,(long long)(i-prgIdx)*hopSmpCnt),0);
+        prgIdx = i;
+      }
+
+    
+    }while(i<hopCnt && actFrmCnt == hopSmpCnt && (keyEndSmpIdx==0 || smpIdx < keyEndSmpIdx) );
+
+    cmtPrgUpdate(&prg,(unsigned long long)(i-prgIdx)*hopSmpCnt,_masSrcByteCnt(&src1,(long long)(i-prgIdx)*hopSmpCnt),0);
+
+    cmtTrEnd(&sp);
+
+    cmtAfsReport(&ctx->rpt,"\nI/O",rdH,cmtAfWrNullHandle);
+
+    // release the key file for the refinement stage
+    cmtAfRdDestroy(&rdH);
+  }
+
+  // refine the hop aligned match to the sample level
+  if( minSmpIdx != kInvalidSmpIdx )
+  {
+    cmtTrSpan_t sp;
+    cmtTrBegin(&sp,kPhaseTrCat,"refine",fn1);
+    rc = _masRefineLag(ctx,&src1,fn1,ref,wndSmpCnt,hopSmpCnt,keyBegSmpIdx,&minSmpIdx,&minDist);
+    cmtTrEnd(&sp);
+  }
 
  errLabel:
 
@@ -1045,16 +1819,12 @@ masRC_t slide_match( cmCtx_t* ctx, const cmChar_t* fn0, const cmChar_t* fn1, syn
       cmBinMtxFile_t* bf0p = cmBinMtxFileAlloc(ctxp,NULL,"/home/kevin/temp/bf0.bin");
       cmBinMtxFile_t* bf1p = cmBinMtxFileAlloc(ctxp,NULL,"/home/kevin/temp/bf1.bin");
 
-      if( cmAudioFileSeek( af1H, minSmpIdx ) != kOkAfRC )
-        goto errLabel;
-
-      bp1 = buf1;
-      if( cmAudioFileReadSample(af1H, wndSmpCnt, chIdx, chCnt, &bp1, &actFrmCnt ) != kOkAfRC )
+      if( _masSrcSamples(&src1,minSmpIdx,wndSmpCnt,buf1) != buf1 )
         goto errLabel;
 
 
       cmBinMtxFileExecS(bf1p,buf1,wndSmpCnt);
-      cmBinMtxFileExecS(bf0p,buf0,wndSmpCnt);
+      cmBinMtxFileExecS(bf0p,ref,wndSmpCnt);
       cmBinMtxFileFree(&bf0p);
       cmBinMtxFileFree(&bf1p);
       cmCtxFree(&ctxp);
@@ -1062,33 +1832,414 @@ masRC_t slide_match( cmCtx_t* ctx, const cmChar_t* fn0, const cmChar_t* fn1, syn
 
   cmMemPtrFree(&buf0);
   cmMemPtrFree(&buf1);
-  cmAudioFileDelete(&af0H);
-  cmAudioFileDelete(&af1H);
+  cmMemPtrFree(&rgnBuf);
+  cmtAfRdDestroy(&rdH);
 
   s->syncDist    = minDist;
   s->keySyncIdx  = minSmpIdx;
-  s->refSmpCnt   = afInfo0.frameCnt;
-  s->keySmpCnt   = afInfo1.frameCnt;
-  s->srate       = afInfo1.srate;
+  s->refSmpCnt   = src0.frameCnt;
+  s->keySmpCnt   = src1.frameCnt;
+  s->srate       = src1.info.srate;
+
+  cmtPrgEnd(&prg,rc);
+
+  _masSrcClose(&src0);
+  _masSrcClose(&src1);
+  return rc;
+}
+
+
+// Decimate x[n] in place by averaging blocks of d samples.
+// Returns the count of samples in the decimated signal.
+unsigned _masDecimate( cmSample_t* x, unsigned n, unsigned d )
+{
+  unsigned i,j,m;
+
+  if( d <= 1 )
+    return n;
+
+  for(i=0,m=n/d; i<m; ++i)
+  {
+    double sum = 0;
+    for(j=0; j<d; ++j)
+      sum += x[i*d+j];
+    x[i] = sum / d;
+  }
+
+  return m;
+}
+
+// Fit keySecs = driftOffsSecs + driftRate * refSecs to the matched anchors
+// with least squares and store the residual of each anchor.
+void _masFitAnchorDrift( anchorSetRecd_t* a )
+{
+  double   sx  = 0, sy = 0, sxx = 0, sxy = 0;
+  unsigned n   = 0;
+  unsigned i;
+
+  a->driftOffsSecs = 0;
+  a->driftRate     = 1;
+
+  for(i=0; i<a->anchorCnt; ++i)
+    if( a->anchorArray[i].keySyncIdx != kInvalidSmpIdx )
+    {
+      double x = a->anchorArray[i].refSmpIdx  / a->srate;
+      double y = a->anchorArray[i].keySyncIdx / a->srate;
+      sx  += x;
+      sy  += y;
+      sxx += x*x;
+      sxy += x*y;
+      ++n;
+    }
+
+  if( n == 0 )
+    return;
+
+  double d = n*sxx - sx*sx;
+
+  // with a single anchor (or coincident anchors) only the offset can be estimated
+  if( n > 1 && d > 0 )
+    a->driftRate = (n*sxy - sx*sy) / d;
+
+  a->driftOffsSecs = (sy - a->driftRate * sx) / n;
+
+  for(i=0; i<a->anchorCnt; ++i)
+  {
+    anchorRecd_t* ar = a->anchorArray + i;
+    if( ar->keySyncIdx != kInvalidSmpIdx )
+      ar->residSecs = ar->keySyncIdx/a->srate - (a->driftOffsSecs + a->driftRate * ar->refSmpIdx/a->srate);
+  }
+}
+
+// Match every reference window (anchor) of a multi-anchor record against a
+// single key search range. The key search range is read and decimated once and
+// all of the anchors are scored at each lag in a single pass over the key buffer.
+// Mapped key files which are not decimated are used in place. Otherwise the
+// key search range is read and decimated in blocks of at most kMaxKeyRgnSmpCnt
+// samples so that the range may be longer than the available memory.
+// The lags and window lengths follow slide_match() so that with decim==1 each
+// anchor gives the same result as an equivalent 'sync_array' record.
+// Notes:
+// fn0 = midi file
+// fn1 = audio file
+masRC_t anchor_match( cmCtx_t* ctx, const cmChar_t* fn0, const cmChar_t* fn1, anchorSetRecd_t* a, double hopMs, double keyEndSecs, unsigned decim )
+{
+  masRC_t            rc        = kOkMasRC;
+  masSrc_t           src0;
+  masSrc_t           src1;
+  cmSample_t*        keyBuf    = NULL;
+  const cmSample_t*  keyV      = NULL;
+  cmSample_t**       refBufV   = NULL;  // refBufV[anchorCnt] decimated ref. windows
+  unsigned*          wndCntV   = NULL;  // wndCntV[anchorCnt] decimated ref. window lengths
+  double*            minDistV  = NULL;  // minDistV[anchorCnt]
+  long long*         minLagV   = NULL;  // minLagV[anchorCnt]
+  unsigned           i;
+  long long          j,j0;
+  cmtPrgStage_t      prg;
+
+  if( a->anchorCnt == 0 )
+    return rc;
+
+  // the stage samples are the key samples searched
+  cmtPrgBegin(_masPrgH,&prg,_masPrgParent,"anchor_match",fn1,0);
+
+  if( _masSrcOpen(ctx,&src0,fn0) != kOkMasRC )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The ref. audio file '%s' could not be opened.",cmStringNullGuard(fn0));
+    cmtPrgEnd(&prg,rc);
+    return rc;
+  }
+
+  if( _masSrcOpen(ctx,&src1,fn1) != kOkMasRC )
+  {
+    rc =  cmErrMsg(&ctx->err,kFailMasRC,"The key audio file '%s' could not be opened.",cmStringNullGuard(fn1));
+    goto errLabel;
+  }
+
+  cmAudioFileInfo_t afInfo0 = src0.info;
+  cmAudioFileInfo_t afInfo1 = src1.info;
+
+  assert( afInfo0.srate == afInfo1.srate );
+
+  refBufV  = cmMemAllocZ(cmSample_t*,a->anchorCnt);
+  wndCntV  = cmMemAllocZ(unsigned,   a->anchorCnt);
+  minDistV = cmMemAllocZ(double,     a->anchorCnt);
+  minLagV  = cmMemAllocZ(long long,  a->anchorCnt);
+
+  unsigned  hopSmpCnt    = floor(hopMs * afInfo0.srate / 1000);
+  long long keyBegSmpIdx = floor(a->keyBegSecs * afInfo1.srate);
+  long long keyEndSmpIdx = keyEndSecs==0 ? src1.frameCnt : (long long)floor(keyEndSecs * afInfo1.srate);
+  unsigned  maxWndCnt    = 0;
+
+  if( hopSmpCnt == 0 )
+  {
+    rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The sync hop is shorter than one sample.");
+    goto errLabel;
+  }
+
+  if( keyEndSmpIdx > src1.frameCnt )
+    keyEndSmpIdx = src1.frameCnt;
+
+  if( keyBegSmpIdx >= keyEndSmpIdx )
+  {
+    rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The key search range %f to %f seconds is empty in '%s'.",a->keyBegSecs,keyEndSmpIdx/afInfo1.srate,cmStringNullGuard(fn1));
+    goto errLabel;
+  }
+
+  // the decimation factor must evenly divide the hop
+  if( decim == 0 )
+    decim = 1;
+
+  while( decim > 1 && hopSmpCnt % decim != 0 )
+    --decim;
+
+  // read and decimate each reference window
+  for(i=0; i<a->anchorCnt; ++i)
+  {
+    anchorRecd_t* ar        = a->anchorArray + i;
+    unsigned      wndSmpCnt = floor(ar->refWndSecs * afInfo0.srate);
+    long long     smpIdx    = 0;
+    const cmSample_t* bp;
+
+    // make wndSmpCnt an even multiple of hopSmpCnt
+    wndSmpCnt = (wndSmpCnt/hopSmpCnt) * hopSmpCnt;
+
+    if( ar->refWndBegSecs != 0 )
+      smpIdx = floor(ar->refWndBegSecs * afInfo0.srate);
+    else
+    {
+      if( src0.frameCnt >= wndSmpCnt )
+        smpIdx = src0.frameCnt / 2 - wndSmpCnt/2;
+      else
+        wndSmpCnt = src0.frameCnt;
+    }
+
+    if( wndSmpCnt < decim )
+    {
+      rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The reference window of anchor %i is shorter than the sync hop.",i);
+      goto errLabel;
+    }
+
+    refBufV[i] = cmMemAllocZ(cmSample_t,wndSmpCnt);
+
+    // the window is decimated in place so mapped samples are copied
+    if((bp = _masSrcSamples(&src0,smpIdx,wndSmpCnt,refBufV[i])) == NULL )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while reading ref. window %i in '%s'.",i,cmStringNullGuard(fn0));
+      goto errLabel;
+    }
+
+    if( bp != refBufV[i] )
+      memcpy(refBufV[i],bp,wndSmpCnt*sizeof(cmSample_t));
+
+    cmtPrgUpdate(&prg,0,_masSrcByteCnt(&src0,wndSmpCnt),0);
+
+    ar->refSmpIdx = smpIdx;
+    wndCntV[i]    = _masDecimate(refBufV[i],wndSmpCnt,decim);
+    minDistV[i]   = DBL_MAX;
+    maxWndCnt     = cmMax(maxWndCnt,wndSmpCnt);
+  }
+
+  // As in slide_match() the last window begins before keyEndSmpIdx but may extend past it.
+  long long keyRgnSmpCnt = cmMin(src1.frameCnt - keyBegSmpIdx, (keyEndSmpIdx - keyBegSmpIdx) + maxWndCnt);
+  long long lagCnt       = (keyEndSmpIdx - keyBegSmpIdx + hopSmpCnt - 1) / hopSmpCnt;
+  long long blkLagCnt    = lagCnt;
+  unsigned  hopN         = hopSmpCnt / decim;
+
+  // Mapped samples are used in place unless they must be decimated.
+  if( _masSrcIsMapped(&src1) == false || decim > 1 )
+  {
+    if( maxWndCnt + hopSmpCnt < kMaxKeyRgnSmpCnt )
+      blkLagCnt = cmMin(lagCnt, (kMaxKeyRgnSmpCnt - maxWndCnt) / hopSmpCnt + 1);
+    else
+      blkLagCnt = 1;
+
+    keyBuf = cmMemAllocZ(cmSample_t,cmMin(keyRgnSmpCnt,(blkLagCnt-1)*hopSmpCnt + maxWndCnt));
+  }
+
+  printf("anchors:%i hop:%i lags:%lli blk:%lli decim:%i\n",a->anchorCnt,hopSmpCnt,lagCnt,blkLagCnt,decim);
+
+  prg.totalSmpCnt = lagCnt * hopSmpCnt;
+
+  // Each block holds the key windows of lags j0 to j0+blkLagCnt-1. Blocks begin
+  // on a hop boundary and so the decimation of a block matches the decimation of
+  // the whole key search range.
+  for(j0=0; j0<lagCnt; j0+=blkLagCnt)
+  {
+    long long bi   = keyBegSmpIdx + j0*hopSmpCnt;
+    long long n    = cmMin(keyBegSmpIdx + keyRgnSmpCnt - bi, (blkLagCnt-1)*hopSmpCnt + maxWndCnt);
+    long long keyN = n;
+    long long jn   = cmMin(blkLagCnt, lagCnt - j0);
+
+    if((keyV = _masSrcSamples(&src1,bi,n,keyBuf)) == NULL )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"Audio file read failed while reading the search area in '%s'.",cmStringNullGuard(fn1));
+      goto errLabel;
+    }
+
+    if( decim > 1 )
+    {
+      if( keyV != keyBuf )
+        memcpy(keyBuf,keyV,n*sizeof(cmSample_t));
+
+      keyN = _masDecimate(keyBuf,(unsigned)n,decim);
+      keyV = keyBuf;
+    }
+
+    cmtTrSpan_t sp;
+    cmtTrBegin(&sp,kPhaseTrCat,"search",fn1);
+
+    // score every anchor at each lag - the key window at lag j is shared by all anchors
+    for(j=0; j<jn; ++j)
+    {
+      const cmSample_t* kp = keyV + j*hopN;
+
+      for(i=0; i<a->anchorCnt; ++i)
+        if( j*hopN + wndCntV[i] <= keyN )
+        {
+          double dist = cmtKnDistance(kp,refBufV[i],wndCntV[i],minDistV[i]+1);
+
+          if( dist < minDistV[i] )
+          {
+            minDistV[i] = dist;
+            minLagV[i]  = j0 + j;
+          }
+        }
+    }
+
+    cmtTrEnd(&sp);
+
+    cmtPrgUpdate(&prg,(unsigned long long)jn*hopSmpCnt,_masSrcByteCnt(&src1,n),0);
+  }
+
+  a->refSmpCnt = src0.frameCnt;
+  a->keySmpCnt = src1.frameCnt;
+  a->srate     = afInfo1.srate;
+
+  for(i=0; i<a->anchorCnt; ++i)
+  {
+    anchorRecd_t* ar = a->anchorArray + i;
+
+    if( minDistV[i] == DBL_MAX )
+    {
+      cmErrWarnMsg(&ctx->err,kParamErrMasRC,"Anchor %i did not fit inside the key search range of '%s'.",i,cmStringNullGuard(fn1));
+      ar->keySyncIdx = kInvalidSmpIdx;
+      ar->syncDist   = DBL_MAX;
+      continue;
+    }
+
+    // scale the decimated distance to approximate the full rate distance
+    ar->keySyncIdx = keyBegSmpIdx + minLagV[i] * hopSmpCnt;
+    ar->syncDist   = minDistV[i] * decim;
+    ar->offsetSecs = ((double)ar->keySyncIdx - ar->refSmpIdx) / a->srate;
+  }
+
+  _masFitAnchorDrift(a);
+
+ errLabel:
+
+  if( refBufV != NULL )
+    for(i=0; i<a->anchorCnt; ++i)
+      cmMemFree(refBufV[i]);
+
+  cmMemPtrFree(&refBufV);
+  cmMemPtrFree(&wndCntV);
+  cmMemPtrFree(&minDistV);
+  cmMemPtrFree(&minLagV);
+  cmMemPtrFree(&keyBuf);
+  cmtPrgEnd(&prg,rc);
+  _masSrcClose(&src0);
+  _masSrcClose(&src1);
   return rc;
 }
 
 
+// Parse the 'anchor_array' multi-anchor records.
+//    [ <ref_fn> [ [<wnd_beg_secs> <wnd_dur_secs>] ... ] <key_fn> <key_beg_secs> <key_end_secs> ]
+masRC_t _masParseAnchorArray( cmCtx_t* c, const cmChar_t* fn, cmJsonNode_t* arr, syncCtx_t* scp )
+{
+  unsigned i,j;
+
+  if((scp->anchorSetCnt = cmJsonChildCount(arr)) == 0 )
+    return kOkMasRC;
+
+  scp->anchorSetArray = cmMemAllocZ(anchorSetRecd_t,scp->anchorSetCnt);
+
+  for(i=0; i<scp->anchorSetCnt; ++i)
+  {
+    cmJsonNode_t*    ele  = cmJsonArrayElement(arr,i);
+    anchorSetRecd_t* a    = scp->anchorSetArray + i;
+    cmJsonNode_t*    wndA = NULL;
+    const int        kFive = 5;
+
+    if( cmJsonIsArray(ele) == false || cmJsonChildCount(ele) != kFive )
+      return cmErrMsg(&c->err,kJsonFailMasRC,"An 'anchor_array' element record at index %i is not a 5 element array in '%s'.",i,fn);
+
+    wndA = cmJsonArrayElement(ele,1);
+
+    if( cmJsonStringValue( cmJsonArrayElement(ele,0), &a->refFn )      != kOkJsRC
+      || cmJsonIsArray(wndA) == false
+      || cmJsonStringValue( cmJsonArrayElement(ele,2), &a->keyFn )      != kOkJsRC
+      || cmJsonRealValue(   cmJsonArrayElement(ele,3), &a->keyBegSecs ) != kOkJsRC
+      || cmJsonRealValue(   cmJsonArrayElement(ele,4), &a->keyEndSecs ) != kOkJsRC )
+    {
+      return cmErrMsg(&c->err,kJsonFailMasRC,"The 'anchor_array' element record at index %i is not valid in '%s'.",i,fn);
+    }
+
+    if((a->anchorCnt = cmJsonChildCount(wndA)) == 0 )
+      return cmErrMsg(&c->err,kJsonFailMasRC,"The 'anchor_array' element record at index %i has no anchor windows in '%s'.",i,fn);
+
+    a->anchorArray = cmMemAllocZ(anchorRecd_t,a->anchorCnt);
+
+    for(j=0; j<a->anchorCnt; ++j)
+    {
+      cmJsonNode_t* wnd = cmJsonArrayElement(wndA,j);
+
+      if( cmJsonIsArray(wnd) == false || cmJsonChildCount(wnd) != 2
+        || cmJsonRealValue( cmJsonArrayElement(wnd,0), &a->anchorArray[j].refWndBegSecs ) != kOkJsRC
+        || cmJsonRealValue( cmJsonArrayElement(wnd,1), &a->anchorArray[j].refWndSecs )    != kOkJsRC )
+      {
+        return cmErrMsg(&c->err,kJsonFailMasRC,"The anchor window at index %i of the 'anchor_array' record at index %i is not a 2 element array in '%s'.",j,i,fn);
+      }
+    }
+  }
+
+  return kOkMasRC;
+}
+
 //
 // {
 //  sync_array:
 //  {
 //    { <ref_fn> <wnd_beg_secs> <wnd_dur_secs> <key_fn> <key_beg_secs> }
 //  }
+//  anchor_array:  (optional)
+//  {
+//    { <ref_fn> [ [<wnd_beg_secs> <wnd_dur_secs>] ... ] <key_fn> <key_beg_secs> <key_end_secs> }
+//  }
+//  anchor_decim: <n>  (optional)
 // }
 masRC_t parse_sync_cfg_file( cmCtx_t* c, const cmChar_t* fn, syncCtx_t* scp )
 {
   masRC_t       rc          = kOkMasRC;
   cmJsonNode_t* arr         = NULL;
+  cmJsonNode_t* anchorArr   = NULL;
   const char*   errLabelPtr = NULL;
   unsigned      i,j;
+  cmJsRC_t      jsRC;
+  cmtTrSpan_t   sp;
+  int           anchorDecim = 1;
+
+  cmtFpCfgDefault(&scp->fpCfg);
+  scp->fpMarginSecs = 2.0;
+
+  cmtTrBegin(&sp,kPhaseTrCat,"json_parse",fn);
 
-  if( cmJsonInitializeFromFile( &scp->jsH, fn, c ) != kOkJsRC )
+  jsRC = cmJsonInitializeFromFile( &scp->jsH, fn, c );
+
+  cmtTrEnd(&sp);
+
+  if( jsRC != kOkJsRC )
   {
     rc = cmErrMsg(&c->err,kJsonFailMasRC,"JSON file open failed on '%s'.",cmStringNullGuard(fn));
     goto errLabel;
@@ -1099,12 +2250,29 @@ masRC_t parse_sync_cfg_file( cmCtx_t* c, const cmChar_t* fn, syncCtx_t* scp )
       "key_dir",    kStringTId, &scp->keyDir,
       "hop_ms",     kRealTId,   &scp->hopMs,
       "sync_array", kArrayTId,  &arr,
+      "anchor_array", kArrayTId | kOptArgJsFl, &anchorArr,
+      "anchor_decim", kIntTId   | kOptArgJsFl, &anchorDecim,
+      "fp_index_fn",  kStringTId| kOptArgJsFl, &scp->fpIndexFn,
+      "fp_margin_secs",kRealTId | kOptArgJsFl, &scp->fpMarginSecs,
+      "fp_threshold", kRealTId  | kOptArgJsFl, &scp->fpCfg.threshold,
       NULL ) != kOkJsRC )
   {
     rc = _masJsonFieldNotFoundError(c, "header", errLabelPtr, fn );
     goto errLabel;
   }
 
+  if( anchorDecim < 1 )
+  {
+    rc = cmErrMsg(&c->err,kParamErrMasRC,"The 'anchor_decim' value (%i) in '%s' must be 1 or greater.",anchorDecim,cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  scp->anchorDecim = anchorDecim;
+
+  if( anchorArr != NULL )
+    if((rc = _masParseAnchorArray(c,fn,anchorArr,scp)) != kOkMasRC )
+      goto errLabel;
+
   if((scp->syncArrayCnt = cmJsonChildCount(arr)) == 0 )
     goto errLabel;
 
@@ -1158,6 +2326,7 @@ masRC_t parse_sync_cfg_file( cmCtx_t* c, const cmChar_t* fn, syncCtx_t* scp )
     scp->syncArray[i].keyFn        = keyFn;
     scp->syncArray[i].keyBegSecs   = keyBegSecs;
     scp->syncArray[i].keyEndSecs   = keyEndSecs;
+    scp->syncArray[i].keySyncIdx   = kInvalidSmpIdx;
 
     //printf("beg:%f dur:%f ref:%s key:%s key beg:%f\n",wndBegSecs,wndDurSecs,refFn,keyFn,keyBegSecs);
   }
@@ -1168,6 +2337,7 @@ masRC_t parse_sync_cfg_file( cmCtx_t* c, const cmChar_t* fn, syncCtx_t* scp )
   {
     cmJsonFinalize(&scp->jsH);
     cmMemPtrFree(&scp->syncArray);
+    _masAnchorSetArrayFree(scp);
   }
 
   return rc;
@@ -1189,7 +2359,7 @@ unsigned findFile( const char* fn, unsigned flags, fileRecd_t* array, unsigned f
 }
 
 
-unsigned insertFile( const char* fn, const char* fullFn, unsigned flags, unsigned smpCnt, double srate, fileRecd_t* array, unsigned fcnt )
+unsigned insertFile( const char* fn, const char* fullFn, unsigned flags, long long smpCnt, double srate, fileRecd_t* array, unsigned fcnt )
 {
  
   if( findFile(fn,flags,array,fcnt)==-1 )
@@ -1212,7 +2382,7 @@ unsigned insertFile( const char* fn, const char* fullFn, unsigned flags, unsigne
 }
 
 // calculate the absolute sample index (relative to the master file) of keySmpIdx
-int calcAbsSmpIdx( const fileRecd_t* f )
+long long calcAbsSmpIdx( const fileRecd_t* f )
 {
   // if this file has no master then the absSmpIdx is 0
   if( f->refPtr == NULL )
@@ -1223,7 +2393,7 @@ int calcAbsSmpIdx( const fileRecd_t* f )
     return f->refSmpIdx;
   
   // this file has a master - recurse
-  int v = calcAbsSmpIdx( f->refPtr );
+  long long v = calcAbsSmpIdx( f->refPtr );
 
   // absSmpIdx is the absSmpIdx of the reference plus the difference to this sync point
   // Note that both f->refSmpIdx and f->refPtr->keySmpIdx are both relative to the file pointed to by f->refPtr
@@ -1232,6 +2402,8 @@ int calcAbsSmpIdx( const fileRecd_t* f )
 
 // Write an array of fileRecd_t[] (which was created from the output of sync_files()) to
 // a JSON file which can be read by cmTimeLineReadJson().
+// The libcm time line uses 32 bit sample positions. Time lines with longer
+// positions must be written with the binary format (See masWriteBinTimeLine()).
 masRC_t masWriteJsonTimeLine(
   cmCtx_t*    ctx, 
   double      srate, 
@@ -1281,12 +2453,18 @@ masRC_t masWriteJsonTimeLine(
     const cmChar_t* refLabel    = f->refPtr == NULL ? "" : f->refPtr->label;
     //int             childOffset = f->refPtr == NULL ? 0  : f->absBegSmpIdx - f->refPtr->absBegSmpIdx;
 
+    if( f->absBegSmpIdx < INT_MIN || f->absBegSmpIdx > INT_MAX || f->smpCnt > INT_MAX )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"The time line position of '%s' is outside the range of a JSON time line. Use a binary time line ('.tlb') instead.",cmStringNullGuard(f->fn));
+      goto errLabel;
+    }
+
     if( cmJsonCreateFilledObject(jsH,jnp, 
         "label",kStringTId,f->label,
         "type", kStringTId,typeLabel,
         "ref",  kStringTId,refLabel,
-        "offset",kIntTId,f->absBegSmpIdx,
-        "smpCnt",kIntTId,f->smpCnt,
+        "offset",kIntTId,(int)f->absBegSmpIdx,
+        "smpCnt",kIntTId,(int)f->smpCnt,
         "trackId",kIntTId,f->groupId,
         "textStr",kStringTId,f->fullFn,
         NULL) == NULL )
@@ -1309,6 +2487,46 @@ masRC_t masWriteJsonTimeLine(
   return rc;
 }
 
+// Write an array of fileRecd_t[] to a binary time line file. (See cmtTlBin.h)
+masRC_t masWriteBinTimeLine(
+  cmCtx_t*    ctx,
+  double      srate,
+  fileRecd_t* fileArray,
+  unsigned    fcnt,
+  const char* outFn )
+{
+  masRC_t     rc  = kOkMasRC;
+  cmtTlbWrH_t wrH = cmtTlbWrNullHandle;
+  unsigned    i;
+
+  if( cmtTlbWrCreate(ctx,&wrH,srate) != kOkTlbRC )
+  {
+    rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time_line output initialization failed.");
+    goto errLabel;
+  }
+
+  for(i=0; i<fcnt; ++i)
+  {
+    const fileRecd_t* f = fileArray + i;
+
+    const cmChar_t* typeLabel = cmIsFlag(f->flags,kAudioFl) ? "af" : "mf";
+    const cmChar_t* refLabel  = f->refPtr == NULL ? "" : f->refPtr->label;
+
+    if( cmtTlbWrInsert(wrH,f->label,typeLabel,refLabel,f->absBegSmpIdx,f->smpCnt,f->groupId,f->fullFn) != kOkTlbRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time_line object insert failed on '%s'.",cmStringNullGuard(f->fn));
+      goto errLabel;
+    }
+  }
+
+  if( cmtTlbWrWriteBin(wrH,outFn) != kOkTlbRC )
+    rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time_line write failed on '%s'.",cmStringNullGuard(outFn));
+
+ errLabel:
+  cmtTlbWrDestroy(&wrH);
+  return rc;
+}
+
 const cmChar_t* _masGenTlFileName( const cmChar_t* dir, const cmChar_t* fn, const cmChar_t* ext )
 {
   cmFileSysPathPart_t* pp = cmFsPathParts(fn);
@@ -1340,7 +2558,7 @@ enum
 void  masProcFileArray(
   fileRecd_t* fileArray, 
   unsigned    fcnt,
-  unsigned    smpsBetweenGroups,
+  long long   smpsBetweenGroups,
   unsigned    flags
   )
 {
@@ -1387,11 +2605,11 @@ void  masProcFileArray(
   // Shift all groups to be seperated by secsBetweenGroups.
   if( cmIsFlag(flags,kSequenceGroupsMasFl) )
   {
-    int offsetSmpCnt = 0;
+    long long offsetSmpCnt = 0;
 
     for(i=0; i<groupCnt; ++i)
     {
-      int maxEndSmpIdx = 0;
+      long long maxEndSmpIdx = 0;
 
       for(j=0; j<fcnt; ++j)
         if( fileArray[j].groupId == i )
@@ -1419,6 +2637,13 @@ void  masProcFileArray(
 }
 
 
+// Return true if the audio file of the sync record is locked to its MIDI file.
+// A record whose search begins at the start of the key file locks audio to MIDI.
+// A record proposed by the fingerprint index always locks MIDI to audio - even
+// when its proposed search range begins at the start of the key file.
+bool _masLockAudioToMidi( const syncRecd_t* s )
+{ return s->fpFl == false && s->keyBegSecs == 0; }
+
 masRC_t masCreateTimeLine( 
   cmCtx_t* ctx, 
   const syncCtx_t* scp, 
@@ -1446,16 +2671,17 @@ masRC_t masCreateTimeLine(
     //printf("beg:%f sync:%i dist:%f ref:%s key:%s \n",s->keyBegSecs,s->keySyncIdx,s->syncDist,s->refFn,s->keyFn);
 
     // insert the reference (master) file prior to the dependent (slave) file
-    const char* fn0 =  s->keyBegSecs == 0 ? s->refFn     : s->keyFn;
-    const char* fn1 =  s->keyBegSecs == 0 ? s->keyFn     : s->refFn;
-    unsigned    fl0 =  s->keyBegSecs == 0 ? kMidiFl      : kAudioFl;
-    unsigned    fl1 =  s->keyBegSecs == 0 ? kAudioFl     : kMidiFl;
-    unsigned    sn0 =  s->keyBegSecs == 0 ? s->refSmpCnt : s->keySmpCnt;
-    unsigned    sn1 =  s->keyBegSecs == 0 ? s->keySmpCnt : s->refSmpCnt;
-    const char* dr0 =  s->keyBegSecs == 0 ? refDir       : keyDir;
-    const char* dr1 =  s->keyBegSecs == 0 ? keyDir       : refDir;
-    const char* ex0 =  s->keyBegSecs == 0 ? refExt       : keyExt;
-    const char* ex1 =  s->keyBegSecs == 0 ? keyExt       : refExt;
+    bool        a2mFl = _masLockAudioToMidi(s);
+    const char* fn0 =  a2mFl ? s->refFn     : s->keyFn;
+    const char* fn1 =  a2mFl ? s->keyFn     : s->refFn;
+    unsigned    fl0 =  a2mFl ? kMidiFl      : kAudioFl;
+    unsigned    fl1 =  a2mFl ? kAudioFl     : kMidiFl;
+    long long   sn0 =  a2mFl ? s->refSmpCnt : s->keySmpCnt;
+    long long   sn1 =  a2mFl ? s->keySmpCnt : s->refSmpCnt;
+    const char* dr0 =  a2mFl ? refDir       : keyDir;
+    const char* dr1 =  a2mFl ? keyDir       : refDir;
+    const char* ex0 =  a2mFl ? refExt       : keyExt;
+    const char* ex1 =  a2mFl ? keyExt       : refExt;
 
     const char* ffn0 = _masGenTlFileName( dr0, fn0, ex0 );
     const char* ffn1 = _masGenTlFileName( dr1, fn1, ex1 );
@@ -1476,7 +2702,7 @@ masRC_t masCreateTimeLine(
     fileRecd_t*       mfp = fileArray + mfi;
     fileRecd_t*       afp = fileArray + afi;
 
-    if( s->keyBegSecs == 0 )
+    if( _masLockAudioToMidi(s) )
     {
       // lock audio to midi
       afp->refIdx    = mfi;
@@ -1528,8 +2754,8 @@ masRC_t masCreateTimeLine(
   {
     for(i=0; i<gcnt; ++i)
     {
-      int begSmpIdx = -1;
-      int j;
+      long long begSmpIdx = -1;
+      int       j;
 
       // find the file in groupId==i  with the earliest absolute start time
       for(j=0; j<fcnt; ++j)
@@ -1538,60 +2764,282 @@ masRC_t masCreateTimeLine(
         if( f->groupId==i && (begSmpIdx == -1 || f->absBegSmpIdx < begSmpIdx) )
           begSmpIdx = f->absBegSmpIdx;
 
-      }
+      }
+
+      // subtract the earliest absolute start time from all files in groupId==i
+      for(j=0; j<fcnt; ++j)
+      {
+        fileRecd_t* f = fileArray + j;
+        if( f->groupId == i )
+          f->absBegSmpIdx -= begSmpIdx;
+      }
+    }
+  }
+
+  // fill in the text label assoc'd with each file
+  unsigned   acnt = 0;
+  unsigned   mcnt = 0;
+
+  for(i=0; i<fcnt; ++i)
+  {
+    fileRecd_t* f = fileArray + i;
+
+    if( cmIsFlag(f->flags,kAudioFl) )
+      snprintf(f->label,kLabelCharCnt,"af-%i",acnt++);
+    else
+    {
+      if( cmIsFlag(f->flags,kMidiFl) )
+        snprintf(f->label,kLabelCharCnt,"mf-%i",mcnt++);
+      else
+      { assert(0); }
+    }
+  }
+
+  if( fcnt > 0 )
+  {
+    cmReal_t  srate             = fileArray[0].srate;
+    long long smpsBetweenGroups = floor(secsBetweenGroups * srate );
+    masProcFileArray(fileArray,fcnt,smpsBetweenGroups,procFlags);
+
+    cmtTrSpan_t sp;
+    cmtTrBegin(&sp,kPhaseTrCat,"write",outFn);
+
+    // the output file extension determines the time line file format
+    if( cmtTlbIsBinFn(outFn) )
+      rc = masWriteBinTimeLine(ctx,fileArray[0].srate,fileArray,fcnt,outFn);
+    else
+      rc = masWriteJsonTimeLine(ctx,fileArray[0].srate,fileArray,fcnt,outFn);
+
+    cmtTrEnd(&sp);
+
+    for(i=0; i<fcnt; ++i)
+      cmFsFreeFn(fileArray[i].fullFn);
+  }
+
+  return rc;
+}
+
+
+// Load the key directory fingerprint index from scp->fpIndexFn or build it
+// from the files in scp->keyDir (and then cache it in scp->fpIndexFn).
+masRC_t _masFpLoadIndex( cmCtx_t* ctx, syncCtx_t* scp )
+{
+  if( cmtFpIsValid(scp->fpH) )
+    return kOkMasRC;
+
+  if( scp->fpIndexFn != NULL && cmFsIsFile(scp->fpIndexFn) )
+  {
+    if( cmtFpRead(ctx,&scp->fpH,scp->fpIndexFn) != kOkFpRC )
+      return cmErrMsg(&ctx->err,kFailMasRC,"The fingerprint index '%s' could not be read.",scp->fpIndexFn);
+
+    return kOkMasRC;
+  }
+
+  if( cmtFpCreate(ctx,&scp->fpH,&scp->fpCfg) != kOkFpRC || cmtFpInsertDir(scp->fpH,scp->keyDir) != kOkFpRC )
+    return cmErrMsg(&ctx->err,kFailMasRC,"The fingerprint index of the key directory '%s' could not be created.",cmStringNullGuard(scp->keyDir));
+
+  if( scp->fpIndexFn != NULL )
+    if( cmtFpWrite(scp->fpH,scp->fpIndexFn) != kOkFpRC )
+      return cmErrMsg(&ctx->err,kFailMasRC,"The fingerprint index could not be written to '%s'.",scp->fpIndexFn);
+
+  return kOkMasRC;
+}
+
+// Use the key directory fingerprint index to propose the key file and
+// key search range for each sync record which does not give a key file.
+// The proposal is then refined by slide_match() in sync_files().
+// Only the records in scp->syncArray[begIdx:endIdx] are considered.
+masRC_t _masFpProposeKeys( cmCtx_t* ctx, syncCtx_t* scp, unsigned begIdx, unsigned endIdx )
+{
+  enum { kCandCnt = 5 };
+
+  masRC_t     rc = kOkMasRC;
+  cmtFpCand_t candV[ kCandCnt ];
+  unsigned    i;
+
+  for(i=begIdx; i<endIdx; ++i)
+  {
+    syncRecd_t*       s        = scp->syncArray + i;
+    const cmChar_t*   refFn    = NULL;
+    double*           onsetV   = NULL;
+    unsigned          onsetCnt = 0;
+    unsigned          candN    = 0;
+    long long         frameCnt = 0;
+    cmAudioFileInfo_t afInfo;
+
+    if( s->keyFn != NULL && strlen(s->keyFn) > 0 )
+      continue;
+
+    if((rc = _masFpLoadIndex(ctx,scp)) != kOkMasRC )
+      return rc;
+
+    refFn = cmFsMakeFn(scp->refDir, s->refFn, NULL, NULL);
+
+    if( cmtF32IsFile(refFn) )
+    {
+      cmtF32Info_t f32Info;
+
+      if( cmtF32GetInfo(ctx,refFn,&f32Info) != kOkF32RC )
+      {
+        rc = cmErrMsg(&ctx->err,kFailMasRC,"The ref. float32 file '%s' could not be opened.",cmStringNullGuard(refFn));
+        goto errLabel;
+      }
+
+      afInfo.srate = f32Info.srate;
+      frameCnt     = f32Info.frameCnt;
+    }
+    else
+    {
+      if( cmAudioFileGetInfo(refFn,&afInfo,&ctx->rpt) != kOkAfRC )
+      {
+        rc = cmErrMsg(&ctx->err,kFailMasRC,"The ref. audio file '%s' could not be opened.",cmStringNullGuard(refFn));
+        goto errLabel;
+      }
+
+      frameCnt = afInfo.frameCnt;
+    }
+
+    // locate the reference window as in slide_match()
+    unsigned  wndSmpCnt = floor(s->refWndSecs * afInfo.srate);
+    long long begSmpIdx = 0;
+
+    if( s->refWndBegSecs != 0 )
+      begSmpIdx = floor(s->refWndBegSecs * afInfo.srate);
+    else
+      if( frameCnt >= wndSmpCnt )
+        begSmpIdx = frameCnt/2 - wndSmpCnt/2;
+
+    const cmtFpCfg_t* cfg = cmtFpCfg(scp->fpH);
+
+    if( cmtFpAudioOnsets(ctx,refFn,begSmpIdx,wndSmpCnt,cfg->threshold,cfg->minGapMs,&onsetV,&onsetCnt) != kOkFpRC )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"Onset detection failed on the ref. window of '%s'.",cmStringNullGuard(refFn));
+      goto errLabel;
+    }
+
+    if((candN = cmtFpQuery(scp->fpH,onsetV,onsetCnt,candV,kCandCnt)) == 0 )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The fingerprint index did not locate a key file for the sync record at index %i (%s).",i,s->refFn);
+      goto errLabel;
+    }
+
+    // the location in the key file of the first sample of the ref. window
+    double keySecs = begSmpIdx / afInfo.srate + candV[0].offsSecs;
+
+    s->keyFn      = cmtFpFileName(scp->fpH,candV[0].fileIdx);
+    s->keyBegSecs = cmMax(0.0, keySecs - scp->fpMarginSecs);
+    s->keyEndSecs = keySecs + scp->fpMarginSecs;
+    s->fpFl       = true;
+
+  errLabel:
+    cmMemFree(onsetV);
+    cmFsFreeFn(refFn);
+
+    if( rc != kOkMasRC )
+      return rc;
+  }
+
+  return rc;
+}
+
+// Predict the location (in seconds) in the key file of the reference window of
+// scp->syncArray[i] to seed the slide_match() search order.
+// Returns -1 if no prediction can be made.
+double _masPredictKeySecs( const syncCtx_t* scp, unsigned i )
+{
+  const syncRecd_t* s = scp->syncArray + i;
+
+  // a fingerprint proposal is centered on the search range
+  if( s->fpFl )
+    return (s->keyBegSecs + s->keyEndSecs) / 2;
+
+  // otherwise assume that this ref. file was performed immediately after
+  // the ref. file of the previous record on the same key file
+  if( i == 0 || s->refWndBegSecs == 0 )
+    return -1;
+
+  const syncRecd_t* p = s - 1;
+
+  if( strcmp(p->keyFn,s->keyFn) != 0 || p->keySyncIdx == kInvalidSmpIdx || p->srate == 0 )
+    return -1;
+
+  double pRefBegSecs = p->refWndBegSecs;
+
+  if( pRefBegSecs == 0 && p->refSmpCnt >= p->refWndSecs * p->srate )
+    pRefBegSecs = (p->refSmpCnt / 2 - floor(p->refWndSecs * p->srate)/2) / p->srate;
+
+  return p->keySyncIdx / p->srate - pRefBegSecs + p->refSmpCnt / p->srate + s->refWndBegSecs;
+}
+
+// Return true if the key file of the sync record will be proposed by the fingerprint index.
+bool _masIsFpRecd( const syncRecd_t* s )
+{ return s->fpFl || s->keyFn == NULL || strlen(s->keyFn) == 0; }
+
+// Set the end of the key search range of each sync record.
+// If the cur key fn is the same as the next key file then use the search start
+// location (keyBegSecs) of the next sync recd as the search end
+// location for this file.
+// This is done over all of the records prior to selecting the records
+// of a shard so that every shard uses the same search ranges.
+masRC_t _masSetSearchEnds( cmCtx_t* ctx, syncCtx_t* scp )
+{
+  masRC_t  rc = kOkMasRC;
+  unsigned i;
+
+  for(i=0; i<scp->syncArrayCnt; ++i)
+  {
+    syncRecd_t* s = scp->syncArray + i;
+
+    s->searchEndSecs = s->keyEndSecs;
 
-      // subtract the earliest absolute start time from all files in groupId==i
-      for(j=0; j<fcnt; ++j)
+    if( i < scp->syncArrayCnt-1 && _masIsFpRecd(s)==false && _masIsFpRecd(s+1)==false && strcmp(s->keyFn, s[1].keyFn) == 0 )
+    {
+      s->searchEndSecs = s[1].keyBegSecs;
+
+      if( s->searchEndSecs < s->keyBegSecs )
       {
-        fileRecd_t* f = fileArray + j;
-        if( f->groupId == i )
-          f->absBegSmpIdx -= begSmpIdx;
+        rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The key file search area start times for for multiple sync records referencing the the same key file should increment in time.");        
       }
     }
   }
 
-  // fill in the text label assoc'd with each file
-  unsigned   acnt = 0;
-  unsigned   mcnt = 0;
-
-  for(i=0; i<fcnt; ++i)
-  {
-    fileRecd_t* f = fileArray + i;
+  return rc;
+}
 
-    if( cmIsFlag(f->flags,kAudioFl) )
-      snprintf(f->label,kLabelCharCnt,"af-%i",acnt++);
-    else
-    {
-      if( cmIsFlag(f->flags,kMidiFl) )
-        snprintf(f->label,kLabelCharCnt,"mf-%i",mcnt++);
-      else
-      { assert(0); }
-    }
-  }
+// Match the records of 'shard' or all records if 'shard' is NULL.
+masRC_t sync_files( cmCtx_t* ctx, syncCtx_t* scp, const masShard_t* shard )
+{
+  masRC_t       rc;
+  unsigned      i;
+  masShard_t    all;
+  cmtPrgStage_t prg;
 
-  if( fcnt > 0 )
+  if( shard == NULL )
   {
-    cmReal_t srate             = fileArray[0].srate;
-    unsigned smpsBetweenGroups = floor(secsBetweenGroups * srate );
-    masProcFileArray(fileArray,fcnt,smpsBetweenGroups,procFlags);
+    _masShardSetup(&all,0,1,scp->syncArrayCnt,scp->anchorSetCnt);
+    shard = &all;
+  }
 
-    rc =  masWriteJsonTimeLine(ctx,fileArray[0].srate,fileArray,fcnt,outFn);
+  // the search ends depend on the key files given in the cfg. file and
+  // are therefore set before the fingerprint index proposals are made
+  masRC_t rc1 = _masSetSearchEnds(ctx,scp);
 
-    for(i=0; i<fcnt; ++i)
-      cmFsFreeFn(fileArray[i].fullFn);
-  }
+  // propose key files for records which do not give one
+  if((rc = _masFpProposeKeys(ctx,scp,shard->syncBegIdx,shard->syncEndIdx)) != kOkMasRC )
+    return rc;
 
-  return rc;
-}
+  // a proposed record is searched only within the margin of its proposal
+  for(i=shard->syncBegIdx; i<shard->syncEndIdx; ++i)
+    if( scp->syncArray[i].fpFl )
+      scp->syncArray[i].searchEndSecs = scp->syncArray[i].keyEndSecs;
 
+  rc = rc1;
 
-masRC_t sync_files( cmCtx_t* ctx, syncCtx_t* scp )
-{
-  masRC_t rc = kOkMasRC;
-  unsigned i;
+  cmtPrgBegin(_masPrgH,&prg,NULL,"sync",NULL,0);
+  _masPrgParent = &prg;
 
   // for each syncRecd
-  for(i=0; i<scp->syncArrayCnt; ++i)
+  for(i=shard->syncBegIdx; i<shard->syncEndIdx; ++i)
   {
     syncRecd_t* s = scp->syncArray + i;
 
@@ -1599,34 +3047,55 @@ masRC_t sync_files( cmCtx_t* ctx, syncCtx_t* scp )
     const cmChar_t* refFn  = cmFsMakeFn(scp->refDir, s->refFn,  NULL, NULL);
     const cmChar_t* keyFn  = cmFsMakeFn(scp->keyDir, s->keyFn, NULL, NULL);
     
-    double keyEndSecs = s->keyEndSecs;
+    double keyEndSecs = s->searchEndSecs;
+
+    masRC_t     rc0;
+    cmtTrSpan_t sp;
 
-    // if the cur key fn is the same as the next key file.   Use the search start 
-    // location (keyBegSecs) of the next sync recd as the search end 
-    // location for this file.
-    if( i < scp->syncArrayCnt-1 && strcmp(s->keyFn, scp->syncArray[i+1].keyFn) == 0 )
+    cmtTrBegin(&sp,kFileTrCat,"slide_match",keyFn);
+
+    if((rc0 = slide_match(ctx,refFn,keyFn,s,scp->hopMs,keyEndSecs,_masPredictKeySecs(scp,i))) != kOkMasRC)
     {
-      keyEndSecs = scp->syncArray[i+1].keyBegSecs;
-      
-      if( keyEndSecs < s->keyBegSecs )
-      {
-        rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The key file search area start times for for multiple sync records referencing the the same key file should increment in time.");        
-      }
+      cmErrMsg(&ctx->err,rc0,"Slide match failed on Ref:%s Key:%s.",cmStringNullGuard(refFn),cmStringNullGuard(keyFn));
+      rc = rc0;
     }
 
-    masRC_t rc0;
-    if((rc0 = slide_match(ctx,refFn,keyFn,s,scp->hopMs,floor(keyEndSecs*1000))) != kOkMasRC)
+    cmtTrEnd(&sp);
+
+    printf("\nbeg:%f end:%f sync:%lli dist:%f ref:%s key:%s \n",s->keyBegSecs,keyEndSecs,s->keySyncIdx,s->syncDist,refFn,keyFn);
+
+    cmFsFreeFn(keyFn);
+    cmFsFreeFn(refFn);
+  }
+
+  // for each multi-anchor record
+  for(i=shard->anchorBegIdx; i<shard->anchorEndIdx; ++i)
+  {
+    anchorSetRecd_t* a     = scp->anchorSetArray + i;
+    const cmChar_t*  refFn = cmFsMakeFn(scp->refDir, a->refFn, NULL, NULL);
+    const cmChar_t*  keyFn = cmFsMakeFn(scp->keyDir, a->keyFn, NULL, NULL);
+    masRC_t          rc0;
+    cmtTrSpan_t      sp;
+
+    cmtTrBegin(&sp,kFileTrCat,"anchor_match",keyFn);
+
+    if((rc0 = anchor_match(ctx,refFn,keyFn,a,scp->hopMs,a->keyEndSecs,scp->anchorDecim)) != kOkMasRC )
     {
-      cmErrMsg(&ctx->err,rc0,"Slide match failed on Ref:%s Key:%s.",cmStringNullGuard(refFn),cmStringNullGuard(keyFn));
+      cmErrMsg(&ctx->err,rc0,"Anchor match failed on Ref:%s Key:%s.",cmStringNullGuard(refFn),cmStringNullGuard(keyFn));
       rc = rc0;
     }
 
-    printf("\nbeg:%f end:%f sync:%i dist:%f ref:%s key:%s \n",s->keyBegSecs,keyEndSecs,s->keySyncIdx,s->syncDist,refFn,keyFn);
+    cmtTrEnd(&sp);
+
+    printf("\nanchors:%i drift offs:%f rate:%f ref:%s key:%s \n",a->anchorCnt,a->driftOffsSecs,a->driftRate,refFn,keyFn);
 
     cmFsFreeFn(keyFn);
     cmFsFreeFn(refFn);
   }
 
+  _masPrgParent = NULL;
+  cmtPrgEnd(&prg,rc);
+
   return rc;
 }
 
@@ -1644,6 +3113,8 @@ masRC_t masSyncCtxFinalize(cmCtx_t* ctx, syncCtx_t* scp)
 
   cmMemFree(scp->syncArray);
   scp->syncArrayCnt = 0;
+  _masAnchorSetArrayFree(scp);
+  cmtFpDestroy(&scp->fpH);
   return rc;
 }
 
@@ -1652,7 +3123,7 @@ masRC_t masMidiToImpulse( cmCtx_t* ctx, const masPgmArgs_t* p )
   assert(p->input!=NULL && p->output!=NULL);
 
   if( cmFsIsDir(p->input) )
-    return fileDriver(ctx, kMidiToAudioSelId, p->input, p->output, p->srate, 0, NULL );
+    return fileDriver(ctx, kMidiToAudioSelId, p->input, p->output, "aif", p->srate, 0, NULL );
 
   return midiToAudio(ctx, p->input, p->output, p->srate );  
 }
@@ -1662,7 +3133,7 @@ masRC_t masAudioToOnset( cmCtx_t* ctx, const masPgmArgs_t* p )
   assert(p->input!=NULL && p->output!=NULL);
 
   if( cmFsIsDir(p->input) )
-    return fileDriver(ctx, kAudioOnsetSelId, p->input, p->output, 0, 0,  &p->onsetCfg );
+    return fileDriver(ctx, kAudioOnsetSelId, p->input, p->output, "aif", 0, 0,  &p->onsetCfg );
 
   return audioToOnset(ctx, p->input, p->output, &p->onsetCfg );
 }
@@ -1672,29 +3143,160 @@ masRC_t masConvolve( cmCtx_t* ctx, const masPgmArgs_t* p )
   assert(p->input!=NULL && p->output!=NULL);
 
   if( cmFsIsDir(p->input) )
-    return fileDriver(ctx, kConvolveSelId, p->input, p->output, 0, p->wndMs, NULL );
+    return fileDriver(ctx, kConvolveSelId, p->input, p->output, p->f32Fl ? "f32" : "aif", 0, p->wndMs, NULL );
 
   return convolve(ctx, p->input, p->output, p->wndMs );  
 }
 
 masRC_t masSync( cmCtx_t* ctx, const masPgmArgs_t* p )
 {
-  masRC_t rc = kOkMasRC,rc0;
-  syncCtx_t sc;
+  masRC_t    rc = kOkMasRC,rc0;
+  syncCtx_t  sc;
+  masShard_t shard;
+  unsigned   shardIdx = 0;
+  unsigned   shardCnt = 1;
 
   assert(p->input!=NULL && p->output!=NULL);
 
+  if( p->shard != NULL )
+  {
+    char c;
+    if( sscanf(p->shard,"%u/%u%c",&shardIdx,&shardCnt,&c) != 2 || shardCnt == 0 || shardIdx >= shardCnt )
+      return cmErrMsg(&ctx->err,kParamErrMasRC,"The shard '%s' is not valid. The shard must be given as 'i/N' where 0 <= i < N.",p->shard);
+  }
+
   masSyncCtxInit(&sc);
 
   if( (rc = parse_sync_cfg_file(ctx, p->input, &sc )) == kOkMasRC )
-    if((rc = sync_files(ctx, &sc )) == kOkMasRC )
-      rc = write_sync_json(ctx,&sc,p->output);
+  {
+    _masShardSetup(&shard,shardIdx,shardCnt,sc.syncArrayCnt,sc.anchorSetCnt);
+
+    if((rc = sync_files(ctx, &sc, &shard )) == kOkMasRC )
+      rc = write_sync_json(ctx,&sc,p->output,p->shard==NULL ? NULL : &shard);
+  }
 
   rc0 = masSyncCtxFinalize(ctx,&sc);
 
   return rc!=kOkMasRC ? rc : rc0;
 }
 
+// Combine the partial sync files written by 'mas -y --shard i/N' into a single sync file.
+// Every file in the directory p->input must be a partial sync file and
+// every shard of a single sync must be present.
+masRC_t masMergeSync( cmCtx_t* ctx, const masPgmArgs_t* p )
+{
+  masRC_t              rc          = kOkMasRC;
+  cmFileSysDirEntry_t* dep         = NULL;
+  unsigned             dirEntryCnt = 0;
+  syncCtx_t*           scV         = NULL;   // scV[shardCnt] partial sync records in shard order
+  unsigned             shardCnt    = 0;
+  unsigned             syncArrayCnt= 0;
+  unsigned             anchorSetCnt= 0;
+  syncCtx_t            sc;
+  unsigned             i;
+
+  assert(p->input!=NULL && p->output!=NULL);
+
+  masSyncCtxInit(&sc);
+
+  if( (dep = cmFsDirEntries( p->input, kFileFsFl | kFullPathFsFl, &dirEntryCnt )) == NULL || dirEntryCnt == 0 )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The partial sync directory '%s' could not be read or is empty.",cmStringNullGuard(p->input));
+    goto errLabel;
+  }
+
+  shardCnt = dirEntryCnt;
+  scV      = cmMemAllocZ(syncCtx_t,shardCnt);
+
+  for(i=0; i<shardCnt; ++i)
+    masSyncCtxInit(scV + i);
+
+  for(i=0; i<dirEntryCnt; ++i)
+  {
+    const cmChar_t* fn  = dep[i].name;
+    syncCtx_t       t;
+    cmJsonNode_t*   hnp = NULL;
+    unsigned        idx = 0, cnt = 0, sN = 0, aN = 0;
+    masShard_t      sh;
+
+    masSyncCtxInit(&t);
+
+    if((rc = read_sync_json(ctx,&t,fn)) != kOkMasRC )
+      goto errLabel;
+
+    if((hnp = cmJsonFindValue(t.jsH,"shard",cmJsonFindValue(t.jsH,"sync",cmJsonRoot(t.jsH),kObjectTId),kObjectTId)) == NULL
+      || cmJsonMemberValues(hnp,NULL,
+        "idx",          kIntTId, &idx,
+        "cnt",          kIntTId, &cnt,
+        "syncArrayCnt", kIntTId, &sN,
+        "anchorSetCnt", kIntTId, &aN,
+        NULL) != kOkJsRC )
+    {
+      masSyncCtxFinalize(ctx,&t);
+      rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"The file '%s' is not a partial sync file.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
+
+    if( i == 0 )
+    {
+      syncArrayCnt = sN;
+      anchorSetCnt = aN;
+    }
+
+    _masShardSetup(&sh,idx,cnt,sN,aN);
+
+    // the partial files must be the shards of a single sync and each shard must appear once
+    if( cnt != shardCnt || idx >= cnt || sN != syncArrayCnt || aN != anchorSetCnt || cmJsonIsValid(scV[idx].jsH)
+      || t.syncArrayCnt != sh.syncEndIdx - sh.syncBegIdx || t.anchorSetCnt != sh.anchorEndIdx - sh.anchorBegIdx )
+    {
+      masSyncCtxFinalize(ctx,&t);
+      rc = cmErrMsg(&ctx->err,kParamErrMasRC,"The partial sync file '%s' (shard %i/%i) does not belong with the other %i files in '%s'.",cmStringNullGuard(fn),idx,cnt,shardCnt,cmStringNullGuard(p->input));
+      goto errLabel;
+    }
+
+    scV[idx] = t;
+  }
+
+  // gather the records in shard order - the strings remain owned by the partial JSON trees
+  sc.refDir         = scV[0].refDir;
+  sc.keyDir         = scV[0].keyDir;
+  sc.hopMs          = scV[0].hopMs;
+  sc.syncArrayCnt   = syncArrayCnt;
+  sc.anchorSetCnt   = anchorSetCnt;
+  sc.syncArray      = cmMemAllocZ(syncRecd_t,     cmMax(1,syncArrayCnt));
+  sc.anchorSetArray = cmMemAllocZ(anchorSetRecd_t,cmMax(1,anchorSetCnt));
+
+  for(i=0; i<shardCnt; ++i)
+  {
+    masShard_t sh;
+    _masShardSetup(&sh,i,shardCnt,syncArrayCnt,anchorSetCnt);
+
+    if( scV[i].syncArrayCnt > 0 )
+      memcpy(sc.syncArray + sh.syncBegIdx, scV[i].syncArray, scV[i].syncArrayCnt * sizeof(syncRecd_t));
+
+    if( scV[i].anchorSetCnt > 0 )
+      memcpy(sc.anchorSetArray + sh.anchorBegIdx, scV[i].anchorSetArray, scV[i].anchorSetCnt * sizeof(anchorSetRecd_t));
+  }
+
+  rc = write_sync_json(ctx,&sc,p->output,NULL);
+
+ errLabel:
+  // the anchor arrays are owned by the partial records
+  cmMemFree(sc.syncArray);
+  cmMemFree(sc.anchorSetArray);
+
+  if( scV != NULL )
+    for(i=0; i<shardCnt; ++i)
+      masSyncCtxFinalize(ctx,scV + i);
+
+  cmMemFree(scV);
+
+  if( dep != NULL )
+    cmFsDirFreeEntries(dep);
+
+  return rc;
+}
+
 
 masRC_t masGenTimeLine( cmCtx_t* ctx, const masPgmArgs_t* p )
 {
@@ -1714,18 +3316,303 @@ masRC_t masGenTimeLine( cmCtx_t* ctx, const masPgmArgs_t* p )
   if((rc = read_sync_json(ctx,&sc,p->input)) != kOkMasRC )
     goto errLabel;
 
-  // TODO: Add these as program options, also add a --dry-run option 
-  // 
-  unsigned procFlags = 0; //kZeroBaseTimeMasFl | kSequenceGroupsMasFl | kMakeOneGroupMasFl;
-  double   secsBetweenGroups = 60.0;
+  // TODO: Add these as program options, also add a --dry-run option 
+  // 
+  unsigned procFlags = 0; //kZeroBaseTimeMasFl | kSequenceGroupsMasFl | kMakeOneGroupMasFl;
+  double   secsBetweenGroups = 60.0;
+
+  if((rc = masCreateTimeLine(ctx, &sc, p->output, p->refDir, p->keyDir, p->refExt, p->keyExt, secsBetweenGroups, procFlags)) != kOkMasRC )
+    goto errLabel;
+
+ errLabel:
+  rc0  = masSyncCtxFinalize(ctx,&sc);
+
+  return rc!=kOkMasRC ? rc : rc0;
+}
+
+// Audio file object index used to locate the audio file referenced by each marker.
+typedef struct
+{
+  const cmChar_t* fn;      // audio file name
+  const cmChar_t* label;   // label of the time line object
+  unsigned        seqId;   // time line sequence id
+  long long       begSmpIdx; // begin of the audio file relative to the start of its sequence
+  long long       smpCnt;    // duration of the audio file object
+} masTlAudioFile_t;
+
+typedef struct
+{
+  masTlAudioFile_t* afV;   // afV[afN]
+  unsigned          afN;
+  cmtStrMap_t       fnMap; // audio file name -> index into afV[]
+} masAfIndex_t;
+
+enum { kAfFnCharCnt = 1024 };
+
+typedef struct
+{
+  unsigned        recdIdx; // index of this record in the marker file
+  int             sectId;  // audio file number
+  double          begSecs;
+  double          endSecs;
+  const cmChar_t* text;
+  unsigned        afIdx;   // index into masAfIndex_t.afV[] or cmInvalidIdx if the audio file was not found
+  unsigned        seqId;   // time line sequence id of the audio file
+} masMarker_t;
+
+void _masAfIndexAppend( masAfIndex_t* x, const cmChar_t* fn, const cmChar_t* label, unsigned seqId, long long begSmpIdx, long long smpCnt, unsigned allocN )
+{
+  if( x->afV == NULL )
+  {
+    x->afV = cmMemAllocZ(masTlAudioFile_t,allocN);
+    cmtStrMapInit(&x->fnMap,allocN);
+  }
+
+  x->afV[ x->afN ].fn    = fn;
+  x->afV[ x->afN ].label = label;
+  x->afV[ x->afN ].seqId = seqId;
+  x->afV[ x->afN ].begSmpIdx = begSmpIdx;
+  x->afV[ x->afN ].smpCnt    = smpCnt;
+
+  cmtStrMapInsert(&x->fnMap,fn,x->afN);
+
+  x->afN += 1;
+}
+
+// Index the audio file objects in a libcm time line.
+void _masAfIndexFromTimeLine( masAfIndex_t* x, cmTlH_t tlH )
+{
+  unsigned   seqCnt = cmTimeLineSeqCount(tlH);
+  unsigned   objCnt = 0;
+  unsigned   seqId;
+  cmTlObj_t* op;
+
+  // count the objects to size the index
+  for(seqId=0; seqId<seqCnt; ++seqId)
+    for(op=NULL; (op = cmTimeLineNextObj(tlH,op,seqId)) != NULL; )
+      ++objCnt;
+
+  for(seqId=0; seqId<seqCnt; ++seqId)
+    for(op=NULL; (op = cmTimeLineNextObj(tlH,op,seqId)) != NULL; )
+    {
+      cmTlAudioFile_t* ap;
+      if( op->typeId == kAudioFileTlId && (ap = cmTimeLineAudioFileObjPtr(tlH,op)) != NULL && ap->fn != NULL )
+        _masAfIndexAppend(x,ap->fn,op->name,op->seqId,op->seqSmpIdx,op->durSmpCnt,objCnt);
+    }
+}
+
+// Index the audio file objects in a binary time line.
+void _masAfIndexFromTlb( masAfIndex_t* x, cmtTlbH_t tlbH )
+{
+  unsigned i;
+  unsigned n = cmtTlbObjCount(tlbH);
+
+  for(i=0; i<n; ++i)
+  {
+    const cmtTlbObj_t* o = cmtTlbObj(tlbH,i);
+    if( strcmp(cmtTlbStr(tlbH,o->typeOffs),"af") == 0 )
+      _masAfIndexAppend(x,cmtTlbStr(tlbH,o->textOffs),cmtTlbStr(tlbH,o->labelOffs),o->trackId,cmtTlbObjAbsSmpIdx(tlbH,i),o->smpCnt,n);
+  }
+}
+
+void _masAfIndexFree( masAfIndex_t* x )
+{
+  cmMemPtrFree(&x->afV);
+  cmtStrMapFree(&x->fnMap);
+  x->afN = 0;
+}
+
+// Verify that the audio file name format contains exactly one integer conversion.
+bool _masIsValidAfFmt( const cmChar_t* fmt )
+{
+  unsigned        cnt = 0;
+  const cmChar_t* s;
+
+  for(s=fmt; *s; ++s)
+    if( *s == '%' )
+    {
+      if( s[1] == '%' )
+      {
+        ++s;
+        continue;
+      }
+
+      // skip the flags, width and precision
+      for(++s; *s && strchr("-+ #0123456789.",*s) != NULL; ++s)
+      {}
+
+      if( *s != 'd' && *s != 'i' )
+        return false;
+
+      ++cnt;
+    }
+
+  return cnt == 1;
+}
+
+int _masMarkerCompare( const void* p0, const void* p1 )
+{
+  const masMarker_t* m0 = (const masMarker_t*)p0;
+  const masMarker_t* m1 = (const masMarker_t*)p1;
+
+  if( m0->seqId != m1->seqId )
+    return m0->seqId < m1->seqId ? -1 : 1;
+
+  if( m0->afIdx != m1->afIdx )
+    return m0->afIdx < m1->afIdx ? -1 : 1;
+
+  if( m0->begSecs != m1->begSecs )
+    return m0->begSecs < m1->begSecs ? -1 : 1;
+
+  return m0->recdIdx < m1->recdIdx ? -1 : (m0->recdIdx > m1->recdIdx ? 1 : 0);
+}
+
+// Read the marker records from a marker file, locate the audio file assoc'd
+// with each marker and then sort the markers by sequence and time.
+masRC_t _masReadMarkers( cmCtx_t* ctx, cmJsonH_t jsH, const cmChar_t* mkFn, const cmChar_t* afFmt, const masAfIndex_t* x, masMarker_t** markerVRef, unsigned* markerNRef )
+{
+  masRC_t       rc  = kOkMasRC;
+  cmJsonNode_t* anp = NULL;
+  masMarker_t*  mV  = NULL;
+  unsigned      i,n;
+
+  *markerVRef = NULL;
+  *markerNRef = 0;
+
+  // locate the marker array in the marker file
+  if((anp = cmJsonFindValue(jsH,"markerArray",NULL,kArrayTId)) == NULL )
+    return cmErrMsg(&ctx->err,kJsonFailMasRC,"The marker file is missing a 'markerArray' node in '%s'.",cmStringNullGuard(mkFn));
+
+  if((n = cmJsonChildCount(anp)) == 0 )
+    return rc;
+
+  mV = cmMemAllocZ(masMarker_t,n);
+
+  for(i=0; i<n; ++i)
+  {
+    masMarker_t* m        = mV + i;
+    const char*  errLabel = NULL;
+    cmChar_t     afFn[ kAfFnCharCnt ];
+
+    // read the ith marker record
+    if( cmJsonMemberValues(cmJsonArrayElementC(anp,i), &errLabel,
+      "sect",  kIntTId,    &m->sectId,
+      "beg",   kRealTId,   &m->begSecs,
+      "end",   kRealTId,   &m->endSecs,
+      "label", kStringTId, &m->text,
+      NULL) != kOkJsRC )
+    {
+      if( errLabel != NULL )
+        rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"The field '%s' was missing on the marker record at index %i.",errLabel,i);
+      else
+        rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"An error occurred while reading the marker record at index %i.",i);
+      goto errLabel;
+    }
+
+    snprintf(afFn,kAfFnCharCnt,afFmt,m->sectId);
+
+    m->recdIdx = i;
+    m->seqId   = cmInvalidId;
+
+    // find the audio file this marker refers to in the time line
+    if((m->afIdx = cmtStrMapFind(&x->fnMap,afFn)) == cmInvalidIdx )
+      cmErrWarnMsg(&ctx->err,kParamErrMasRC,"The audio file '%s' associated with the marker record at index %i could not be found in the time line.",afFn,i);
+    else
+      m->seqId = x->afV[ m->afIdx ].seqId;
+  }
+
+  // sort the markers by sequence, audio file and time (unresolved markers sort last)
+  qsort(mV,n,sizeof(masMarker_t),_masMarkerCompare);
+
+  *markerVRef = mV;
+  *markerNRef = n;
+
+ errLabel:
+  if( rc != kOkMasRC )
+    cmMemFree(mV);
+
+  return rc;
+}
+
+// Use the time line index to verify that each marker lies inside its audio file
+// and overlaps at least one MIDI file. Problems are reported as warnings.
+void _masValidateMarkers( cmCtx_t* ctx, cmtTlIdxH_t tlIdxH, double srate, const masAfIndex_t* x, const masMarker_t* mV, unsigned mN )
+{
+  unsigned i;
+
+  for(i=0; i<mN; ++i)
+  {
+    const masMarker_t*      m = mV + i;
+    const masTlAudioFile_t* af;
+
+    if( m->afIdx == cmInvalidIdx )
+      continue;
+
+    af = x->afV + m->afIdx;
+
+    long long begSmpIdx = floor(srate * m->begSecs);
+    long long endSmpIdx = floor(srate * m->endSecs);
+
+    if( begSmpIdx < 0 || endSmpIdx > af->smpCnt )
+      cmErrWarnMsg(&ctx->err,kParamErrMasRC,"The marker at record index %i (%f-%f secs) extends beyond the end of the audio file '%s'.",m->recdIdx,m->begSecs,m->endSecs,af->fn);
+
+    if( cmtTlIdxRange(tlIdxH,m->seqId,af->begSmpIdx+begSmpIdx,af->begSmpIdx+endSmpIdx,kMidiFileTlId,NULL,0) == 0 )
+      cmErrWarnMsg(&ctx->err,kParamErrMasRC,"The marker at record index %i (%f-%f secs) does not overlap any MIDI file in the time line.",m->recdIdx,m->begSecs,m->endSecs);
+  }
+}
+
+// Insert sorted markers into a libcm time line.
+masRC_t _masInsertMarkersTimeLine( cmCtx_t* ctx, cmTlH_t tlH, const masAfIndex_t* x, const masMarker_t* mV, unsigned mN )
+{
+  double   srate = cmTimeLineSampleRate(tlH);
+  unsigned i;
+
+  for(i=0; i<mN; ++i)
+  {
+    const masMarker_t* m = mV + i;
+
+    if( m->afIdx == cmInvalidIdx )
+      continue;
+
+    // convert the marker seconds to samples
+    long long begSmpIdx = floor(srate * m->begSecs);
+    long long durSmpCnt = floor(srate * m->endSecs) - begSmpIdx;
+
+    // the libcm time line uses 32 bit sample positions
+    if( begSmpIdx > INT_MAX || durSmpCnt > UINT_MAX )
+      return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"The marker at record index %i is outside the range of a JSON time line. Use a binary time line ('.tlb') instead.",m->recdIdx);
+
+    // insert the marker into the time line
+    if( cmTimeLineInsert(tlH,cmTsPrintfS("Mark %i",m->recdIdx),kMarkerTlId,m->text,begSmpIdx,durSmpCnt,x->afV[m->afIdx].label,m->seqId) != kOkTlRC )
+      return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Marker record insertion failed for marker at record index %i.",m->recdIdx);
+  }
+
+  return kOkMasRC;
+}
+
+// Insert sorted markers into a binary time line builder.
+masRC_t _masInsertMarkersTlb( cmCtx_t* ctx, cmtTlbWrH_t wrH, double srate, const masAfIndex_t* x, const masMarker_t* mV, unsigned mN )
+{
+  unsigned i;
+
+  for(i=0; i<mN; ++i)
+  {
+    const masMarker_t* m = mV + i;
+    cmChar_t           label[ 32 ];
+
+    if( m->afIdx == cmInvalidIdx )
+      continue;
+
+    long long begSmpIdx = floor(srate * m->begSecs);
+    long long durSmpCnt = floor(srate * m->endSecs) - begSmpIdx;
 
-  if((rc = masCreateTimeLine(ctx, &sc, p->output, p->refDir, p->keyDir, p->refExt, p->keyExt, secsBetweenGroups, procFlags)) != kOkMasRC )
-    goto errLabel;
+    snprintf(label,sizeof(label),"Mark %i",m->recdIdx);
 
- errLabel:
-  rc0  = masSyncCtxFinalize(ctx,&sc);
+    if( cmtTlbWrInsert(wrH,label,"mk",x->afV[m->afIdx].label,begSmpIdx,durSmpCnt,m->seqId,m->text) != kOkTlbRC )
+      return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Marker record insertion failed for marker at record index %i.",m->recdIdx);
+  }
 
-  return rc!=kOkMasRC ? rc : rc0;
+  return kOkMasRC;
 }
 
 // Given a time line file and a marker file, insert the markers in the time line and
@@ -1741,6 +3628,15 @@ masRC_t masGenTimeLine( cmCtx_t* ctx, const masPgmArgs_t* p )
 // NOTES: 
 //  1) beg/end are in seconds, 
 //  2) 'sect' refers to the audio file number (e.g. "Piano_01.wav,Piano_03.wav,Piano_04.wav")
+//  3) The audio file name is formed from 'sect' using the --af_fmt format string
+//     (e.g. "/home/kevin/media/audio/20110723-Kriesberg/Audio Files/Piano 3_%02.2i.wav").
+//  4) The time line audio file objects are indexed once by file name and the markers
+//     are sorted by time prior to being inserted as a single batch.
+//  5) If the input time line is a binary time line (.tlb) then libcm time line
+//     (and the audio files it references) is never loaded.
+//  6) The time line objects are placed in an interval index (cmtTlIndex.h) which is
+//     used to warn about markers that extend past their audio file or that do not
+//     overlap any MIDI file.
 //
 masRC_t masLoadMarkers( cmCtx_t* ctx, const masPgmArgs_t* p )
 {
@@ -1752,14 +3648,48 @@ masRC_t masLoadMarkers( cmCtx_t* ctx, const masPgmArgs_t* p )
   const cmChar_t* tlFn     = p->input;
   const cmChar_t* mkFn     = p->markFn;
   const cmChar_t* outFn    = p->output;
-  const cmChar_t* afFmtStr = "/home/kevin/media/audio/20110723-Kriesberg/Audio Files/Piano 3_%02.2i.wav";
   cmTlH_t         tlH      = cmTimeLineNullHandle;
+  cmtTlbH_t       tlbH     = cmtTlbNullHandle;
+  cmtTlbWrH_t     wrH      = cmtTlbWrNullHandle;
   cmJsonH_t       jsH      = cmJsonNullHandle;
-  cmJsonNode_t*   anp      = NULL;
+  cmtTlIdxH_t     tlIdxH   = cmtTlIdxNullHandle;
+  masAfIndex_t    afx;
+  masMarker_t*    markerV  = NULL;
+  unsigned        markerN  = 0;
+  bool            binFl    = cmtTlbIsBinFn(tlFn);
+
+  memset(&afx,0,sizeof(afx));
+
+  if( p->afFmt == NULL || _masIsValidAfFmt(p->afFmt) == false )
+    return cmErrMsg(&ctx->err,kParamErrMasRC,"A marker audio file name format containing a single integer conversion (e.g. 'Piano 3_%%02i.wav') must be given with 'af_fmt'.");
+
+  // load the time line and index the audio file objects
+  if( binFl )
+  {
+    if( cmtTlbOpen(ctx, &tlbH, tlFn ) != kOkTlbRC )
+      return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time line open failed on '%s'.", cmStringNullGuard(tlFn));
+
+    _masAfIndexFromTlb(&afx,tlbH);
+
+    if( cmtTlIdxFromTlb(ctx,&tlIdxH,tlbH) != kOkTlIdxRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line index creation failed on '%s'.", cmStringNullGuard(tlFn));
+      goto errLabel;
+    }
+  }
+  else
+  {
+    if( cmTimeLineInitializeFromFile(ctx, &tlH, NULL, NULL, tlFn, p->prefixPath ) != kOkTlRC )
+      return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line created failed on '%s'.", cmStringNullGuard(tlFn));
 
-  // create the time line
-  if( cmTimeLineInitializeFromFile(ctx, &tlH, NULL, NULL, tlFn, p->prefixPath ) != kOkTlRC )
-    return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line created failed on '%s'.", cmStringNullGuard(tlFn));
+    _masAfIndexFromTimeLine(&afx,tlH);
+
+    if( cmtTlIdxFromTimeLine(ctx,&tlIdxH,tlH) != kOkTlIdxRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line index creation failed on '%s'.", cmStringNullGuard(tlFn));
+      goto errLabel;
+    }
+  }
 
   // open the marker file
   if( cmJsonInitializeFromFile(&jsH, mkFn, ctx ) != kOkJsRC )
@@ -1768,71 +3698,418 @@ masRC_t masLoadMarkers( cmCtx_t* ctx, const masPgmArgs_t* p )
     goto errLabel;
   }
 
-  // locate the marker array in the marker file
-  if((anp = cmJsonFindValue(jsH,"markerArray",NULL,kArrayTId)) == NULL )
+  // read, resolve and sort the markers
+  if((rc = _masReadMarkers(ctx,jsH,mkFn,p->afFmt,&afx,&markerV,&markerN)) != kOkMasRC )
+    goto errLabel;
+
+  _masValidateMarkers(ctx,tlIdxH,binFl ? cmtTlbSampleRate(tlbH) : cmTimeLineSampleRate(tlH),&afx,markerV,markerN);
+
+  if( binFl )
+  {
+    double srate = cmtTlbSampleRate(tlbH);
+
+    if( cmtTlbWrCreate(ctx,&wrH,srate) != kOkTlbRC || cmtTlbWrInsertTlb(wrH,tlbH) != kOkTlbRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time line copy failed on '%s'.",cmStringNullGuard(tlFn));
+      goto errLabel;
+    }
+
+    if((rc = _masInsertMarkersTlb(ctx,wrH,srate,&afx,markerV,markerN)) != kOkMasRC )
+      goto errLabel;
+
+    // write the time line as a binary or JSON file
+    if( cmtTlbWrWrite(wrH,outFn) != kOkTlbRC )
+    {
+      rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line write to '%s'. failed.",cmStringNullGuard(outFn));
+      goto errLabel;
+    }
+  }
+  else
+  {
+    if((rc = _masInsertMarkersTimeLine(ctx,tlH,&afx,markerV,markerN)) != kOkMasRC )
+      goto errLabel;
+
+    // write the time line as a binary or JSON file
+    if( cmtTlbIsBinFn(outFn) )
+    {
+      if( cmtTlbWriteTimeLine(ctx,tlH,outFn) != kOkTlbRC )
+      {
+        rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Binary time line write to '%s'. failed.",cmStringNullGuard(outFn));
+        goto errLabel;
+      }
+    }
+    else
+    {
+      if( cmTimeLineWrite(tlH,outFn) != kOkTlRC )
+      {
+        rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line write to '%s'. failed.",cmStringNullGuard(outFn));
+        goto errLabel;
+      }
+    }
+  }
+
+ errLabel:
+  cmMemFree(markerV);
+  _masAfIndexFree(&afx);
+  cmtTlIdxDestroy(&tlIdxH);
+  cmJsonFinalize(&jsH);
+  cmtTlbWrDestroy(&wrH);
+  cmtTlbClose(&tlbH);
+  cmTimeLineFinalize(&tlH);
+  return rc;
+}
+
+// Convert a JSON time line to a binary time line or a binary time line to JSON.
+// The direction of the conversion is determined by the input file extension.
+masRC_t masConvertTimeLine( cmCtx_t* ctx, const masPgmArgs_t* p )
+{
+  cmtTlbRC_t rc;
+
+  assert(p->input!=NULL && p->output!=NULL);
+
+  if( cmtTlbIsBinFn(p->input) )
+    rc = cmtTlbBinToJson(ctx,p->input,p->output);
+  else
+    rc = cmtTlbJsonToBin(ctx,p->input,p->output);
+
+  if( rc != kOkTlbRC )
+    return cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line conversion from '%s' to '%s' failed.",cmStringNullGuard(p->input),cmStringNullGuard(p->output));
+
+  return kOkMasRC;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Synthetic sync benchmark
+//
+// Each benchmark case generates a random MIDI file and a 'recording' of it.
+// The recording begins at a known random offset into the audio file, runs
+// slightly fast or slow (drift), places each note with a small random timing
+// error (jitter) and adds noise.  Each note is rendered as a short decaying
+// sine burst so that the onset detector can find it.  The m, a, c and y stages
+// are then run on the generated files and the time taken by each stage and the
+// error of the sync location (relative to the location given by the offset and
+// drift) are reported.
+//----------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+  double   durSecs;      // length of the MIDI file
+  double   srate;        // sample rate of the recording and the MIDI impulse file
+} masBenchCase_t;
+
+static const masBenchCase_t _masBenchCaseArray[] =
+{
+  {   60, 44100 },
+  {   60, 96000 },
+  {  300, 44100 },
+  {  300, 96000 },
+  { 1200, 48000 }
+};
+
+enum
+{
+  kMasBenchTicksPerQN = 1000,   // with the tempo set to 60 BPM one tick is one millisecond
+  kMasBenchBlkSmpCnt  = 65536,  // recording write block size
+  kMasBenchSeed       = 1       // random seed - the generated files are the same on every run
+};
+
+#define kMasBenchHopMs      (25.0)   // sync hop
+#define kMasBenchRefWndSecs (20.0)   // length of the sync reference window
+#define kMasBenchBurstSecs  (0.05)   // length of the sine burst which represents each note
+#define kMasBenchJitterSecs (0.002)  // maximum note timing error
+#define kMasBenchDrift      (5e-5)   // recording clock rate error (50 ppm)
+#define kMasBenchNoiseGain  (0.005)  // recording noise level
+
+typedef struct
+{
+  double       secs;    // location of the note in the MIDI file
+  double       recSecs; // location of the note in the recording
+  cmMidiByte_t pitch;
+  cmMidiByte_t vel;
+} masBenchNote_t;
+
+double _masBenchSecs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+double _masBenchRand( double minV, double maxV )
+{ return minV + (maxV - minV) * rand() / RAND_MAX; }
+
+// Generate the notes of the MIDI file and their location in the recording.
+masBenchNote_t* _masBenchGenNotes( double durSecs, double offsetSecs, unsigned* noteNRef )
+{
+  unsigned        allocN = (unsigned)(durSecs / 0.1) + 1;
+  masBenchNote_t* noteV  = cmMemAllocZ(masBenchNote_t,allocN);
+  unsigned        n      = 0;
+  unsigned        tick   = 500;
+
+  for(; n<allocN && tick < durSecs*1000; tick += (unsigned)_masBenchRand(100,500),++n)
+  {
+    noteV[n].secs    = tick / 1000.0;
+    noteV[n].recSecs = offsetSecs + noteV[n].secs * (1.0 + kMasBenchDrift) + _masBenchRand(-kMasBenchJitterSecs,kMasBenchJitterSecs);
+    noteV[n].pitch   = (cmMidiByte_t)_masBenchRand(36,96);
+    noteV[n].vel     = (cmMidiByte_t)_masBenchRand(30,127);
+  }
+
+  *noteNRef = n;
+  return noteV;
+}
+
+masRC_t _masBenchWriteMidi( cmCtx_t* ctx, const cmChar_t* fn, const masBenchNote_t* noteV, unsigned noteN )
+{
+  masRC_t       rc  = kOkMasRC;
+  cmMidiFileH_t mfH = cmMidiFileNullHandle;
+  unsigned      i;
+
+  if( cmMidiFileCreate(ctx,&mfH,1,kMasBenchTicksPerQN) != kOkMfRC )
+    return cmErrMsg(&ctx->err,kFailMasRC,"The benchmark MIDI file could not be created.");
+
+  if( cmMidiFileInsertTrackTempoMsg(mfH,0,0,60) != kOkMfRC )
   {
-    rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"The marker file is missing a 'markerArray' node in '%s'.",cmStringNullGuard(mkFn));
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The benchmark MIDI tempo could not be set.");
     goto errLabel;
   }
 
-  unsigned i;  
-  unsigned markerCnt = cmJsonChildCount(anp);
-  for(i=0; i<markerCnt; ++i)
+  for(i=0; i<noteN; ++i)
   {
-    int         sectId;
-    double      begSecs;
-    double      endSecs;
-    char*       markText = NULL;
-    const char* errLabel = NULL;
-    cmJsRC_t    jsRC;
+    unsigned tick = (unsigned)round(noteV[i].secs * 1000);
 
-    // read the ith marker record
-    if((jsRC = cmJsonMemberValues(cmJsonArrayElementC(anp,i), &errLabel, 
-      "sect",  kIntTId,    &sectId,
-      "beg",   kRealTId,   &begSecs,
-      "end",   kRealTId,   &endSecs,
-      "label", kStringTId, &markText,
-      NULL)) != kOkJsRC )
+    if( cmMidiFileInsertTrackChMsg(mfH,0,tick,     kNoteOnMdId, noteV[i].pitch,noteV[i].vel) != kOkMfRC
+      || cmMidiFileInsertTrackChMsg(mfH,0,tick + 80,kNoteOffMdId,noteV[i].pitch,0)           != kOkMfRC )
     {
-      if( errLabel != NULL )
-        rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"The field '%s' was missing on the marker record at index %i.",errLabel,i);
-      else
-        rc = cmErrMsg(&ctx->err,kJsonFailMasRC,"An error occurred while reading the marker record at index %i.",i);
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The benchmark MIDI note %i could not be inserted.",i);
       goto errLabel;
     }
+  }
 
-    cmChar_t*        afFn = cmTsPrintfS(afFmtStr,sectId);
-    cmTlAudioFile_t* tlop;
+  if( cmMidiFileWrite(mfH,fn) != kOkMfRC )
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The benchmark MIDI file '%s' could not be written.",cmStringNullGuard(fn));
 
-    // find the audio file this marker refers to in the time line
-    if(( tlop = cmTimeLineFindAudioFile(tlH,afFn)) == NULL )
-      cmErrWarnMsg(&ctx->err,kParamErrMasRC,"The audio file '%s' associated with the marker record at index %i could not be found in the time line.",cmStringNullGuard(afFn),i);
-    else
+ errLabel:
+  cmMidiFileClose(&mfH);
+  return rc;
+}
+
+// Render the recording block by block so that long recordings are not held in memory.
+masRC_t _masBenchWriteRecording( cmCtx_t* ctx, const cmChar_t* fn, double srate, double durSecs, const masBenchNote_t* noteV, unsigned noteN )
+{
+  masRC_t        rc       = kOkMasRC;
+  cmRC_t         afRC;
+  cmAudioFileH_t afH      = cmNullAudioFileH;
+  long long      smpCnt   = (long long)ceil(durSecs * srate);
+  unsigned       burstN   = (unsigned)(kMasBenchBurstSecs * srate);
+  unsigned       ni       = 0;  // first note which may overlap the current block
+  cmSample_t*    buf      = cmMemAllocZ(cmSample_t,kMasBenchBlkSmpCnt);
+  long long      bi;
+
+  if( cmAudioFileIsValid( afH = cmAudioFileNewCreate(fn,srate,16,1,&afRC,&ctx->rpt)) == false )
+  {
+    rc = cmErrMsg(&ctx->err,kFailMasRC,"The benchmark recording '%s' could not be created.",cmStringNullGuard(fn));
+    goto errLabel;
+  }
+
+  for(bi=0; bi<smpCnt; bi+=kMasBenchBlkSmpCnt)
+  {
+    unsigned n = (unsigned)cmMin((long long)kMasBenchBlkSmpCnt,smpCnt-bi);
+    unsigned i,j;
+
+    for(i=0; i<n; ++i)
+      buf[i] = _masBenchRand(-kMasBenchNoiseGain,kMasBenchNoiseGain);
+
+    // skip the notes which end before this block
+    while( ni < noteN && (long long)(noteV[ni].recSecs * srate) + burstN < bi )
+      ++ni;
+
+    // add the notes which begin before the end of this block
+    for(j=ni; j<noteN && (long long)(noteV[j].recSecs * srate) < bi + n; ++j)
     {
-      // convert the marker seconds to samples
-      unsigned begSmpIdx = floor(cmTimeLineSampleRate(tlH) * begSecs);
-      unsigned durSmpCnt = floor(cmTimeLineSampleRate(tlH) * endSecs) - begSmpIdx;
+      long long begSmpIdx = (long long)(noteV[j].recSecs * srate);
+      double    hz        = 440.0 * pow(2.0,(noteV[j].pitch - 69)/12.0);
+      double    gain      = 0.5 * noteV[j].vel / 127.0;
 
-      // insert the marker into the time line
-      if( cmTimeLineInsert(tlH,cmTsPrintfS("Mark %i",i),kMarkerTlId,markText,begSmpIdx,durSmpCnt,tlop->obj.name, tlop->obj.seqId) != kOkTlRC )
+      for(i=0; i<burstN; ++i)
       {
-        rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Marker record insertion failed for marker at record index %i.",i);
-        goto errLabel;
+        long long k = begSmpIdx + i - bi;
+
+        if( 0 <= k && k < n )
+          buf[k] += gain * exp(-8.0*i/burstN) * sin(2*M_PI*hz*i/srate);
       }
     }
-    
+
+    if( cmAudioFileWriteSample(afH,n,1,&buf) != kOkAfRC )
+    {
+      rc = cmErrMsg(&ctx->err,kFailMasRC,"The benchmark recording write failed on '%s'.",cmStringNullGuard(fn));
+      goto errLabel;
+    }
   }
 
-  // write the time line as a JSON file
-  if( cmTimeLineWrite(tlH,outFn) != kOkTlRC )
+ errLabel:
+  if( cmAudioFileIsValid(afH) )
+    cmAudioFileDelete(&afH);
+
+  cmMemFree(buf);
+  return rc;
+}
+
+// Return the index of the first non-zero sample in the audio file or kInvalidSmpIdx if the file is silent.
+long long _masBenchFirstSmpIdx( cmCtx_t* ctx, const cmChar_t* fn )
+{
+  masSrc_t   src;
+  long long  smpIdx = kInvalidSmpIdx;
+  long long  bi;
+  cmSample_t buf[ 4096 ];
+
+  if( _masSrcOpen(ctx,&src,fn) != kOkMasRC )
+    return kInvalidSmpIdx;
+
+  for(bi=0; bi<src.frameCnt && smpIdx==kInvalidSmpIdx; bi+=4096)
   {
-    rc = cmErrMsg(&ctx->err,kTimeLineFailMasRC,"Time line write to '%s'. failed.",cmStringNullGuard(outFn));
+    long long         n = cmMin(4096LL,src.frameCnt-bi);
+    const cmSample_t* v;
+    long long         i;
+
+    if((v = _masSrcSamples(&src,bi,n,buf)) == NULL )
+      break;
+
+    for(i=0; i<n; ++i)
+      if( v[i] != 0 )
+      {
+        smpIdx = bi + i;
+        break;
+      }
+  }
+
+  _masSrcClose(&src);
+  return smpIdx;
+}
+
+// Run one benchmark case in directory 'dir' and append the results to 'fp'.
+masRC_t _masBenchCase( cmCtx_t* ctx, const masPgmArgs_t* p, const cmChar_t* dir, unsigned caseIdx, const masBenchCase_t* c, FILE* fp )
+{
+  masRC_t         rc         = kOkMasRC;
+  unsigned        noteN      = 0;
+  double          offsetSecs = _masBenchRand(5,30);
+  masBenchNote_t* noteV      = _masBenchGenNotes(c->durSecs,offsetSecs,&noteN);
+  double          recSecs    = offsetSecs + c->durSecs * (1.0 + kMasBenchDrift) + 5;
+  cmChar_t        label[32];
+  double          stageSecsV[4];  // m,a,c,y
+  double          t0;
+  syncRecd_t      s;
+
+  snprintf(label,sizeof(label),"case%i",caseIdx);
+
+  const cmChar_t* midiFn   = cmFsMakeFn(dir,label,"mid",NULL);
+  const cmChar_t* recFn    = cmFsMakeFn(dir,label,"aif",NULL);
+  const cmChar_t* refImpFn = cmFsMakeFn(dir,label,"ref_imp.aif",NULL);
+  const cmChar_t* keyImpFn = cmFsMakeFn(dir,label,"key_imp.aif",NULL);
+  const cmChar_t* refCnvFn = cmFsMakeFn(dir,label,"ref_cnv.aif",NULL);
+  const cmChar_t* keyCnvFn = cmFsMakeFn(dir,label,"key_cnv.aif",NULL);
+
+  cmRptPrintf(&ctx->rpt,"Benchmark case %i: %f secs %f Hz notes:%i offset:%f secs\n",caseIdx,c->durSecs,c->srate,noteN,offsetSecs);
+
+  if((rc = _masBenchWriteMidi(ctx,midiFn,noteV,noteN)) != kOkMasRC )
     goto errLabel;
+
+  if((rc = _masBenchWriteRecording(ctx,recFn,c->srate,recSecs,noteV,noteN)) != kOkMasRC )
+    goto errLabel;
+
+  // m - MIDI to impulse file
+  t0 = _masBenchSecs();
+  if((rc = midiToAudio(ctx,midiFn,refImpFn,c->srate)) != kOkMasRC )
+    goto errLabel;
+  stageSecsV[0] = _masBenchSecs() - t0;
+
+  // a - recording to onset impulse file
+  t0 = _masBenchSecs();
+  if((rc = audioToOnset(ctx,recFn,keyImpFn,&p->onsetCfg)) != kOkMasRC )
+    goto errLabel;
+  stageSecsV[1] = _masBenchSecs() - t0;
+
+  // c - convolve both impulse files
+  t0 = _masBenchSecs();
+  if((rc = convolve(ctx,refImpFn,refCnvFn,p->wndMs)) != kOkMasRC )
+    goto errLabel;
+  if((rc = convolve(ctx,keyImpFn,keyCnvFn,p->wndMs)) != kOkMasRC )
+    goto errLabel;
+  stageSecsV[2] = _masBenchSecs() - t0;
+
+  {
+    // The MIDI impulse file is delayed relative to the MIDI file (See midiToAudio()).
+    // The delay is measured at the first impulse which represents the first note.
+    long long refFirstSmpIdx = _masBenchFirstSmpIdx(ctx,refImpFn);
+    double    delaySecs      = refFirstSmpIdx==kInvalidSmpIdx ? 0 : refFirstSmpIdx / c->srate - noteV[0].secs;
+
+    // y - sync a window at the center of the MIDI file to the recording
+    memset(&s,0,sizeof(s));
+    s.refFn         = refCnvFn;
+    s.refWndSecs    = cmMin(kMasBenchRefWndSecs,c->durSecs/4);
+    s.refWndBegSecs = delaySecs + c->durSecs/2 - s.refWndSecs/2;
+    s.keyFn         = keyCnvFn;
+
+    t0 = _masBenchSecs();
+    if((rc = slide_match(ctx,refCnvFn,keyCnvFn,&s,kMasBenchHopMs,0,-1)) != kOkMasRC )
+      goto errLabel;
+    stageSecsV[3] = _masBenchSecs() - t0;
+
+    // slide_match() shortens the window to a multiple of the hop. With drift
+    // the best match is the one which aligns the window centers.
+    long long hopSmpCnt   = (long long)floor(kMasBenchHopMs * c->srate / 1000);
+    long long wndSmpCnt   = ((long long)floor(s.refWndSecs * c->srate) / hopSmpCnt) * hopSmpCnt;
+    double    midiSecs    = (floor(s.refWndBegSecs * c->srate) + wndSmpCnt/2) / c->srate - delaySecs;
+    long long truthSmpIdx = llround((offsetSecs + midiSecs * (1.0 + kMasBenchDrift)) * c->srate) - wndSmpCnt/2;
+    long long errSmpCnt   = s.keySyncIdx - truthSmpIdx;
+    double    totalSecs   = stageSecsV[0] + stageSecsV[1] + stageSecsV[2] + stageSecsV[3];
+
+    cmRptPrintf(&ctx->rpt,"case:%i secs:%f srate:%f m:%f a:%f c:%f y:%f total:%f sync:%lli truth:%lli err:%lli smp %f ms\n",
+      caseIdx,c->durSecs,c->srate,stageSecsV[0],stageSecsV[1],stageSecsV[2],stageSecsV[3],totalSecs,s.keySyncIdx,truthSmpIdx,errSmpCnt,errSmpCnt*1000.0/c->srate);
+
+    fprintf(fp,"%i,%f,%f,%i,%f,%f,%f,%f,%f,%f,%lli,%lli,%lli,%f\n",
+      caseIdx,c->durSecs,c->srate,noteN,stageSecsV[0],stageSecsV[1],stageSecsV[2],stageSecsV[3],totalSecs,s.syncDist,s.keySyncIdx,truthSmpIdx,errSmpCnt,errSmpCnt*1000.0/c->srate);
+    fflush(fp);
   }
 
  errLabel:
-  cmJsonFinalize(&jsH);
-  cmTimeLineFinalize(&tlH);
+  cmFsFreeFn(midiFn);
+  cmFsFreeFn(recFn);
+  cmFsFreeFn(refImpFn);
+  cmFsFreeFn(keyImpFn);
+  cmFsFreeFn(refCnvFn);
+  cmFsFreeFn(keyCnvFn);
+  cmMemFree(noteV);
+  return rc;
+}
+
+// Run the benchmark cases in the directory p->input and write the results as a CSV file to p->output.
+masRC_t masBench( cmCtx_t* ctx, const masPgmArgs_t* p )
+{
+  masRC_t  rc = kOkMasRC;
+  FILE*    fp = NULL;
+  unsigned i;
+
+  assert(p->input!=NULL && p->output!=NULL);
+
+  if( !cmFsIsDir(p->input) )
+    if( cmFsMkDir(p->input) != kOkFsRC )
+      return cmErrMsg(&ctx->err,kFailMasRC,"The benchmark directory '%s' could not be created.",p->input);
+
+  if((fp = fopen(p->output,"w")) == NULL )
+    return cmErrMsg(&ctx->err,kFailMasRC,"The benchmark results file '%s' could not be created.",p->output);
+
+  fprintf(fp,"case,secs,srate,notes,m_secs,a_secs,c_secs,y_secs,total_secs,sync_dist,sync_smp_idx,truth_smp_idx,err_smp,err_ms\n");
+
+  srand(kMasBenchSeed);
+
+  for(i=0; i<sizeof(_masBenchCaseArray)/sizeof(_masBenchCaseArray[0]); ++i)
+    if((rc = _masBenchCase(ctx,p,p->input,i,_masBenchCaseArray + i,fp)) != kOkMasRC )
+    {
+      cmErrMsg(&ctx->err,rc,"Benchmark case %i failed.",i);
+      break;
+    }
+
+  fclose(fp);
   return rc;
 }
 
@@ -1927,7 +4204,13 @@ int main( int argc, char* argv[] )
     kRefExtSelId,
     kKeyExtSelId,
     kMarkFnSelId,
+    kAfFmtSelId,
     kPrefixPathSelId,
+    kF32SelId,
+    kShardSelId,
+    kProgressFdSelId,
+    kMetricsFnSelId,
+    kTraceFnSelId,
   };
 
   const cmChar_t helpStr0[] =
@@ -1964,6 +4247,9 @@ int main( int argc, char* argv[] )
   cmPgmOptInstallEnum(poH, kExecSelId,        'y', "sync",            kReqPoFl,  kSyncSelId,       cmInvalidId, &args.selId,                 1, "Run a synchronization process based on a JSON sync control file and generate a sync. output JSON file..",NULL);
   cmPgmOptInstallEnum(poH, kExecSelId,        'g', "gen_time_line",   kReqPoFl,  kGenTimeLineSelId,cmInvalidId, &args.selId,                 1, "Generate a time-line JSON file from a sync. output JSON file.",NULL);
   cmPgmOptInstallEnum(poH, kExecSelId,        'k', "markers",         kReqPoFl,  kLoadMarkersSelId,cmInvalidId, &args.selId,                 1, "Read markers into the time line.",NULL);
+  cmPgmOptInstallEnum(poH, kExecSelId,        'j', "convert_time_line",kReqPoFl, kConvertTimeLineSelId,cmInvalidId,&args.selId,              1, "Convert a JSON time-line file to a binary (.tlb) time-line file or the reverse.",NULL);
+  cmPgmOptInstallEnum(poH, kExecSelId,        'Y', "merge_sync",      kReqPoFl,  kMergeSyncSelId,  cmInvalidId, &args.selId,                 1, "Combine the partial sync. output files in the input directory (see 'shard') into a single sync. output JSON file.",NULL);
+  cmPgmOptInstallEnum(poH, kExecSelId,        'B', "bench",           kReqPoFl,  kBenchSelId,      cmInvalidId, &args.selId,                 1, "Run the synthetic sync benchmark in the input directory and write the results as a CSV file to the output file.",NULL);
   cmPgmOptInstallEnum(poH, kExecSelId,        'T', "test",            kReqPoFl,  kTestStubSelId,   cmInvalidId, &args.selId,                 1, "Run the test stub.",NULL ),
   cmPgmOptInstallDbl( poH, kWndMsSelId,       'w', "wnd_ms",          0,                           42.0,        &args.wndMs,                 1, "Analysis window look in milliseconds."     );
   cmPgmOptInstallUInt(poH, kHopFactSelId,     'f', "hop_factor",      0,                           4,           &args.onsetCfg.hopFact,      1, "Sliding window hop factor 1=1:1 2=1:2 4=1:4 ...");
@@ -1983,7 +4269,13 @@ int main( int argc, char* argv[] )
   cmPgmOptInstallStr( poH, kRefExtSelId,      'M', "ref_ext",         0,                           NULL,        &args.refExt,                1, "Reference file extension. Only used with 'gen_time_line'.");
   cmPgmOptInstallStr( poH, kKeyExtSelId,      'A', "key_ext",         0,                           NULL,        &args.keyExt,                1, "Key file extension. Only used with 'gen_time_line'.");
   cmPgmOptInstallStr( poH, kMarkFnSelId,      'E', "mark_fn",         0,                           NULL,        &args.markFn,                1, "Marker file name");
+  cmPgmOptInstallStr( poH, kAfFmtSelId,       'F', "af_fmt",          0,                           NULL,        &args.afFmt,                 1, "Marker audio file name printf() format. The marker 'sect' number is the only argument. Only used with 'markers'.");
   cmPgmOptInstallStr( poH, kPrefixPathSelId,  'P', "prefix_path",     0,                           NULL,        &args.prefixPath,            1, "Time Line data file prefix path");
+  cmPgmOptInstallFlag(poH, kF32SelId,         'D', "f32",             0,                           1,           &args.f32Fl,                 1, "Write 'convolve' output files as float32 (.f32) files which 'sync' memory maps. Single output files use the .f32 format when the output file name ends with '.f32'.");
+  cmPgmOptInstallStr( poH, kShardSelId,       'H', "shard",           0,                           NULL,        &args.shard,                 1, "Process only shard 'i/N' of the sync records and write a partial sync. output file. Only used with 'sync'.");
+  cmPgmOptInstallUInt(poH, kProgressFdSelId,  'Q', "progress_fd",     0,                           0,           &args.progressFd,            1, "Write newline delimited JSON progress events to this open file descriptor (e.g. 3 with '3>progress.json'). 0=no events.");
+  cmPgmOptInstallStr( poH, kMetricsFnSelId,   'W', "metrics",         0,                           NULL,        &args.metricsFn,             1, "Write newline delimited JSON progress events to this file.");
+  cmPgmOptInstallStr( poH, kTraceFnSelId,     'L', "trace",           0,                           NULL,        &args.traceFn,               1, "Write a Chrome trace-event JSON file of the time spent in each command, file and processing phase.");
 
 
   if((rc = cmPgmOptRC(poH,kOkPoRC)) != kOkPoRC )
@@ -1992,8 +4284,35 @@ int main( int argc, char* argv[] )
   if( cmPgmOptParse(poH, argc, argv ) != kOkPoRC )
     goto errLabel;
   
+  if( args.progressFd != 0 && args.metricsFn != NULL )
+  {
+    rc = cmErrMsg(&ctx.err,kParamErrMasRC,"Only one of 'progress_fd' and 'metrics' may be given.");
+    goto errLabel;
+  }
+
+  if( args.progressFd != 0 || args.metricsFn != NULL )
+    if((rc = cmtPrgCreate(&ctx,&_masPrgH,args.progressFd!=0 ? (int)args.progressFd : -1,args.metricsFn)) != kOkPrgRC )
+      goto errLabel;
+
+  if( args.traceFn != NULL )
+    if((rc = cmtTrInitialize(&ctx,args.traceFn)) != kOkTrRC )
+      goto errLabel;
+
   if( cmPgmOptHandleBuiltInActions(poH,&ctx.rpt) )
   {
+    cmtTrSpan_t sp;
+    cmtTrBegin(&sp,kActionTrCat,_masSelLabelArray[args.selId],args.input);
+
+    // the onset detector parameters are used by 'onsets' and 'bench'
+    args.onsetCfg.wndMs = args.wndMs;
+    switch( args.onsetCfg.filterId )
+    {
+      case kSmthFiltSelId:   args.onsetCfg.filterId = kSmoothFiltId; break;
+      case kMedianFiltSelId: args.onsetCfg.filterId = kMedianFiltId; break;
+      default:
+        args.onsetCfg.filterId = 0;
+    }
+
     switch( args.selId )
     {
       case kMidiToAudioSelId:
@@ -2001,15 +4320,6 @@ int main( int argc, char* argv[] )
         break;
 
       case kAudioOnsetSelId:
-        args.onsetCfg.wndMs = args.wndMs;
-        switch( args.onsetCfg.filterId )
-        {
-          case kSmthFiltSelId:   args.onsetCfg.filterId = kSmoothFiltId; break;
-          case kMedianFiltSelId: args.onsetCfg.filterId = kMedianFiltId; break;
-          default:
-            args.onsetCfg.filterId = 0;
-        }
-        
         masAudioToOnset(&ctx,&args);
         break;
 
@@ -2029,6 +4339,18 @@ int main( int argc, char* argv[] )
         masLoadMarkers(&ctx,&args);
         break;
 
+      case kConvertTimeLineSelId:
+        masConvertTimeLine(&ctx,&args);
+        break;
+
+      case kMergeSyncSelId:
+        masMergeSync(&ctx,&args);
+        break;
+
+      case kBenchSelId:
+        masBench(&ctx,&args);
+        break;
+
       case kTestStubSelId:
         masTestStub(&ctx,&args);
         break;
@@ -2036,9 +4358,13 @@ int main( int argc, char* argv[] )
       default:
         { assert(0); }
     }
+
+    cmtTrEnd(&sp);
   }
 
  errLabel:
+  cmtTrFinalize();
+  cmtPrgDestroy(&_masPrgH);
   cmPgmOptFinalize(&poH);
   cmTsFinalize();
   cmFsFinalize();
@@ -2082,12 +4408,20 @@ Use Cases:
    c) Convolve impulse files created in a) and b) with a 
       Hann window to widen the impulse width.
 
-      mas -c -i <audio_dir | audio_fn > -o <out_dir> -w <wndMs>
+      mas -c -i <audio_dir | audio_fn > -o <out_dir> -w <wndMs> [-D]
 
       1) If <audio_dir> is given then use all files
          in the directory as input otherwise convert a 
          single file.
       2) <wndMs> gives the width of the Hann window.
+      3) -D writes the output files as dense float32 '.f32' files.
+         A single output file uses this format when its name ends
+         with '.f32'.  The samples are raw little-endian 32 bit floats
+         and the sample rate and count are in the sidecar '<fn>.f32.hdr'.
+         'mas -y' memory maps '.f32' ref. and key files and uses the
+         samples in place.  Name the '.f32' files in the sync cfg file
+         to use them.  Unlike the libcm audio files the '.f32' files
+         may be longer than 2^32 samples (e.g. day long recordings).
       
    d) Synchronize MIDI and Audio based convolved impulse
       files based on their onset patterns.
@@ -2113,6 +4447,19 @@ Use Cases:
             to the key file search area <key_beg_secs> to <key_end_secs> by sliding it 
             in increments of 'hop_ms' samples.
 
+            The search begins at the predicted location of the window and
+            moves outward so that most distant windows are abandoned early.
+            The prediction follows from the previous sync record on the same
+            key file (when <ref_wnd_beg_secs> is non-zero), from the fingerprint
+            proposal (See e.) or from a coarse pass over the search area.
+            The result is the same as a left to right search.
+
+            The best hop aligned window is then refined to the sample level
+            by comparing every sample lag within one hop of the match.  The
+            refined result is not limited to the hop grid, but a coarse hop
+            may still select the wrong hop aligned window.  Check a larger 'hop_ms' against the
+            synthetic benchmark (See 7.) before relying on it.
+
          b. Set 'key_end_secs' to 0 to search to the end of the file.
 
          c. When one key file matches to multiple reference files the
@@ -2131,6 +4478,70 @@ Use Cases:
             how this is used to assign file group id's during the
             time line creation.
 
+         d. To measure drift between a reference and key file several reference
+            windows may be matched against one key search area by adding an
+            optional 'anchor_array' to <sync_cfg_fn.js>:
+
+          anchor_decim : 4   // optional - decimate the key and ref signals (default:1)
+
+          anchor_array :
+          [
+            //   ref_fn   [ [wnd_beg_secs wnd_dur_secs] ...]      key_fn       key_beg_secs key_end_secs
+            [    "1.aif", [ [100,20], [400,20], [700,20] ], "Piano 3_01.aif",     0.0,        0.0 ],
+          ]
+
+            The key search area is read (and decimated) once and every window
+            is scored against it in a single pass. See anchor_match().
+            The decimation factor must evenly divide the hop.  The results are
+            written to an 'anchorArray' in <sync_out_fn.js> which gives the
+            offset of each window and the line fitted to the anchor locations:
+
+               keySecs = driftOffsSecs + driftRate * refSecs
+
+            along with the residual of each anchor from the fitted line.
+
+         e. If a 'sync_array' record gives an empty key file name ("") the key file
+            and search range are proposed by an onset fingerprint index of 'key_dir'
+            (See cmtFpIndex.h).  The onsets in the ref. window are hashed as
+            triplets of inter-onset intervals and matched against the index. The best
+            candidate sets <key_fn> and a search range of 'fp_margin_secs' around the
+            candidate location which is then refined by slide_match().
+
+          fp_index_fn    : "/home/kevin/temp/mas/key.fp"  // optional - fingerprint index cache file
+          fp_margin_secs : 2.0                            // optional - search range margin (default:2)
+          fp_threshold   : 0.1                            // optional - onset peak picking threshold
+
+          sync_array :
+          [
+            [    "5.aif",    0,          30,    "",  0.0,     0.0 ],
+          ]
+
+            The index is built from every file in 'key_dir' the first time it is
+            needed. If 'fp_index_fn' is given and the file exists the index is read
+            from it, otherwise the new index is written to it. Delete the file
+            when the contents of 'key_dir' change.
+
+            Proposed records lock the MIDI file to the audio file (as with a
+            non-zero <key_beg_secs>), even when the proposed search range
+            begins at the start of the key file, and do not take part in the
+            consecutive key file search end rule described in c.
+
+         f. A large sync may be spread over several processes or machines
+            by giving each process one shard of the records:
+
+            mas -y -i <sync_cfg_fn.js> -o <partial_dir>/0.js --shard 0/3
+            mas -y -i <sync_cfg_fn.js> -o <partial_dir>/1.js --shard 1/3
+            mas -y -i <sync_cfg_fn.js> -o <partial_dir>/2.js --shard 2/3
+
+            mas --merge_sync -i <partial_dir> -o <sync_out_fn.js>
+
+            Shard i/N processes a contiguous range of the 'sync_array' and
+            'anchor_array' records and writes only these records along with
+            a 'shard' object to its partial file.  The search ends of c. are
+            set from all of the records before the shard is selected so
+            <sync_out_fn.js> is the same as the output of an unsharded
+            'mas -y'.  <partial_dir> must contain only the N partial files.
+
       3) The <sync_out_fn.js> has the following form.
 
          {
@@ -2165,6 +4576,7 @@ Use Cases:
                  "refSmpCnt" : 200112000     // Count of samples in the reference file.       
                  "keySmpCnt" : 161884800     // Count of samples in the key file.        
                  "srate"     : 96000.000000  // Sample rate of the reference and key file.
+                 "fpFl"      : false         // true if the key file was proposed by the fingerprint index.
                },
              ]    
            }  
@@ -2196,6 +4608,80 @@ Use Cases:
      begins relative to other objects in the group.  Note that the master object in the
      group may not begin at offset 0 if there are slave objects which start before it.
 
+  3) If <time_line_out_fn> uses the extension '.tlb' then a binary time line is
+     written instead of a JSON time line. (See cmtTlBin.h)
+
+  4) The sync and time line sample positions are 64 bit but the JSON time line
+     'offset' and 'smpCnt' values are limited to 32 bits (about 6.2 hours at 96 kHz).
+     Use a binary time line for longer recordings.
+
+3) Convert between JSON and binary time line files.
+
+  mas -j -i <time_line_in_fn> -o <time_line_out_fn>
+
+  If <time_line_in_fn> has the extension '.tlb' it is converted to a JSON time line
+  otherwise the JSON time line is converted to a binary time line.  The conversion
+  is lossless in both directions.
+
+  The binary time line contains a string table, a fixed size object array and
+  byte offsets and is loaded with a single mmap() and no per-object allocation.
+  'mas -g' and 'mas -k' write a binary time line when the output file name uses
+  the '.tlb' extension.
+
+4) Insert markers into a time line.
+
+  mas -k -i <time_line_in_fn> -E <marker_fn> -F <af_fmt> -o <time_line_out_fn>
+
+  <af_fmt> is a printf() format which forms the audio file name referenced by
+  each marker from the marker 'sect' number (e.g. "Piano 3_%02i.wav"). See masLoadMarkers().
+
+5) Machine readable progress events.
+
+  mas <command> ... --progress_fd <fd>
+  mas <command> ... --metrics <events_fn>
+
+  Every command which converts or matches audio files writes one JSON object per
+  line (newline delimited JSON) to the file descriptor <fd> (e.g. 3 with '3>events.json')
+  or to the file <events_fn>.
+
+    {"event":"progress","stage":"convolve","file":"1.aif","smpCnt":96000,"totalSmpCnt":960000,
+     "rdByteCnt":288000,"wrByteCnt":288000,"elapsedSecs":0.25,"smpPerSec":384000,"etaSecs":2.25}
+
+  'event' is "begin", "progress" or "end" and the "end" event includes the result code 'rc'.
+  The stages are "midi_to_impulse", "onsets", "convolve", "filter", "slide_match" and
+  "anchor_match" for single files and "directory" and "sync" for the set of files
+  processed by one command.  The counts of a file stage are included in the counts
+  of its directory or sync stage.  'etaSecs' is null when the total count of samples
+  is not known. "progress" events are written at most twice a second for each stage.
+  The human readable progress percentages are still printed to stdout.
+
+6) Trace where the wall time of a command is spent.
+
+  mas <command> ... --trace <trace_fn.json>
+
+  A Chrome trace-event file is written when the command completes.  It can be
+  viewed with chrome://tracing or https://ui.perfetto.dev.  The nested spans are
+  the command, each file (e.g. each sync record), and the open, decode, search,
+  refine, write, json_parse and json_emit phases.  The audio file reads and writes
+  which run on separate I/O threads are recorded as one 'io' span per stream, on
+  the thread id of the stream, whose arguments give the count of blocks ('ops')
+  and the time spent in the reads or writes ('busy_ms').  Without --trace the spans cost a single flag test.
+
+7) Benchmark the sync speed and accuracy on synthetic files.
+
+  mas -B -i <work_dir> -o <results.csv>
+
+  or 'make bench' from the build directory.
+
+  Each benchmark case generates a random MIDI file and a recording of it which
+  begins at a known random offset (5 to 30 seconds), runs 50 ppm fast, places each
+  note with up to 2 ms of timing error and adds noise.  The m, a, c and y stages are
+  run on the generated files in <work_dir>.  The wall time of each stage and the
+  sync error in samples and milliseconds are printed and written to <results.csv>.
+  The cases cover 1, 5 and 20 minute files at 44.1, 48 and 96 kHz.  The random
+  seed is fixed so every run generates the same files.  The onset detector options
+  (-w,-f,-u,-r,-x,-t,-z,-e,-d) apply to the 'a' stage.
+
 
      
  */